@@ -24,6 +24,7 @@
  */
 
 #include "urpc-data.h"
+#include "urpc-timer.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -35,16 +36,157 @@
 #define HEADER_SIZE   16
 #define MAX_PARAMS    1024
 
+#define BENCHMARK_OPS 1000000
+
 #if defined _MSVC_COMPILER
 #define snprintf sprintf_s
 #endif
 
+/* Измерение времени записи и чтения переменных в зависимости от их числа в буфере.
+   Время одной операции не должно зависеть от числа переменных. */
+static void
+benchmark (uRpcData *urpc_data)
+{
+  static const uint32_t params_nums[] = { 4, 16, 64, 128, 256, 1024, 4096 };
+
+  uRpcTimer *timer = urpc_timer_create ();
+  uint32_t params_num;
+  uint32_t iterations;
+  uint32_t value;
+  double set_time;
+  double get_time;
+  unsigned int i, j, k;
+
+  printf ("%8s %12s %12s\n", "params", "set, ns", "get, ns");
+
+  for (k = 0; k < sizeof (params_nums) / sizeof (params_nums[0]); k++)
+    {
+      params_num = params_nums[k];
+      iterations = BENCHMARK_OPS / params_num;
+      set_time = 0.0;
+      get_time = 0.0;
+
+      for (j = 0; j < iterations; j++)
+        {
+          urpc_data_set_data_size (urpc_data, URPC_DATA_OUTPUT, 0);
+
+          urpc_timer_start (timer);
+          for (i = 0; i < params_num; i++)
+            urpc_data_set_uint32 (urpc_data, 7 * i + 1, i);
+          set_time += urpc_timer_elapsed (timer);
+
+          urpc_data_set_data (urpc_data, URPC_DATA_INPUT,
+                              urpc_data_get_data (urpc_data, URPC_DATA_OUTPUT),
+                              urpc_data_get_data_size (urpc_data, URPC_DATA_OUTPUT));
+
+          urpc_timer_start (timer);
+          for (i = 0; i < params_num; i++)
+            urpc_data_get_uint32 (urpc_data, 7 * (params_num - 1 - i) + 1, &value);
+          get_time += urpc_timer_elapsed (timer);
+        }
+
+      printf ("%8u %12.1f %12.1f\n", params_num,
+              1e9 * set_time / ((double) iterations * params_num),
+              1e9 * get_time / ((double) iterations * params_num));
+    }
+
+  urpc_timer_destroy (timer);
+}
+
+/* Проверка регистрации переменных без копирования. */
+static int
+reserve_test (uRpcData *urpc_data)
+{
+  uint8_t *param1;
+  uint8_t *param2;
+  uint8_t *param;
+  uint32_t size;
+  unsigned int i;
+
+  urpc_data_set_data_size (urpc_data, URPC_DATA_OUTPUT, 0);
+
+  /* Регистрация переменной и заполнение её в буфере передачи. */
+  param1 = urpc_data_reserve (urpc_data, 1, 16);
+  if (param1 == NULL)
+    {
+      printf ("Reserve failed\n");
+      return ERROR_CODE;
+    }
+  memset (param1, 0xA5, 16);
+
+  param2 = urpc_data_reserve (urpc_data, 2, 64);
+  if (param2 == NULL)
+    {
+      printf ("Reserve of second parameter failed\n");
+      return ERROR_CODE;
+    }
+  memset (param2, 0x5A, 64);
+
+  /* Повторная регистрация с тем же размером возвращает ту же переменную и не
+     изменяет её содержимое, в том числе через urpc_data_set с NULL. */
+  if (urpc_data_reserve (urpc_data, 1, 16) != param1 || urpc_data_set (urpc_data, 1, NULL, 16) != param1)
+    {
+      printf ("Repeated reserve returned other address\n");
+      return ERROR_CODE;
+    }
+  for (i = 0; i < 16; i++)
+    if (param1[i] != 0xA5)
+      {
+        printf ("Repeated reserve changed parameter data\n");
+        return ERROR_CODE;
+      }
+
+  /* Размер можно уменьшить только у последней переменной. */
+  if (urpc_data_reserve (urpc_data, 1, 8) != NULL)
+    {
+      printf ("Reserve changed size of not last parameter\n");
+      return ERROR_CODE;
+    }
+  if (urpc_data_reserve (urpc_data, 2, 32) != param2)
+    {
+      printf ("Reserve failed to shrink last parameter\n");
+      return ERROR_CODE;
+    }
+
+  /* Переменная, не помещающаяся в буфер, не регистрируется. */
+  if (urpc_data_reserve (urpc_data, 3, BUFFER_SIZE) != NULL)
+    {
+      printf ("Reserve of oversized parameter succeeded\n");
+      return ERROR_CODE;
+    }
+
+  /* Принятые данные совпадают с записанными в буфер передачи. */
+  urpc_data_set_data (urpc_data, URPC_DATA_INPUT,
+                      urpc_data_get_data (urpc_data, URPC_DATA_OUTPUT),
+                      urpc_data_get_data_size (urpc_data, URPC_DATA_OUTPUT));
+
+  param = urpc_data_get (urpc_data, 1, &size);
+  if (param == NULL || size != 16 || memcmp (param, param1, 16) != 0)
+    {
+      printf ("Reserved parameter 1 mismatch\n");
+      return ERROR_CODE;
+    }
+  param = urpc_data_get (urpc_data, 2, &size);
+  if (param == NULL || size != 32 || memcmp (param, param2, 32) != 0)
+    {
+      printf ("Reserved parameter 2 mismatch\n");
+      return ERROR_CODE;
+    }
+
+  urpc_data_set_data_size (urpc_data, URPC_DATA_OUTPUT, 0);
+  urpc_data_set_data_size (urpc_data, URPC_DATA_INPUT, 0);
+
+  return 0;
+}
+
 int
 main (int    argc,
       char **argv)
 {
   int do_export = 0;
   int do_import = 0;
+  int do_benchmark = 0;
+  int do_reserve = 0;
   int show_help = 0;
 
   uRpcData *urpc_data;
@@ -76,35 +218,55 @@ main (int    argc,
     }
   else
     {
-      for (i = 1; i < argc - 1; i++)
+      for (i = 1; i < argc; i++)
         {
           if ((strcmp (argv[i], "-e") == 0) || strcmp (argv[i], "--export") == 0)
             do_export = 1;
           else if ((strcmp (argv[i], "-i") == 0) || strcmp (argv[i], "--import") == 0)
             do_import = 1;
+          else if ((strcmp (argv[i], "-b") == 0) || strcmp (argv[i], "--benchmark") == 0)
+            do_benchmark = 1;
+          else if ((strcmp (argv[i], "-r") == 0) || strcmp (argv[i], "--reserve") == 0)
+            do_reserve = 1;
           else if ((strcmp (argv[i], "-h") == 0) || strcmp (argv[i], "--help") == 0)
             show_help = 1;
+          else if (i == argc - 1 && argv[i][0] != '-')
+            fio_name = argv[i];
           else
             fprintf (stderr, "%s: unknown option '%s' in command line\n", argv[0], argv[i]);
         }
-      fio_name = argv[argc - 1];
-      if (fio_name[0] == '-')
-        show_help = 1;
     }
 
-  if ((!do_export && !do_import) || (show_help) || (fio_name == NULL))
+  if ((!do_export && !do_import && !do_benchmark && !do_reserve) || (show_help) ||
+      ((do_export || do_import) && (fio_name == NULL)))
     {
       fprintf (stderr, "\nUsage:\n");
       fprintf (stderr, "  %s: [OPTION...] FILE\n\n", argv[0]);
       fprintf (stderr, "Options:\n");
       fprintf (stderr, "  -e, --export     Perform data export\n");
       fprintf (stderr, "  -i, --import     Perform data export\n");
+      fprintf (stderr, "  -b, --benchmark  Measure parameters access time\n");
+      fprintf (stderr, "  -r, --reserve    Check parameters registration without copying\n");
       fprintf (stderr, "\n\n");
       return show_help ? 0 : -1;
     }
 
   urpc_data = urpc_data_create (BUFFER_SIZE, HEADER_SIZE, NULL, NULL, 1);
 
+  if (do_reserve && reserve_test (urpc_data) != 0)
+    exit (ERROR_CODE);
+
+  if (do_benchmark || do_reserve)
+    {
+      if (do_benchmark)
+        benchmark (urpc_data);
+      if (!do_export && !do_import)
+        {
+          urpc_data_destroy (urpc_data);
+          return 0;
+        }
+    }
+
   /* Подготавливаем набор тестовых данных. */
   strings = malloc (MAX_PARAMS * sizeof (char*));
   for (i = 0; i < MAX_PARAMS; i++)
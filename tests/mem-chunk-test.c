@@ -27,10 +27,13 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include "urpc-mem-chunk.h"
+#include "urpc-timer.h"
 
 #define ERROR_CODE -1
 
 #define N_DATA 250000
+#define N_BENCH_OPS 10000000
+#define N_CACHE_SIZE 256
 
 typedef struct
 {
@@ -38,6 +41,44 @@ typedef struct
   uint32_t data[16];
 } TestData;
 
+/* Измерение времени выделения и освобождения памяти. В каждом проходе выделяется
+   n_data объектов, затем освобождается каждый второй и они выделяются повторно,
+   после чего освобождаются все объекты. */
+static void
+benchmark (uRpcMemChunk      *umem_chunk,
+           uRpcMemChunkCache *ucache,
+           TestData         **data,
+           unsigned int       n_data,
+           const char        *name)
+{
+  uRpcTimer *timer = urpc_timer_create ();
+  unsigned int n_rounds = N_BENCH_OPS / n_data;
+  double elapsed;
+  unsigned int i, round;
+
+  urpc_timer_start (timer);
+  for (round = 0; round < n_rounds; round++)
+    {
+      for (i = 0; i < n_data; i++)
+        data[i] = (ucache != NULL) ? urpc_mem_chunk_cache_alloc (ucache) : urpc_mem_chunk_alloc (umem_chunk);
+
+      for (i = 0; i < n_data; i += 2)
+        (ucache != NULL) ? urpc_mem_chunk_cache_free (ucache, data[i]) : urpc_mem_chunk_free (umem_chunk, data[i]);
+
+      for (i = 0; i < n_data; i += 2)
+        data[i] = (ucache != NULL) ? urpc_mem_chunk_cache_alloc (ucache) : urpc_mem_chunk_alloc (umem_chunk);
+
+      for (i = 0; i < n_data; i++)
+        (ucache != NULL) ? urpc_mem_chunk_cache_free (ucache, data[i]) : urpc_mem_chunk_free (umem_chunk, data[i]);
+    }
+  elapsed = urpc_timer_elapsed (timer);
+
+  printf ("%-16s %8u objects: %6.1f ns per alloc/free pair\n", name, n_data,
+          1e9 * elapsed / (n_rounds * (n_data + n_data / 2)));
+
+  urpc_timer_destroy (timer);
+}
+
 int
 main (int    argc,
       char **argv)
@@ -95,7 +136,72 @@ main (int    argc,
         }
     }
 
+  for (i = 0; i < N_DATA; i++)
+    if (urpc_mem_chunk_free (umem_chunk, data[i]) != 0)
+      {
+        printf ("error freeing data %u\n", i);
+        exit (ERROR_CODE);
+      }
+
+  if (urpc_mem_chunk_free (umem_chunk, data[0]) == 0)
+    {
+      printf ("double free not detected\n");
+      exit (ERROR_CODE);
+    }
+
+  /* После освобождения всех объектов большая часть страниц должна быть возвращена системе. */
+  {
+    uRpcMemChunkStats stats;
+
+    urpc_mem_chunk_stats (umem_chunk, &stats);
+    printf ("pages %u (peak %u), empty pages %u, chunks %u (peak %u), fragmentation %.3f\n",
+            stats.pages, stats.peak_pages, stats.empty_pages,
+            stats.chunks, stats.peak_chunks, stats.fragmentation);
+
+    if (stats.chunks != 0 || stats.peak_chunks != N_DATA ||
+        stats.pages != stats.empty_pages || stats.pages > 1 + stats.peak_pages / 8)
+      {
+        printf ("error in mem chunk statistics\n");
+        exit (ERROR_CODE);
+      }
+  }
+
+  /* Объекты выделенные через кеш не должны пересекаться. */
+  {
+    uRpcMemChunkCache *ucache = urpc_mem_chunk_cache_create (umem_chunk, N_CACHE_SIZE);
+
+    for (i = 0; i < N_DATA; i++)
+      {
+        data[i] = urpc_mem_chunk_cache_alloc (ucache);
+        data[i]->id = i;
+      }
+
+    for (i = 0; i < N_DATA; i++)
+      {
+        if (data[i]->id != i)
+          {
+            printf ("cache error in id %u != %u\n", data[i]->id, i);
+            exit (ERROR_CODE);
+          }
+        urpc_mem_chunk_cache_free (ucache, data[i]);
+      }
+
+    urpc_mem_chunk_cache_destroy (ucache);
+  }
+
+  /* Производительность с небольшим числом объектов и со всеми объектами теста. */
+  benchmark (umem_chunk, NULL, data, 64, "mem chunk");
+  benchmark (umem_chunk, NULL, data, N_DATA, "mem chunk");
+
+  {
+    uRpcMemChunkCache *ucache = urpc_mem_chunk_cache_create (umem_chunk, N_CACHE_SIZE);
+    benchmark (umem_chunk, ucache, data, 64, "mem chunk cache");
+    benchmark (umem_chunk, ucache, data, N_DATA, "mem chunk cache");
+    urpc_mem_chunk_cache_destroy (ucache);
+  }
+
   urpc_mem_chunk_destroy (umem_chunk);
+  free (data);
 
   printf ("All done\n");
 
@@ -0,0 +1,291 @@
+/*
+ * uRPC - rpc (remote procedure call) library.
+ *
+ * Copyright 2015 Andrei Fadeev (andrei@webcontrol.ru)
+ *
+ * This file is part of uRPC.
+ *
+ * uRPC is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * uRPC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the author in this case.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "urpc-common.h"
+#include "urpc-timer.h"
+#include "urpc-server.h"
+#include "urpc-client.h"
+
+#if defined(__unix__)
+#include <sys/resource.h>
+#endif
+
+#define URPC_TEST_PROC                     URPC_PROC_USER + 1
+#define URPC_TEST_PARAM_VALUE              URPC_PARAM_USER + 1
+
+#define URPC_TEST_DATA_SIZE                256
+#define URPC_TEST_RESERVED_FDS             64
+
+char *uri = NULL;
+unsigned int clients_num = 50000;
+unsigned int servers_num = 4;
+unsigned int requests_num = 1;
+unsigned int show_help = 0;
+
+void
+help (char *prog_name)
+{
+  printf ("\nUsage:\n");
+  printf ("  %s: [OPTION...] URI\n\n", prog_name);
+  printf ("Options:\n");
+  printf ("  -c, --clients     Number of simultaneously connected clients (default: 50000)\n");
+  printf ("  -t, --threads     Number of working server threads (default: 4)\n");
+  printf ("  -r, --requests    Number of RPC requests per client (default: 1)\n");
+  printf ("\n");
+  printf ("Number of clients is limited by the number of open files allowed to the process\n");
+  printf ("and by the range of local ports available for loopback connections.\n");
+  printf ("\n\n");
+  exit (0);
+}
+
+int
+test_proc (uRpcData *urpc_data,
+           void     *thread_data,
+           void     *session_data,
+           void     *user_data)
+{
+  uint32_t value;
+
+  if (urpc_data_get_uint32 (urpc_data, URPC_TEST_PARAM_VALUE, &value) < 0)
+    return -1;
+
+  urpc_data_set_uint32 (urpc_data, URPC_TEST_PARAM_VALUE, ~value);
+
+  return 0;
+}
+
+/* Функция увеличивает ограничение на число открытых файлов до максимально
+   возможного и возвращает допустимое число клиентов. Для каждого клиента в
+   процессе открываются два сокета: клиентский и серверный. */
+static unsigned int
+max_clients_num (void)
+{
+#if defined(__unix__)
+  struct rlimit limit;
+
+  if (getrlimit (RLIMIT_NOFILE, &limit) < 0)
+    return clients_num;
+
+  if (limit.rlim_cur != limit.rlim_max)
+    {
+      limit.rlim_cur = limit.rlim_max;
+      setrlimit (RLIMIT_NOFILE, &limit);
+      getrlimit (RLIMIT_NOFILE, &limit);
+    }
+
+  if (limit.rlim_cur == RLIM_INFINITY)
+    return clients_num;
+  if (limit.rlim_cur < 2 * URPC_TEST_RESERVED_FDS)
+    return 0;
+
+  return (unsigned int) ((limit.rlim_cur - URPC_TEST_RESERVED_FDS) / 2);
+#else
+  return clients_num;
+#endif
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  uRpcServer *server;
+  uRpcClient **clients;
+  uRpcData *urpc_data;
+  uRpcTimer *timer;
+
+  unsigned int connected = 0;
+  unsigned int max_clients;
+  unsigned int i, j;
+  int fail = 0;
+
+  /* Разбор командной строки. */
+  {
+    int i;
+
+    if (argc == 1)
+      help (argv[0]);
+
+    for (i = 1; i < argc; i++)
+      {
+        if ((strcmp (argv[i], "-h") == 0) || strcmp (argv[i], "--help") == 0)
+          {
+            show_help = 1;
+            continue;
+          }
+
+        if ((strcmp (argv[i], "-c") == 0) || strcmp (argv[i], "--clients") == 0)
+          {
+            i += 1;
+            clients_num = atoi (argv[i]);
+            continue;
+          }
+
+        if ((strcmp (argv[i], "-t") == 0) || strcmp (argv[i], "--threads") == 0)
+          {
+            i += 1;
+            servers_num = atoi (argv[i]);
+            continue;
+          }
+
+        if ((strcmp (argv[i], "-r") == 0) || strcmp (argv[i], "--requests") == 0)
+          {
+            i += 1;
+            requests_num = atoi (argv[i]);
+            continue;
+          }
+
+        if (i == argc - 1)
+          {
+            uri = argv[i];
+            break;
+          }
+
+        fprintf (stderr, "%s: unknown option '%s' in command line\n", argv[0], argv[i]);
+      }
+
+    if (show_help || uri == NULL)
+      help (argv[0]);
+
+    if (urpc_get_type (uri) != URPC_TCP)
+      {
+        printf ("uRPC: only tcp transport is supported by this test\n");
+        return -1;
+      }
+
+    if (servers_num == 0)
+      servers_num = 1;
+  }
+
+  max_clients = max_clients_num ();
+  if (clients_num > max_clients)
+    {
+      printf ("uRPC: number of clients limited to %d due to open files limit\n", max_clients);
+      clients_num = max_clients;
+    }
+
+  server = urpc_server_create (uri, servers_num, clients_num, URPC_DEFAULT_SESSION_TIMEOUT,
+                               URPC_TEST_DATA_SIZE, URPC_DEFAULT_DATA_TIMEOUT);
+  if (server == NULL)
+    {
+      printf ("error creating uRPC server for %d clients\n", clients_num);
+      return -1;
+    }
+
+  urpc_server_add_callback (server, URPC_TEST_PROC, test_proc, NULL);
+
+  if (urpc_server_bind (server) < 0)
+    {
+      printf ("error starting uRPC server\n");
+      return -1;
+    }
+
+  clients = malloc (clients_num * sizeof (uRpcClient *));
+  if (clients == NULL)
+    {
+      printf ("error allocating memory for clients\n");
+      return -1;
+    }
+
+  timer = urpc_timer_create ();
+
+  /* Подключаем клиентов. */
+  urpc_timer_start (timer);
+  for (i = 0; i < clients_num; i++)
+    {
+      clients[i] = urpc_client_create (uri, URPC_TEST_DATA_SIZE, URPC_DEFAULT_DATA_TIMEOUT);
+      if (clients[i] == NULL)
+        {
+          printf ("error creating uRPC client %d\n", i);
+          fail = 1;
+          break;
+        }
+
+      connected += 1;
+
+      if (urpc_client_connect (clients[i]) < 0)
+        {
+          printf ("error connecting uRPC client %d to server\n", i);
+          fail = 1;
+          break;
+        }
+    }
+
+  printf ("uRPC: %d clients connected in %.3lfs\n", connected, urpc_timer_elapsed (timer));
+  fflush (stdout);
+
+  /* Выполняем запросы от всех клиентов по очереди, подключения остаются открытыми. */
+  urpc_timer_start (timer);
+  for (j = 0; j < requests_num && !fail; j++)
+    {
+      for (i = 0; i < clients_num && !fail; i++)
+        {
+          uint32_t value = i ^ (j << 16);
+          uint32_t result = 0;
+
+          urpc_data = urpc_client_lock (clients[i]);
+          if (urpc_data == NULL)
+            {
+              fail = 1;
+              break;
+            }
+
+          urpc_data_set_uint32 (urpc_data, URPC_TEST_PARAM_VALUE, value);
+
+          if (urpc_client_exec (clients[i], URPC_TEST_PROC) != URPC_STATUS_OK)
+            fail = 1;
+          else if (urpc_data_get_uint32 (urpc_data, URPC_TEST_PARAM_VALUE, &result) < 0 || result != ~value)
+            fail = 1;
+
+          urpc_client_unlock (clients[i]);
+
+          if (fail)
+            printf ("client %d failed\n", i);
+        }
+    }
+
+  if (!fail)
+    {
+      printf ("uRPC: %d requests from %d clients in %.3lfs\n",
+              requests_num * clients_num, clients_num, urpc_timer_elapsed (timer));
+      fflush (stdout);
+    }
+
+  /* Отключаем клиентов. */
+  urpc_timer_start (timer);
+  for (i = 0; i < connected; i++)
+    urpc_client_destroy (clients[i]);
+
+  printf ("uRPC: %d clients disconnected in %.3lfs\n", connected, urpc_timer_elapsed (timer));
+
+  urpc_timer_destroy (timer);
+  free (clients);
+
+  urpc_server_destroy (server);
+
+  return fail ? -1 : 0;
+}
@@ -0,0 +1,660 @@
+/*
+ * uRPC - rpc (remote procedure call) library.
+ *
+ * Copyright 2015 Andrei Fadeev (andrei@webcontrol.ru)
+ *
+ * This file is part of uRPC.
+ *
+ * uRPC is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * uRPC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the author in this case.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "urpc-common.h"
+#include "urpc-timer.h"
+#include "urpc-mutex.h"
+#include "urpc-thread.h"
+#include "urpc-server.h"
+#include "urpc-client.h"
+
+#define URPC_BENCH_PROC                    URPC_PROC_USER + 1
+#define URPC_BENCH_PARAM_DATA              URPC_PARAM_USER + 1
+
+#define URPC_BENCH_MAX_LIST                32
+
+/* Запас буфера на служебные параметры запроса и заголовки параметров. */
+#define URPC_BENCH_OVERHEAD                128
+#define URPC_BENCH_PARAM_OVERHEAD          16
+
+/* Список значений параметра сценария. */
+typedef struct
+{
+  unsigned int         num;
+  unsigned int         values[URPC_BENCH_MAX_LIST];
+} uRpcBenchList;
+
+/* Сценарий и его результаты. */
+typedef struct
+{
+  const char          *transport;
+  unsigned int         payload_size;
+  unsigned int         params_num;
+  unsigned int         clients_num;
+  unsigned int         servers_num;
+
+  uint64_t             requests;
+  uint64_t             errors;
+  double               elapsed;
+  uRpcHistogram        latency;
+} uRpcBenchResult;
+
+/* Состояние клиентского потока. */
+typedef struct
+{
+  const char          *uri;
+  uRpcBenchResult     *result;
+  uint64_t             requests;
+  uint64_t             errors;
+  uRpcHistogram        latency;
+  int                  fail;
+} uRpcBenchClient;
+
+char *transports = "udp,tcp,shm";
+char *port = "12347";
+char *output = NULL;
+uRpcBenchList sizes;
+uRpcBenchList clients;
+uRpcBenchList servers;
+uRpcBenchList params;
+double duration = 0.5;
+double timeout = 1.0;
+unsigned int max_requests = 0;
+unsigned int json = 0;
+unsigned int show_help = 0;
+
+FILE *out = NULL;
+unsigned int rows_num = 0;
+
+volatile unsigned int ready_clients = 0;
+volatile int start = 0;
+volatile double start_time = 0.0;
+uRpcMutex lock;
+
+void
+help (char *prog_name)
+{
+  printf ("\nUsage:\n");
+  printf ("  %s: [OPTION...]\n\n", prog_name);
+  printf ("Options:\n");
+  printf ("  --transports      Comma separated list of transports (default: udp,tcp,shm)\n");
+  printf ("  --port            TCP and UDP port on localhost (default: 12347)\n");
+  printf ("  -s, --sizes       Payload sizes, K and M suffixes allowed (default: 64,1K,16K,64K,1M,16M)\n");
+  printf ("  -c, --clients     Numbers of client threads (default: 1,4)\n");
+  printf ("  --servers         Numbers of working server threads (default: 1,4)\n");
+  printf ("  -p, --params      Numbers of parameters the payload is split into (default: 1,16)\n");
+  printf ("  --time            Duration of every scenario in seconds (default: 0.5)\n");
+  printf ("  --timeout         Timeout for RPC requests in seconds (default: 1.0)\n");
+  printf ("  -r, --requests    Maximum number of RPC requests per client in scenario (default: unlimited)\n");
+  printf ("  --json            Output results as JSON (default: CSV)\n");
+  printf ("  -o, --output      Output file (default: standard output)\n");
+  printf ("\n");
+  printf ("Payload is limited by the transport maximum data size, the actual size is reported.\n");
+  printf ("Latency is reported in microseconds, throughput counts payload in both directions.\n");
+  printf ("\n\n");
+  exit (0);
+}
+
+/* Разбор списка значений вида "64,1K,16M". */
+int
+parse_list (const char    *str,
+            uRpcBenchList *list)
+{
+  char *end;
+
+  list->num = 0;
+  while (*str != 0)
+    {
+      unsigned long value = strtoul (str, &end, 10);
+
+      if (end == str || list->num == URPC_BENCH_MAX_LIST)
+        return -1;
+
+      if (*end == 'K' || *end == 'k')
+        value *= 1024, end++;
+      else if (*end == 'M' || *end == 'm')
+        value *= 1024 * 1024, end++;
+
+      if (*end == ',')
+        end++;
+      else if (*end != 0)
+        return -1;
+
+      list->values[list->num++] = value;
+      str = end;
+    }
+
+  return list->num > 0 ? 0 : -1;
+}
+
+/* Процедура возвращает клиенту все принятые параметры. */
+int
+bench_proc (uRpcData *urpc_data,
+            void     *thread_data,
+            void     *session_data,
+            void     *user_data)
+{
+  uint32_t param_id;
+
+  for (param_id = URPC_BENCH_PARAM_DATA;; param_id++)
+    {
+      uint8_t *idata;
+      uint8_t *odata;
+      uint32_t size;
+
+      idata = urpc_data_get (urpc_data, param_id, &size);
+      if (idata == NULL)
+        break;
+
+      odata = urpc_data_reserve (urpc_data, param_id, size);
+      if (odata == NULL)
+        return -1;
+
+      memcpy (odata, idata, size);
+    }
+
+  return 0;
+}
+
+void *
+bench_client_proc (void *data)
+{
+  uRpcBenchClient *bench = data;
+  uRpcBenchResult *result = bench->result;
+  uRpcClient *client;
+  uRpcData *urpc_data;
+  uint8_t *payload;
+  uint32_t param_size;
+  uint32_t size;
+  unsigned int i;
+
+  param_size = result->payload_size / result->params_num;
+
+  payload = malloc (result->payload_size);
+  client = urpc_client_create (bench->uri,
+                               result->payload_size + URPC_BENCH_OVERHEAD +
+                               result->params_num * URPC_BENCH_PARAM_OVERHEAD,
+                               timeout);
+  if (payload == NULL || client == NULL || urpc_client_connect (client) < 0)
+    bench->fail = 1;
+  else
+    for (i = 0; i < result->payload_size; i++)
+      payload[i] = i;
+
+  urpc_mutex_lock (&lock);
+  ready_clients += 1;
+  urpc_mutex_unlock (&lock);
+
+  while (!start);
+
+  while (!bench->fail)
+    {
+      double begin;
+      double end;
+      uint32_t status;
+
+      if (max_requests > 0 && bench->requests >= max_requests)
+        break;
+      if (bench->requests > 0 && urpc_timer_get_monotonic_time () - start_time >= duration)
+        break;
+
+      urpc_data = urpc_client_lock (client);
+      if (urpc_data == NULL)
+        {
+          bench->fail = 1;
+          break;
+        }
+
+      /* Последний параметр содержит остаток данных. */
+      for (i = 0; i < result->params_num; i++)
+        {
+          size = (i == result->params_num - 1) ? result->payload_size - i * param_size : param_size;
+          urpc_data_set (urpc_data, URPC_BENCH_PARAM_DATA + i, payload + i * param_size, size);
+        }
+
+      begin = urpc_timer_get_monotonic_time ();
+      status = urpc_client_exec (client, URPC_BENCH_PROC);
+      end = urpc_timer_get_monotonic_time ();
+
+      bench->requests += 1;
+      if (status != URPC_STATUS_OK ||
+          urpc_data_get (urpc_data, URPC_BENCH_PARAM_DATA, &size) == NULL ||
+          size != param_size)
+        bench->errors += 1;
+      else
+        urpc_histogram_add (&bench->latency, (uint64_t) (1e9 * (end - begin)));
+
+      urpc_client_unlock (client);
+
+      /* После ошибки передачи подключение к серверу разорвано. Потерянные
+         UDP запросы учитываются как ошибки, обмен продолжается. */
+      if (status == URPC_STATUS_TRANSPORT_ERROR)
+        bench->fail = 1;
+    }
+
+  if (client != NULL)
+    urpc_client_destroy (client);
+  free (payload);
+
+  return NULL;
+}
+
+/* Запуск сервера, общего для сценариев с одинаковым размером данных и числом потоков. */
+uRpcServer *
+bench_server_start (const char *uri,
+                    uint32_t    servers_num,
+                    uint32_t    clients_num,
+                    uint32_t    data_size)
+{
+  uRpcServer *server;
+
+  server = urpc_server_create (uri, servers_num, clients_num + 1,
+                               URPC_DEFAULT_SESSION_TIMEOUT, data_size, URPC_DEFAULT_DATA_TIMEOUT);
+  if (server == NULL)
+    return NULL;
+
+  urpc_server_add_callback (server, URPC_BENCH_PROC, bench_proc, NULL);
+
+  if (urpc_server_bind (server) < 0)
+    {
+      urpc_server_destroy (server);
+      return NULL;
+    }
+
+  return server;
+}
+
+/* Выполнение сценария клиентскими потоками. */
+int
+bench_run (const char      *uri,
+           uRpcBenchResult *result)
+{
+  uRpcThread **threads;
+  uRpcBenchClient *benches;
+  unsigned int local_ready_clients;
+  unsigned int i;
+  int fail = 0;
+
+  threads = calloc (result->clients_num, sizeof (uRpcThread *));
+  benches = calloc (result->clients_num, sizeof (uRpcBenchClient));
+  if (threads == NULL || benches == NULL)
+    {
+      free (threads);
+      free (benches);
+      return -1;
+    }
+
+  ready_clients = 0;
+  start = 0;
+
+  for (i = 0; i < result->clients_num; i++)
+    {
+      benches[i].uri = uri;
+      benches[i].result = result;
+      threads[i] = urpc_thread_create (bench_client_proc, &benches[i]);
+      if (threads[i] == NULL)
+        {
+          fail = 1;
+          break;
+        }
+    }
+
+  /* Ожидаем подключения всех клиентов. */
+  do
+    {
+      urpc_mutex_lock (&lock);
+      local_ready_clients = ready_clients;
+      urpc_mutex_unlock (&lock);
+    }
+  while (!fail && local_ready_clients != result->clients_num);
+
+  start_time = urpc_timer_get_monotonic_time ();
+  start = 1;
+
+  for (i = 0; i < result->clients_num; i++)
+    if (threads[i] != NULL)
+      urpc_thread_destroy (threads[i]);
+
+  result->elapsed = urpc_timer_get_monotonic_time () - start_time;
+
+  for (i = 0; i < result->clients_num; i++)
+    {
+      result->requests += benches[i].requests;
+      result->errors += benches[i].errors;
+      urpc_histogram_merge (&result->latency, &benches[i].latency);
+      if (benches[i].fail)
+        fail = 1;
+    }
+
+  free (threads);
+  free (benches);
+
+  return fail ? -1 : 0;
+}
+
+void
+print_header (void)
+{
+  if (json)
+    fprintf (out, "[\n");
+  else
+    fprintf (out, "transport,payload,params,clients,servers,requests,errors,seconds,"
+                  "rps,mbps,p50_us,p99_us,p999_us,max_us\n");
+}
+
+void
+print_result (uRpcBenchResult *result)
+{
+  double rps = result->requests / result->elapsed;
+  double mbps = 2.0 * rps * result->payload_size / (1024.0 * 1024.0);
+  double p50 = urpc_histogram_get_percentile (&result->latency, 50.0) / 1000.0;
+  double p99 = urpc_histogram_get_percentile (&result->latency, 99.0) / 1000.0;
+  double p999 = urpc_histogram_get_percentile (&result->latency, 99.9) / 1000.0;
+  double max = result->latency.max / 1000.0;
+
+  if (json)
+    fprintf (out, "%s  {\"transport\": \"%s\", \"payload\": %u, \"params\": %u, \"clients\": %u, "
+                  "\"servers\": %u, \"requests\": %llu, \"errors\": %llu, \"seconds\": %.3lf, "
+                  "\"rps\": %.0lf, \"mbps\": %.2lf, \"p50_us\": %.1lf, \"p99_us\": %.1lf, "
+                  "\"p999_us\": %.1lf, \"max_us\": %.1lf}",
+             rows_num > 0 ? ",\n" : "", result->transport, result->payload_size, result->params_num,
+             result->clients_num, result->servers_num, (unsigned long long) result->requests,
+             (unsigned long long) result->errors, result->elapsed, rps, mbps, p50, p99, p999, max);
+  else
+    fprintf (out, "%s,%u,%u,%u,%u,%llu,%llu,%.3lf,%.0lf,%.2lf,%.1lf,%.1lf,%.1lf,%.1lf\n",
+             result->transport, result->payload_size, result->params_num,
+             result->clients_num, result->servers_num, (unsigned long long) result->requests,
+             (unsigned long long) result->errors, result->elapsed, rps, mbps, p50, p99, p999, max);
+
+  fflush (out);
+  rows_num += 1;
+}
+
+void
+print_footer (void)
+{
+  if (json)
+    fprintf (out, "%s]\n", rows_num > 0 ? "\n" : "");
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  char *transport;
+  char *next;
+  uint32_t max_clients = 1;
+  uint32_t max_params = 1;
+  unsigned int i;
+  int fail = 0;
+
+  parse_list ("64,1K,16K,64K,1M,16M", &sizes);
+  parse_list ("1,4", &clients);
+  parse_list ("1,4", &servers);
+  parse_list ("1,16", &params);
+
+  /* Разбор командной строки. */
+  {
+
+    for (i = 1; i < (unsigned int) argc; i++)
+      {
+        if ((strcmp (argv[i], "-h") == 0) || strcmp (argv[i], "--help") == 0)
+          {
+            show_help = 1;
+            continue;
+          }
+
+        if (strcmp (argv[i], "--json") == 0)
+          {
+            json = 1;
+            continue;
+          }
+
+        /* Остальные параметры имеют значение. */
+        if (i == (unsigned int) argc - 1)
+          {
+            fprintf (stderr, "%s: unknown option '%s' in command line\n", argv[0], argv[i]);
+            show_help = 1;
+            break;
+          }
+
+        if (strcmp (argv[i], "--transports") == 0)
+          {
+            i += 1;
+            transports = argv[i];
+            continue;
+          }
+
+        if (strcmp (argv[i], "--port") == 0)
+          {
+            i += 1;
+            port = argv[i];
+            continue;
+          }
+
+        if ((strcmp (argv[i], "-s") == 0) || strcmp (argv[i], "--sizes") == 0)
+          {
+            i += 1;
+            if (parse_list (argv[i], &sizes) < 0)
+              show_help = 1;
+            continue;
+          }
+
+        if ((strcmp (argv[i], "-c") == 0) || strcmp (argv[i], "--clients") == 0)
+          {
+            i += 1;
+            if (parse_list (argv[i], &clients) < 0)
+              show_help = 1;
+            continue;
+          }
+
+        if (strcmp (argv[i], "--servers") == 0)
+          {
+            i += 1;
+            if (parse_list (argv[i], &servers) < 0)
+              show_help = 1;
+            continue;
+          }
+
+        if ((strcmp (argv[i], "-p") == 0) || strcmp (argv[i], "--params") == 0)
+          {
+            i += 1;
+            if (parse_list (argv[i], &params) < 0)
+              show_help = 1;
+            continue;
+          }
+
+        if (strcmp (argv[i], "--time") == 0)
+          {
+            i += 1;
+            duration = atof (argv[i]);
+            continue;
+          }
+
+        if (strcmp (argv[i], "--timeout") == 0)
+          {
+            i += 1;
+            timeout = atof (argv[i]);
+            continue;
+          }
+
+        if ((strcmp (argv[i], "-r") == 0) || strcmp (argv[i], "--requests") == 0)
+          {
+            i += 1;
+            max_requests = atoi (argv[i]);
+            continue;
+          }
+
+        if ((strcmp (argv[i], "-o") == 0) || strcmp (argv[i], "--output") == 0)
+          {
+            i += 1;
+            output = argv[i];
+            continue;
+          }
+
+        fprintf (stderr, "%s: unknown option '%s' in command line\n", argv[0], argv[i]);
+        show_help = 1;
+      }
+
+    if (show_help)
+      help (argv[0]);
+  }
+
+  out = (output != NULL) ? fopen (output, "w") : stdout;
+  if (out == NULL)
+    {
+      fprintf (stderr, "error opening output file '%s'\n", output);
+      return -1;
+    }
+
+  /* Серверы рассчитываются на наибольшее число клиентов и параметров. */
+  for (i = 0; i < clients.num; i++)
+    if (clients.values[i] > max_clients)
+      max_clients = clients.values[i];
+  for (i = 0; i < params.num; i++)
+    if (params.values[i] > max_params)
+      max_params = params.values[i];
+
+  urpc_mutex_init (&lock);
+
+  print_header ();
+
+  /* Перебор сценариев по всем транспортам. */
+  for (transport = transports; transport != NULL && *transport != 0; transport = next)
+    {
+      char name[16];
+      char uri[MAX_HOST_LEN];
+      uint32_t max_payload;
+      unsigned int clamped = 0;
+      unsigned int is, ic, iv, ip;
+      size_t len;
+
+      next = strchr (transport, ',');
+      len = (next != NULL) ? (size_t) (next - transport) : strlen (transport);
+      if (next != NULL)
+        next += 1;
+
+      snprintf (name, sizeof (name), "%.*s", (int) len, transport);
+
+      if (strcmp (name, "udp") == 0)
+        {
+          snprintf (uri, sizeof (uri), "udp://localhost:%s", port);
+          max_payload = URPC_DEFAULT_DATA_SIZE;
+        }
+      else if (strcmp (name, "tcp") == 0)
+        {
+          snprintf (uri, sizeof (uri), "tcp://localhost:%s", port);
+          max_payload = URPC_MAX_DATA_SIZE;
+        }
+      else if (strcmp (name, "shm") == 0)
+        {
+          snprintf (uri, sizeof (uri), "shm://urpc-bench-%s", port);
+          max_payload = URPC_MAX_DATA_SIZE;
+        }
+      else
+        {
+          fprintf (stderr, "unknown transport '%s'\n", name);
+          fail = 1;
+          continue;
+        }
+
+      max_payload -= URPC_BENCH_OVERHEAD;
+
+      for (is = 0; is < sizes.num; is++)
+        {
+          /* Размеры выше ограничения транспорта сводятся к максимальному,
+             повторные сценарии с тем же размером пропускаются. */
+          if (sizes.values[is] > max_payload)
+            {
+              if (clamped)
+                continue;
+              clamped = 1;
+            }
+
+          for (iv = 0; iv < servers.num; iv++)
+            {
+              uRpcServer *server;
+              uint32_t servers_num = servers.values[iv] > 0 ? servers.values[iv] : 1;
+              uint32_t data_size = sizes.values[is] + max_params * URPC_BENCH_PARAM_OVERHEAD;
+
+              if (data_size > max_payload)
+                data_size = max_payload;
+
+              server = bench_server_start (uri, servers_num, max_clients, data_size + URPC_BENCH_OVERHEAD);
+              if (server == NULL)
+                {
+                  fprintf (stderr, "%s: error starting server, data size %u, threads %u\n",
+                           name, data_size, servers_num);
+                  fail = 1;
+                  continue;
+                }
+
+              for (ip = 0; ip < params.num; ip++)
+                for (ic = 0; ic < clients.num; ic++)
+                  {
+                    uRpcBenchResult result;
+                    uint32_t limit;
+
+                    memset (&result, 0, sizeof (result));
+                    result.transport = name;
+                    result.servers_num = servers_num;
+                    result.params_num = params.values[ip] > 0 ? params.values[ip] : 1;
+                    result.clients_num = clients.values[ic] > 0 ? clients.values[ic] : 1;
+
+                    limit = max_payload - result.params_num * URPC_BENCH_PARAM_OVERHEAD;
+                    result.payload_size = (sizes.values[is] > limit) ? limit : sizes.values[is];
+                    if (result.payload_size == 0)
+                      result.payload_size = 1;
+                    if (result.params_num > result.payload_size)
+                      result.params_num = result.payload_size;
+
+                    if (bench_run (uri, &result) < 0)
+                      {
+                        fprintf (stderr, "%s: scenario failed, payload %u, params %u, clients %u, servers %u\n",
+                                 name, result.payload_size, result.params_num,
+                                 result.clients_num, result.servers_num);
+                        fail = 1;
+                      }
+
+                    print_result (&result);
+                  }
+
+              urpc_server_destroy (server);
+            }
+        }
+    }
+
+  print_footer ();
+
+  if (out != stdout)
+    fclose (out);
+
+  urpc_mutex_clear (&lock);
+
+  return fail ? -1 : 0;
+}
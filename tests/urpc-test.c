@@ -32,6 +32,7 @@
 #include "urpc-thread.h"
 #include "urpc-server.h"
 #include "urpc-client.h"
+#include "urpc-network.h"
 
 #define URPC_TEST_PROC                     URPC_PROC_USER + 1
 #define URPC_TEST_PARAM_ARRAY              URPC_PARAM_USER + 1
@@ -43,9 +44,19 @@ unsigned int threads_num = 1;
 unsigned int requests_num = 1000;
 unsigned int iterations_num = 0;
 unsigned int servers_num = 0;
+double busy_poll = 0.0;
+int server_cpu = -1;
+unsigned int udp_batch = 1;
+unsigned int udp_reuse_port = 0;
+unsigned int handlers_num = 0;
+unsigned int deferred_num = 0;
+unsigned int use_uring = 1;
 unsigned int run_server = 0;
 unsigned int run_clients = 0;
 unsigned int dry_run = 0;
+unsigned int shared = 0;
+unsigned int async_num = 0;
+unsigned int show_stats = 0;
 unsigned int show_help = 0;
 
 volatile int thread_id = 0;
@@ -53,6 +64,14 @@ volatile int running_clients = 0;
 volatile int start = 0;
 volatile int fail = 0;
 uRpcMutex lock;
+uRpcClient *shared_client = NULL;
+
+/* Отложенные ответы сервера, завершаемые отдельным потоком. */
+uRpcMutex deferred_lock;
+uRpcServerReply **deferred_replies = NULL;
+uRpcData **deferred_data = NULL;
+volatile unsigned int deferred_pending = 0;
+volatile int deferred_stop = 0;
 
 void
 help (char *prog_name)
@@ -66,13 +85,93 @@ help (char *prog_name)
   printf ("  -r, --requests    Number of RPC requests per thread (default: 1000)\n");
   printf ("  -i, --iterations  Number of test iterations per threads (default: 1)\n");
   printf ("  -n, --dry-run     Don't perform received data verification\n");
+  printf ("  -p, --shared      Use one client connection for all threads\n");
+  printf ("  -a, --async       Number of asynchronous RPC requests in flight per thread (default: 0)\n");
   printf ("  --servers         Number of working server threads (default: same as clients)\n");
+  printf ("  --busy-poll       Time server threads spin waiting for SHM requests (default: 0)\n");
+  printf ("  --server-cpu      Pin server threads to consecutive CPUs starting from this one\n");
+  printf ("  --udp-batch       Number of UDP requests server threads receive per system call (default: 1)\n");
+  printf ("  --udp-reuse-port  Use separate UDP socket for every server thread\n");
+  printf ("  --handlers        Number of server handler threads, server threads only do I/O (default: 0)\n");
+  printf ("  --no-uring        Do not use io_uring for server TCP/UDP I/O\n");
+  printf ("  --defer           Number of server requests waiting for deferred reply (default: 0)\n");
+  printf ("  --stats           Print client and server statistics after test\n");
   printf ("  --server-only     Run only server (default: server and clients)\n");
   printf ("  --clients-only    Run only clients (default: server and clients)\n");
   printf ("\n\n");
   exit (0);
 }
 
+/* Запрос и вывод статистики сервера. */
+int
+print_server_stats (void)
+{
+  uRpcServerProcStats stats;
+  uRpcClient *client;
+  int received;
+
+  client = urpc_client_create (uri, URPC_DEFAULT_DATA_SIZE, timeout);
+  if (client == NULL || urpc_client_connect (client) < 0)
+    {
+      printf ("error connecting uRPC client to server\n");
+      return -1;
+    }
+
+  received = urpc_client_get_server_stats (client, &stats, 1);
+  urpc_client_destroy (client);
+
+  if (received != 1 || stats.proc_id != URPC_TEST_PROC)
+    {
+      printf ("error getting uRPC server statistics\n");
+      return -1;
+    }
+
+  printf ("uRPC server: %llu calls, %llu errors, %llu bytes in, %llu bytes out\n",
+          (unsigned long long) stats.calls, (unsigned long long) stats.errors,
+          (unsigned long long) stats.bytes_in, (unsigned long long) stats.bytes_out);
+  printf ("uRPC server: dispatch p50 %.1lfus p99 %.1lfus, proc p50 %.1lfus p99 %.1lfus, send p50 %.1lfus p99 %.1lfus\n",
+          urpc_histogram_get_percentile (&stats.dispatch_time, 50.0) / 1000.0,
+          urpc_histogram_get_percentile (&stats.dispatch_time, 99.0) / 1000.0,
+          urpc_histogram_get_percentile (&stats.proc_time, 50.0) / 1000.0,
+          urpc_histogram_get_percentile (&stats.proc_time, 99.0) / 1000.0,
+          urpc_histogram_get_percentile (&stats.send_time, 50.0) / 1000.0,
+          urpc_histogram_get_percentile (&stats.send_time, 99.0) / 1000.0);
+
+  return 0;
+}
+
+/* Вывод статистики клиента, для общего клиента client_id равен 0. */
+void
+print_client_stats (uRpcClient   *client,
+                    unsigned int  client_id)
+{
+  uRpcClientStats stats;
+  uRpcClientProcStats procs[4];
+  int procs_num;
+  int i;
+
+  procs_num = urpc_client_get_stats (client, &stats, procs, 4);
+  if (procs_num < 0)
+    return;
+
+  urpc_mutex_lock (&lock);
+  printf ("uRPC client %d: %llu calls, %llu errors, %llu timeouts, %llu transport errors, %llu retries, wait %.3lfs\n",
+          client_id, (unsigned long long) stats.calls, (unsigned long long) stats.errors,
+          (unsigned long long) stats.timeouts, (unsigned long long) stats.transport_errors,
+          (unsigned long long) stats.retries, stats.wait_time / 1e9);
+  for (i = 0; i < procs_num && i < 4; i++)
+    {
+      if (procs[i].proc_id != URPC_TEST_PROC)
+        continue;
+      printf ("uRPC client %d: latency p50 %.1lfus p99 %.1lfus max %.1lfus\n", client_id,
+              urpc_histogram_get_percentile (&procs[i].latency, 50.0) / 1000.0,
+              urpc_histogram_get_percentile (&procs[i].latency, 99.0) / 1000.0,
+              procs[i].latency.max / 1000.0);
+    }
+  fflush (stdout);
+  urpc_mutex_unlock (&lock);
+}
+
 void * test_thread_start_proc (void *user_data)
 {
   uint32_t *id = malloc (sizeof (uint32_t));
@@ -120,11 +219,9 @@ void test_disconnect_proc (void *session_data,
   free (session_data);
 }
 
-int
-test_proc (uRpcData *urpc_data,
-           void     *thread_data,
-           void     *session_data,
-           void     *user_data)
+/* Формирование ответа - массив в обратном порядке. */
+void
+test_reply (uRpcData *urpc_data)
 {
   uint8_t *array1;
   uint8_t *array2;
@@ -132,7 +229,7 @@ test_proc (uRpcData *urpc_data,
   unsigned int i;
 
   array1 = urpc_data_get (urpc_data, URPC_TEST_PARAM_ARRAY, &array_size);
-  array2 = urpc_data_set (urpc_data, URPC_TEST_PARAM_ARRAY, NULL, array_size);
+  array2 = urpc_data_reserve (urpc_data, URPC_TEST_PARAM_ARRAY, array_size);
 
   if (!dry_run)
     {
@@ -142,10 +239,195 @@ test_proc (uRpcData *urpc_data,
           array2[array_size - 1 - i] = array1[i];
         }
     }
+}
+
+int
+test_proc (uRpcData *urpc_data,
+           void     *thread_data,
+           void     *session_data,
+           void     *user_data)
+{
+  uRpcServerReply *reply;
+
+  /* Ответ формируется и отправляется потоком завершения отложенных ответов. */
+  if (deferred_num > 0)
+    {
+      reply = urpc_server_defer (urpc_data);
+      if (reply != NULL)
+        {
+          urpc_mutex_lock (&deferred_lock);
+          deferred_replies[deferred_pending] = reply;
+          deferred_data[deferred_pending] = urpc_data;
+          deferred_pending += 1;
+          urpc_mutex_unlock (&deferred_lock);
+          return 0;
+        }
+    }
+
+  test_reply (urpc_data);
 
   return 0;
 }
 
+/* Поток завершения отложенных ответов. */
+void *
+test_deferred_proc (void *data)
+{
+  uRpcServerReply *reply;
+  uRpcData *urpc_data;
+  int idle;
+
+  while (!deferred_stop || deferred_pending > 0)
+    {
+      reply = NULL;
+      urpc_data = NULL;
+
+      urpc_mutex_lock (&deferred_lock);
+      if (deferred_pending > 0)
+        {
+          deferred_pending -= 1;
+          reply = deferred_replies[deferred_pending];
+          urpc_data = deferred_data[deferred_pending];
+        }
+      idle = (deferred_pending == 0);
+      urpc_mutex_unlock (&deferred_lock);
+
+      if (reply != NULL)
+        {
+          test_reply (urpc_data);
+          if (urpc_server_complete (reply, 0) < 0)
+            {
+              printf ("error completing deferred reply\n");
+              fail = 1;
+            }
+        }
+
+      if (idle)
+        urpc_timer_sleep (0.0001);
+    }
+
+  return NULL;
+}
+
+/* При общем подключении ответы на запросы потока могут обрабатываться
+   другими потоками, поэтому состояние изменяется под блокировкой. */
+typedef struct
+{
+  volatile unsigned int pending;
+  volatile unsigned int fail;
+} uRpcTestAsync;
+
+void
+urpc_test_async_proc (uRpcClient *client,
+                      uRpcData   *urpc_data,
+                      uint32_t    status,
+                      void       *user_data)
+{
+  uRpcTestAsync *async = user_data;
+
+  uint8_t *array2;
+  uint32_t array_size;
+  unsigned int j;
+
+  urpc_mutex_lock (&lock);
+  async->pending -= 1;
+  urpc_mutex_unlock (&lock);
+
+  if (status != URPC_STATUS_OK)
+    {
+      async->fail = 1;
+      return;
+    }
+
+  array2 = urpc_data_get (urpc_data, URPC_TEST_PARAM_ARRAY, &array_size);
+  if (array_size != payload_size)
+    {
+      async->fail = 1;
+      return;
+    }
+
+  /* Запрос с номером i содержит байты i + j, в ответе они идут в обратном порядке. */
+  if (!dry_run)
+    {
+      for (j = 0; j < array_size; j++)
+        {
+          if (array2[array_size - 1 - j] != (uint8_t) (array2[array_size - 1] + j))
+            {
+              async->fail = 1;
+              break;
+            }
+        }
+    }
+}
+
+/* Функция выполняет запросы асинхронно, ожидая ответов не более чем на async_num запросов. */
+int
+urpc_test_client_async (uRpcClient *client,
+                        uint8_t    *array1)
+{
+  uRpcTestAsync async;
+  uRpcData *urpc_data;
+  unsigned int i, j;
+  int poll_fd, event_fd;
+  double timeout;
+
+  async.pending = 0;
+  async.fail = 0;
+
+  poll_fd = urpc_client_get_poll_fd (client);
+  event_fd = urpc_client_get_event_fd (client);
+
+  for (i = 0; (i < requests_num || async.pending > 0) && !async.fail; )
+    {
+      /* Отправляем новые запросы. */
+      while (i < requests_num && async.pending < async_num && !async.fail)
+        {
+          for (j = 0; j < payload_size; j++)
+            array1[j] = i + j;
+
+          urpc_data = urpc_client_lock_data (client);
+          if (urpc_data == NULL)
+            return -1;
+
+          urpc_data_set (urpc_data, URPC_TEST_PARAM_ARRAY, array1, payload_size);
+
+          urpc_mutex_lock (&lock);
+          async.pending += 1;
+          urpc_mutex_unlock (&lock);
+          if (urpc_client_exec_async (client, urpc_data, URPC_TEST_PROC, urpc_test_async_proc, &async) < 0)
+            {
+              urpc_client_unlock_data (client, urpc_data);
+              return -1;
+            }
+
+          i += 1;
+        }
+
+      /* Ожидаем ответы или оповещение не дольше таймаута запросов и обрабатываем их. */
+      timeout = urpc_client_get_timeout (client);
+      if (async.pending > 0 && poll_fd >= 0 && event_fd >= 0 && timeout != 0.0)
+        {
+          struct timeval tv;
+          fd_set fds;
+
+          if (timeout < 0.0 || timeout > 0.1)
+            timeout = 0.1;
+          tv.tv_sec = 0;
+          tv.tv_usec = (long) (1000000.0 * timeout);
+
+          FD_ZERO (&fds);
+          FD_SET ((SOCKET) poll_fd, &fds);
+          FD_SET ((SOCKET) event_fd, &fds);
+          if (select ((poll_fd > event_fd ? poll_fd : event_fd) + 1, &fds, NULL, NULL, &tv) < 0)
+            return -1;
+        }
+      if (async.pending > 0 && urpc_client_dispatch (client) < 0)
+        return -1;
+    }
+
+  return async.fail ? -1 : 0;
+}
+
 void *
 urpc_test_client_proc (void *data)
 {
@@ -165,19 +447,27 @@ urpc_test_client_proc (void *data)
   uint32_t array_size;
   unsigned int i, j;
 
-  client = urpc_client_create (uri, payload_size + 128, timeout);
-  if (client == NULL)
+  /* При общем подключении потоки выполняют запросы одновременно через один клиент. */
+  if (shared)
     {
-      printf ("error creating uRPC client\n");
-      fail = 1;
-      return NULL;
+      client = shared_client;
     }
-
-  if (urpc_client_connect (client) < 0)
+  else
     {
-      printf ("error connecting uRPC client to server\n");
-      fail = 1;
-      return NULL;
+      client = urpc_client_create (uri, payload_size + 128, timeout);
+      if (client == NULL)
+        {
+          printf ("error creating uRPC client\n");
+          fail = 1;
+          return NULL;
+        }
+
+      if (urpc_client_connect (client) < 0)
+        {
+          printf ("error connecting uRPC client to server\n");
+          fail = 1;
+          return NULL;
+        }
     }
 
   self_address = urpc_client_get_self_address (client);
@@ -209,12 +499,15 @@ urpc_test_client_proc (void *data)
 
   urpc_timer_start (timer);
 
-  for (i = 0; i < requests_num; i++)
+  if (async_num > 0 && urpc_test_client_async (client, array1) < 0)
+    fail = 1;
+
+  for (i = 0; i < requests_num && async_num == 0; i++)
     {
       for (j = 0; j < payload_size; j++)
         array1[j] = i + j;
 
-      urpc_data = urpc_client_lock (client);
+      urpc_data = shared ? urpc_client_lock_data (client) : urpc_client_lock (client);
       if (urpc_data == NULL)
         {
           fail = 1;
@@ -223,7 +516,8 @@ urpc_test_client_proc (void *data)
 
       urpc_data_set (urpc_data, URPC_TEST_PARAM_ARRAY, array1, payload_size);
 
-      if (urpc_client_exec (client, URPC_TEST_PROC) != URPC_STATUS_OK)
+      if ((shared ? urpc_client_exec_data (client, urpc_data, URPC_TEST_PROC) :
+                    urpc_client_exec (client, URPC_TEST_PROC)) != URPC_STATUS_OK)
         {
           fail = 1;
           break;
@@ -247,14 +541,22 @@ urpc_test_client_proc (void *data)
             }
         }
 
-      urpc_client_unlock (client);
+      if (shared)
+        urpc_client_unlock_data (client, urpc_data);
+      else
+        urpc_client_unlock (client);
       urpc_data = NULL;
     }
 
   elapsed = urpc_timer_elapsed (timer);
 
   if (urpc_data != NULL)
-    urpc_client_unlock (client);
+    {
+      if (shared)
+        urpc_client_unlock_data (client, urpc_data);
+      else
+        urpc_client_unlock (client);
+    }
 
   if (fail)
     printf ("client %d failed, size %d\n", client_id, payload_size);
@@ -265,7 +567,11 @@ urpc_test_client_proc (void *data)
   urpc_timer_destroy (timer);
   free (array1);
 
-  urpc_client_destroy (client);
+  if (show_stats && !shared)
+    print_client_stats (client, client_id);
+
+  if (!shared)
+    urpc_client_destroy (client);
 
   urpc_mutex_lock (&lock);
   running_clients -= 1;
@@ -280,6 +586,7 @@ main (int    argc,
 {
 
   uRpcServer *server = NULL;
+  uRpcThread *deferred = NULL;
   uRpcThread **clients;
   unsigned int local_running_clients;
   unsigned int i;
@@ -305,6 +612,19 @@ main (int    argc,
             continue;
           }
 
+        if ((strcmp (argv[i], "-p") == 0) || strcmp (argv[i], "--shared") == 0)
+          {
+            shared = 1;
+            continue;
+          }
+
+        if ((strcmp (argv[i], "-a") == 0) || strcmp (argv[i], "--async") == 0)
+          {
+            i += 1;
+            async_num = atoi (argv[i]);
+            continue;
+          }
+
         if ((strcmp (argv[i], "-n") == 0) || strcmp (argv[i], "--dry-run") == 0)
           {
             dry_run = 1;
@@ -338,6 +658,59 @@ main (int    argc,
             continue;
           }
 
+        if (strcmp (argv[i], "--busy-poll") == 0)
+          {
+            i += 1;
+            busy_poll = atof (argv[i]);
+            continue;
+          }
+
+        if (strcmp (argv[i], "--server-cpu") == 0)
+          {
+            i += 1;
+            server_cpu = atoi (argv[i]);
+            continue;
+          }
+
+        if (strcmp (argv[i], "--stats") == 0)
+          {
+            show_stats = 1;
+            continue;
+          }
+
+        if (strcmp (argv[i], "--udp-reuse-port") == 0)
+          {
+            udp_reuse_port = 1;
+            continue;
+          }
+
+        if (strcmp (argv[i], "--no-uring") == 0)
+          {
+            use_uring = 0;
+            continue;
+          }
+
+        if (strcmp (argv[i], "--defer") == 0)
+          {
+            i += 1;
+            deferred_num = atoi (argv[i]);
+            continue;
+          }
+
+        if (strcmp (argv[i], "--handlers") == 0)
+          {
+            i += 1;
+            handlers_num = atoi (argv[i]);
+            continue;
+          }
+
+        if (strcmp (argv[i], "--udp-batch") == 0)
+          {
+            i += 1;
+            udp_batch = atoi (argv[i]);
+            continue;
+          }
+
         if ((strcmp (argv[i], "-w") == 0) || strcmp (argv[i], "--timeout") == 0)
           {
             i += 1;
@@ -385,6 +758,8 @@ main (int    argc,
       iterations_num = 1;
     if (servers_num == 0)
       servers_num = threads_num;
+    if (shared && async_num * threads_num > URPC_MAX_REQUESTS_NUM)
+      async_num = (URPC_MAX_REQUESTS_NUM / threads_num) ? (URPC_MAX_REQUESTS_NUM / threads_num) : 1;
   }
 
   if (urpc_get_type (uri) == URPC_UDP && payload_size > URPC_DEFAULT_DATA_SIZE - 128)
@@ -419,6 +794,37 @@ main (int    argc,
 
       urpc_server_add_callback (server, URPC_TEST_PROC, test_proc, NULL);
 
+      urpc_server_set_busy_poll (server, busy_poll);
+      if (urpc_get_type (uri) == URPC_UDP && urpc_server_set_udp_batch (server, udp_batch) < 0)
+        {
+          printf ("error setting UDP batch size %d\n", udp_batch);
+          return -1;
+        }
+      urpc_server_set_udp_reuse_port (server, udp_reuse_port);
+      urpc_server_set_handlers (server, handlers_num);
+      urpc_server_set_io_uring (server, use_uring);
+      if (deferred_num > 0)
+        {
+          urpc_mutex_init (&deferred_lock);
+          deferred_replies = malloc (URPC_MAX_CONTEXTS_NUM * sizeof (uRpcServerReply *));
+          deferred_data = malloc (URPC_MAX_CONTEXTS_NUM * sizeof (uRpcData *));
+          deferred = urpc_thread_create (test_deferred_proc, NULL);
+          if (deferred_replies == NULL || deferred_data == NULL || deferred == NULL ||
+              urpc_server_set_deferred (server, deferred_num) < 0)
+            {
+              printf ("error setting deferred replies\n");
+              return -1;
+            }
+        }
+      if (server_cpu >= 0)
+        {
+          uint32_t *cpus = malloc (servers_num * sizeof (uint32_t));
+          for (i = 0; i < servers_num; i++)
+            cpus[i] = server_cpu + i;
+          urpc_server_set_cpu_affinity (server, cpus, servers_num);
+          free (cpus);
+        }
+
       if (urpc_server_bind (server) < 0)
         {
           printf ("error starting uRPC server\n");
@@ -431,6 +837,22 @@ main (int    argc,
 
   urpc_mutex_init (&lock);
 
+  if (run_clients && shared)
+    {
+      shared_client = urpc_client_create (uri, payload_size + 128, timeout);
+      if (shared_client == NULL)
+        {
+          printf ("error creating uRPC client\n");
+          return -1;
+        }
+
+      if (urpc_client_connect (shared_client) < 0)
+        {
+          printf ("error connecting uRPC client to server\n");
+          return -1;
+        }
+    }
+
   if (run_clients)
     {
       clients = malloc (threads_num * sizeof (uRpcThread *));
@@ -475,6 +897,27 @@ main (int    argc,
       for (i = 0; i < threads_num; i++)
         urpc_thread_destroy (clients[i]);
       free (clients);
+
+      if (shared_client != NULL)
+        {
+          if (show_stats)
+            print_client_stats (shared_client, 0);
+          urpc_client_destroy (shared_client);
+        }
+
+      if (show_stats && print_server_stats () < 0)
+        fail = 1;
+    }
+
+  if (run_server && show_stats)
+    {
+      uRpcServerSessionStats sessions;
+
+      if (urpc_server_get_session_stats (server, &sessions) == 0)
+        printf ("uRPC server: %u session slots, %u active, %u peak, %llu bytes\n",
+                sessions.slots, sessions.active, sessions.peak, (unsigned long long) sessions.memory);
+      else
+        fail = 1;
     }
 
   if (run_server)
@@ -485,7 +928,15 @@ main (int    argc,
           fflush (stdout);
           getchar ();
         }
+
+      /* Сервер ожидает завершения отложенных ответов, поэтому поток завершения
+         останавливается после удаления сервера. */
       urpc_server_destroy (server);
+      if (deferred != NULL)
+        {
+          deferred_stop = 1;
+          urpc_thread_destroy (deferred);
+        }
     }
 
   return 0;
@@ -0,0 +1,65 @@
+/*
+ * uRPC - rpc (remote procedure call) library.
+ *
+ * Copyright 2015 Andrei Fadeev (andrei@webcontrol.ru)
+ *
+ * This file is part of uRPC.
+ *
+ * uRPC is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * uRPC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the author in this case.
+ *
+ */
+
+/* Заголовочный файл атомарных операций над 32-х битными словами. Операции используются
+   библиотекой uRPC самостоятельно, в том числе для слов в разделяемой памяти, и не
+   предназначены для пользователей.
+
+   URPC_ATOMIC_LOAD  - чтение слова (acquire);
+   URPC_ATOMIC_STORE - запись слова (release);
+   URPC_ATOMIC_CAS   - замена значения old на new, возвращает не ноль в случае успеха;
+   URPC_ATOMIC_INC   - увеличение на единицу, возвращает новое значение;
+   URPC_ATOMIC_DEC   - уменьшение на единицу, возвращает новое значение. */
+
+#ifndef __URPC_ATOMIC_H__
+#define __URPC_ATOMIC_H__
+
+#include <stdint.h>
+
+#if defined (__GNUC__)
+
+#define URPC_ATOMIC_LOAD(ptr)          __atomic_load_n ((ptr), __ATOMIC_ACQUIRE)
+#define URPC_ATOMIC_STORE(ptr, val)    __atomic_store_n ((ptr), (val), __ATOMIC_RELEASE)
+#define URPC_ATOMIC_CAS(ptr, old, new) __sync_bool_compare_and_swap ((ptr), (old), (new))
+#define URPC_ATOMIC_INC(ptr)           __atomic_add_fetch ((ptr), 1, __ATOMIC_SEQ_CST)
+#define URPC_ATOMIC_DEC(ptr)           __atomic_sub_fetch ((ptr), 1, __ATOMIC_SEQ_CST)
+
+#elif defined (_MSC_VER)
+
+#include <intrin.h>
+#define URPC_ATOMIC_LOAD(ptr)          (*(volatile uint32_t*)(ptr))
+#define URPC_ATOMIC_STORE(ptr, val)    _InterlockedExchange ((volatile long*)(ptr), (long)(val))
+#define URPC_ATOMIC_CAS(ptr, old, new) (_InterlockedCompareExchange ((volatile long*)(ptr), \
+                                                                     (long)(new), (long)(old)) == (long)(old))
+#define URPC_ATOMIC_INC(ptr)           ((uint32_t)_InterlockedIncrement ((volatile long*)(ptr)))
+#define URPC_ATOMIC_DEC(ptr)           ((uint32_t)_InterlockedDecrement ((volatile long*)(ptr)))
+
+#else
+
+#error "atomic operations are not supported for this compiler"
+
+#endif
+
+#endif /* __URPC_ATOMIC_H__ */
@@ -26,6 +26,8 @@
 #include "urpc-client.h"
 #include "urpc-common.h"
 #include "urpc-mutex.h"
+#include "urpc-timer.h"
+#include "urpc-hash-table.h"
 #include "urpc-endian.h"
 
 #include "urpc-udp-client.h"
@@ -38,6 +40,14 @@
 
 static int urpc_client_initialized = 0;
 
+/* Асинхронный запрос, ожидающий ответа. */
+typedef struct
+{
+  uRpcData            *urpc_data;              /* Буферы приёма-передачи запроса. */
+  uint32_t             proc_id;                /* Идентификатор процедуры. */
+  double               start;                  /* Время отправки запроса. */
+} uRpcClientAsyncRequest;
+
 struct _uRpcClient
 {
   uint32_t             urpc_client_type;       /* Тип объекта uRpcClient. */
@@ -52,11 +62,155 @@ struct _uRpcClient
 
   uRpcMutex            lock;                   /* Блокировка канала передачи. */
   uRpcData            *urpc_data;              /* Данные RPC запроса/ответа. */
+  uRpcMutex            transport_lock;         /* Блокировка транспорта без поддержки параллельных запросов. */
 
   uint32_t             state;                  /* Состояние подключения. */
   uint32_t             session_id;             /* Идентификатор сессии. */
+
+  uRpcMutex            stats_lock;             /* Блокировка доступа к статистике. */
+  uRpcClientStats      stats;                  /* Статистика клиента. */
+  uRpcClientProcStats *procs;                  /* Статистика процедур в порядке первого вызова. */
+  uint32_t             procs_num;              /* Число процедур. */
+  uint32_t             procs_size;             /* Размер массива статистики процедур. */
+  uRpcHashTable       *procs_index;            /* Номера процедур в массиве статистики, начиная с единицы. */
+  uRpcClientAsyncRequest async[URPC_MAX_REQUESTS_NUM]; /* Асинхронные запросы. */
 };
 
+/* Функция возвращает статистику процедуры, при первом вызове процедуры статистика создаётся.
+   Вызывается под блокировкой статистики. */
+static uRpcClientProcStats *
+urpc_client_get_proc_stats (uRpcClient *urpc_client,
+                            uint32_t    proc_id)
+{
+  uint32_t index = urpc_hash_table_find_uint32 (urpc_client->procs_index, proc_id);
+
+  if (index > 0)
+    return &urpc_client->procs[index - 1];
+
+  if (urpc_client->procs_num == urpc_client->procs_size)
+    {
+      uint32_t procs_size = (urpc_client->procs_size > 0) ? 2 * urpc_client->procs_size : 16;
+      uRpcClientProcStats *procs = realloc (urpc_client->procs, procs_size * sizeof (uRpcClientProcStats));
+
+      if (procs == NULL)
+        return NULL;
+
+      urpc_client->procs = procs;
+      urpc_client->procs_size = procs_size;
+    }
+
+  if (urpc_hash_table_insert_uint32 (urpc_client->procs_index, proc_id, urpc_client->procs_num + 1) != 0)
+    return NULL;
+
+  memset (&urpc_client->procs[urpc_client->procs_num], 0, sizeof (uRpcClientProcStats));
+  urpc_client->procs[urpc_client->procs_num].proc_id = proc_id;
+
+  return &urpc_client->procs[urpc_client->procs_num++];
+}
+
+/* Функция учитывает выполненный запрос в статистике клиента. */
+static void
+urpc_client_update_stats (uRpcClient *urpc_client,
+                          uRpcData   *urpc_data,
+                          uint32_t    proc_id,
+                          uint32_t    status,
+                          double      start)
+{
+  uRpcClientProcStats *proc_stats;
+  uRpcHeader *iheader;
+  uRpcHeader *oheader;
+  double stop = urpc_timer_get_monotonic_time ();
+
+  oheader = urpc_data_get_header (urpc_data, URPC_DATA_OUTPUT);
+  iheader = urpc_data_get_header (urpc_data, URPC_DATA_INPUT);
+
+  urpc_mutex_lock (&urpc_client->stats_lock);
+
+  urpc_client->stats.calls += 1;
+  urpc_client->stats.bytes_sent += UINT32_FROM_BE (oheader->size);
+
+  if (status == URPC_STATUS_OK)
+    urpc_client->stats.bytes_received += UINT32_FROM_BE (iheader->size);
+  else if (status == URPC_STATUS_TIMEOUT)
+    urpc_client->stats.timeouts += 1;
+  else if (status == URPC_STATUS_TRANSPORT_ERROR)
+    urpc_client->stats.transport_errors += 1;
+  else
+    urpc_client->stats.errors += 1;
+
+  proc_stats = urpc_client_get_proc_stats (urpc_client, proc_id);
+  if (proc_stats != NULL)
+    {
+      proc_stats->calls += 1;
+      if (status != URPC_STATUS_OK)
+        proc_stats->errors += 1;
+      urpc_histogram_add (&proc_stats->latency, (stop > start) ? (uint64_t) (1e9 * (stop - start)) : 0);
+    }
+
+  urpc_mutex_unlock (&urpc_client->stats_lock);
+}
+
+/* Функция заполняет заголовок отправляемого пакета. Идентификатор запроса
+   устанавливается транспортом. */
+static void
+urpc_client_prepare_request (uRpcClient *urpc_client,
+                             uRpcData   *urpc_data,
+                             uint32_t    proc_id)
+{
+  uRpcHeader *oheader;
+  uint32_t send_size;
+
+  urpc_data_set_uint32 (urpc_data, URPC_PARAM_PROC, proc_id);
+
+  oheader = urpc_data_get_header (urpc_data, URPC_DATA_OUTPUT);
+  send_size = URPC_HEADER_SIZE + urpc_data_get_data_size (urpc_data, URPC_DATA_OUTPUT);
+
+  oheader->magic = UINT32_TO_BE (URPC_MAGIC);
+  oheader->version = UINT32_TO_BE (URPC_VERSION);
+  oheader->size = UINT32_TO_BE (send_size);
+  oheader->session = UINT32_TO_BE (urpc_client->session_id);
+  oheader->id = 0;
+}
+
+/* Функция проверяет ответ сервера. */
+static uint32_t
+urpc_client_check_reply (uRpcClient *urpc_client,
+                         uRpcData   *urpc_data,
+                         uint32_t    proc_id,
+                         uint32_t    status)
+{
+  uRpcHeader *iheader;
+
+  if (status != URPC_STATUS_OK)
+    return status;
+
+  iheader = urpc_data_get_header (urpc_data, URPC_DATA_INPUT);
+
+  /* Проверка версии сервера. */
+  if ((UINT32_FROM_BE (iheader->version) >> 8) != (URPC_VERSION >> 8))
+    return URPC_STATUS_VERSION_MISMATCH;
+
+  /* Проверка выполнения функции LOGIN. */
+  if (urpc_client->state == URPC_STATE_NOT_CONNECTED
+      && proc_id == URPC_PROC_LOGIN)
+    {
+      urpc_data_get_uint32 (urpc_data, URPC_PARAM_STATUS, &status);
+      if (status != URPC_STATUS_OK)
+        return URPC_STATUS_AUTH_ERROR;
+      urpc_client->session_id = UINT32_FROM_BE (iheader->session);
+      urpc_client->state = URPC_STATE_CONNECTED;
+    }
+
+  if (UINT32_FROM_BE (iheader->session) != urpc_client->session_id)
+    return URPC_STATUS_AUTH_ERROR;
+
+  /* Проверка принятых данных. */
+  if (urpc_data_validate (urpc_data, URPC_DATA_INPUT) < 0)
+    return URPC_STATUS_TRANSPORT_ERROR;
+
+  return URPC_STATUS_OK;
+}
+
 uRpcClient *
 urpc_client_create (const char *uri,
                     uint32_t    max_data_size,
@@ -90,7 +244,19 @@ urpc_client_create (const char *uri,
   urpc_client->transport = NULL;
   urpc_client->urpc_data = NULL;
   urpc_client->session_id = 0;
+  urpc_client->procs = NULL;
+  urpc_client->procs_num = 0;
+  urpc_client->procs_size = 0;
+  urpc_client->procs_index = NULL;
+  memset (&urpc_client->stats, 0, sizeof (uRpcClientStats));
+  memset (urpc_client->async, 0, sizeof (urpc_client->async));
   urpc_mutex_init (&urpc_client->lock);
+  urpc_mutex_init (&urpc_client->transport_lock);
+  urpc_mutex_init (&urpc_client->stats_lock);
+
+  urpc_client->procs_index = urpc_hash_table_create (NULL);
+  if (urpc_client->procs_index == NULL)
+    goto failed;
 
   urpc_client->uri = malloc (strlen (uri) + 1);
   if (urpc_client->uri == NULL)
@@ -140,7 +306,13 @@ urpc_client_destroy (uRpcClient *urpc_client)
   /* Удаляем объект. */
   if (urpc_client->uri != NULL)
     free (urpc_client->uri);
+  if (urpc_client->procs_index != NULL)
+    urpc_hash_table_destroy (urpc_client->procs_index);
+  if (urpc_client->procs != NULL)
+    free (urpc_client->procs);
 
+  urpc_mutex_clear (&urpc_client->stats_lock);
+  urpc_mutex_clear (&urpc_client->transport_lock);
   urpc_mutex_clear (&urpc_client->lock);
 
   free (urpc_client);
@@ -190,30 +362,10 @@ urpc_client_lock (uRpcClient *urpc_client)
     return NULL;
 
   urpc_mutex_lock (&urpc_client->lock);
-  urpc_client->urpc_data = NULL;
-
-  if (urpc_client->transport != NULL)
-    {
-      switch (urpc_client->type)
-        {
-        case URPC_UDP:
-          urpc_client->urpc_data = urpc_udp_client_lock (urpc_client->transport);
-          break;
-        case URPC_TCP:
-          urpc_client->urpc_data = urpc_tcp_client_lock (urpc_client->transport);
-          break;
-        case URPC_SHM:
-          urpc_client->urpc_data = urpc_shm_client_lock (urpc_client->transport);
-          break;
-        case URPC_UNKNOWN:
-          break;
-        }
-    }
 
+  urpc_client->urpc_data = urpc_client_lock_data (urpc_client);
   if (urpc_client->urpc_data == NULL)
     urpc_mutex_unlock (&urpc_client->lock);
-  else
-    urpc_data_set_uint32 (urpc_client->urpc_data, URPC_PARAM_PROC, 0);
 
   return urpc_client->urpc_data;
 }
@@ -222,25 +374,84 @@ uint32_t
 urpc_client_exec (uRpcClient *urpc_client,
                   uint32_t    proc_id)
 {
-  uRpcHeader *iheader;
-  uRpcHeader *oheader;
-  uint32_t send_size;
-  uint32_t status;
-
   if (urpc_client->urpc_client_type != URPC_CLIENT_TYPE)
     return URPC_STATUS_FAIL;
 
-  iheader = urpc_data_get_header (urpc_client->urpc_data, URPC_DATA_INPUT);
-  oheader = urpc_data_get_header (urpc_client->urpc_data, URPC_DATA_OUTPUT);
-  send_size = URPC_HEADER_SIZE + urpc_data_get_data_size (urpc_client->urpc_data, URPC_DATA_OUTPUT);
+  return urpc_client_exec_data (urpc_client, urpc_client->urpc_data, proc_id);
+}
 
-  /* Заголовок отправляемого пакета. */
-  oheader->magic = UINT32_TO_BE (URPC_MAGIC);
-  oheader->version = UINT32_TO_BE (URPC_VERSION);
-  oheader->size = UINT32_TO_BE (send_size);
-  oheader->session = UINT32_TO_BE (urpc_client->session_id);
+void
+urpc_client_unlock (uRpcClient *urpc_client)
+{
+  if (urpc_client->urpc_client_type != URPC_CLIENT_TYPE)
+    return;
+  if (urpc_client->urpc_data == NULL)
+    return;
+
+  urpc_client_unlock_data (urpc_client, urpc_client->urpc_data);
+
+  urpc_client->urpc_data = NULL;
+  urpc_mutex_unlock (&urpc_client->lock);
+}
+
+uRpcData *
+urpc_client_lock_data (uRpcClient *urpc_client)
+{
+  uRpcData *urpc_data = NULL;
+
+  if (urpc_client->urpc_client_type != URPC_CLIENT_TYPE)
+    return NULL;
+  if (urpc_client->transport == NULL)
+    return NULL;
+
+  /* TCP клиент выполняет несколько запросов одновременно, остальные
+     транспорты используют единственный буфер по очереди. */
+  if (urpc_client->type != URPC_TCP)
+    urpc_mutex_lock (&urpc_client->transport_lock);
+
+  switch (urpc_client->type)
+    {
+    case URPC_UDP:
+      urpc_data = urpc_udp_client_lock (urpc_client->transport);
+      break;
+    case URPC_TCP:
+      urpc_data = urpc_tcp_client_lock (urpc_client->transport);
+      break;
+    case URPC_SHM:
+      urpc_data = urpc_shm_client_lock (urpc_client->transport);
+      break;
+    case URPC_UNKNOWN:
+      break;
+    }
+
+  if (urpc_data == NULL)
+    {
+      if (urpc_client->type != URPC_TCP)
+        urpc_mutex_unlock (&urpc_client->transport_lock);
+    }
+  else
+    {
+      urpc_data_set_uint32 (urpc_data, URPC_PARAM_PROC, 0);
+    }
+
+  return urpc_data;
+}
+
+uint32_t
+urpc_client_exec_data (uRpcClient *urpc_client,
+                       uRpcData   *urpc_data,
+                       uint32_t    proc_id)
+{
+  uint32_t status;
+  double start;
 
-  urpc_data_set_uint32 (urpc_client->urpc_data, URPC_PARAM_PROC, proc_id);
+  if (urpc_client->urpc_client_type != URPC_CLIENT_TYPE)
+    return URPC_STATUS_FAIL;
+  if (urpc_data == NULL)
+    return URPC_STATUS_FAIL;
+
+  urpc_client_prepare_request (urpc_client, urpc_data, proc_id);
+  start = urpc_timer_get_monotonic_time ();
 
   /* Обмен данными с сервером. Перед обменом должен быть заполнен заголовок отправляемых данных!!! */
   switch (urpc_client->type)
@@ -249,7 +460,7 @@ urpc_client_exec (uRpcClient *urpc_client,
       status = urpc_udp_client_exchange (urpc_client->transport);
       break;
     case URPC_TCP:
-      status = urpc_tcp_client_exchange (urpc_client->transport);
+      status = urpc_tcp_client_exchange (urpc_client->transport, urpc_data);
       break;
     case URPC_SHM:
       status = urpc_shm_client_exchange (urpc_client->transport);
@@ -257,51 +468,175 @@ urpc_client_exec (uRpcClient *urpc_client,
     default:
       return URPC_STATUS_FAIL;
     }
-  if (status != URPC_STATUS_OK)
-    return status;
 
-  /* Проверка версии сервера. */
-  if ((UINT32_FROM_BE (iheader->version) >> 8) != (URPC_VERSION >> 8))
-    return URPC_STATUS_VERSION_MISMATCH;
+  status = urpc_client_check_reply (urpc_client, urpc_data, proc_id, status);
+  urpc_client_update_stats (urpc_client, urpc_data, proc_id, status, start);
 
-  /* Проверка выполнения функции LOGIN. */
-  if (urpc_client->state == URPC_STATE_NOT_CONNECTED
-      && proc_id == URPC_PROC_LOGIN)
+  return status;
+}
+
+void
+urpc_client_unlock_data (uRpcClient *urpc_client,
+                         uRpcData   *urpc_data)
+{
+  if (urpc_client->urpc_client_type != URPC_CLIENT_TYPE)
+    return;
+  if (urpc_data == NULL)
+    return;
+
+  /* Очищаем буферы приёма-передачи. */
+  urpc_data_set_data_size (urpc_data, URPC_DATA_INPUT, 0);
+  urpc_data_set_data_size (urpc_data, URPC_DATA_OUTPUT, 0);
+
+  switch (urpc_client->type)
     {
-      urpc_data_get_uint32 (urpc_client->urpc_data, URPC_PARAM_STATUS, &status);
-      if (status != URPC_STATUS_OK)
-        return URPC_STATUS_AUTH_ERROR;
-      urpc_client->session_id = UINT32_FROM_BE (iheader->session);
-      urpc_client->state = URPC_STATE_CONNECTED;
+    case URPC_TCP:
+      urpc_tcp_client_unlock (urpc_client->transport, urpc_data);
+      break;
+    case URPC_SHM:
+      urpc_shm_client_unlock (urpc_client->transport);
+      urpc_mutex_unlock (&urpc_client->transport_lock);
+      break;
+    default:
+      urpc_mutex_unlock (&urpc_client->transport_lock);
+      break;
     }
+}
 
-  if (UINT32_FROM_BE (iheader->session) != urpc_client->session_id)
-    return URPC_STATUS_AUTH_ERROR;
+int
+urpc_client_exec_async (uRpcClient             *urpc_client,
+                        uRpcData               *urpc_data,
+                        uint32_t                proc_id,
+                        urpc_client_async_proc  proc,
+                        void                   *user_data)
+{
+  uint32_t status;
+  unsigned int i;
 
-  /* Проверка принятых данных. */
-  if (urpc_data_validate (urpc_client->urpc_data, URPC_DATA_INPUT) < 0)
-    return URPC_STATUS_TRANSPORT_ERROR;
+  if (urpc_client->urpc_client_type != URPC_CLIENT_TYPE)
+    return -1;
+  if (urpc_data == NULL || proc == NULL)
+    return -1;
 
-  return URPC_STATUS_OK;
+  /* Протоколы без поддержки асинхронных запросов выполняют запрос синхронно. */
+  if (urpc_client->type != URPC_TCP)
+    {
+      status = urpc_client_exec_data (urpc_client, urpc_data, proc_id);
+      proc (urpc_client, urpc_data, status, user_data);
+      urpc_client_unlock_data (urpc_client, urpc_data);
+      return 0;
+    }
+
+  urpc_client_prepare_request (urpc_client, urpc_data, proc_id);
+
+  /* Запоминаем процедуру и время отправки для статистики. Через клиент выполняется
+     не более URPC_MAX_REQUESTS_NUM запросов, поэтому свободная запись всегда есть. */
+  urpc_mutex_lock (&urpc_client->stats_lock);
+  for (i = 0; i < URPC_MAX_REQUESTS_NUM; i++)
+    {
+      if (urpc_client->async[i].urpc_data != NULL)
+        continue;
+      urpc_client->async[i].urpc_data = urpc_data;
+      urpc_client->async[i].proc_id = proc_id;
+      urpc_client->async[i].start = urpc_timer_get_monotonic_time ();
+      break;
+    }
+  urpc_mutex_unlock (&urpc_client->stats_lock);
+
+  status = urpc_tcp_client_exchange_async (urpc_client->transport, urpc_data, proc, user_data);
+
+  /* Запрос не отправлен, функция завершения не будет вызвана. */
+  if (status != URPC_STATUS_OK && i < URPC_MAX_REQUESTS_NUM)
+    {
+      urpc_mutex_lock (&urpc_client->stats_lock);
+      urpc_client->async[i].urpc_data = NULL;
+      urpc_mutex_unlock (&urpc_client->stats_lock);
+    }
+
+  return status == URPC_STATUS_OK ? 0 : -1;
 }
 
-void
-urpc_client_unlock (uRpcClient *urpc_client)
+int
+urpc_client_dispatch (uRpcClient *urpc_client)
 {
+  urpc_client_async_proc proc;
+  void *user_data;
+  uRpcData *urpc_data;
+  uRpcClientAsyncRequest async_request;
+  uint32_t status;
+  unsigned int i;
+  int completed = 0;
+
   if (urpc_client->urpc_client_type != URPC_CLIENT_TYPE)
-    return;
-  if (urpc_client->urpc_data == NULL)
-    return;
+    return -1;
+  if (urpc_client->type != URPC_TCP)
+    return 0;
 
-  if (urpc_client->type == URPC_SHM)
-    urpc_shm_client_unlock (urpc_client->transport);
+  /* Принимаем доступные ответы. При ошибке все ожидающие запросы завершаются с ошибкой. */
+  urpc_tcp_client_receive_async (urpc_client->transport);
 
-  /* Очищаем буферы приёма-передачи. */
-  urpc_data_set_data_size (urpc_client->urpc_data, URPC_DATA_INPUT, 0);
-  urpc_data_set_data_size (urpc_client->urpc_data, URPC_DATA_OUTPUT, 0);
+  /* Вызываем функции завершения запросов. */
+  while ((urpc_data = urpc_tcp_client_get_completed (urpc_client->transport, &status, &proc, &user_data)) != NULL)
+    {
+      /* Подключение к серверу выполняется синхронно, поэтому идентификатор
+         функции для проверки ответа не нужен. */
+      status = urpc_client_check_reply (urpc_client, urpc_data, 0, status);
+
+      /* Статистика асинхронного запроса. */
+      urpc_mutex_lock (&urpc_client->stats_lock);
+      for (i = 0; i < URPC_MAX_REQUESTS_NUM; i++)
+        if (urpc_client->async[i].urpc_data == urpc_data)
+          break;
+      if (i < URPC_MAX_REQUESTS_NUM)
+        {
+          async_request = urpc_client->async[i];
+          urpc_client->async[i].urpc_data = NULL;
+        }
+      urpc_mutex_unlock (&urpc_client->stats_lock);
 
-  urpc_client->urpc_data = NULL;
-  urpc_mutex_unlock (&urpc_client->lock);
+      if (i < URPC_MAX_REQUESTS_NUM)
+        urpc_client_update_stats (urpc_client, urpc_data, async_request.proc_id, status, async_request.start);
+
+      proc (urpc_client, urpc_data, status, user_data);
+      urpc_client_unlock_data (urpc_client, urpc_data);
+
+      completed += 1;
+    }
+
+  return completed;
+}
+
+int
+urpc_client_get_poll_fd (uRpcClient *urpc_client)
+{
+  if (urpc_client->urpc_client_type != URPC_CLIENT_TYPE)
+    return -1;
+  if (urpc_client->type != URPC_TCP || urpc_client->transport == NULL)
+    return -1;
+
+  return (int) urpc_tcp_client_get_socket (urpc_client->transport);
+}
+
+int
+urpc_client_get_event_fd (uRpcClient *urpc_client)
+{
+  if (urpc_client->urpc_client_type != URPC_CLIENT_TYPE)
+    return -1;
+  if (urpc_client->type != URPC_TCP || urpc_client->transport == NULL)
+    return -1;
+
+  return (int) urpc_tcp_client_get_event_fd (urpc_client->transport);
+}
+
+double
+urpc_client_get_timeout (uRpcClient *urpc_client)
+{
+  if (urpc_client->urpc_client_type != URPC_CLIENT_TYPE)
+    return -1.0;
+  if (urpc_client->type != URPC_TCP || urpc_client->transport == NULL)
+    return -1.0;
+
+  return urpc_tcp_client_get_timeout (urpc_client->transport);
 }
 
 const char *
@@ -351,3 +686,92 @@ urpc_client_get_peer_address (uRpcClient *urpc_client)
 
   return NULL;
 }
+
+int
+urpc_client_get_server_stats (uRpcClient          *urpc_client,
+                              uRpcServerProcStats *stats,
+                              uint32_t             stats_num)
+{
+  uRpcData *urpc_data;
+  uint8_t *data;
+  uint32_t data_size;
+  uint32_t i;
+  int received = -1;
+
+  urpc_data = urpc_client_lock (urpc_client);
+  if (urpc_data == NULL)
+    return -1;
+
+  if (urpc_client_exec (urpc_client, URPC_PROC_GET_STATS) != URPC_STATUS_OK)
+    goto urpc_client_get_server_stats_exit;
+
+  /* Сервер без зарегистрированных процедур не возвращает данных. */
+  data = urpc_data_get (urpc_data, URPC_PARAM_STATS, &data_size);
+  if (data == NULL)
+    data_size = 0;
+
+  for (i = 0; i < stats_num && data_size > 0; i++)
+    {
+      uint32_t size = urpc_server_proc_stats_import (&stats[i], data, data_size);
+
+      if (size == 0)
+        goto urpc_client_get_server_stats_exit;
+
+      data += size;
+      data_size -= size;
+    }
+
+  received = i;
+
+urpc_client_get_server_stats_exit:
+  urpc_client_unlock (urpc_client);
+
+  return received;
+}
+
+int
+urpc_client_get_stats (uRpcClient          *urpc_client,
+                       uRpcClientStats     *stats,
+                       uRpcClientProcStats *procs,
+                       uint32_t             procs_num)
+{
+  int tracked;
+
+  if (urpc_client->urpc_client_type != URPC_CLIENT_TYPE)
+    return -1;
+
+  urpc_mutex_lock (&urpc_client->stats_lock);
+
+  if (stats != NULL)
+    *stats = urpc_client->stats;
+
+  if (procs_num > urpc_client->procs_num)
+    procs_num = urpc_client->procs_num;
+  if (procs != NULL && procs_num > 0)
+    memcpy (procs, urpc_client->procs, procs_num * sizeof (uRpcClientProcStats));
+
+  tracked = urpc_client->procs_num;
+
+  urpc_mutex_unlock (&urpc_client->stats_lock);
+
+  /* Повторные ожидания и время ожидания учитываются транспортом. */
+  if (stats != NULL && urpc_client->transport != NULL)
+    {
+      switch (urpc_client->type)
+        {
+        case URPC_UDP:
+          urpc_udp_client_get_stats (urpc_client->transport, stats);
+          break;
+        case URPC_TCP:
+          urpc_tcp_client_get_stats (urpc_client->transport, stats);
+          break;
+        case URPC_SHM:
+          urpc_shm_client_get_stats (urpc_client->transport, stats);
+          break;
+        default:
+          break;
+        }
+    }
+
+  return tracked;
+}
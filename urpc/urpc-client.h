@@ -70,6 +70,34 @@
  * Клиент вызывает функции сервера используя функцию #urpc_client_exec, в которую передает
  * идентификатор этой функции.
  *
+ * Функции #urpc_client_lock, #urpc_client_exec и #urpc_client_unlock выполняют запросы
+ * по очереди. Для одновременного выполнения запросов из нескольких потоков используются
+ * функции #urpc_client_lock_data, #urpc_client_exec_data и #urpc_client_unlock_data.
+ * Каждый поток получает собственный объект \link uRpcData \endlink и выполняет запрос
+ * независимо от других потоков. При работе по протоколу TCP запросы передаются серверу
+ * не дожидаясь ответов на предыдущие запросы (до #URPC_MAX_REQUESTS_NUM запросов одновременно), сервер
+ * обрабатывает их параллельно и ответы могут приходить в произвольном порядке. Для
+ * протоколов UDP и SHM запросы по прежнему выполняются по очереди.
+ *
+ * Запрос может быть выполнен асинхронно функцией #urpc_client_exec_async. Функция отправляет
+ * запрос серверу и не ожидает ответа. После получения ответа вызывается функция
+ * #urpc_client_async_proc. Ответы принимаются и обрабатываются функцией #urpc_client_dispatch,
+ * которая не блокирует выполнение программы. Для ожидания ответов используются два
+ * дескриптора совместно с select, poll или epoll: сокет, возвращаемый функцией
+ * #urpc_client_get_poll_fd, и дескриптор оповещения, возвращаемый функцией
+ * #urpc_client_get_event_fd. Оповещение устанавливается, если ответы на асинхронные запросы
+ * принял поток, выполняющий синхронный запрос через этот же клиент, или соединение стало
+ * неисправным. Ожидание необходимо ограничивать временем, возвращаемым функцией
+ * #urpc_client_get_timeout, так как истечение таймаута асинхронных запросов проверяется
+ * только функцией #urpc_client_dispatch. Таким образом один поток может выполнять множество
+ * запросов через несколько клиентов одновременно. Асинхронный запрос занимает объект \link uRpcData \endlink до вызова
+ * функции завершения, поэтому через один клиент может выполняться не более
+ * #URPC_MAX_REQUESTS_NUM запросов. При превышении этого числа #urpc_client_lock_data
+ * ожидает освобождения объекта, что для потока обрабатывающего ответы приводит
+ * к взаимной блокировке. Асинхронные запросы поддерживаются только протоколом TCP, для протоколов
+ * UDP и SHM запрос выполняется синхронно и функция завершения вызывается до возврата из
+ * функции #urpc_client_exec_async.
+ *
  * Функция #urpc_client_exec возвращает один из статусов выполнения запроса:
  *
  * - #URPC_STATUS_OK - запрос успешно выполнен;
@@ -99,6 +127,7 @@
 #include <urpc-exports.h>
 #include <urpc-types.h>
 #include <urpc-data.h>
+#include <urpc-stats.h>
 
 #ifdef __cplusplus
 extern "C"
@@ -107,6 +136,24 @@ extern "C"
 
 typedef struct _uRpcClient uRpcClient;
 
+/**
+ *
+ * Функция вызывается при завершении асинхронного запроса. После возврата из функции
+ * объект urpc_data освобождается и не должен использоваться.
+ *
+ * \param urpc_client указатель на uRpcClient объект;
+ * \param urpc_data указатель на uRpcData объект с результатами выполнения запроса;
+ * \param status статус выполнения запроса;
+ * \param user_data указатель на пользовательские данные.
+ *
+ * \return Нет.
+ *
+ */
+typedef void (*urpc_client_async_proc)         (uRpcClient            *urpc_client,
+                                                uRpcData              *urpc_data,
+                                                uint32_t               status,
+                                                void                  *user_data);
+
 /**
  *
  * Функция создаёт RPC клиент для связи с сервером заданым адресом uri. Адрес задается в виде строки:
@@ -239,6 +286,131 @@ uint32_t       urpc_client_exec                (uRpcClient            *urpc_clie
 URPC_EXPORT
 void           urpc_client_unlock              (uRpcClient            *urpc_client);
 
+/**
+ *
+ * Функция возвращает объект для обмена данными одного запроса. В отличие от #urpc_client_lock
+ * функция может вызываться одновременно из нескольких потоков, каждый из которых получает
+ * собственный объект. При исчерпании доступных объектов функция ожидает освобождения одного из них.
+ *
+ * \param urpc_client указатель на uRpcClient объект.
+ *
+ * \return Указатель на uRpcData объект в случае успеха, иначе NULL.
+ *
+ */
+URPC_EXPORT
+uRpcData      *urpc_client_lock_data           (uRpcClient            *urpc_client);
+
+/**
+ *
+ * Функция аналогична #urpc_client_exec, но выполняет запрос с данными полученными
+ * функцией #urpc_client_lock_data.
+ *
+ * \param urpc_client указатель на uRpcClient объект;
+ * \param urpc_data указатель на uRpcData объект;
+ * \param proc_id идентификатор вызываемой процедуры.
+ *
+ * \return Статус выполнения запроса.
+ *
+ */
+URPC_EXPORT
+uint32_t       urpc_client_exec_data           (uRpcClient            *urpc_client,
+                                                uRpcData              *urpc_data,
+                                                uint32_t               proc_id);
+
+/**
+ *
+ * Функция освобождает объект полученный функцией #urpc_client_lock_data.
+ *
+ * \param urpc_client указатель на uRpcClient объект;
+ * \param urpc_data указатель на uRpcData объект.
+ *
+ * \return Нет.
+ *
+ */
+URPC_EXPORT
+void           urpc_client_unlock_data         (uRpcClient            *urpc_client,
+                                                uRpcData              *urpc_data);
+
+/**
+ *
+ * Функция отправляет запрос с данными полученными функцией #urpc_client_lock_data и не
+ * ожидает ответа. После получения ответа вызывается функция proc, после чего объект
+ * urpc_data освобождается. Если запрос не удалось отправить, функция proc не вызывается
+ * и объект urpc_data необходимо освободить функцией #urpc_client_unlock_data.
+ *
+ * \param urpc_client указатель на uRpcClient объект;
+ * \param urpc_data указатель на uRpcData объект;
+ * \param proc_id идентификатор вызываемой процедуры;
+ * \param proc функция завершения запроса;
+ * \param user_data указатель на пользовательские данные для функции завершения.
+ *
+ * \return 0 - если запрос отправлен, иначе -1.
+ *
+ */
+URPC_EXPORT
+int            urpc_client_exec_async          (uRpcClient            *urpc_client,
+                                                uRpcData              *urpc_data,
+                                                uint32_t               proc_id,
+                                                urpc_client_async_proc proc,
+                                                void                  *user_data);
+
+/**
+ *
+ * Функция принимает доступные ответы сервера и вызывает функции завершения асинхронных
+ * запросов. Функция не ожидает поступления ответов. Функция также завершает с ошибкой
+ * запросы, время ожидания ответа на которые истекло, и сбрасывает оповещение
+ * дескриптора #urpc_client_get_event_fd.
+ *
+ * \param urpc_client указатель на uRpcClient объект.
+ *
+ * \return Число завершённых запросов или -1 в случае ошибки.
+ *
+ */
+URPC_EXPORT
+int            urpc_client_dispatch            (uRpcClient            *urpc_client);
+
+/**
+ *
+ * Функция возвращает рабочий сокет клиента, готовность которого к чтению означает
+ * поступление ответов сервера для обработки функцией #urpc_client_dispatch. Сокет
+ * необходимо ожидать совместно с дескриптором #urpc_client_get_event_fd.
+ *
+ * \param urpc_client указатель на uRpcClient объект.
+ *
+ * \return Дескриптор или -1 если протокол не поддерживает асинхронные запросы.
+ *
+ */
+URPC_EXPORT
+int            urpc_client_get_poll_fd         (uRpcClient            *urpc_client);
+
+/**
+ *
+ * Функция возвращает дескриптор оповещения, готовность которого к чтению означает
+ * наличие асинхронных запросов, ответы на которые приняты другими потоками, или
+ * неисправность соединения. Оповещение сбрасывается функцией #urpc_client_dispatch.
+ * В Linux используется eventfd, в остальных POSIX системах - канал, в Windows - сокет.
+ *
+ * \param urpc_client указатель на uRpcClient объект.
+ *
+ * \return Дескриптор или -1 если протокол не поддерживает асинхронные запросы.
+ *
+ */
+URPC_EXPORT
+int            urpc_client_get_event_fd        (uRpcClient            *urpc_client);
+
+/**
+ *
+ * Функция возвращает время, через которое необходимо вызвать функцию #urpc_client_dispatch
+ * для проверки таймаута асинхронных запросов, даже если дескрипторы не стали готовы к чтению.
+ *
+ * \param urpc_client указатель на uRpcClient объект.
+ *
+ * \return Время, с, 0 - если есть завершённые запросы, или -1 если асинхронных запросов нет.
+ *
+ */
+URPC_EXPORT
+double         urpc_client_get_timeout         (uRpcClient            *urpc_client);
+
 /**
  *
  * Функция возвращает указатель на строку с локальным адресом, к которому подключен RPC объект,
@@ -269,6 +441,46 @@ const char    *urpc_client_get_self_address    (uRpcClient            *urpc_clie
 URPC_EXPORT
 const char    *urpc_client_get_peer_address    (uRpcClient            *urpc_client);
 
+/**
+ *
+ * Функция запрашивает у сервера статистику выполнения его процедур (#urpc_server_get_stats).
+ * Записываются данные процедур, которые поместились в ответ сервера, но не более stats_num.
+ *
+ * \param urpc_client указатель на uRpcClient объект;
+ * \param stats массив для статистики процедур;
+ * \param stats_num число элементов массива.
+ *
+ * \return Число записанных элементов массива или отрицательное значение в случае ошибки.
+ *
+ */
+URPC_EXPORT
+int            urpc_client_get_server_stats    (uRpcClient            *urpc_client,
+                                                uRpcServerProcStats   *stats,
+                                                uint32_t               stats_num);
+
+/**
+ *
+ * Функция возвращает статистику запросов клиента (\link uRpcClientStats \endlink) и статистику
+ * по каждой вызванной процедуре (\link uRpcClientProcStats \endlink), включая системные.
+ * Статистика процедур записывается в порядке их первого вызова, но не более procs_num элементов.
+ *
+ * Превышение времени ожидания ответа TCP сервера приводит к разрыву подключения, такой
+ * запрос учитывается как ошибка передачи данных.
+ *
+ * \param urpc_client указатель на uRpcClient объект;
+ * \param stats указатель на статистику клиента или NULL;
+ * \param procs массив для статистики процедур или NULL;
+ * \param procs_num число элементов массива.
+ *
+ * \return Число процедур, для которых собрана статистика, или отрицательное значение в случае ошибки.
+ *
+ */
+URPC_EXPORT
+int            urpc_client_get_stats           (uRpcClient            *urpc_client,
+                                                uRpcClientStats       *stats,
+                                                uRpcClientProcStats   *procs,
+                                                uint32_t               procs_num);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
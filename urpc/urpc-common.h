@@ -29,6 +29,9 @@
 #include <urpc-types.h>
 #include <urpc-exports.h>
 #include <urpc-network.h>
+#include <urpc-doorbell.h>
+#include <urpc-stats.h>
+#include <urpc-data.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -54,17 +57,20 @@ extern "C"
 
 /* Все поля RPC заголовка представлены в сетевом (big endian) порядке следования байт. */
 #define URPC_MAGIC                     0x75525043      /* Идентификатор RPC пакета - строка 'uRPC'. */
-#define URPC_VERSION                   0x00030000      /* Версия протокола uRPC - старшие 16 бит - MAJOR, младшие 16 бит - MINOR. */
+#define URPC_VERSION                   0x00040000      /* Версия протокола uRPC - старшие 16 бит - MAJOR, младшие 16 бит - MINOR. */
 
 /* Системные идентификаторы параметров. */
 #define URPC_PARAM_PROC                0x00010000      /* Идентификатор вызываемой функции - uint32_t. */
 #define URPC_PARAM_STATUS              0x00020000      /* Идентификатор статуса - uint32_t. */
 #define URPC_PARAM_CAP                 0x00030000      /* Идентификатор возможностей сервера - uint32_t. */
+#define URPC_PARAM_STATS               0x00040000      /* Статистика процедур сервера - последовательность
+                                                          записей urpc_server_proc_stats_export. */
 
 /* Системные идентификаторы процедур. */
 #define URPC_PROC_GET_CAP              0x00010000      /* Получение возможностей сервера. */
 #define URPC_PROC_LOGIN                0x00020000      /* Начало сессии. */
 #define URPC_PROC_LOGOUT               0x00030000      /* Окончание сессии. */
+#define URPC_PROC_GET_STATS            0x00040000      /* Получение статистики процедур сервера. */
 
 /* Системные идентификаторы состояния подключения клиента. */
 #define URPC_STATE_CONNECTED           0x00010000      /* Подключено. */
@@ -79,6 +85,7 @@ struct _uRpcHeader
   uint32_t                             version;        /* Версия протокола uRPC. */
   uint32_t                             session;        /* Идентификатор сессии клиента. */
   uint32_t                             size;           /* Размер пакета. */
+  uint32_t                             id;             /* Идентификатор запроса, сервер возвращает его в ответе. */
 };
 
 /* Структура управляющего сегмента общей области памяти. */
@@ -87,14 +94,63 @@ struct _uRpcSHMControl
 {
   uint32_t                             pid;            /* Идентификатор процесса сервера. */
   uint32_t                             size;           /* Размер буфера RPC данных. */
-  uint32_t                             threads_num;    /* Число потоков сервера (буферов RPC данных). */
+  uint32_t                             threads_num;    /* Число потоков сервера. */
+  uint32_t                             slots_num;      /* Число слотов (пар буферов) RPC данных. */
 };
 
+/* Выравнивание областей транспортного сегмента общей области памяти по строке кеша. */
+#define URPC_SHM_ALIGN(size)                   (((size) + 63) & ~((size_t) 63))
+
+/* Заголовок транспортного сегмента общей области памяти. За ним следуют очередь
+   запросов, очередь свободных слотов, сигнальные слова каждого слота и сами буферы
+   RPC данных. Размеры структур кратны строке кеша. */
+typedef struct _uRpcSHMTransportHeader uRpcSHMTransportHeader;
+struct _uRpcSHMTransportHeader
+{
+  uRpcDoorbell                         request;        /* Сигнал поступления запроса в очередь. */
+  uRpcDoorbell                         released;       /* Сигнал освобождения слота. */
+  uint32_t                             reserved[12];
+};
+
+/* Сигнальные слова слота общей области памяти. */
+typedef struct _uRpcSHMSlot uRpcSHMSlot;
+struct _uRpcSHMSlot
+{
+  uRpcDoorbell                         stop;           /* Сигнал завершения выполнения запроса. */
+  uint32_t                             reserved[14];
+};
+
+/* Функция связывает объект RPC данных с его владельцем. Сервер указывает так запрос,
+   процедура которого выполняется с этим объектом. */
+void                   urpc_data_set_owner     (uRpcData              *urpc_data,
+                                                void                  *owner);
+
+/* Функция возвращает владельца объекта RPC данных или NULL. */
+void                  *urpc_data_get_owner     (uRpcData              *urpc_data);
+
 /* Функция возвращает указатель на структуру addrinfo с информацией о сетевых адресах.
    Формат сетевого адреса аналогичен возвращаемому функцией getaddrinfo. */
 URPC_EXPORT
 struct addrinfo       *urpc_get_sockaddr       (const char            *uri);
 
+/* Функция возвращает размер статистики процедуры сервера при передаче. */
+URPC_EXPORT
+uint32_t               urpc_server_proc_stats_get_size (const uRpcServerProcStats     *stats);
+
+/* Функция записывает статистику процедуры сервера в буфер размером не менее
+   urpc_server_proc_stats_get_size. Все значения записываются в сетевом порядке байт,
+   для гистограмм передаются только непустые интервалы. Возвращает число записанных байт. */
+URPC_EXPORT
+uint32_t               urpc_server_proc_stats_export   (const uRpcServerProcStats     *stats,
+                                                        void                          *data);
+
+/* Функция считывает статистику процедуры сервера из буфера. Возвращает число
+   считанных байт или 0 при ошибке в данных. */
+URPC_EXPORT
+uint32_t               urpc_server_proc_stats_import   (uRpcServerProcStats           *stats,
+                                                        const void                    *data,
+                                                        uint32_t                       size);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
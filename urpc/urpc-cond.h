@@ -0,0 +1,158 @@
+/*
+ * uRPC - rpc (remote procedure call) library.
+ *
+ * Copyright 2015 Andrei Fadeev (andrei@webcontrol.ru)
+ *
+ * This file is part of uRPC.
+ *
+ * uRPC is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * uRPC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the author in this case.
+ *
+ */
+
+/**
+ * \file urpc-cond.h
+ *
+ * \brief Заголовочный файл библиотеки работы с условными переменными
+ * \author Andrei Fadeev (andrei@webcontrol.ru)
+ * \date 2015
+ * \license GNU General Public License version 3 или более поздняя<br>
+ * Коммерческая лицензия - свяжитесь с автором
+ *
+ * \defgroup uRpcCond uRpcCond - библиотека работы с условными переменными.
+ *
+ * Библиотека предназначена для кросплатформенной работы с условными переменными. В POSIX совместимых
+ * системах используется pthread_cond, в Windows системах используется CONDITION_VARIABLE.
+ *
+ * Условная переменная используется совместно с мьютексом \link uRpcMutex \endlink. Поток
+ * заблокировавший мьютекс может ожидать изменения состояния функциями #urpc_cond_wait и
+ * #urpc_cond_timed_wait. На время ожидания мьютекс разблокируется. Другой поток изменяет
+ * состояние под защитой того же мьютекса и оповещает ожидающие потоки функциями
+ * #urpc_cond_signal или #urpc_cond_broadcast.
+ *
+ * Ожидание может завершиться без оповещения, поэтому после выхода из функции ожидания
+ * состояние необходимо проверять повторно.
+ *
+ * Перед использованием необходимо инициализировать условную переменную функцией #urpc_cond_init.
+ * Функция #urpc_cond_clear освобождает ресурсы выделенные при инициализации.
+ *
+ */
+
+#ifndef __URPC_COND_H__
+#define __URPC_COND_H__
+
+#include <urpc-exports.h>
+#include <urpc-mutex.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32)
+#include <windows.h>
+typedef CONDITION_VARIABLE uRpcCond;
+#endif
+
+#if defined(__unix__)
+#include <pthread.h>
+typedef pthread_cond_t uRpcCond;
+#endif
+
+/**
+ *
+ * Функция инициализирует условную переменную.
+ *
+ * \param cond указатель на условную переменную.
+ *
+ * \return Нет.
+ *
+*/
+URPC_EXPORT
+void           urpc_cond_init                  (uRpcCond              *cond);
+
+/**
+ *
+ * Функция освобождает ресурсы выделенные для условной переменной.
+ *
+ * \param cond указатель на условную переменную.
+ *
+ * \return Нет.
+ *
+*/
+URPC_EXPORT
+void           urpc_cond_clear                 (uRpcCond              *cond);
+
+/**
+ *
+ * Функция разблокирует мьютекс и ожидает оповещения. Перед выходом из функции мьютекс
+ * снова блокируется.
+ *
+ * \param cond указатель на условную переменную;
+ * \param mutex указатель на заблокированный мьютекс.
+ *
+ * \return Нет.
+ *
+*/
+URPC_EXPORT
+void           urpc_cond_wait                  (uRpcCond              *cond,
+                                                uRpcMutex             *mutex);
+
+/**
+ *
+ * Функция разблокирует мьютекс и ожидает оповещения в течение указанного времени.
+ * Перед выходом из функции мьютекс снова блокируется.
+ *
+ * \param cond указатель на условную переменную;
+ * \param mutex указатель на заблокированный мьютекс;
+ * \param timeout время ожидания, с.
+ *
+ * \return 0 - если получено оповещение, 1 - при истечении времени ожидания.
+ *
+*/
+URPC_EXPORT
+int            urpc_cond_timed_wait            (uRpcCond              *cond,
+                                                uRpcMutex             *mutex,
+                                                double                 timeout);
+
+/**
+ *
+ * Функция оповещает один из ожидающих потоков.
+ *
+ * \param cond указатель на условную переменную.
+ *
+ * \return Нет.
+ *
+*/
+URPC_EXPORT
+void           urpc_cond_signal                (uRpcCond              *cond);
+
+/**
+ *
+ * Функция оповещает все ожидающие потоки.
+ *
+ * \param cond указатель на условную переменную.
+ *
+ * \return Нет.
+ *
+*/
+URPC_EXPORT
+void           urpc_cond_broadcast             (uRpcCond              *cond);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __URPC_COND_H__ */
@@ -32,12 +32,29 @@
 #define URPC_DATA_TYPE   0x54445275
 
 #define DATA_ALIGN_SIZE  sizeof (uint32_t)     /* Минимальный размер переменной. */
+#define DATA_INDEX_SIZE  16                    /* Начальный размер индекса переменных. */
+#define DATA_INDEX_MIN   8                     /* Число переменных начиная с которого строится индекс. */
+
+typedef struct
+{
+  uint32_t             id;                     /* Идентификатор переменной. */
+  uint32_t             offset;                 /* Смещение переменной от начала данных. */
+  uint32_t             generation;             /* Поколение индекса в котором добавлена запись. */
+} DataIndex;
 
 typedef struct
 {
   uint8_t             *data;                   /* Указатель на данные в буфере приемо-передачи. */
   uint32_t             buffer_size;            /* Размер буфера. */
   uint32_t             data_size;              /* Размер данных. */
+
+  DataIndex           *index;                  /* Индекс переменных с открытой адресацией. */
+  uint32_t             index_mask;             /* Маска размера индекса (размер - степень двойки). */
+  uint32_t             index_used;             /* Число переменных в индексе. */
+  uint32_t             generation;             /* Текущее поколение индекса, записи других поколений свободны. */
+  uint32_t             last_offset;            /* Смещение последней переменной в буфере. */
+  int                  indexed;                /* Индекс соответствует данным в буфере - 1, индекс
+                                                  не построен - 0, цепочка переменных повреждена - -1. */
 } DataBuffer;
 
 typedef struct
@@ -64,19 +81,176 @@ struct _uRpcData
   int                  ibuffer_created;        /* Память под буфер входящих данных была выделена объектом. */
   int                  obuffer_created;        /* Память под буфер исходящих данных была выделена объектом. */
 
+  void                *owner;                  /* Владелец объекта или NULL. */
+
   DataBuffer           input;
   DataBuffer           output;
 };
 
+/* Функция сбрасывает индекс переменных. Записи индекса не очищаются, а
+   становятся недействительными за счёт смены поколения. */
+static void
+urpc_data_index_reset (DataBuffer *buffer)
+{
+  buffer->indexed = 0;
+  buffer->index_used = 0;
+  buffer->last_offset = 0;
+  buffer->generation += 1;
+
+  if (buffer->generation == 0)
+    {
+      if (buffer->index != NULL)
+        memset (buffer->index, 0, (buffer->index_mask + 1) * sizeof (DataIndex));
+      buffer->generation = 1;
+    }
+}
+
+/* Функция возвращает запись индекса для переменной или свободную запись,
+   в которую эта переменная может быть добавлена. */
+static DataIndex *
+urpc_data_index_lookup (DataIndex *index,
+                        uint32_t   index_mask,
+                        uint32_t   generation,
+                        uint32_t   id)
+{
+  uint32_t hash = id;
+
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6b;
+  hash ^= hash >> 13;
+
+  while (1)
+    {
+      DataIndex *entry = &index[hash & index_mask];
+      if (entry->generation != generation || entry->id == id)
+        return entry;
+      hash += 1;
+    }
+}
+
+/* Функция увеличивает размер индекса в два раза. */
+static int
+urpc_data_index_grow (DataBuffer *buffer)
+{
+  DataIndex *index;
+  uint32_t index_size;
+  uint32_t i;
+
+  index_size = (buffer->index == NULL) ? DATA_INDEX_SIZE : 2 * (buffer->index_mask + 1);
+  index = calloc (index_size, sizeof (DataIndex));
+  if (index == NULL)
+    return -1;
+
+  if (buffer->index != NULL)
+    {
+      for (i = 0; i <= buffer->index_mask; i++)
+        {
+          DataIndex *entry = &buffer->index[i];
+          if (entry->generation == buffer->generation)
+            *urpc_data_index_lookup (index, index_size - 1, buffer->generation, entry->id) = *entry;
+        }
+      free (buffer->index);
+    }
+
+  buffer->index = index;
+  buffer->index_mask = index_size - 1;
+
+  return 0;
+}
+
+/* Функция добавляет переменную в индекс. Если переменная с таким идентификатором
+   уже есть в индексе, в нём остаётся первая из них. */
+static int
+urpc_data_index_insert (DataBuffer *buffer,
+                        uint32_t    id,
+                        uint32_t    offset)
+{
+  DataIndex *entry;
+
+  /* Заполненность индекса не превышает половины. */
+  if (buffer->index == NULL || 2 * (buffer->index_used + 1) > buffer->index_mask + 1)
+    if (urpc_data_index_grow (buffer) < 0)
+      return -1;
+
+  entry = urpc_data_index_lookup (buffer->index, buffer->index_mask, buffer->generation, id);
+  if (entry->generation == buffer->generation)
+    return 0;
+
+  entry->id = id;
+  entry->offset = offset;
+  entry->generation = buffer->generation;
+  buffer->index_used += 1;
+
+  return 0;
+}
+
+/* Функция строит индекс по всем переменным в буфере. Если цепочка переменных
+   повреждена индекс не строится, поиск в таком буфере выполняется перебором. */
+static int
+urpc_data_index_build (DataBuffer *buffer)
+{
+  DataParam *param = (DataParam *)buffer->data;
+  uint32_t left_size = buffer->data_size;
+  uint32_t offset = 0;
+  uint32_t cur_param_size;
+
+  urpc_data_index_reset (buffer);
+
+  while (1)
+    {
+      uint32_t param_size;
+      uint32_t param_next;
+
+      if (left_size < sizeof (DataParam) - DATA_ALIGN_SIZE)
+        {
+          buffer->indexed = -1;
+          return -1;
+        }
+
+      param_size = UINT32_FROM_BE (param->size);
+      param_next = UINT32_FROM_BE (param->next);
+
+      cur_param_size = param_size + sizeof (DataParam) - DATA_ALIGN_SIZE;
+      if (cur_param_size > left_size)
+        {
+          buffer->indexed = -1;
+          return -1;
+        }
+
+      if (urpc_data_index_insert (buffer, UINT32_FROM_BE (param->id), offset) < 0)
+        {
+          urpc_data_index_reset (buffer);
+          return -1;
+        }
+
+      if (param_next == 0)
+        break;
+
+      left_size -= param_next;
+      offset += param_next;
+      param = (DataParam *) (buffer->data + offset);
+    }
+
+  buffer->last_offset = offset;
+  buffer->indexed = 1;
+
+  return 0;
+}
+
+/* Функция ищет переменную перебором всех переменных в буфере. В steps
+   возвращается число просмотренных переменных. */
 static DataParam *
-urpc_data_find_param (DataBuffer *buffer,
-                      uint32_t    id)
+urpc_data_walk_param (DataBuffer *buffer,
+                      uint32_t    id,
+                      uint32_t   *steps)
 {
   DataParam *param = (DataParam *)buffer->data;
   uint32_t left_size = buffer->data_size;
   uint32_t offset = 0;
   uint32_t cur_param_size;
 
+  *steps = 0;
+
   if (buffer->data_size == 0)
     return NULL;
 
@@ -101,6 +275,8 @@ urpc_data_find_param (DataBuffer *buffer,
       if (cur_param_size > left_size)
         return NULL;
 
+      *steps += 1;
+
       /* Если идентификаторы совпали, возвращаем указатель на искомый параметр.
          Последний параметр в списке можно определить по нулевому смещению до
          следующего параметра. В этом случае завершаем поиск. */
@@ -122,6 +298,38 @@ urpc_data_find_param (DataBuffer *buffer,
   return param;
 }
 
+/* Функция ищет переменную. Пока переменных в буфере немного, поиск выполняется
+   перебором. Если перебор оказался длинным, строится индекс и дальнейший поиск
+   выполняется по нему. Если искомая переменная не найдена возвращается указатель
+   на последнюю переменную в буфере. */
+static DataParam *
+urpc_data_find_param (DataBuffer *buffer,
+                      uint32_t    id)
+{
+  DataIndex *entry;
+
+  if (buffer->data_size == 0)
+    return NULL;
+
+  if (buffer->indexed <= 0)
+    {
+      DataParam *param;
+      uint32_t steps;
+
+      param = urpc_data_walk_param (buffer, id, &steps);
+      if (buffer->indexed == 0 && steps > DATA_INDEX_MIN)
+        urpc_data_index_build (buffer);
+
+      return param;
+    }
+
+  entry = urpc_data_index_lookup (buffer->index, buffer->index_mask, buffer->generation, id);
+  if (entry->generation == buffer->generation)
+    return (DataParam *) (buffer->data + entry->offset);
+
+  return (DataParam *) (buffer->data + buffer->last_offset);
+}
+
 static void *
 urpc_data_set_param (DataBuffer *buffer,
                      uint32_t    id,
@@ -160,7 +368,8 @@ urpc_data_set_param (DataBuffer *buffer,
       /* Если размер совпадает, установим значение. */
       if (param_size == size)
         {
-          memcpy (param->data, object, size);
+          if (object != NULL)
+            memcpy (param->data, object, size);
           return param->data;
         }
       /* Иначе вернем ошибку. */
@@ -184,6 +393,15 @@ urpc_data_set_param (DataBuffer *buffer,
       buffer->data_size += data_pad;
     }
 
+  /* Добавляем параметр в индекс, если он уже построен. */
+  if (buffer->indexed > 0)
+    {
+      if (urpc_data_index_insert (buffer, id, buffer->data_size) < 0)
+        urpc_data_index_reset (buffer);
+      else
+        buffer->last_offset = buffer->data_size;
+    }
+
   /* Запоминаем параметр в буфере. */
   param = (DataParam *) (buffer->data + buffer->data_size);
   buffer->data_size += size + sizeof (DataParam) - DATA_ALIGN_SIZE;
@@ -270,15 +488,42 @@ urpc_data_create (uint32_t buffer_size,
   urpc_data->input.data = urpc_data->ibuffer + urpc_data->header_size;
   urpc_data->input.data_size = 0;
   urpc_data->input.buffer_size = urpc_data->buffer_size - urpc_data->header_size;
+  urpc_data->input.index = NULL;
+  urpc_data->input.generation = 0;
+  urpc_data_index_reset (&urpc_data->input);
+
+  urpc_data->owner = NULL;
 
   urpc_data->output.data = urpc_data->obuffer + urpc_data->header_size;
   urpc_data->output.data_size = 0;
   urpc_data->output.buffer_size = urpc_data->buffer_size - urpc_data->header_size;
+  urpc_data->output.index = NULL;
+  urpc_data->output.generation = 0;
+  urpc_data_index_reset (&urpc_data->output);
 
   return urpc_data;
 }
 
 
+void
+urpc_data_set_owner (uRpcData *urpc_data,
+                     void     *owner)
+{
+  if (urpc_data->urpc_data_type != URPC_DATA_TYPE)
+    return;
+
+  urpc_data->owner = owner;
+}
+
+void *
+urpc_data_get_owner (uRpcData *urpc_data)
+{
+  if (urpc_data->urpc_data_type != URPC_DATA_TYPE)
+    return NULL;
+
+  return urpc_data->owner;
+}
+
 void
 urpc_data_destroy (uRpcData *urpc_data)
 {
@@ -289,6 +534,8 @@ urpc_data_destroy (uRpcData *urpc_data)
     free (urpc_data->ibuffer);
   if (urpc_data->obuffer_created)
     free (urpc_data->obuffer);
+  free (urpc_data->input.index);
+  free (urpc_data->output.index);
   free (urpc_data);
 }
 
@@ -346,6 +593,7 @@ urpc_data_set_data_size (uRpcData         *urpc_data,
     memset (data_buffer->data + data_size, 0, data_buffer->data_size - data_size);
 
   data_buffer->data_size = data_size;
+  urpc_data_index_reset (data_buffer);
 
   return 0;
 }
@@ -392,6 +640,7 @@ urpc_data_set_data (uRpcData         *urpc_data,
     memset (data_buffer->data + data_size, 0, data_buffer->data_size - data_size);
 
   data_buffer->data_size = data_size;
+  urpc_data_index_reset (data_buffer);
 
   return 0;
 }
@@ -484,6 +733,17 @@ urpc_data_set (uRpcData   *urpc_data,
   return urpc_data_set_param (&urpc_data->output, id, object, size);
 }
 
+void *
+urpc_data_reserve (uRpcData *urpc_data,
+                   uint32_t  id,
+                   uint32_t  size)
+{
+  if (urpc_data->urpc_data_type != URPC_DATA_TYPE)
+    return NULL;
+
+  return urpc_data_set_param (&urpc_data->output, id, NULL, size);
+}
+
 void *
 urpc_data_get (uRpcData *urpc_data,
                uint32_t  id,
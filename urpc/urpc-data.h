@@ -46,6 +46,9 @@
  * памяти. Пользователь может записывать и считывать данные из этой области в
  * границах заданного размера. Эти данные будут переданы серверу или клиенту в неизменном виде.
  *
+ * Место под переменную можно зарегистрировать без копирования функцией #urpc_data_reserve,
+ * после чего заполнить её непосредственно в буфере передачи.
+ *
  * Указатель на принятые данные можно получить функцией #urpc_data_get.
  *
  * Так как клиент и сервер могут работать на разных архитектурах, включая архитектуры
@@ -264,9 +267,33 @@ void          *urpc_data_set                   (uRpcData              *urpc_data
                                                 const void            *object,
                                                 uint32_t               size);
 
+/**
+ *
+ * Функция регистрирует переменную заданного размера в буфере передачи без
+ * копирования данных и возвращает указатель на неё. Пользователь заполняет
+ * переменную непосредственно в буфере передачи. Для транспорта shm буфер
+ * расположен в общей области памяти, поэтому данные передаются без копирования.
+ *
+ * Если переменная с таким идентификатором уже зарегистрирована, возвращается
+ * указатель на неё при совпадении размера или если это последняя переменная в буфере.
+ * Функция эквивалентна вызову #urpc_data_set с object равным NULL.
+ *
+ * \param urpc_data указатель на RPC буфер;
+ * \param id идентификатор переменной;
+ * \param size размер переменной.
+ *
+ * \return Адрес переменной в буфере в случае успешного завершения, иначе NULL.
+ *
+ */
+URPC_EXPORT
+void          *urpc_data_reserve               (uRpcData              *urpc_data,
+                                                uint32_t               id,
+                                                uint32_t               size);
+
 /**
  *
  * Функция возвращает указатель на хранимую переменную и ее размер по идентификатору.
+ * Переменная не копируется, указатель действителен до освобождения RPC буфера.
  *
  * \param urpc_data указатель на RPC буфер;
  * \param id идентификатор переменной;
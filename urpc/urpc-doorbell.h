@@ -0,0 +1,158 @@
+/*
+ * uRPC - rpc (remote procedure call) library.
+ *
+ * Copyright 2015 Andrei Fadeev (andrei@webcontrol.ru)
+ *
+ * This file is part of uRPC.
+ *
+ * uRPC is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * uRPC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the author in this case.
+ *
+ */
+
+/**
+ * \file urpc-doorbell.h
+ *
+ * \brief Заголовочный файл библиотеки межпроцессной сигнализации через общую память
+ * \author Andrei Fadeev (andrei@webcontrol.ru)
+ * \date 2015
+ * \license GNU General Public License version 3 или более поздняя<br>
+ * Коммерческая лицензия - свяжитесь с автором
+ *
+ * \defgroup uRpcDoorbell uRpcDoorbell - библиотека межпроцессной сигнализации через общую память.
+ *
+ * Сигнал (doorbell) - это структура uRpcDoorbell, расположенная в сегменте разделяемой памяти
+ * \link uRpcShm \endlink и доступная нескольким процессам. Сигнал используется для передачи
+ * события от одного процесса другому без обращения к именованным объектам операционной системы.
+ *
+ * Функция #urpc_doorbell_ring устанавливает сигнал и, если получатель уже заснул в ожидании,
+ * будит его. Если получатель не спит, системный вызов не выполняется. Функция #urpc_doorbell_wait ожидает установки сигнала и сбрасывает его. Ожидание
+ * начинается с короткого активного опроса слова, число итераций которого подстраивается под
+ * время реакции второй стороны. Если за время опроса сигнал не получен, поток засыпает. В Linux
+ * для этого используется futex, в остальных системах - периодический опрос с уступкой процессора.
+ *
+ * Сигнал рассчитан на одного получателя. Если сигнал ожидают несколько потоков, его получит
+ * только один из них, а установка сигнала до его получения не накапливается. Поэтому при
+ * нескольких получателях ожидание необходимо ограничивать по времени и проверять состояние повторно.
+ *
+ * Функция #urpc_doorbell_poll опрашивает сигнал в течение заданного времени без засыпания и
+ * адаптации. Она предназначена для потоков, которым выделен отдельный процессор.
+ *
+ * Функции #urpc_doorbell_trylock и #urpc_doorbell_unlock используют 32-х битное слово
+ * общей памяти как признак захвата ресурса без ожидания.
+ *
+ * Перед использованием структура сигнала и слова захвата должны быть обнулены.
+ *
+ */
+
+#ifndef __URPC_DOORBELL_H__
+#define __URPC_DOORBELL_H__
+
+#include <urpc-exports.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Максимальное число итераций активного опроса сигнала. */
+#define URPC_DOORBELL_MAX_SPIN                 4096
+
+typedef struct _uRpcDoorbell uRpcDoorbell;
+
+struct _uRpcDoorbell
+{
+  uint32_t                             signal;         /* Признак установки сигнала. */
+  uint32_t                             waiters;        /* Число спящих получателей. */
+};
+
+/**
+ *
+ * Функция устанавливает сигнал и будит ожидающий его поток.
+ *
+ * \param doorbell указатель на сигнал.
+ *
+ * \return Нет.
+ *
+ */
+URPC_EXPORT
+void urpc_doorbell_ring        (uRpcDoorbell          *doorbell);
+
+/**
+ *
+ * Функция ожидает установки сигнала в течение указанного времени и сбрасывает его.
+ *
+ * Перед засыпанием функция опрашивает сигнал не более *spin раз. Если сигнал
+ * был получен во время опроса, значение *spin увеличивается, иначе уменьшается. Переменная
+ * spin принадлежит вызывающему потоку и должна сохраняться между вызовами. Если spin
+ * равен NULL или в системе один процессор, активный опрос не выполняется.
+ *
+ * \param doorbell указатель на сигнал;
+ * \param spin указатель на текущее число итераций активного опроса или NULL;
+ * \param timeout время ожидания сигнала, с, отрицательное значение - без ограничения.
+ *
+ * \return 0 - если сигнал получен, 1 - в случае таймаута.
+ *
+ */
+URPC_EXPORT
+int urpc_doorbell_wait         (uRpcDoorbell          *doorbell,
+                                uint32_t              *spin,
+                                double                 timeout);
+
+/**
+ *
+ * Функция активно опрашивает сигнал в течение указанного времени и сбрасывает его,
+ * если он был установлен. Функция не засыпает и не уступает процессор.
+ *
+ * \param doorbell указатель на сигнал;
+ * \param time время опроса, с.
+ *
+ * \return 0 - если сигнал получен, 1 - если за время опроса сигнал не был установлен.
+ *
+ */
+URPC_EXPORT
+int urpc_doorbell_poll         (uRpcDoorbell          *doorbell,
+                                double                 time);
+
+/**
+ *
+ * Функция однократно пытается захватить слово.
+ *
+ * \param lock указатель на слово.
+ *
+ * \return 0 - в случае успешного захвата, иначе отрицательное число.
+ *
+ */
+URPC_EXPORT
+int urpc_doorbell_trylock      (volatile uint32_t     *lock);
+
+/**
+ *
+ * Функция освобождает захваченное слово.
+ *
+ * \param lock указатель на слово.
+ *
+ * \return Нет.
+ *
+ */
+URPC_EXPORT
+void urpc_doorbell_unlock      (volatile uint32_t     *lock);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __URPC_DOORBELL_H__ */
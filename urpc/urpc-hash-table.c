@@ -24,62 +24,198 @@
  */
 
 #include "urpc-hash-table.h"
-#include "urpc-mem-chunk.h"
 
 #include <stdlib.h>
 
 #define URPC_HASH_TABLE_TYPE 0x54544875
-#define HASH_TABLE_SIZE      251
+#define HASH_TABLE_MIN_SIZE  16                /* Начальный размер таблицы, степень двойки. */
+#define HASH_TABLE_STEP      8                 /* Число ячеек переносимых за одну операцию. */
 
-typedef struct _HashNode HashNode;
+#define HASH_NODE_FREE       0                 /* Ячейка свободна. */
+#define HASH_NODE_USED       1                 /* Ячейка занята. */
+#define HASH_NODE_DELETED    2                 /* Ключ из ячейки удалён. */
 
-struct _HashNode
+typedef struct
 {
   uint32_t             key;                    /* Значение ключа. */
+  uint32_t             state;                  /* Состояние ячейки. */
   void                *value;                  /* Указатель на данные. */
-  HashNode            *next;                   /* Указатель на следующий узел. */
-};
+} HashNode;
+
+typedef struct
+{
+  HashNode            *nodes;                  /* Ячейки таблицы с открытой адресацией. */
+  uint32_t             mask;                   /* Маска размера таблицы (размер - степень двойки). */
+  uint32_t             used;                   /* Число занятых ячеек. */
+  uint32_t             deleted;                /* Число ячеек с удалёнными ключами. */
+} HashNodes;
 
 struct _uRpcHashTable
 {
   uint32_t             type;                   /* Тип объекта uRpcHashTable. */
 
   uint32_t             nnodes;                 /* Число объектов. */
-  HashNode           **nodes;                  /* Хэш таблица. */
-
-  uRpcMemChunk        *chunks;                 /* Аллокатор ключей. */
+  HashNodes            nodes;                  /* Хэш таблица. */
+  HashNodes            old_nodes;              /* Предыдущая хэш таблица, ключи из которой
+                                                  переносятся в новую по мере работы. */
+  uint32_t             rehash_pos;             /* Номер следующей переносимой ячейки. */
+  uint32_t             iterating;              /* Признак обхода таблицы функцией foreach. */
 
   urpc_hash_table_destroy_callback value_destroy_func;
 };
 
+/* Функция перемешивания битов ключа. */
+static uint32_t
+urpc_hash_table_hash (uint32_t key)
+{
+  key ^= key >> 16;
+  key *= 0x85ebca6b;
+  key ^= key >> 13;
+  key *= 0xc2b2ae35;
+  key ^= key >> 16;
+
+  return key;
+}
+
+/* Функция ищет ячейку с ключом. */
+static HashNode *
+urpc_hash_table_lookup (HashNodes *nodes,
+                        uint32_t   key)
+{
+  uint32_t pos;
+
+  if (nodes->nodes == NULL)
+    return NULL;
+
+  pos = urpc_hash_table_hash (key);
+  while (1)
+    {
+      HashNode *node = &nodes->nodes[pos & nodes->mask];
+
+      if (node->state == HASH_NODE_FREE)
+        return NULL;
+      if (node->state == HASH_NODE_USED && node->key == key)
+        return node;
+
+      pos += 1;
+    }
+}
+
+/* Функция добавляет отсутствующий в таблице ключ. */
+static void
+urpc_hash_table_put (HashNodes *nodes,
+                     uint32_t   key,
+                     void      *value)
+{
+  uint32_t pos = urpc_hash_table_hash (key);
+  HashNode *node;
+
+  while (1)
+    {
+      node = &nodes->nodes[pos & nodes->mask];
+      if (node->state != HASH_NODE_USED)
+        break;
+      pos += 1;
+    }
+
+  if (node->state == HASH_NODE_DELETED)
+    nodes->deleted -= 1;
+
+  node->key = key;
+  node->value = value;
+  node->state = HASH_NODE_USED;
+  nodes->used += 1;
+}
+
+/* Функция переносит часть ключей из предыдущей таблицы в новую. При обходе
+   таблицы ключи не переносятся. */
+static void
+urpc_hash_table_rehash (uRpcHashTable *hash_table,
+                        uint32_t       steps)
+{
+  HashNodes *old_nodes = &hash_table->old_nodes;
+
+  if (old_nodes->nodes == NULL || hash_table->iterating)
+    return;
+
+  while (steps-- > 0 && hash_table->rehash_pos <= old_nodes->mask)
+    {
+      HashNode *node = &old_nodes->nodes[hash_table->rehash_pos++];
+      if (node->state == HASH_NODE_USED)
+        {
+          urpc_hash_table_put (&hash_table->nodes, node->key, node->value);
+          node->state = HASH_NODE_DELETED;
+        }
+    }
+
+  if (hash_table->rehash_pos > old_nodes->mask)
+    {
+      free (old_nodes->nodes);
+      old_nodes->nodes = NULL;
+    }
+}
+
+/* Функция создаёт новую таблицу, ключи из текущей переносятся в неё постепенно.
+   Размер новой таблицы выбирается так, чтобы перенос завершился раньше, чем она
+   заполнится наполовину. */
+static int
+urpc_hash_table_resize (uRpcHashTable *hash_table)
+{
+  HashNodes *nodes = &hash_table->nodes;
+  HashNode *new_nodes;
+  uint32_t size;
+
+  /* Незавершённый перенос завершаем сразу. */
+  if (hash_table->old_nodes.nodes != NULL)
+    urpc_hash_table_rehash (hash_table, UINT32_MAX);
+
+  size = HASH_TABLE_MIN_SIZE;
+  while (size < 4 * (nodes->used + 1))
+    size *= 2;
+
+  new_nodes = calloc (size, sizeof (HashNode));
+  if (new_nodes == NULL)
+    return -1;
+
+  hash_table->old_nodes = *nodes;
+  hash_table->rehash_pos = 0;
+
+  nodes->nodes = new_nodes;
+  nodes->mask = size - 1;
+  nodes->used = 0;
+  nodes->deleted = 0;
+
+  urpc_hash_table_rehash (hash_table, HASH_TABLE_STEP);
+
+  return 0;
+}
+
 uRpcHashTable *
 urpc_hash_table_create (urpc_hash_table_destroy_callback value_destroy_func)
 {
   uRpcHashTable *hash_table;
-  int i;
 
   hash_table = malloc (sizeof (uRpcHashTable));
   if (hash_table == NULL)
     return NULL;
 
-  hash_table->nodes = malloc (HASH_TABLE_SIZE * sizeof (HashNode *));
-  if (hash_table->nodes == NULL)
+  hash_table->nodes.nodes = calloc (HASH_TABLE_MIN_SIZE, sizeof (HashNode));
+  if (hash_table->nodes.nodes == NULL)
     {
       free (hash_table);
       return NULL;
     }
 
-  hash_table->chunks = urpc_mem_chunk_create (sizeof (HashNode));
-  if (hash_table->chunks == NULL)
-    {
-      free (hash_table->nodes);
-      free (hash_table);
-      return NULL;
-    }
-
   hash_table->nnodes = 0;
-  for (i = 0; i < HASH_TABLE_SIZE; i++)
-    hash_table->nodes[i] = NULL;
+  hash_table->nodes.mask = HASH_TABLE_MIN_SIZE - 1;
+  hash_table->nodes.used = 0;
+  hash_table->nodes.deleted = 0;
+  hash_table->old_nodes.nodes = NULL;
+  hash_table->old_nodes.mask = 0;
+  hash_table->old_nodes.used = 0;
+  hash_table->old_nodes.deleted = 0;
+  hash_table->rehash_pos = 0;
+  hash_table->iterating = 0;
 
   hash_table->value_destroy_func = value_destroy_func;
 
@@ -91,7 +227,6 @@ urpc_hash_table_create (urpc_hash_table_destroy_callback value_destroy_func)
 void
 urpc_hash_table_destroy (uRpcHashTable *hash_table)
 {
-  HashNode *node;
   uint32_t i;
 
   if (hash_table->type != URPC_HASH_TABLE_TYPE)
@@ -99,22 +234,17 @@ urpc_hash_table_destroy (uRpcHashTable *hash_table)
 
   if (hash_table->value_destroy_func != NULL)
     {
-      for (i = 0; i < HASH_TABLE_SIZE; i++)
-        {
-          node = hash_table->nodes[i];
-          if (node == NULL)
-            continue;
-
-          while (node != NULL)
-            {
-              hash_table->value_destroy_func (node->value);
-              node = node->next;
-            }
-        }
+      for (i = 0; hash_table->old_nodes.nodes != NULL && i <= hash_table->old_nodes.mask; i++)
+        if (hash_table->old_nodes.nodes[i].state == HASH_NODE_USED)
+          hash_table->value_destroy_func (hash_table->old_nodes.nodes[i].value);
+
+      for (i = 0; i <= hash_table->nodes.mask; i++)
+        if (hash_table->nodes.nodes[i].state == HASH_NODE_USED)
+          hash_table->value_destroy_func (hash_table->nodes.nodes[i].value);
     }
 
-  urpc_mem_chunk_destroy (hash_table->chunks);
-  free (hash_table->nodes);
+  free (hash_table->old_nodes.nodes);
+  free (hash_table->nodes.nodes);
   free (hash_table);
 }
 
@@ -123,34 +253,34 @@ urpc_hash_table_insert (uRpcHashTable *hash_table,
                         uint32_t       key,
                         void          *value)
 {
-  HashNode *parrent = NULL;
-  HashNode *node;
+  HashNodes *nodes = &hash_table->nodes;
 
   if (hash_table->type != URPC_HASH_TABLE_TYPE)
     return -1;
 
-  node = hash_table->nodes[key % HASH_TABLE_SIZE];
-  while (node != NULL)
-    {
-      if (node->key == key)
-        return 1;
-
-      parrent = node;
-      node = node->next;
-    }
+  if (urpc_hash_table_lookup (nodes, key) != NULL ||
+      urpc_hash_table_lookup (&hash_table->old_nodes, key) != NULL)
+    return 1;
 
-  node = urpc_mem_chunk_alloc (hash_table->chunks);
-  if (node == NULL)
-    return -1;
+  urpc_hash_table_rehash (hash_table, HASH_TABLE_STEP);
 
-  node->key = key;
-  node->value = value;
-  node->next = NULL;
+  /* Заполненность таблицы, включая удалённые ключи, не превышает половины.
+     При обходе таблица не изменяется, но в ней должна оставаться хотя бы
+     одна свободная ячейка. */
+  if (2 * (nodes->used + nodes->deleted + 1) > nodes->mask + 1)
+    {
+      if (!hash_table->iterating)
+        {
+          if (urpc_hash_table_resize (hash_table) < 0)
+            return -1;
+        }
+      else if (nodes->used + nodes->deleted + 1 > nodes->mask)
+        {
+          return -1;
+        }
+    }
 
-  if (parrent == NULL)
-    hash_table->nodes[key % HASH_TABLE_SIZE] = node;
-  else
-    parrent->next = node;
+  urpc_hash_table_put (nodes, key, value);
   hash_table->nnodes += 1;
 
   return 0;
@@ -173,16 +303,13 @@ urpc_hash_table_find (uRpcHashTable *hash_table,
   if (hash_table->type != URPC_HASH_TABLE_TYPE)
     return NULL;
 
-  node = hash_table->nodes[key % HASH_TABLE_SIZE];
-  while (node != NULL)
-    {
-      if (node->key == key)
-        return node->value;
-
-      node = node->next;
-    }
+  node = urpc_hash_table_lookup (&hash_table->nodes, key);
+  if (node == NULL)
+    node = urpc_hash_table_lookup (&hash_table->old_nodes, key);
+  if (node == NULL)
+    return NULL;
 
-  return NULL;
+  return node->value;
 }
 
 uint32_t
@@ -197,25 +324,30 @@ urpc_hash_table_foreach (uRpcHashTable                   *hash_table,
                          urpc_hash_table_foreach_callback callback,
                          void                            *user_data)
 {
-  HashNode *node, *next;
-  uint32_t i;
+  HashNodes *tables[2];
+  uint32_t i, j;
 
   if (hash_table->type != URPC_HASH_TABLE_TYPE)
     return;
 
-  for (i = 0; i < HASH_TABLE_SIZE; i++)
+  /* Во время обхода ключи между таблицами не переносятся. */
+  hash_table->iterating += 1;
+
+  tables[0] = &hash_table->old_nodes;
+  tables[1] = &hash_table->nodes;
+  for (i = 0; i < 2; i++)
     {
-      node = hash_table->nodes[i];
-      if (node == NULL)
-        continue;
+      HashNodes *nodes = tables[i];
 
-      while (node != NULL)
+      for (j = 0; nodes->nodes != NULL && j <= nodes->mask; j++)
         {
-          next = node->next;
-          callback (node->key, node->value, user_data);
-          node = next;
+          HashNode *node = &nodes->nodes[j];
+          if (node->state == HASH_NODE_USED)
+            callback (node->key, node->value, user_data);
         }
     }
+
+  hash_table->iterating -= 1;
 }
 
 uint32_t
@@ -231,33 +363,35 @@ int
 urpc_hash_table_remove (uRpcHashTable *hash_table,
                         uint32_t       key)
 {
-  HashNode *parrent = NULL;
+  HashNodes *nodes = &hash_table->nodes;
   HashNode *node;
+  void *value;
 
   if (hash_table->type != URPC_HASH_TABLE_TYPE)
     return -1;
 
-  node = hash_table->nodes[key % HASH_TABLE_SIZE];
-  while (node != NULL)
-    {
-      if (node->key == key)
-        {
-          if (parrent != NULL)
-            parrent->next = node->next;
-          else
-            hash_table->nodes[key % HASH_TABLE_SIZE] = node->next;
+  urpc_hash_table_rehash (hash_table, HASH_TABLE_STEP);
 
-          if (hash_table->value_destroy_func != NULL)
-            hash_table->value_destroy_func (node->value);
+  node = urpc_hash_table_lookup (nodes, key);
+  if (node == NULL)
+    {
+      nodes = &hash_table->old_nodes;
+      node = urpc_hash_table_lookup (nodes, key);
+    }
+  if (node == NULL)
+    return 1;
 
-          urpc_mem_chunk_free (hash_table->chunks, node);
-          hash_table->nnodes -= 1;
-          return 0;
-        }
+  /* Ячейка помечается удалённой, чтобы не прерывать цепочки поиска
+     других ключей. Такие ячейки очищаются при перестроении таблицы. */
+  value = node->value;
+  node->state = HASH_NODE_DELETED;
+  node->value = NULL;
+  nodes->used -= 1;
+  nodes->deleted += 1;
+  hash_table->nnodes -= 1;
 
-      parrent = node;
-      node = node->next;
-    }
+  if (hash_table->value_destroy_func != NULL)
+    hash_table->value_destroy_func (value);
 
-  return 1;
+  return 0;
 }
@@ -34,9 +34,13 @@
  *
  * \defgroup uRpcHashTable uRpcHashTable - библиотека работы с хэш таблицей.
  *
- * Хэш таблица предстваляет собой упрощённый вариант и предназначена для хранения указателей на
- * объекты общим числом примерно до 100000 элементов. Большее число элементов может размещаться в
- * таблице, но при этом возрастают накладные расходы на добавление и поиск.
+ * Хэш таблица предназначена для хранения указателей на объекты. Таблица использует открытую
+ * адресацию и увеличивается по мере добавления элементов. Ключи переносятся в увеличенную таблицу
+ * постепенно, при добавлении и удалении ключей, поэтому время выполнения операций не зависит от
+ * числа элементов в таблице.
+ *
+ * Функции хэш таблицы не защищены блокировками. При использовании одной таблицы из нескольких
+ * потоков доступ к ней должен синхронизироваться пользователем.
  *
  * Хэш таблица сохраняет указатели на данные ассоциированные с ключами и по запросу возвращает эти
  * указатели. При удалении ключа или всей таблицы целиком может быть вызвана функция #urpc_hash_table_destroy_callback
@@ -86,7 +90,8 @@ typedef void (*urpc_hash_table_destroy_callback)   (void              *data);
  * Функция используется для выполнения определённых действий над всеми ключами массива.
  * В этой функции нельзя удалять элементы массива отличные от текущего обрабатываемого.
  * Если пользователь добавил новые элементы массива, нет гарантии, что они будут обработаны
- * в текущем цикле функции #urpc_hash_table_foreach.
+ * в текущем цикле функции #urpc_hash_table_foreach. Во время обхода размер таблицы не изменяется,
+ * поэтому добавление элементов может завершиться ошибкой.
  *
  * \param key значение ключа;
  * \param value указатель на данные;
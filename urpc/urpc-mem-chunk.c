@@ -24,22 +24,47 @@
  */
 
 #include "urpc-mem-chunk.h"
+#include "urpc-mutex.h"
 
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 #define URPC_MEM_CHUNK_TYPE 0x54434D75
+#define URPC_MEM_CACHE_TYPE 0x43434D75
 
 #define DATA_ALIGN          (2 * sizeof (void*))
 #define PAGE_SIZE_ALIGN     4096
 
+#define CHUNK_LIST_END      0xffffffff         /* Признак конца списка свободных блоков. */
+#define CHUNK_USED          0xfffffffe         /* Признак занятого блока. */
+
+#define KEEP_EMPTY_PAGES    1                  /* Минимальное число сохраняемых пустых страниц. */
+#define KEEP_EMPTY_RATIO    8                  /* Доля сохраняемых пустых страниц от числа страниц. */
+
 typedef struct _ChunkPage ChunkPage;
+typedef struct _ChunkHeader ChunkHeader;
 
+/* Заголовок страницы. Освобождённые блоки страницы связаны в список по номерам блоков,
+   блоки за границей uninit ещё ни разу не выдавались и в список не входят. Страницы
+   с освобождёнными блоками связаны в общий список. */
 struct _ChunkPage
 {
   ChunkPage           *next;                   /* Указатель на следующую страницу. */
+  ChunkPage           *prev;                   /* Указатель на предыдущую страницу. */
+  ChunkPage           *next_free;              /* Следующая страница с освобождёнными блоками. */
+  ChunkPage           *prev_free;              /* Предыдущая страница с освобождёнными блоками. */
   uint32_t             free;                   /* Число свободных слотов для объектов. */
+  uint32_t             uninit;                 /* Номер первого ещё не выдававшегося блока. */
+  uint32_t             free_head;              /* Первый блок в списке свободных. */
+  uint32_t             free_tail;              /* Последний блок в списке свободных. */
+};
+
+/* Служебная информация блока, за ней идут данные пользователя. */
+struct _ChunkHeader
+{
+  uint32_t             index;                  /* Номер блока в странице. */
+  uint32_t             next;                   /* Следующий свободный блок или признак занятости. */
 };
 
 struct _uRpcMemChunk
@@ -52,8 +77,220 @@ struct _uRpcMemChunk
   void                *pages;                  /* Страницы памяти объектов. */
   int                  page_size;              /* Размер страницы. */
   int                  offset;                 /* Смещение до данных от начала страницы. */
+
+  ChunkPage           *free_pages;             /* Первая страница с освобождёнными блоками. */
+  ChunkPage           *free_pages_tail;        /* Последняя страница с освобождёнными блоками. */
+  ChunkPage           *uninit_page;            /* Страница с ещё не выдававшимися блоками. */
+
+  uint32_t             pages_num;              /* Число страниц. */
+  uint32_t             empty_pages_num;        /* Число пустых страниц. */
+  uint32_t             peak_pages_num;         /* Максимальное число страниц. */
+  uint32_t             chunks_num;             /* Число выделенных объектов. */
+  uint32_t             peak_chunks_num;        /* Максимальное число выделенных объектов. */
+
+  uRpcMutex            lock;                   /* Блокировка доступа к страницам. */
 };
 
+struct _uRpcMemChunkCache
+{
+  uint32_t             type;                   /* Тип объекта uRpcMemChunkCache. */
+
+  uRpcMemChunk        *mem_chunk;              /* Блок объектов. */
+  void               **chunks;                 /* Стек блоков кеша. */
+  int                  chunks_num;             /* Число блоков в кеше. */
+  int                  size;                   /* Максимальное число блоков в кеше. */
+};
+
+/* Функция возвращает заголовок блока с указанным номером. */
+static ChunkHeader *
+urpc_mem_chunk_get_header (uRpcMemChunk *mem_chunk,
+                           ChunkPage    *chunk_page,
+                           uint32_t      index)
+{
+  return (ChunkHeader *) ((uint8_t *) chunk_page + mem_chunk->offset + index * mem_chunk->chunk_size);
+}
+
+/* Функция добавляет страницу в конец списка страниц с освобождёнными блоками. */
+static void
+urpc_mem_chunk_push_free_page (uRpcMemChunk *mem_chunk,
+                               ChunkPage    *chunk_page)
+{
+  chunk_page->next_free = NULL;
+  chunk_page->prev_free = mem_chunk->free_pages_tail;
+  if (mem_chunk->free_pages_tail != NULL)
+    mem_chunk->free_pages_tail->next_free = chunk_page;
+  else
+    mem_chunk->free_pages = chunk_page;
+  mem_chunk->free_pages_tail = chunk_page;
+}
+
+/* Функция удаляет страницу из списка страниц с освобождёнными блоками. */
+static void
+urpc_mem_chunk_remove_free_page (uRpcMemChunk *mem_chunk,
+                                 ChunkPage    *chunk_page)
+{
+  if (chunk_page->prev_free != NULL)
+    chunk_page->prev_free->next_free = chunk_page->next_free;
+  else
+    mem_chunk->free_pages = chunk_page->next_free;
+
+  if (chunk_page->next_free != NULL)
+    chunk_page->next_free->prev_free = chunk_page->prev_free;
+  else
+    mem_chunk->free_pages_tail = chunk_page->prev_free;
+}
+
+/* Функция выделяет и инициализирует новую страницу. */
+static ChunkPage *
+urpc_mem_chunk_new_page (uRpcMemChunk *mem_chunk)
+{
+  ChunkPage *chunk_page;
+
+  chunk_page = malloc (mem_chunk->page_size);
+  if (chunk_page == NULL)
+    return NULL;
+
+  chunk_page->next = mem_chunk->pages;
+  chunk_page->prev = NULL;
+  if (mem_chunk->pages != NULL)
+    ((ChunkPage *) mem_chunk->pages)->prev = chunk_page;
+  mem_chunk->pages = chunk_page;
+
+  chunk_page->next_free = NULL;
+  chunk_page->prev_free = NULL;
+  chunk_page->free = mem_chunk->nchunks_in_page;
+  chunk_page->uninit = 0;
+  chunk_page->free_head = CHUNK_LIST_END;
+  chunk_page->free_tail = CHUNK_LIST_END;
+
+  mem_chunk->pages_num += 1;
+  mem_chunk->empty_pages_num += 1;
+  if (mem_chunk->pages_num > mem_chunk->peak_pages_num)
+    mem_chunk->peak_pages_num = mem_chunk->pages_num;
+
+  return chunk_page;
+}
+
+/* Функция освобождает пустую страницу. */
+static void
+urpc_mem_chunk_release_page (uRpcMemChunk *mem_chunk,
+                             ChunkPage    *chunk_page)
+{
+  if (chunk_page->free_head != CHUNK_LIST_END)
+    urpc_mem_chunk_remove_free_page (mem_chunk, chunk_page);
+
+  if (chunk_page->prev != NULL)
+    chunk_page->prev->next = chunk_page->next;
+  else
+    mem_chunk->pages = chunk_page->next;
+  if (chunk_page->next != NULL)
+    chunk_page->next->prev = chunk_page->prev;
+
+  if (mem_chunk->uninit_page == chunk_page)
+    mem_chunk->uninit_page = NULL;
+
+  mem_chunk->pages_num -= 1;
+  mem_chunk->empty_pages_num -= 1;
+
+  free (chunk_page);
+}
+
+/* Функция выделения памяти под объект без блокировки. */
+static void *
+urpc_mem_chunk_alloc_unlocked (uRpcMemChunk *mem_chunk)
+{
+  ChunkPage *chunk_page = mem_chunk->free_pages;
+  ChunkHeader *header;
+
+  /* Сначала используются освобождённые блоки в порядке их освобождения. */
+  if (chunk_page != NULL)
+    {
+      header = urpc_mem_chunk_get_header (mem_chunk, chunk_page, chunk_page->free_head);
+      chunk_page->free_head = header->next;
+      if (chunk_page->free_head == CHUNK_LIST_END)
+        {
+          chunk_page->free_tail = CHUNK_LIST_END;
+          urpc_mem_chunk_remove_free_page (mem_chunk, chunk_page);
+        }
+    }
+
+  /* Затем ещё не выдававшиеся блоки. Если таких нет, выделяем память под новую страницу. */
+  else
+    {
+      chunk_page = mem_chunk->uninit_page;
+      if (chunk_page == NULL || chunk_page->uninit == (uint32_t) mem_chunk->nchunks_in_page)
+        {
+          chunk_page = urpc_mem_chunk_new_page (mem_chunk);
+          if (chunk_page == NULL)
+            return NULL;
+
+          mem_chunk->uninit_page = chunk_page;
+        }
+
+      header = urpc_mem_chunk_get_header (mem_chunk, chunk_page, chunk_page->uninit);
+      header->index = chunk_page->uninit;
+      chunk_page->uninit += 1;
+    }
+
+  /* Уменьшаем число свободных блоков в странице, помечаем блок как занятый. */
+  if (chunk_page->free == (uint32_t) mem_chunk->nchunks_in_page)
+    mem_chunk->empty_pages_num -= 1;
+  chunk_page->free -= 1;
+  header->next = CHUNK_USED;
+
+  mem_chunk->chunks_num += 1;
+  if (mem_chunk->chunks_num > mem_chunk->peak_chunks_num)
+    mem_chunk->peak_chunks_num = mem_chunk->chunks_num;
+
+  return header + 1;
+}
+
+/* Функция освобождения памяти объекта без блокировки. */
+static int
+urpc_mem_chunk_free_unlocked (uRpcMemChunk *mem_chunk,
+                              void         *chunk)
+{
+  ChunkHeader *header = (ChunkHeader *) chunk - 1;
+  ChunkPage *chunk_page;
+
+  /* Повторное освобождение блока. */
+  if (header->next != CHUNK_USED)
+    return -1;
+
+  /* Страница, в которой расположен блок данных, определяется по номеру блока. */
+  chunk_page = (ChunkPage *) ((uint8_t *) header - mem_chunk->offset - header->index * mem_chunk->chunk_size);
+
+  /* Блок добавляется в конец списка освобождённых блоков страницы, а страница
+     с первым освобождённым блоком - в список страниц с освобождёнными блоками. */
+  header->next = CHUNK_LIST_END;
+  if (chunk_page->free_tail != CHUNK_LIST_END)
+    {
+      urpc_mem_chunk_get_header (mem_chunk, chunk_page, chunk_page->free_tail)->next = header->index;
+    }
+  else
+    {
+      chunk_page->free_head = header->index;
+      urpc_mem_chunk_push_free_page (mem_chunk, chunk_page);
+    }
+  chunk_page->free_tail = header->index;
+
+  /* Увеличиваем счётчик свободных блоков. */
+  chunk_page->free += 1;
+  mem_chunk->chunks_num -= 1;
+
+  /* Опустевшая страница возвращается системе, если пустых страниц уже достаточно.
+     Запас пустых страниц исключает постоянное выделение и освобождение страницы
+     при колебании числа объектов около границы страницы. */
+  if (chunk_page->free == (uint32_t) mem_chunk->nchunks_in_page)
+    {
+      mem_chunk->empty_pages_num += 1;
+      if (mem_chunk->empty_pages_num > KEEP_EMPTY_PAGES + mem_chunk->pages_num / KEEP_EMPTY_RATIO)
+        urpc_mem_chunk_release_page (mem_chunk, chunk_page);
+    }
+
+  return 0;
+}
+
 uRpcMemChunk *
 urpc_mem_chunk_create (int chunk_size)
 {
@@ -71,10 +308,10 @@ urpc_mem_chunk_create (int chunk_size)
   mem_chunk->offset = DATA_ALIGN * ((sizeof (ChunkPage) / DATA_ALIGN) +
                       (sizeof (ChunkPage) % DATA_ALIGN ? 1 : 0));
 
-  /* Размер одного блока данных включая служебную информацию: признак занятости и номер страницы.
-     Служебная информация хранится в первых 8 байтах блока, затем идут данные пользователя.
-     Размер кратен DATA_ALIGN. */
-  chunk_size += 2 * sizeof (uint32_t);
+  /* Размер одного блока данных включая служебную информацию: номер блока в странице и
+     ссылку на следующий свободный блок или признак занятости. Служебная информация хранится
+     в первых 8 байтах блока, затем идут данные пользователя. Размер кратен DATA_ALIGN. */
+  chunk_size += sizeof (ChunkHeader);
   chunk_size = DATA_ALIGN * ((chunk_size / DATA_ALIGN) +
                (chunk_size % DATA_ALIGN ? 1 : 0));
   mem_chunk->chunk_size = chunk_size;
@@ -89,19 +326,26 @@ urpc_mem_chunk_create (int chunk_size)
   /* Число блоков хранящихся в одной странице. */
   mem_chunk->nchunks_in_page = (page_size - mem_chunk->offset) / chunk_size;
 
+  mem_chunk->pages = NULL;
+  mem_chunk->pages_num = 0;
+  mem_chunk->empty_pages_num = 0;
+  mem_chunk->peak_pages_num = 0;
+  mem_chunk->chunks_num = 0;
+  mem_chunk->peak_chunks_num = 0;
+
   /* Память под начальную страницу выделяется при создании объекта. */
-  mem_chunk->pages = malloc (page_size);
-  if (mem_chunk->pages == NULL)
+  chunk_page = urpc_mem_chunk_new_page (mem_chunk);
+  if (chunk_page == NULL)
     {
       free (mem_chunk);
       return NULL;
     }
-  memset (mem_chunk->pages, 0, page_size);
 
-  /* Заголовок страницы. */
-  chunk_page = mem_chunk->pages;
-  chunk_page->next = NULL;
-  chunk_page->free = mem_chunk->nchunks_in_page;
+  mem_chunk->free_pages = NULL;
+  mem_chunk->free_pages_tail = NULL;
+  mem_chunk->uninit_page = chunk_page;
+
+  urpc_mutex_init (&mem_chunk->lock);
 
   mem_chunk->type = URPC_MEM_CHUNK_TYPE;
 
@@ -126,89 +370,170 @@ urpc_mem_chunk_destroy (uRpcMemChunk *mem_chunk)
       parrent_page = next_page;
     }
 
+  urpc_mutex_clear (&mem_chunk->lock);
+
   free (mem_chunk);
 }
 
 void *
 urpc_mem_chunk_alloc (uRpcMemChunk *mem_chunk)
 {
-  ChunkPage *chunk_page = mem_chunk->pages;
+  void *chunk;
+
+  if (mem_chunk->type != URPC_MEM_CHUNK_TYPE)
+    return NULL;
 
-  uint32_t page = 0;
-  uint32_t *data;
+  urpc_mutex_lock (&mem_chunk->lock);
+  chunk = urpc_mem_chunk_alloc_unlocked (mem_chunk);
+  urpc_mutex_unlock (&mem_chunk->lock);
 
-  int i;
+  return chunk;
+}
+
+int
+urpc_mem_chunk_free (uRpcMemChunk *mem_chunk,
+                     void         *chunk)
+{
+  int status;
+
+  if (mem_chunk->type != URPC_MEM_CHUNK_TYPE)
+    return -1;
+
+  urpc_mutex_lock (&mem_chunk->lock);
+  status = urpc_mem_chunk_free_unlocked (mem_chunk, chunk);
+  urpc_mutex_unlock (&mem_chunk->lock);
+
+  return status;
+}
+
+int
+urpc_mem_chunk_stats (uRpcMemChunk      *mem_chunk,
+                      uRpcMemChunkStats *stats)
+{
+  uint64_t capacity;
+
+  if (mem_chunk->type != URPC_MEM_CHUNK_TYPE)
+    return -1;
+
+  urpc_mutex_lock (&mem_chunk->lock);
+
+  stats->page_size = mem_chunk->page_size;
+  stats->chunks_in_page = mem_chunk->nchunks_in_page;
+  stats->pages = mem_chunk->pages_num;
+  stats->empty_pages = mem_chunk->empty_pages_num;
+  stats->peak_pages = mem_chunk->peak_pages_num;
+  stats->chunks = mem_chunk->chunks_num;
+  stats->peak_chunks = mem_chunk->peak_chunks_num;
+
+  urpc_mutex_unlock (&mem_chunk->lock);
+
+  /* Доля памяти страниц не занятой объектами. */
+  capacity = (uint64_t) stats->pages * stats->chunks_in_page;
+  stats->fragmentation = (capacity > 0) ? 1.0 - (double) stats->chunks / capacity : 0.0;
+
+  return 0;
+}
+
+uRpcMemChunkCache *
+urpc_mem_chunk_cache_create (uRpcMemChunk *mem_chunk,
+                             int           size)
+{
+  uRpcMemChunkCache *cache;
 
   if (mem_chunk->type != URPC_MEM_CHUNK_TYPE)
     return NULL;
 
-  /* По цепочке ищем страницу в которой есть свободный блок. */
-  while (chunk_page->free == 0)
-    {
-      /* Если такой страницы не найдено, выделяем память под новую страницу. */
-      if (chunk_page->next == NULL)
-        {
-          chunk_page->next = malloc (mem_chunk->page_size);
-          chunk_page = chunk_page->next;
-          memset (chunk_page, 0, mem_chunk->page_size);
-          chunk_page->next = NULL;
-          chunk_page->free = mem_chunk->nchunks_in_page;
-          page += 1;
-          break;
-        }
+  if (size < 2)
+    size = 2;
 
-      chunk_page = chunk_page->next;
-      page += 1;
-    }
+  cache = malloc (sizeof (uRpcMemChunkCache));
+  if (cache == NULL)
+    return NULL;
 
-  /* Находим свободный блок в странице. */
-  for (i = 0; i < mem_chunk->nchunks_in_page; i++)
+  cache->chunks = malloc (size * sizeof (void*));
+  if (cache->chunks == NULL)
     {
-      data = (uint32_t *) ((uint8_t *) chunk_page + mem_chunk->offset + i * mem_chunk->chunk_size);
-      if (*data == 0)
-        break;
+      free (cache);
+      return NULL;
     }
 
-  /* Просмотрели все блоки, но не нашли свободный - ошибка в целостности данных. */
-  if (i >= mem_chunk->nchunks_in_page)
+  cache->type = URPC_MEM_CACHE_TYPE;
+  cache->mem_chunk = mem_chunk;
+  cache->chunks_num = 0;
+  cache->size = size;
+
+  return cache;
+}
+
+void
+urpc_mem_chunk_cache_destroy (uRpcMemChunkCache *cache)
+{
+  uRpcMemChunk *mem_chunk = cache->mem_chunk;
+  int i;
+
+  if (cache->type != URPC_MEM_CACHE_TYPE)
+    return;
+
+  /* Блоки из кеша возвращаются в блок объектов. */
+  urpc_mutex_lock (&mem_chunk->lock);
+  for (i = 0; i < cache->chunks_num; i++)
+    urpc_mem_chunk_free_unlocked (mem_chunk, cache->chunks[i]);
+  urpc_mutex_unlock (&mem_chunk->lock);
+
+  free (cache->chunks);
+  free (cache);
+}
+
+void *
+urpc_mem_chunk_cache_alloc (uRpcMemChunkCache *cache)
+{
+  uRpcMemChunk *mem_chunk = cache->mem_chunk;
+
+  if (cache->type != URPC_MEM_CACHE_TYPE)
     return NULL;
 
-  /* Уменьшаем число занятых блоков в странице, помечаем блок как занятый. */
-  chunk_page->free -= 1;
-  *data = 1;
-  data += 1;
-  *data = page;
-  data += 1;
+  /* Пустой кеш заполняется наполовину за одну блокировку блока объектов. */
+  if (cache->chunks_num == 0)
+    {
+      urpc_mutex_lock (&mem_chunk->lock);
+      while (cache->chunks_num < cache->size / 2)
+        {
+          void *chunk = urpc_mem_chunk_alloc_unlocked (mem_chunk);
+          if (chunk == NULL)
+            break;
+          cache->chunks[cache->chunks_num++] = chunk;
+        }
+      urpc_mutex_unlock (&mem_chunk->lock);
+
+      if (cache->chunks_num == 0)
+        return NULL;
+    }
 
-  return data;
+  return cache->chunks[--cache->chunks_num];
 }
 
 int
-urpc_mem_chunk_free (uRpcMemChunk *mem_chunk,
-                     void         *chunk)
+urpc_mem_chunk_cache_free (uRpcMemChunkCache *cache,
+                           void              *chunk)
 {
-  ChunkPage *chunk_page = mem_chunk->pages;
+  uRpcMemChunk *mem_chunk = cache->mem_chunk;
 
-  uint32_t *data = chunk;
-  uint32_t *page = data - 1;
-  uint32_t *used = data - 2;
-
-  unsigned int i;
+  if (cache->type != URPC_MEM_CACHE_TYPE)
+    return -1;
 
-  if (mem_chunk->type != URPC_MEM_CHUNK_TYPE)
+  if (((ChunkHeader *) chunk - 1)->next != CHUNK_USED)
     return -1;
 
-  /* Находим страницу в которой расположен блок данных. */
-  for (i = 0; i < *page; i++)
+  /* Из заполненного кеша половина блоков возвращается в блок объектов за одну блокировку. */
+  if (cache->chunks_num == cache->size)
     {
-      if (chunk_page->next == NULL)
-        return -1;
-      chunk_page = chunk_page->next;
+      urpc_mutex_lock (&mem_chunk->lock);
+      while (cache->chunks_num > cache->size / 2)
+        urpc_mem_chunk_free_unlocked (mem_chunk, cache->chunks[--cache->chunks_num]);
+      urpc_mutex_unlock (&mem_chunk->lock);
     }
 
-  /* Увеличиваем счётчик свободных блоков и помечаем блок как свободный. */
-  chunk_page->free += 1;
-  *used = 0;
+  cache->chunks[cache->chunks_num++] = chunk;
 
   return 0;
 }
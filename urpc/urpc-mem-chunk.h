@@ -35,13 +35,35 @@
  * \defgroup uRpcMemChunk uRpcMemChunk - библиотека хранения множества объектов.
  *
  * Библиотека предназначена для хранения большого числа небольших, одинаковых по размеру
- * объектов. Библиотека эффективно работает с числом объектов до 100000. Интерфейс
- * библиотеки содержит следующие функции:
+ * объектов. Выделение и освобождение памяти выполняются за постоянное время независимо
+ * от числа объектов: освобождённые объекты связаны в списки внутри страниц, а страницы
+ * с освобождёнными объектами - в общий список. Освобождённая память используется повторно
+ * в порядке освобождения. Сервер uRPC эту библиотеку не использует: сессии хранятся в
+ * массиве слотов, а таблица \link uRpcHashTable \endlink использует открытую адресацию.
+ * Интерфейс библиотеки содержит следующие функции:
  *
  * - #urpc_mem_chunk_create - создание блока объектов;
  * - #urpc_mem_chunk_destroy - удаление блока объектов;
  * - #urpc_mem_chunk_alloc - выделение памяти под новый объект;
- * - #urpc_mem_chunk_free - освобождение памяти неиспользуемого объекта.
+ * - #urpc_mem_chunk_free - освобождение памяти неиспользуемого объекта;
+ * - #urpc_mem_chunk_stats - статистика использования памяти.
+ *
+ * Страница, в которой не осталось объектов, возвращается системе, если число пустых
+ * страниц превышает одну страницу плюс восьмую часть от общего числа страниц.
+ *
+ * Функции #urpc_mem_chunk_alloc и #urpc_mem_chunk_free можно вызывать из разных потоков,
+ * доступ к страницам защищён блокировкой. Для выделения памяти без блокировки каждый поток
+ * может создать свой кеш объектов. Блоки объектов берутся из общего блока и возвращаются
+ * в него группами. Для работы с кешем используются функции:
+ *
+ * - #urpc_mem_chunk_cache_create - создание кеша объектов;
+ * - #urpc_mem_chunk_cache_destroy - удаление кеша объектов;
+ * - #urpc_mem_chunk_cache_alloc - выделение памяти под новый объект из кеша;
+ * - #urpc_mem_chunk_cache_free - освобождение памяти объекта в кеш.
+ *
+ * Кеш объектов должен использоваться только одним потоком. Память, выделенная через кеш,
+ * может быть освобождена через любой кеш этого же блока объектов или функцией
+ * #urpc_mem_chunk_free.
  *
  */
 
@@ -49,6 +71,7 @@
 #define __URPC_MEM_CHUNK_H__
 
 #include <urpc-exports.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C"
@@ -56,6 +79,26 @@ extern "C"
 #endif
 
 typedef struct _uRpcMemChunk uRpcMemChunk;
+typedef struct _uRpcMemChunkCache uRpcMemChunkCache;
+
+/**
+ *
+ * Статистика использования памяти блоком объектов. Объекты, находящиеся в кешах
+ * потоков, считаются выделенными.
+ *
+ */
+typedef struct _uRpcMemChunkStats uRpcMemChunkStats;
+struct _uRpcMemChunkStats
+{
+  uint32_t             page_size;              /**< Размер страницы, байт. */
+  uint32_t             chunks_in_page;         /**< Число объектов в странице. */
+  uint32_t             pages;                  /**< Число страниц. */
+  uint32_t             empty_pages;            /**< Число пустых страниц. */
+  uint32_t             peak_pages;             /**< Максимальное число страниц. */
+  uint32_t             chunks;                 /**< Число выделенных объектов. */
+  uint32_t             peak_chunks;            /**< Максимальное число выделенных объектов. */
+  double               fragmentation;          /**< Доля памяти страниц не занятой объектами. */
+};
 
 /**
  *
@@ -109,6 +152,74 @@ URPC_EXPORT
 int                    urpc_mem_chunk_free     (uRpcMemChunk  *mem_chunk,
                                                 void          *chunk);
 
+/**
+ *
+ * Функция возвращает статистику использования памяти блоком объектов.
+ *
+ * \param mem_chunk указатель на блок объектов;
+ * \param stats указатель на структуру статистики.
+ *
+ * \return 0 - если статистика получена, -1 в случае ошибки.
+ *
+ */
+URPC_EXPORT
+int                    urpc_mem_chunk_stats            (uRpcMemChunk          *mem_chunk,
+                                                        uRpcMemChunkStats     *stats);
+
+/**
+ *
+ * Функция создаёт кеш объектов для использования одним потоком.
+ *
+ * \param mem_chunk указатель на блок объектов;
+ * \param size максимальное число объектов в кеше.
+ *
+ * \return Указатель на кеш объектов или NULL в случае ошибки.
+ *
+ */
+URPC_EXPORT
+uRpcMemChunkCache     *urpc_mem_chunk_cache_create     (uRpcMemChunk          *mem_chunk,
+                                                        int                    size);
+
+/**
+ *
+ * Функция удаляет кеш объектов. Свободные объекты кеша возвращаются в блок объектов.
+ *
+ * \param cache указатель на кеш объектов.
+ *
+ * \return Нет.
+ *
+ */
+URPC_EXPORT
+void                   urpc_mem_chunk_cache_destroy    (uRpcMemChunkCache     *cache);
+
+/**
+ *
+ * Функция выделяет память под новый объект из кеша. Если кеш пуст, он заполняется
+ * из блока объектов.
+ *
+ * \param cache указатель на кеш объектов.
+ *
+ * \return Указатель на память для нового объекта или NULL в случае ошибки.
+ *
+ */
+URPC_EXPORT
+void                  *urpc_mem_chunk_cache_alloc      (uRpcMemChunkCache     *cache);
+
+/**
+ *
+ * Функция освобождает память используемую объектом в кеш. Если кеш заполнен,
+ * часть объектов возвращается в блок объектов.
+ *
+ * \param cache указатель на кеш объектов;
+ * \param chunk указатель на память освобождаемого объекта.
+ *
+ * \return 0 - если память успешно особождена, -1 в случае ошибки.
+ *
+ */
+URPC_EXPORT
+int                    urpc_mem_chunk_cache_free       (uRpcMemChunkCache     *cache,
+                                                        void                  *chunk);
+
 #ifdef __cplusplus
 }
 #endif
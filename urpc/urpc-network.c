@@ -39,6 +39,17 @@ urpc_network_set_reuse (SOCKET socket)
   return setsockopt (socket, SOL_SOCKET, SO_REUSEADDR, (void *)&flag, sizeof (flag));
 }
 
+int
+urpc_network_set_reuse_port (SOCKET socket)
+{
+#if defined(SO_REUSEPORT)
+  int flag = 1;
+  return setsockopt (socket, SOL_SOCKET, SO_REUSEPORT, (void *)&flag, sizeof (flag));
+#else
+  return -1;
+#endif
+}
+
 int
 urpc_network_set_non_block (SOCKET socket)
 {
@@ -53,11 +53,17 @@
  * #urpc_network_last_error_str и две наиболее часто используемые константы EAGAIN и EINTR.
  * Также определена константа MSG_NOSIGNAL.
  *
- * Библиотека содержит три дополнительные функции:
+ * Библиотека содержит шесть дополнительных функций:
  *
  * - #urpc_network_set_tcp_nodelay - отключение алгоритма Нейгла;
  * - #urpc_network_set_reuse - разрешение использования адреса уже использовавшегося ранее;
- * - #urpc_network_set_non_block - перевод соединения в неблокирующий режим.
+ * - #urpc_network_set_reuse_port - разрешение привязки нескольких сокетов к одному адресу;
+ * - #urpc_network_set_non_block - перевод соединения в неблокирующий режим;
+ * - #urpc_network_wait_read - ожидание возможности чтения из сокета;
+ * - #urpc_network_wait_write - ожидание возможности записи в сокет.
+ *
+ * Функции ожидания работают с одним сокетом и, в отличие от select, не ограничены
+ * значением дескриптора сокета FD_SETSIZE.
  *
  * Практически все основные функции BSD socket можно использовать без изменений, включая: socket, bind,
  * connect, accept, recv, send, select и др.
@@ -89,6 +95,7 @@
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/select.h>
+#include <poll.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
@@ -180,6 +187,20 @@ int            urpc_network_set_tcp_nodelay    (SOCKET                 socket);
 URPC_EXPORT
 int            urpc_network_set_reuse          (SOCKET                 socket);
 
+/**
+ *
+ * Функция разрешает привязать к одному адресу несколько сокетов (SO_REUSEPORT).
+ * Система распределяет входящие пакеты и соединения между такими сокетами.
+ * Параметр должен быть установлен для каждого сокета до вызова bind.
+ *
+ * \param socket дескриптор сокета.
+ *
+ * \return 0 - в случае успеха, иначе -1, в том числе если система не поддерживает SO_REUSEPORT.
+ *
+ */
+URPC_EXPORT
+int            urpc_network_set_reuse_port     (SOCKET                 socket);
+
 /**
  *
  * Функция переводит соединение в неблокирующий режим. После перевода в неблокирующий режим
@@ -195,6 +216,38 @@ int            urpc_network_set_reuse          (SOCKET                 socket);
 URPC_EXPORT
 int            urpc_network_set_non_block      (SOCKET                 socket);
 
+/**
+ *
+ * Функция ожидает появления данных для чтения из сокета в течение указанного времени.
+ * Ошибка или закрытие соединения также считаются готовностью к чтению, о них
+ * сообщит следующий вызов функции recv.
+ *
+ * \param socket дескриптор сокета;
+ * \param timeout время ожидания, с.
+ *
+ * \return 1 - если сокет готов к чтению, 0 - при истечении времени ожидания, иначе -1.
+ *
+ */
+URPC_EXPORT
+int            urpc_network_wait_read          (SOCKET                 socket,
+                                                double                 timeout);
+
+/**
+ *
+ * Функция ожидает возможности записи в сокет в течение указанного времени.
+ * Ошибка или закрытие соединения также считаются готовностью к записи, о них
+ * сообщит следующий вызов функции send.
+ *
+ * \param socket дескриптор сокета;
+ * \param timeout время ожидания, с.
+ *
+ * \return 1 - если сокет готов к записи, 0 - при истечении времени ожидания, иначе -1.
+ *
+ */
+URPC_EXPORT
+int            urpc_network_wait_write         (SOCKET                 socket,
+                                                double                 timeout);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,64 @@
+/*
+ * uRPC - rpc (remote procedure call) library.
+ *
+ * Copyright 2009-2015 Andrei Fadeev (andrei@webcontrol.ru)
+ *
+ * This file is part of uRPC.
+ *
+ * uRPC is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * uRPC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the author in this case.
+ *
+ */
+
+/* Заголовочный файл оповещения через дескриптор. Оповещение - это дескриптор, который
+   становится готовым к чтению после вызова urpc_notify_set и остаётся готовым до вызова
+   urpc_notify_clear. Повторные оповещения до сброса не накапливаются. Дескриптор можно
+   ожидать функциями select, poll или epoll совместно с сокетами. В Linux используется
+   eventfd, в остальных POSIX системах - канал (pipe), в Windows - UDP сокет, подключенный
+   сам к себе. Функции используются библиотекой uRPC самостоятельно и не предназначены
+   для пользователей. */
+
+#ifndef __URPC_NOTIFY_H__
+#define __URPC_NOTIFY_H__
+
+#include <urpc-network.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _uRpcNotify uRpcNotify;
+
+/* Функция создаёт оповещение. */
+uRpcNotify *urpc_notify_create                 (void);
+
+/* Функция удаляет оповещение. */
+void urpc_notify_destroy                       (uRpcNotify            *notify);
+
+/* Функция переводит дескриптор оповещения в состояние готовности к чтению. */
+void urpc_notify_set                           (uRpcNotify            *notify);
+
+/* Функция сбрасывает готовность дескриптора оповещения. */
+void urpc_notify_clear                         (uRpcNotify            *notify);
+
+/* Функция возвращает дескриптор оповещения. */
+SOCKET urpc_notify_get_fd                      (uRpcNotify            *notify);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __URPC_NOTIFY_H__ */
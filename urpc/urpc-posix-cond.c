@@ -0,0 +1,85 @@
+/*
+ * uRPC - rpc (remote procedure call) library.
+ *
+ * Copyright 2015 Andrei Fadeev (andrei@webcontrol.ru)
+ *
+ * This file is part of uRPC.
+ *
+ * uRPC is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * uRPC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the author in this case.
+ *
+ */
+
+#include "urpc-cond.h"
+
+#include <time.h>
+#include <errno.h>
+
+void
+urpc_cond_init (uRpcCond *cond)
+{
+  pthread_condattr_t attr;
+
+  /* Время ожидания отсчитывается по монотонным часам, как и в uRpcTimer. */
+  pthread_condattr_init (&attr);
+  pthread_condattr_setclock (&attr, CLOCK_MONOTONIC);
+  pthread_cond_init ((pthread_cond_t*)cond, &attr);
+  pthread_condattr_destroy (&attr);
+}
+
+void
+urpc_cond_clear (uRpcCond *cond)
+{
+  pthread_cond_destroy ((pthread_cond_t*)cond);
+}
+
+void
+urpc_cond_wait (uRpcCond  *cond,
+                uRpcMutex *mutex)
+{
+  pthread_cond_wait ((pthread_cond_t*)cond, (pthread_mutex_t*)mutex);
+}
+
+int
+urpc_cond_timed_wait (uRpcCond  *cond,
+                      uRpcMutex *mutex,
+                      double     timeout)
+{
+  struct timespec abstime;
+  long nsec;
+
+  clock_gettime (CLOCK_MONOTONIC, &abstime);
+  nsec = abstime.tv_nsec + (long) ((timeout - (long) timeout) * 1000000000.0);
+  abstime.tv_sec += (time_t) timeout + nsec / 1000000000;
+  abstime.tv_nsec = nsec % 1000000000;
+
+  if (pthread_cond_timedwait ((pthread_cond_t*)cond, (pthread_mutex_t*)mutex, &abstime) == ETIMEDOUT)
+    return 1;
+
+  return 0;
+}
+
+void
+urpc_cond_signal (uRpcCond *cond)
+{
+  pthread_cond_signal ((pthread_cond_t*)cond);
+}
+
+void
+urpc_cond_broadcast (uRpcCond *cond)
+{
+  pthread_cond_broadcast ((pthread_cond_t*)cond);
+}
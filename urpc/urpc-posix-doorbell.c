@@ -0,0 +1,219 @@
+/*
+ * uRPC - rpc (remote procedure call) library.
+ *
+ * Copyright 2015 Andrei Fadeev (andrei@webcontrol.ru)
+ *
+ * This file is part of uRPC.
+ *
+ * uRPC is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * uRPC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the author in this case.
+ *
+ */
+
+#include "urpc-doorbell.h"
+
+#include <time.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+/* Минимальное число итераций активного опроса, позволяющее адаптации восстановиться. */
+#define URPC_DOORBELL_MIN_SPIN         16
+
+/* Число итераций опроса между проверками времени в urpc_doorbell_poll. */
+#define URPC_DOORBELL_POLL_SPIN        64
+
+static inline void
+urpc_doorbell_relax (void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+  __builtin_ia32_pause ();
+#elif defined(__aarch64__) || defined(__arm__)
+  __asm__ __volatile__ ("yield" ::: "memory");
+#else
+  __asm__ __volatile__ ("" ::: "memory");
+#endif
+}
+
+/* Функция сбрасывает установленный сигнал. */
+static inline int
+urpc_doorbell_consume (uRpcDoorbell *doorbell)
+{
+  uint32_t signal = 1;
+
+  if (__atomic_load_n (&doorbell->signal, __ATOMIC_RELAXED) != 1)
+    return 0;
+
+  return __atomic_compare_exchange_n (&doorbell->signal, &signal, 0, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+/* Функция засыпает пока сигнал не установлен, но не дольше timeout. */
+static void
+urpc_doorbell_sleep (uRpcDoorbell    *doorbell,
+                     struct timespec *timeout)
+{
+#if defined(__linux__)
+  /* Сегмент общей памяти отображается в разные процессы, поэтому futex используется
+     без флага FUTEX_PRIVATE_FLAG. */
+  syscall (SYS_futex, &doorbell->signal, FUTEX_WAIT, 0, timeout, NULL, 0);
+#else
+  struct timespec pause = { 0, 50000 };
+
+  if (timeout != NULL && (timeout->tv_sec == 0 && timeout->tv_nsec < pause.tv_nsec))
+    pause = *timeout;
+
+  sched_yield ();
+  if (__atomic_load_n (&doorbell->signal, __ATOMIC_ACQUIRE) == 0)
+    nanosleep (&pause, NULL);
+#endif
+}
+
+void
+urpc_doorbell_ring (uRpcDoorbell *doorbell)
+{
+  __atomic_store_n (&doorbell->signal, 1, __ATOMIC_SEQ_CST);
+
+#if defined(__linux__)
+  if (__atomic_load_n (&doorbell->waiters, __ATOMIC_SEQ_CST) > 0)
+    syscall (SYS_futex, &doorbell->signal, FUTEX_WAKE, 1, NULL, NULL, 0);
+#endif
+}
+
+int
+urpc_doorbell_wait (uRpcDoorbell *doorbell,
+                    uint32_t     *spin,
+                    double        timeout)
+{
+  static long cpus_num = 0;
+
+  struct timespec deadline;
+  struct timespec remain;
+  uint32_t i;
+
+  if (urpc_doorbell_consume (doorbell))
+    return 0;
+
+  /* Активный опрос имеет смысл только если вторая сторона выполняется
+     на другом процессоре. */
+  if (cpus_num == 0)
+    cpus_num = sysconf (_SC_NPROCESSORS_ONLN);
+
+  if (spin != NULL && cpus_num > 1)
+    {
+      for (i = 0; i < *spin; i++)
+        {
+          urpc_doorbell_relax ();
+          if (urpc_doorbell_consume (doorbell))
+            {
+              *spin = (*spin < URPC_DOORBELL_MAX_SPIN / 2) ? 2 * *spin : URPC_DOORBELL_MAX_SPIN;
+              return 0;
+            }
+        }
+      *spin = (*spin > 2 * URPC_DOORBELL_MIN_SPIN) ? *spin / 2 : URPC_DOORBELL_MIN_SPIN;
+    }
+
+  if (timeout >= 0.0)
+    {
+      clock_gettime (CLOCK_MONOTONIC, &deadline);
+      deadline.tv_sec += (time_t) timeout;
+      deadline.tv_nsec += (long) (1000000000.0 * (timeout - (time_t) timeout));
+      if (deadline.tv_nsec >= 1000000000)
+        {
+          deadline.tv_nsec -= 1000000000;
+          deadline.tv_sec += 1;
+        }
+    }
+
+  /* Засыпаем до установки сигнала. Число спящих получателей увеличивается до
+     повторной проверки сигнала, поэтому сигнал не может быть пропущен. */
+  __atomic_add_fetch (&doorbell->waiters, 1, __ATOMIC_SEQ_CST);
+
+  while (!urpc_doorbell_consume (doorbell))
+    {
+      if (timeout < 0.0)
+        {
+          urpc_doorbell_sleep (doorbell, NULL);
+          continue;
+        }
+
+      clock_gettime (CLOCK_MONOTONIC, &remain);
+      remain.tv_sec = deadline.tv_sec - remain.tv_sec;
+      remain.tv_nsec = deadline.tv_nsec - remain.tv_nsec;
+      if (remain.tv_nsec < 0)
+        {
+          remain.tv_nsec += 1000000000;
+          remain.tv_sec -= 1;
+        }
+      if (remain.tv_sec < 0)
+        {
+          __atomic_sub_fetch (&doorbell->waiters, 1, __ATOMIC_SEQ_CST);
+          return 1;
+        }
+
+      urpc_doorbell_sleep (doorbell, &remain);
+    }
+
+  __atomic_sub_fetch (&doorbell->waiters, 1, __ATOMIC_SEQ_CST);
+
+  return 0;
+}
+
+int
+urpc_doorbell_poll (uRpcDoorbell *doorbell,
+                    double        time)
+{
+  struct timespec start;
+  struct timespec cur;
+  uint32_t i;
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+
+  while (1)
+    {
+      for (i = 0; i < URPC_DOORBELL_POLL_SPIN; i++)
+        {
+          if (urpc_doorbell_consume (doorbell))
+            return 0;
+          urpc_doorbell_relax ();
+        }
+
+      clock_gettime (CLOCK_MONOTONIC, &cur);
+      if ((cur.tv_sec - start.tv_sec) + 1e-9 * (cur.tv_nsec - start.tv_nsec) >= time)
+        return 1;
+    }
+}
+
+int
+urpc_doorbell_trylock (volatile uint32_t *lock)
+{
+  uint32_t state = 0;
+
+  if (__atomic_compare_exchange_n (lock, &state, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    return 0;
+
+  return -1;
+}
+
+void
+urpc_doorbell_unlock (volatile uint32_t *lock)
+{
+  __atomic_store_n (lock, 0, __ATOMIC_RELEASE);
+}
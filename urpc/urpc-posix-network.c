@@ -47,3 +47,36 @@ urpc_network_last_error_str (void)
 {
   return strerror (errno);
 }
+
+static int
+urpc_network_wait (SOCKET socket,
+                   short  events,
+                   double timeout)
+{
+  struct pollfd sock_fd;
+  int polled;
+
+  sock_fd.fd = socket;
+  sock_fd.events = events;
+  sock_fd.revents = 0;
+
+  polled = poll (&sock_fd, 1, (int) (1000.0 * timeout));
+  if (polled <= 0)
+    return polled;
+
+  return 1;
+}
+
+int
+urpc_network_wait_read (SOCKET socket,
+                        double timeout)
+{
+  return urpc_network_wait (socket, POLLIN, timeout);
+}
+
+int
+urpc_network_wait_write (SOCKET socket,
+                         double timeout)
+{
+  return urpc_network_wait (socket, POLLOUT, timeout);
+}
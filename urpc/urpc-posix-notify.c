@@ -0,0 +1,135 @@
+/*
+ * uRPC - rpc (remote procedure call) library.
+ *
+ * Copyright 2009-2015 Andrei Fadeev (andrei@webcontrol.ru)
+ *
+ * This file is part of uRPC.
+ *
+ * uRPC is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * uRPC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the author in this case.
+ *
+ */
+
+#include "urpc-notify.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+
+#define URPC_NOTIFY_TYPE 0x59544E75
+
+struct _uRpcNotify
+{
+  uint32_t             urpc_notify_type;       /* Тип объекта uRpcNotify. */
+
+  int                  rfd;                    /* Дескриптор для ожидания и сброса оповещения. */
+  int                  wfd;                    /* Дескриптор для установки оповещения. */
+};
+
+uRpcNotify *
+urpc_notify_create (void)
+{
+  uRpcNotify *notify = malloc (sizeof (uRpcNotify));
+
+  if (notify == NULL)
+    return NULL;
+
+  notify->urpc_notify_type = URPC_NOTIFY_TYPE;
+
+#if defined(__linux__)
+  notify->rfd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+  notify->wfd = notify->rfd;
+  if (notify->rfd < 0)
+    goto urpc_notify_create_fail;
+#else
+  {
+    int fds[2];
+    int i;
+
+    if (pipe (fds) < 0)
+      goto urpc_notify_create_fail;
+    for (i = 0; i < 2; i++)
+      {
+        fcntl (fds[i], F_SETFL, fcntl (fds[i], F_GETFL) | O_NONBLOCK);
+        fcntl (fds[i], F_SETFD, FD_CLOEXEC);
+      }
+    notify->rfd = fds[0];
+    notify->wfd = fds[1];
+  }
+#endif
+
+  return notify;
+
+urpc_notify_create_fail:
+  free (notify);
+
+  return NULL;
+}
+
+void
+urpc_notify_destroy (uRpcNotify *notify)
+{
+  if (notify->urpc_notify_type != URPC_NOTIFY_TYPE)
+    return;
+
+  close (notify->rfd);
+  if (notify->wfd != notify->rfd)
+    close (notify->wfd);
+
+  free (notify);
+}
+
+void
+urpc_notify_set (uRpcNotify *notify)
+{
+  uint64_t value = 1;
+  ssize_t written;
+
+  if (notify->urpc_notify_type != URPC_NOTIFY_TYPE)
+    return;
+
+  /* Переполнение канала означает, что оповещение уже установлено. */
+#if defined(__linux__)
+  written = write (notify->wfd, &value, sizeof (value));
+#else
+  written = write (notify->wfd, &value, 1);
+#endif
+  (void) written;
+}
+
+void
+urpc_notify_clear (uRpcNotify *notify)
+{
+  uint64_t value[8];
+
+  if (notify->urpc_notify_type != URPC_NOTIFY_TYPE)
+    return;
+
+  while (read (notify->rfd, value, sizeof (value)) > 0);
+}
+
+SOCKET
+urpc_notify_get_fd (uRpcNotify *notify)
+{
+  if (notify->urpc_notify_type != URPC_NOTIFY_TYPE)
+    return INVALID_SOCKET;
+
+  return notify->rfd;
+}
@@ -165,3 +165,34 @@ urpc_shm_map (uRpcShm *shm)
 
   return shm->maddr;
 }
+
+int
+urpc_shm_discard (uRpcShm       *shm,
+                  void          *address,
+                  unsigned long  size)
+{
+#if defined(MADV_REMOVE)
+  uintptr_t page_size;
+  uintptr_t start;
+  uintptr_t stop;
+
+  if (shm->type != URPC_SHM_TYPE)
+    return -1;
+  if (shm->maddr == NULL || shm->ro)
+    return -1;
+  if ((uint8_t *) address < (uint8_t *) shm->maddr ||
+      (uint8_t *) address + size > (uint8_t *) shm->maddr + shm->size)
+    return -1;
+
+  /* Освобождаются только страницы, целиком попадающие в область. */
+  page_size = (uintptr_t) sysconf (_SC_PAGESIZE);
+  start = ((uintptr_t) address + page_size - 1) & ~(page_size - 1);
+  stop = ((uintptr_t) address + size) & ~(page_size - 1);
+  if (start >= stop)
+    return 0;
+
+  return madvise ((void *) start, stop - start, MADV_REMOVE);
+#else
+  return -1;
+#endif
+}
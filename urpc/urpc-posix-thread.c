@@ -23,6 +23,10 @@
  *
  */
 
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+
 #include "urpc-thread.h"
 
 #include <stdio.h>
@@ -46,6 +50,25 @@ urpc_thread_create (urpc_thread_func func,
   return thread;
 }
 
+int
+urpc_thread_set_affinity (uRpcThread *thread,
+                          uint32_t    cpu)
+{
+#if defined(__linux__)
+  cpu_set_t cpus;
+
+  if (cpu >= CPU_SETSIZE)
+    return -1;
+
+  CPU_ZERO (&cpus);
+  CPU_SET (cpu, &cpus);
+
+  return pthread_setaffinity_np (*thread, sizeof (cpu_set_t), &cpus) == 0 ? 0 : -1;
+#else
+  return -1;
+#endif
+}
+
 void
 urpc_thread_destroy (uRpcThread *thread)
 {
@@ -100,6 +100,16 @@ urpc_timer_elapsed (uRpcTimer *timer)
   return elapsed;
 }
 
+double
+urpc_timer_get_monotonic_time (void)
+{
+  struct timespec now;
+
+  clock_gettime (CLOCK_MONOTONIC, &now);
+
+  return now.tv_sec + now.tv_nsec / 1000000000.0;
+}
+
 void
 urpc_timer_sleep (double time)
 {
@@ -0,0 +1,73 @@
+/*
+ * uRPC - rpc (remote procedure call) library.
+ *
+ * Copyright 2009-2015 Andrei Fadeev (andrei@webcontrol.ru)
+ *
+ * This file is part of uRPC.
+ *
+ * uRPC is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * uRPC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the author in this case.
+ *
+ */
+
+#include "urpc-vmem.h"
+
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#if !defined(MAP_ANONYMOUS)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+void *
+urpc_vmem_alloc (size_t size)
+{
+  void *address;
+
+  /* Анонимное отображение получает физические страницы при первом обращении. */
+  address = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (address == MAP_FAILED)
+    return NULL;
+
+  return address;
+}
+
+void
+urpc_vmem_free (void   *address,
+                size_t  size)
+{
+  if (address != NULL)
+    munmap (address, size);
+}
+
+int
+urpc_vmem_discard (void   *address,
+                   size_t  size)
+{
+  uintptr_t page_size;
+  uintptr_t start;
+  uintptr_t stop;
+
+  /* Освобождаются только страницы, целиком попадающие в область. */
+  page_size = (uintptr_t) sysconf (_SC_PAGESIZE);
+  start = ((uintptr_t) address + page_size - 1) & ~(page_size - 1);
+  stop = ((uintptr_t) address + size) & ~(page_size - 1);
+  if (start >= stop)
+    return 0;
+
+  return madvise ((void *) start, stop - start, MADV_DONTNEED);
+}
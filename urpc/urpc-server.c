@@ -28,34 +28,106 @@
 #include "urpc-common.h"
 #include "urpc-thread.h"
 #include "urpc-mutex.h"
-#include "urpc-rwmutex.h"
+#include "urpc-atomic.h"
 #include "urpc-timer.h"
-#include "urpc-hash-table.h"
-#include "urpc-mem-chunk.h"
 #include "urpc-network.h"
 #include "urpc-endian.h"
 
 #include "urpc-udp-server.h"
 #include "urpc-tcp-server.h"
 #include "urpc-shm-server.h"
+#include "urpc-shm-queue.h"
 
 #include <stdlib.h>
 
 #define URPC_SERVER_TYPE 0x53504455
 
+/* Признаки состояния сессии в старших битах счётчика ссылок. */
+#define URPC_SESSION_FREE      0x80000000      /* Слот сессии свободен. */
+#define URPC_SESSION_REMOVED   0x40000000      /* Сессия завершена. */
+#define URPC_SESSION_REFS      0x3fffffff      /* Маска числа ссылок на сессию. */
+
+/* Колесо таймеров сессий. */
+#define URPC_WHEEL_END         0xffffffff      /* Признак конца списка слотов в ячейке колеса. */
+#define URPC_WHEEL_MIN_TICK    100             /* Минимальный шаг колеса, мс. */
+#define URPC_WHEEL_MAX_SIZE    1024            /* Максимальное число ячеек колеса. */
+
+#define URPC_SERVER_NO_CONTEXT 0xffffffff      /* Поток не владеет контекстом транспорта. */
+
+/* Состояние отложенного ответа. */
+#define URPC_REPLY_NONE        0               /* Ответ отправляется после выполнения процедуры. */
+#define URPC_REPLY_DEFERRED    1               /* Ответ отложен, процедура ещё выполняется. */
+#define URPC_REPLY_DETACHED    2               /* Процедура завершилась, контекстом владеет ответ. */
+#define URPC_REPLY_COMPLETED   3               /* Ответ завершён до окончания процедуры. */
+
 static int urpc_server_initialized = 0;
 
+/* Пользовательская процедура. */
+typedef struct uRpcServerProc
+{
+  uint32_t             proc_id;                /* Идентификатор процедуры. */
+  urpc_proc            proc;                   /* Функция процедуры, NULL - пустая ячейка. */
+  void                *data;                   /* Данные для функции процедуры. */
+  uint32_t             index;                  /* Номер процедуры в порядке регистрации. */
+} uRpcServerProc;
+
+/* Слот сессии. Идентификатор сессии состоит из номера слота в младших битах и
+   поколения слота в старших, поэтому по идентификатору завершённой сессии нельзя
+   обратиться к новой сессии в том же слоте. Поиск сессии выполняется без блокировок:
+   поток увеличивает счётчик ссылок и затем проверяет идентификатор и состояние слота.
+   Слот освобождает поток, который последним отпустил ссылку на завершённую сессию. */
 typedef struct uRpcServerSession
 {
+  uint32_t             id;                     /* Идентификатор сессии, 0 - сессии нет. */
+  uint32_t             refs;                   /* Число ссылок на сессию и признаки состояния. */
+  uint32_t             activity;               /* Время последней активности, мс. */
+  uint32_t             generation;             /* Поколение слота. */
+
   uint32_t             state;                  /* Состояние подключения. */
-  uRpcTimer           *activity;               /* Время последней активности. */
-  SOCKET               socket;                 /* Для TCP/IP соединения сокет подключения клиекнта. */
+  uint32_t             client_id;              /* Для TCP/IP соединения идентификатор подключения клиента. */
 
   void                *user_data;              /* Пользовательскте данные сессии. */
 
-  uRpcMemChunk        *sessions_chunks;        /* Аллокатор данных сессий. */
+  uint32_t             allocated;              /* Слот выдан сессии, изменяется под блокировкой. */
+  uint32_t             in_wheel;               /* Слот находится в колесе таймеров. */
+  uint32_t             wheel_next;             /* Следующий слот в ячейке колеса. */
 } uRpcServerSession;
 
+/* Отложенный ответ на запрос контекста. */
+struct _uRpcServerReply
+{
+  uRpcServer          *urpc_server;            /* Сервер, принявший запрос. */
+  uint32_t             context;                /* Контекст транспорта запроса. */
+};
+
+/* Запрос, принятый в контексте транспорта. Контекст - это номер буферов и состояния
+   транспорта, в которых принимается запрос и отправляется ответ. Контекстом одновременно
+   владеет только один поток или отложенный ответ. */
+typedef struct uRpcServerRequest
+{
+  uRpcData            *urpc_data;              /* Буферы приёма-передачи. */
+  uint32_t             status;                 /* Статус выполнения запроса. */
+  uint32_t             disconnect;             /* Признак завершения сессии после ответа. */
+  uint32_t             session_id;             /* Идентификатор сессии. */
+  uRpcServerSession   *session;                /* Сессия, на которую взята ссылка. */
+  uRpcServerProc      *proc;                   /* Вызываемая пользовательская процедура. */
+  double               recv_time;              /* Время приёма запроса. */
+  double               proc_start;             /* Время начала выполнения процедуры. */
+  double               proc_stop;              /* Время окончания выполнения процедуры. */
+  uint32_t             deferred;               /* Состояние отложенного ответа. */
+  uRpcServerReply      reply;                  /* Отложенный ответ. */
+} uRpcServerRequest;
+
+/* Поток обработчика. Запросы помещаются в локальные очереди обработчиков, а
+   обработчик без запросов забирает их из очередей других обработчиков. */
+typedef struct uRpcServerHandler
+{
+  uRpcSHMQueue        *queue;                  /* Контексты с запросами обработчика. */
+  uRpcDoorbell         bell;                   /* Сигнал поступления запроса. */
+  uint32_t             idle;                   /* Признак ожидания запросов. */
+  uint32_t             spin;                   /* Число итераций активного ожидания. */
+} uRpcServerHandler;
+
 struct _uRpcServer
 {
   uint32_t             urpc_server_type;       /* Тип объекта uRpcServer. */
@@ -75,14 +147,30 @@ struct _uRpcServer
   urpc_free_proc       disconnect_proc;        /* Функция вызываемая при отключении клиента. */
   void                *disconnect_proc_data;   /* Пользовательские данные. */
 
-  uRpcHashTable       *procs;                  /* Пользовательские функции. */
-  uRpcHashTable       *procs_data;             /* Данные для пользовательских функций. */
-
-  uRpcHashTable       *sessions;               /* Пользовательские сессии. */
-  uRpcMemChunk        *sessions_chunks;        /* Аллокатор данных сессий. */
-  uint32_t             last_session_id;        /* Идентификатор последней созданной сессии. */
+  uRpcServerProc      *procs;                  /* Зарегистрированные пользовательские процедуры. */
+  uint32_t             procs_num;              /* Число зарегистрированных процедур. */
+  uint32_t             procs_size;             /* Размер массива зарегистрированных процедур. */
+  uRpcServerProc      *dispatch;               /* Таблица вызова процедур, создаётся при запуске сервера. */
+  uint32_t             dispatch_mask;          /* Маска номера ячейки таблицы вызова. */
+  uRpcServerProcStats *stats;                  /* Статистика процедур, отдельная для каждого потока. */
+  uint32_t             stats_num;              /* Число частей статистики. */
+  uRpcMutex            stats_lock;             /* Блокировка статистики отложенных ответов. */
+
+  uRpcServerSession   *sessions;               /* Слоты пользовательских сессий. */
+  uint32_t             sessions_num;           /* Число слотов сессий. */
+  uint32_t             sessions_bits;          /* Число бит номера слота в идентификаторе сессии. */
+  uint32_t            *free_sessions;          /* Стек номеров свободных слотов. */
+  uint32_t             free_sessions_num;      /* Число свободных слотов. */
+  uint32_t             peak_sessions;          /* Наибольшее число занятых слотов. */
+  uRpcMutex            sessions_lock;          /* Блокировка стека свободных слотов и колеса таймеров. */
   double               session_timeout;        /* Таймаут сессии. */
-  uRpcRWMutex          sessions_lock;          /* Блокировка доступа к пользовательским сессиям. */
+  uint32_t             session_timeout_ms;     /* Таймаут сессии, мс. */
+
+  uint32_t            *wheel;                  /* Ячейки колеса таймеров - списки слотов сессий. */
+  uint32_t             wheel_size;             /* Число ячеек колеса. */
+  uint32_t             wheel_tick;             /* Интервал времени одной ячейки, мс. */
+  uint32_t             wheel_pos;              /* Текущая ячейка колеса. */
+  uint32_t             wheel_time;             /* Время начала текущей ячейки, мс. */
   uRpcThread          *session_check;          /* Поток проверки пользовательских сессий. */
 
   uint32_t             threads_num;            /* Число рабочих потоков. */
@@ -92,38 +180,363 @@ struct _uRpcServer
   void                *transport;              /* Указатель на один из объектов: uRpcUDPServer,
                                                   uRpcTCPServer, uRpcSHMServer. */
 
-  uRpcThread         **servers;                /* Рабочие потоки. */
+  uRpcThread         **servers;                /* Рабочие потоки или потоки ввода-вывода. */
+  uRpcThread         **handlers;               /* Потоки обработчиков. */
+  uint32_t             handlers_num;           /* Число потоков обработчиков, 0 - процедуры
+                                                  вызываются рабочими потоками. */
+  uint32_t             contexts_num;           /* Число контекстов транспорта. */
+  uint32_t             deferred_num;           /* Число контекстов для отложенных ответов. */
+  volatile uint32_t    deferred_active;        /* Число незавершённых отложенных ответов. */
+  uRpcServerRequest   *requests;               /* Запросы контекстов транспорта. */
+  uRpcServerHandler   *handlers_state;         /* Очереди и сигналы обработчиков. */
+  uint32_t             started_handlers;       /* Число запущенных обработчиков. */
+  uRpcSHMQueue        *free_contexts;          /* Свободные контексты. */
+  uRpcDoorbell         context_bell;           /* Сигнал освобождения контекста. */
+  volatile uint32_t    running_io;             /* Число работающих потоков ввода-вывода. */
+  uint32_t            *cpus;                   /* Процессоры рабочих потоков. */
+  uint32_t             cpus_num;               /* Число закрепляемых рабочих потоков. */
+  double               busy_poll;              /* Время активного опроса запросов. */
+  uint32_t             udp_batch;              /* Число UDP запросов принимаемых за один вызов. */
+  int                  udp_reuse_port;         /* Отдельный UDP сокет для каждого потока. */
+  int                  use_uring;              /* Использование io_uring при наличии поддержки. */
   volatile uint32_t    started_servers;        /* Число запущенных потоков. */
   volatile uint32_t    shutdown;               /* Признак завершения работы. */
   uRpcMutex            lock;                   /* Блокировка доступа к критическим данным структуры. */
 };
 
-/* Функция удаления данных сессии. */
+/* Функция возвращает номер ячейки таблицы вызова процедур для идентификатора. */
+static uint32_t
+urpc_server_proc_hash (uRpcServer *urpc_server,
+                       uint32_t    proc_id)
+{
+  return ((proc_id * 0x9E3779B1U) >> 16) & urpc_server->dispatch_mask;
+}
+
+/* Функция создаёт таблицу вызова процедур из зарегистрированных процедур. Таблица
+   заполнена не более чем на четверть, поэтому процедура обычно находится в первой
+   проверенной ячейке. После запуска сервера таблица не изменяется и используется
+   рабочими потоками без блокировок. */
+static int
+urpc_server_build_dispatch (uRpcServer *urpc_server)
+{
+  uint32_t dispatch_size = 4;
+  uint32_t i, index;
+
+  while (dispatch_size < 4 * urpc_server->procs_num)
+    dispatch_size *= 2;
+
+  if (urpc_server->dispatch != NULL)
+    free (urpc_server->dispatch);
+  urpc_server->dispatch = calloc (dispatch_size, sizeof (uRpcServerProc));
+  if (urpc_server->dispatch == NULL)
+    return -1;
+  urpc_server->dispatch_mask = dispatch_size - 1;
+
+  for (i = 0; i < urpc_server->procs_num; i++)
+    {
+      urpc_server->procs[i].index = i;
+
+      index = urpc_server_proc_hash (urpc_server, urpc_server->procs[i].proc_id);
+      while (urpc_server->dispatch[index].proc != NULL)
+        index = (index + 1) & urpc_server->dispatch_mask;
+      urpc_server->dispatch[index] = urpc_server->procs[i];
+    }
+
+  /* Статистика процедур. Каждый поток изменяет только свою часть статистики, а
+     отложенные ответы - последнюю часть под блокировкой. */
+  if (urpc_server->stats != NULL)
+    free (urpc_server->stats);
+  urpc_server->stats_num = urpc_server->threads_num + urpc_server->handlers_num + 1;
+  urpc_server->stats = calloc ((size_t) urpc_server->stats_num * urpc_server->procs_num + 1,
+                               sizeof (uRpcServerProcStats));
+  if (urpc_server->stats == NULL)
+    return -1;
+
+  for (i = 0; i < urpc_server->stats_num * urpc_server->procs_num; i++)
+    urpc_server->stats[i].proc_id = urpc_server->procs[i % urpc_server->procs_num].proc_id;
+
+  return 0;
+}
+
+/* Функция ищет процедуру в таблице вызова. */
+static uRpcServerProc *
+urpc_server_find_proc (uRpcServer *urpc_server,
+                       uint32_t    proc_id)
+{
+  uint32_t index = urpc_server_proc_hash (urpc_server, proc_id);
+
+  while (urpc_server->dispatch[index].proc != NULL)
+    {
+      if (urpc_server->dispatch[index].proc_id == proc_id)
+        return &urpc_server->dispatch[index];
+      index = (index + 1) & urpc_server->dispatch_mask;
+    }
+
+  return NULL;
+}
+
+/* Функция возвращает время в наносекундах между двумя отметками времени. */
+static uint64_t
+urpc_server_get_elapsed (double start,
+                         double stop)
+{
+  return (stop > start) ? (uint64_t) (1e9 * (stop - start)) : 0;
+}
+
+/* Функция возвращает статистику процедур сервера клиенту. В ответ помещаются
+   записи всех процедур, которые помещаются в буфер ответа. */
+static void
+urpc_server_send_stats (uRpcServer *urpc_server,
+                        uRpcData   *urpc_data)
+{
+  uRpcServerProcStats *stats;
+  uint32_t stats_num = urpc_server->procs_num;
+  uint32_t *sizes;
+  uint8_t *data = NULL;
+  uint32_t size = 0;
+  uint32_t i;
+
+  stats = malloc ((stats_num + 1) * sizeof (uRpcServerProcStats));
+  sizes = malloc ((stats_num + 1) * sizeof (uint32_t));
+  if (stats == NULL || sizes == NULL)
+    goto urpc_server_send_stats_exit;
+
+  urpc_server_get_stats (urpc_server, stats, stats_num);
+
+  for (i = 0; i < stats_num; i++)
+    {
+      sizes[i] = urpc_server_proc_stats_get_size (&stats[i]);
+      size += sizes[i];
+    }
+
+  while (stats_num > 0)
+    {
+      data = urpc_data_reserve (urpc_data, URPC_PARAM_STATS, size);
+      if (data != NULL)
+        break;
+      stats_num -= 1;
+      size -= sizes[stats_num];
+    }
+
+  for (i = 0; i < stats_num; i++)
+    data += urpc_server_proc_stats_export (&stats[i], data);
+
+urpc_server_send_stats_exit:
+  free (stats);
+  free (sizes);
+}
+
+/* Функция возвращает текущее время в миллисекундах для отметок активности сессий. */
+static uint32_t
+urpc_server_get_time (void)
+{
+  return (uint32_t) (uint64_t) (1000.0 * urpc_timer_get_monotonic_time ());
+}
+
+/* Функция помещает слот сессии в ячейку колеса таймеров, которая будет проверена
+   после наступления момента времени deadline. Вызывается под блокировкой сессий. */
+static void
+urpc_server_wheel_insert (uRpcServer *urpc_server,
+                          uint32_t    index,
+                          uint32_t    deadline)
+{
+  uRpcServerSession *session = &urpc_server->sessions[index];
+  int32_t offset = (int32_t) (deadline - urpc_server->wheel_time);
+  uint32_t bucket;
+
+  bucket = (offset > 0) ? (uint32_t) offset / urpc_server->wheel_tick : 0;
+  if (bucket > urpc_server->wheel_size - 1)
+    bucket = urpc_server->wheel_size - 1;
+  bucket = (urpc_server->wheel_pos + bucket) % urpc_server->wheel_size;
+
+  session->wheel_next = urpc_server->wheel[bucket];
+  session->in_wheel = 1;
+  urpc_server->wheel[bucket] = index;
+}
+
+/* Функция отпускает ссылку на сессию. Если это была последняя ссылка на завершённую
+   сессию, вызывается функция отключения клиента и слот сессии освобождается. */
+static void
+urpc_server_session_unref (uRpcServer        *urpc_server,
+                           uRpcServerSession *session)
+{
+  uint32_t refs;
+
+  if (URPC_ATOMIC_DEC (&session->refs) != URPC_SESSION_REMOVED)
+    return;
+
+  /* Слот освобождает только один поток. */
+  if (!URPC_ATOMIC_CAS (&session->refs, URPC_SESSION_REMOVED, URPC_SESSION_REMOVED | URPC_SESSION_FREE))
+    return;
+
+  if (urpc_server->disconnect_proc != NULL)
+    urpc_server->disconnect_proc (session->user_data, urpc_server->disconnect_proc_data);
+
+  URPC_ATOMIC_STORE (&session->id, 0);
+  do
+    refs = URPC_ATOMIC_LOAD (&session->refs);
+  while (!URPC_ATOMIC_CAS (&session->refs, refs, refs & ~URPC_SESSION_REMOVED));
+
+  urpc_mutex_lock (&urpc_server->sessions_lock);
+  session->allocated = 0;
+  urpc_server->free_sessions[urpc_server->free_sessions_num++] = (uint32_t) (session - urpc_server->sessions);
+  urpc_mutex_unlock (&urpc_server->sessions_lock);
+}
+
+/* Функция ищет сессию по идентификатору и захватывает ссылку на неё. Пока ссылка
+   не отпущена, слот сессии не освобождается. */
+static uRpcServerSession *
+urpc_server_session_ref (uRpcServer *urpc_server,
+                         uint32_t    session_id)
+{
+  uRpcServerSession *session;
+  uint32_t index;
+
+  index = session_id & ((1U << urpc_server->sessions_bits) - 1);
+  if (session_id == 0 || index >= urpc_server->sessions_num)
+    return NULL;
+
+  session = &urpc_server->sessions[index];
+  if ((URPC_ATOMIC_INC (&session->refs) & (URPC_SESSION_FREE | URPC_SESSION_REMOVED)) ||
+      URPC_ATOMIC_LOAD (&session->id) != session_id)
+    {
+      urpc_server_session_unref (urpc_server, session);
+      return NULL;
+    }
+
+  return session;
+}
+
+/* Функция создаёт новую сессию и захватывает ссылку на неё. */
+static uRpcServerSession *
+urpc_server_session_new (uRpcServer *urpc_server,
+                         uint32_t    client_id)
+{
+  uRpcServerSession *session;
+  uint32_t generation_mask;
+  uint32_t index;
+
+  urpc_mutex_lock (&urpc_server->sessions_lock);
+  if (urpc_server->free_sessions_num == 0)
+    {
+      urpc_mutex_unlock (&urpc_server->sessions_lock);
+      return NULL;
+    }
+  index = urpc_server->free_sessions[--urpc_server->free_sessions_num];
+  session = &urpc_server->sessions[index];
+  session->allocated = 1;
+  if (urpc_server->sessions_num - urpc_server->free_sessions_num > urpc_server->peak_sessions)
+    urpc_server->peak_sessions = urpc_server->sessions_num - urpc_server->free_sessions_num;
+
+  /* Слот, оставшийся в колесе от предыдущей сессии, будет перенесён в нужную ячейку при её проверке. */
+  URPC_ATOMIC_STORE (&session->activity, urpc_server_get_time ());
+  if (!session->in_wheel)
+    urpc_server_wheel_insert (urpc_server, index, session->activity + urpc_server->session_timeout_ms);
+  urpc_mutex_unlock (&urpc_server->sessions_lock);
+
+  /* Ожидаем завершения проверок слота потоками, обращавшимися к нему по старому
+     идентификатору, и захватываем ссылку на новую сессию. */
+  while (!URPC_ATOMIC_CAS (&session->refs, URPC_SESSION_FREE, 1));
+
+  generation_mask = 0xffffffff >> urpc_server->sessions_bits;
+  session->generation = (session->generation + 1) & generation_mask;
+  if (session->generation == 0)
+    session->generation = 1;
+
+  session->state = URPC_STATE_GOT_SESSION_ID;
+  session->client_id = client_id;
+  session->user_data = NULL;
+
+  return session;
+}
+
+/* Функция завершения сессии. Новые запросы сессии не принимаются, а её слот
+   освобождается после завершения обработки всех запросов. Вызывающий поток
+   должен иметь ссылку на сессию. */
 static void
-urpc_server_session_remove_func (uRpcServerSession *session)
+urpc_server_close_session (uRpcServer        *urpc_server,
+                           uRpcServerSession *session)
 {
-  if (session->activity != NULL)
-    urpc_timer_destroy (session->activity);
-  urpc_mem_chunk_free (session->sessions_chunks, session);
+  uint32_t refs;
+
+  do
+    {
+      refs = URPC_ATOMIC_LOAD (&session->refs);
+      if (refs & URPC_SESSION_REMOVED)
+        return;
+    }
+  while (!URPC_ATOMIC_CAS (&session->refs, refs, refs | URPC_SESSION_REMOVED));
+
+  /* Отключаем TCP/IP клиента. */
+  if (urpc_server->type == URPC_TCP)
+    urpc_tcp_server_remove_client (urpc_server->transport, session->client_id);
 }
 
-/* Функция проверки и отключения сессии. */
+/* Функция проверки и отключения сессий. Проверяются только сессии из ячеек колеса
+   таймеров, время которых истекло. Запросы не изменяют колесо, а только отмечают
+   время активности сессии, поэтому активная сессия переносится в ячейку своего нового
+   срока при проверке. Сессии с обрабатываемыми запросами активны и не отключаются. */
 static void
-urpc_server_check_session (uint32_t           session_id,
-                           uRpcServerSession *session,
-                           uRpcServer        *urpc_server)
+urpc_server_check_sessions (uRpcServer *urpc_server)
 {
-  if (urpc_timer_elapsed (session->activity) > urpc_server->session_timeout)
+  uint32_t timeout = urpc_server->session_timeout_ms;
+  uint32_t now = urpc_server_get_time ();
+  uint32_t index, next;
+
+  urpc_mutex_lock (&urpc_server->sessions_lock);
+
+  while ((int32_t) (now - urpc_server->wheel_time) >= (int32_t) urpc_server->wheel_tick)
     {
-      if (urpc_server->disconnect_proc != NULL)
-        urpc_server->disconnect_proc (session->user_data, urpc_server->disconnect_proc_data);
-      urpc_hash_table_remove (urpc_server->sessions, session_id);
-      if (urpc_server->type == URPC_TCP)
+      uint32_t head = urpc_server->wheel[urpc_server->wheel_pos];
+
+      urpc_server->wheel[urpc_server->wheel_pos] = URPC_WHEEL_END;
+      urpc_server->wheel_pos = (urpc_server->wheel_pos + 1) % urpc_server->wheel_size;
+      urpc_server->wheel_time += urpc_server->wheel_tick;
+
+      if (head == URPC_WHEEL_END)
+        continue;
+
+      /* Отключение сессий выполняется без блокировки. Слоты из списка остаются
+         в колесе, поэтому сессии в них не добавляются в колесо повторно. */
+      urpc_mutex_unlock (&urpc_server->sessions_lock);
+      for (index = head; index != URPC_WHEEL_END; index = urpc_server->sessions[index].wheel_next)
         {
-          urpc_tcp_server_remove_client (urpc_server->transport, session->socket);
-          closesocket (session->socket);
+          uRpcServerSession *session;
+          uint32_t session_id;
+
+          session_id = URPC_ATOMIC_LOAD (&urpc_server->sessions[index].id);
+          if (session_id == 0)
+            continue;
+
+          session = urpc_server_session_ref (urpc_server, session_id);
+          if (session == NULL)
+            continue;
+
+          if ((URPC_ATOMIC_LOAD (&session->refs) & URPC_SESSION_REFS) == 1 &&
+              now - URPC_ATOMIC_LOAD (&session->activity) > timeout)
+            urpc_server_close_session (urpc_server, session);
+
+          urpc_server_session_unref (urpc_server, session);
+        }
+      urpc_mutex_lock (&urpc_server->sessions_lock);
+
+      /* Слоты сессий переносятся в ячейки их нового срока, свободные слоты удаляются из колеса. */
+      for (index = head; index != URPC_WHEEL_END; index = next)
+        {
+          uRpcServerSession *session = &urpc_server->sessions[index];
+
+          next = session->wheel_next;
+          if (!session->allocated)
+            {
+              session->in_wheel = 0;
+              continue;
+            }
+
+          urpc_server_wheel_insert (urpc_server, index, URPC_ATOMIC_LOAD (&session->activity) + timeout);
         }
     }
+
+  urpc_mutex_unlock (&urpc_server->sessions_lock);
 }
 
 /* Функция отключения клиентов по таймауту при неактивности. */
@@ -132,28 +545,16 @@ urpc_server_session_timeout_check (void *data)
 {
   uRpcServer *urpc_server = data;
 
-  int step = 0;
-
   /* Сигнализация о запуске потока. */
   urpc_mutex_lock (&urpc_server->lock);
   urpc_server->started_servers++;
   urpc_mutex_unlock (&urpc_server->lock);
 
-  /* Раз в три секунды проверяются сессии. */
+  /* Колесо таймеров проверяется каждые 100 мс. */
   while (!urpc_server->shutdown)
     {
       urpc_timer_sleep (0.1);
-      step += 1;
-
-      if (step < 30)
-        continue;
-      step = 0;
-
-      urpc_rwmutex_writer_lock (&urpc_server->sessions_lock);
-      urpc_hash_table_foreach (urpc_server->sessions,
-                               (urpc_hash_table_foreach_callback) urpc_server_check_session,
-                               urpc_server);
-      urpc_rwmutex_writer_unlock (&urpc_server->sessions_lock);
+      urpc_server_check_sessions (urpc_server);
     }
 
   // Сигнализация о завершении потока.
@@ -164,29 +565,287 @@ urpc_server_session_timeout_check (void *data)
   return NULL;
 }
 
-/* Функция обмена данными в потоке. */
-static void *
-urpc_server_func (void *data)
+/* Функция принимает запрос в контексте транспорта. */
+static uRpcData *
+urpc_server_recv (uRpcServer *urpc_server,
+                  uint32_t    context)
 {
-  uRpcServer *urpc_server = data;
+  switch (urpc_server->type)
+    {
+    case URPC_UDP:
+      return urpc_udp_server_recv (urpc_server->transport, context);
 
-  uint32_t thread_id;
-  void *thread_data;
-  uint32_t status;
-  uint32_t disconnect;
+    case URPC_TCP:
+      return urpc_tcp_server_recv (urpc_server->transport, context);
 
+    case URPC_SHM:
+      return urpc_shm_server_recv (urpc_server->transport, context);
+
+    default:
+      break;
+    }
+
+  return NULL;
+}
+
+/* Функция принимает запрос и обрабатывает системные процедуры. Возвращает отрицательное
+   число, если запрос не поступил, 0 - если ответ готов к отправке и 1 - если необходимо
+   вызвать пользовательскую процедуру. */
+static int
+urpc_server_recv_request (uRpcServer *urpc_server,
+                          uint32_t    context)
+{
+  uRpcServerRequest *request = &urpc_server->requests[context];
+  uRpcServerSession *session;
   uRpcData *urpc_data;
   uRpcHeader *iheader;
+  uint32_t client_id = 0;
+  uint32_t proc_id = 0;
+
+  /* Если в течение периода ожидания запроса не поступило, поток проверяет флаг
+     завершения и возвращается к ожиданию запросов. */
+  urpc_data = urpc_server_recv (urpc_server, context);
+  if (urpc_data == NULL)
+    return -1;
+
+  request->urpc_data = urpc_data;
+  request->status = URPC_STATUS_FAIL;
+  request->disconnect = URPC_FALSE;
+  request->session = NULL;
+  request->proc = NULL;
+  request->recv_time = urpc_timer_get_monotonic_time ();
+
+  /* Очищаем буфер ответа. Входящие данные установлены транспортом. Буферы очищаются
+     до обработки запроса, так как после отправки ответа SHM сервер может передать
+     их другому рабочему потоку. */
+  urpc_data_set_data_size (urpc_data, URPC_DATA_OUTPUT, 0);
+
+  /* Идентификатор подключения клиента для TCP/IP. */
+  if (urpc_server->type == URPC_TCP)
+    client_id = urpc_tcp_server_get_client_id (urpc_server->transport, context);
+
+  iheader = urpc_data_get_header (urpc_data, URPC_DATA_INPUT);
+  request->session_id = UINT32_FROM_BE (iheader->session);
+
+  /* Проверяем версию клиента. */
+  if ((UINT32_FROM_BE (iheader->version) >> 8) != (URPC_VERSION >> 8))
+    {
+      request->status = URPC_STATUS_VERSION_MISMATCH;
+      return 0;
+    }
+
+  /* Запрашиваемая функция. */
+  urpc_data_get_uint32 (urpc_data, URPC_PARAM_PROC, &proc_id);
+
+  /* Запрос возможностей сервера. */
+  if (request->session_id == 0 && proc_id == URPC_PROC_GET_CAP)
+    {
+      urpc_data_set_uint32 (urpc_data, URPC_PARAM_CAP, 0);
+      request->status = URPC_STATUS_OK;
+      return 0;
+    }
+
+  /* Начало сессии. */
+  if (request->session_id == 0 && proc_id == URPC_PROC_LOGIN)
+    {
+      /* Новая сессия, если число подключенных клиентов не превышено. */
+      session = urpc_server_session_new (urpc_server, client_id);
+      if (session == NULL)
+        {
+          request->status = URPC_STATUS_TOO_MANY_CONNECTIONS;
+          return 0;
+        }
+
+      request->session_id = (session->generation << urpc_server->sessions_bits) |
+                            (uint32_t) (session - urpc_server->sessions);
+
+      /* Вызываем функцию при подключении клиента. */
+      if (urpc_server->connect_proc != NULL)
+        session->user_data = urpc_server->connect_proc (request->session_id, urpc_server->connect_proc_data, NULL);
+
+      /* С этого момента сессия доступна по идентификатору. */
+      URPC_ATOMIC_STORE (&session->id, request->session_id);
+      urpc_server_session_unref (urpc_server, session);
+
+      request->status = URPC_STATUS_OK;
+      return 0;
+    }
+
+  /* Проверка наличия сессии. Запросы одной сессии могут обрабатываться
+     несколькими потоками одновременно, поэтому данные сессии удаляются
+     только после завершения обработки всех её запросов. */
+  session = urpc_server_session_ref (urpc_server, request->session_id);
+  if (session == NULL)
+    {
+      request->status = URPC_STATUS_AUTH_ERROR;
+      return 0;
+    }
+  URPC_ATOMIC_STORE (&session->activity, urpc_server_get_time ());
+  request->session = session;
+
+  if (session->state == URPC_STATE_GOT_SESSION_ID)
+    session->state = URPC_STATE_CONNECTED;
+
+  /* Отключение клиента. */
+  if (proc_id == URPC_PROC_LOGOUT && session->state == URPC_STATE_CONNECTED)
+    {
+      request->status = URPC_STATUS_OK;
+      request->disconnect = URPC_TRUE;
+      return 0;
+    }
+
+  /* Запрос статистики сервера. */
+  if (proc_id == URPC_PROC_GET_STATS)
+    {
+      urpc_server_send_stats (urpc_server, urpc_data);
+      request->status = URPC_STATUS_OK;
+      return 0;
+    }
+
+  /* Неизвестная функция, отключаем клиента. */
+  request->proc = urpc_server_find_proc (urpc_server, proc_id);
+  if (request->proc == NULL)
+    {
+      request->disconnect = URPC_TRUE;
+      return 0;
+    }
+
+  return 1;
+}
+
+/* Функция вызывает пользовательскую процедуру. Возвращает 1, если процедура отложила
+   ответ и контекст передан отложенному ответу, иначе 0 - ответ готов к отправке. */
+static int
+urpc_server_call_proc (uRpcServer *urpc_server,
+                       uint32_t    context,
+                       void       *thread_data)
+{
+  uRpcServerRequest *request = &urpc_server->requests[context];
+  uRpcServerProc *proc = request->proc;
+  int status;
+
+  request->proc_start = urpc_timer_get_monotonic_time ();
+  urpc_data_set_owner (request->urpc_data, request);
+  status = proc->proc (request->urpc_data, thread_data, request->session->user_data, proc->data);
+  urpc_data_set_owner (request->urpc_data, NULL);
+
+  /* Отложенный ответ мог быть завершён другим потоком до окончания процедуры,
+     тогда ответ отправляет этот поток, а результат процедуры не учитывается. */
+  if (request->deferred != URPC_REPLY_NONE)
+    {
+      if (URPC_ATOMIC_CAS (&request->deferred, URPC_REPLY_DEFERRED, URPC_REPLY_DETACHED))
+        return 1;
+
+      /* Ответ подготовлен, но процедура выполнялась до этого момента. */
+      request->deferred = URPC_REPLY_NONE;
+      request->proc_stop = urpc_timer_get_monotonic_time ();
+      return 0;
+    }
+
+  if (status == 0)
+    request->status = URPC_STATUS_OK;
+  request->proc_stop = urpc_timer_get_monotonic_time ();
+
+  /* Ошибка при вызове пользовательской функции, отключаем клиента. */
+  if (request->status != URPC_STATUS_OK)
+    request->disconnect = URPC_TRUE;
+
+  return 0;
+}
+
+/* Функция отправляет ответ и завершает обработку запроса. Статистика учитывается
+   в части stats_id, последняя часть принадлежит отложенным ответам. */
+static void
+urpc_server_send_reply (uRpcServer *urpc_server,
+                        uint32_t    context,
+                        uint32_t    stats_id)
+{
+  uRpcServerRequest *request = &urpc_server->requests[context];
+  uRpcData *urpc_data = request->urpc_data;
+  uRpcServerProcStats *stats;
+  uRpcHeader *iheader;
   uRpcHeader *oheader;
+  uint32_t recv_size;
   uint32_t send_size;
+  double send_stop;
 
-  uint32_t session_id;
-  uRpcServerSession *session;
-  SOCKET csocket;
+  urpc_data_set_uint32 (urpc_data, URPC_PARAM_STATUS, request->status);
+
+  /* Заголовок отправляемого пакета. */
+  iheader = urpc_data_get_header (urpc_data, URPC_DATA_INPUT);
+  oheader = urpc_data_get_header (urpc_data, URPC_DATA_OUTPUT);
+  send_size = URPC_HEADER_SIZE + urpc_data_get_data_size (urpc_data, URPC_DATA_OUTPUT);
+  oheader->magic = UINT32_TO_BE (URPC_MAGIC);
+  oheader->version = UINT32_TO_BE (URPC_VERSION);
+  oheader->size = UINT32_TO_BE (send_size);
+  oheader->session = UINT32_TO_BE (request->session_id);
+  oheader->id = iheader->id;
 
-  uint32_t proc_id;
-  urpc_proc proc;
-  void *proc_data;
+  /* После отправки буферы запроса могут быть возвращены в пул транспорта. */
+  recv_size = UINT32_FROM_BE (iheader->size);
+
+  /* Отправка ответа. */
+  switch (urpc_server->type)
+    {
+    case URPC_UDP:
+      urpc_udp_server_send (urpc_server->transport, context);
+      break;
+
+    case URPC_TCP:
+      urpc_tcp_server_send (urpc_server->transport, context);
+      break;
+
+    case URPC_SHM:
+      urpc_shm_server_send (urpc_server->transport, context);
+      break;
+
+    default:
+      break;
+    }
+
+  /* Статистика пользовательской процедуры. Часть статистики потока изменяется
+     без блокировок, отложенные ответы завершаются любыми потоками. */
+  if (request->proc != NULL)
+    {
+      send_stop = urpc_timer_get_monotonic_time ();
+      stats = &urpc_server->stats[stats_id * urpc_server->procs_num + request->proc->index];
+
+      if (stats_id == urpc_server->stats_num - 1)
+        urpc_mutex_lock (&urpc_server->stats_lock);
+
+      stats->calls += 1;
+      if (request->status != URPC_STATUS_OK)
+        stats->errors += 1;
+      stats->bytes_in += recv_size;
+      stats->bytes_out += send_size;
+      urpc_histogram_add (&stats->dispatch_time, urpc_server_get_elapsed (request->recv_time, request->proc_start));
+      urpc_histogram_add (&stats->proc_time, urpc_server_get_elapsed (request->proc_start, request->proc_stop));
+      urpc_histogram_add (&stats->send_time, urpc_server_get_elapsed (request->proc_stop, send_stop));
+
+      if (stats_id == urpc_server->stats_num - 1)
+        urpc_mutex_unlock (&urpc_server->stats_lock);
+    }
+
+  /* Завершаем обработку запроса. Произошла ошибка или штатное отключение - удаляем сессию. */
+  if (request->session != NULL)
+    {
+      if (request->disconnect)
+        urpc_server_close_session (urpc_server, request->session);
+      urpc_server_session_unref (urpc_server, request->session);
+      request->session = NULL;
+    }
+}
+
+/* Функция обмена данными в потоке. Поток принимает запросы, вызывает процедуры
+   и отправляет ответы, номер потока совпадает с номером контекста транспорта. */
+static void *
+urpc_server_func (void *data)
+{
+  uRpcServer *urpc_server = data;
+
+  uint32_t thread_id;
+  void *thread_data;
+  int received;
 
   /* Пользовательская функция запуска рабочего потока. */
   if (urpc_server->thread_start_proc != NULL)
@@ -201,217 +860,247 @@ urpc_server_func (void *data)
 
   while (!urpc_server->shutdown)
     {
-      status = URPC_STATUS_FAIL;
-      disconnect = URPC_FALSE;
-      csocket = INVALID_SOCKET;
-      session = NULL;
-      proc_id = 0;
+      received = urpc_server_recv_request (urpc_server, thread_id);
+      if (received < 0)
+        continue;
 
-      /* Ожидание запроса от клиента. */
-      switch (urpc_server->type)
-        {
-        case URPC_UDP:
-          urpc_data = urpc_udp_server_recv (urpc_server->transport, thread_id);
-          break;
+      if (received > 0)
+        urpc_server_call_proc (urpc_server, thread_id, thread_data);
 
-        case URPC_TCP:
-          urpc_data = urpc_tcp_server_recv (urpc_server->transport, thread_id);
-          break;
+      urpc_server_send_reply (urpc_server, thread_id, thread_id);
+    }
 
-        case URPC_SHM:
-          urpc_data = urpc_shm_server_recv (urpc_server->transport, thread_id);
-          break;
+  /* Пользовательская функция остановки рабочего потока. */
+  if (urpc_server->thread_stop_proc != NULL)
+    urpc_server->thread_stop_proc (thread_data, urpc_server->thread_start_proc_data);
 
-        default:
-          urpc_data = NULL;
-          break;
-        }
+  /* Сигнализация о завершении потока. */
+  urpc_mutex_lock (&urpc_server->lock);
+  urpc_server->started_servers--;
+  urpc_mutex_unlock (&urpc_server->lock);
 
-      /* Если в течение периода ожидания запроса не поступило, проверяем флаг завершения
-         потока и возвращаемся к ожиданию запросов. */
-      if (urpc_data == NULL)
-        continue;
+  return NULL;
+}
 
-      /* Сокет клиента для TCP/IP. */
-      if (urpc_server->type == URPC_TCP)
-        csocket = urpc_tcp_server_get_client_socket (urpc_server->transport, thread_id);
+/* Функция ищет ожидающий запросов обработчик, начиная с указанного. */
+static uint32_t
+urpc_server_find_idle_handler (uRpcServer *urpc_server,
+                               uint32_t    first)
+{
+  uint32_t i, index;
 
-      iheader = urpc_data_get_header (urpc_data, URPC_DATA_INPUT);
-      oheader = urpc_data_get_header (urpc_data, URPC_DATA_OUTPUT);
-      session_id = UINT32_FROM_BE (iheader->session);
+  for (i = 0; i < urpc_server->handlers_num; i++)
+    {
+      index = (first + i) % urpc_server->handlers_num;
+      if (URPC_ATOMIC_LOAD (&urpc_server->handlers_state[index].idle))
+        return index;
+    }
 
-      /* Проверяем версию клиента. */
-      if ((UINT32_FROM_BE (iheader->version) >> 8) != (URPC_VERSION >> 8))
-        {
-          status = URPC_STATUS_VERSION_MISMATCH;
-          goto urpc_server_send_reply;
-        }
+  return URPC_SERVER_NO_CONTEXT;
+}
 
-      /* Запрашиваемая функция. */
-      urpc_data_get_uint32 (urpc_data, URPC_PARAM_PROC, &proc_id);
+/* Функция передаёт контекст с запросом обработчику. Запрос помещается в очередь
+   ожидающего обработчика, а если все заняты - в очередь следующего по кругу.
+   После помещения в очередь будится ожидающий обработчик: он мог начать ожидание
+   уже после выбора очереди и заберёт запрос из чужой очереди. */
+static void
+urpc_server_queue_request (uRpcServer *urpc_server,
+                           uint32_t    context,
+                           uint32_t    next_handler)
+{
+  uint32_t target;
+  uint32_t idle;
 
-      /* Запрос возможностей сервера. */
-      if (session_id == 0 && proc_id == URPC_PROC_GET_CAP)
-        {
-          urpc_data_set_uint32 (urpc_data, URPC_PARAM_CAP, 0);
-          status = URPC_STATUS_OK;
-          goto urpc_server_send_reply;
-        }
+  next_handler %= urpc_server->handlers_num;
+  target = urpc_server_find_idle_handler (urpc_server, next_handler);
+  if (target == URPC_SERVER_NO_CONTEXT)
+    target = next_handler;
 
-      /* Начало сессии. */
-      if (session_id == 0 && proc_id == URPC_PROC_LOGIN)
-        {
-          urpc_rwmutex_writer_lock (&urpc_server->sessions_lock);
+  /* Очереди рассчитаны на все контексты и не переполняются. */
+  urpc_shm_queue_push (urpc_server->handlers_state[target].queue, context);
 
-          /* Проверка числа уже подключенных клиентов. */
-          if (urpc_hash_table_size (urpc_server->sessions) >= urpc_server->max_clients)
-            {
-              urpc_rwmutex_writer_unlock (&urpc_server->sessions_lock);
-              status = URPC_STATUS_TOO_MANY_CONNECTIONS;
-              goto urpc_server_send_reply;
-            }
+  idle = urpc_server_find_idle_handler (urpc_server, target);
+  if (idle != URPC_SERVER_NO_CONTEXT)
+    urpc_doorbell_ring (&urpc_server->handlers_state[idle].bell);
+}
 
-          /* Структура с новой сессией. */
-          session = urpc_mem_chunk_alloc (urpc_server->sessions_chunks);
-          if (session == NULL)
-            {
-              urpc_rwmutex_writer_unlock (&urpc_server->sessions_lock);
-              status = URPC_STATUS_FAIL;
-              goto urpc_server_send_reply;
-            }
+/* Функция извлекает запрос из очереди обработчика, а если она пуста - из очередей
+   других обработчиков. Возвращает 0 или отрицательное число, если запросов нет. */
+static int
+urpc_server_get_request (uRpcServer *urpc_server,
+                         uint32_t    handler_id,
+                         uint32_t   *context)
+{
+  uint32_t i;
 
-          session->state = URPC_STATE_GOT_SESSION_ID;
-          session->sessions_chunks = urpc_server->sessions_chunks;
-          session->socket = csocket;
+  for (i = 0; i < urpc_server->handlers_num; i++)
+    {
+      uRpcServerHandler *handler;
 
-          /* Запоминаем время подключения. */
-          session->activity = urpc_timer_create ();
-          if (session->activity == NULL)
-            {
-              urpc_rwmutex_writer_unlock (&urpc_server->sessions_lock);
-              status = URPC_STATUS_FAIL;
-              urpc_server_session_remove_func (session);
-              session = NULL;
-              goto urpc_server_send_reply;
-            }
+      handler = &urpc_server->handlers_state[(handler_id + i) % urpc_server->handlers_num];
+      if (urpc_shm_queue_pop (handler->queue, context) == 0)
+        return 0;
+    }
 
-          /* Генерируем новый идентификатор. */
-          session_id = urpc_server->last_session_id;
-          do
-            {
-              session_id += 1;
-            }
-          while (session_id == 0 || urpc_hash_table_find (urpc_server->sessions, session_id) != NULL);
+  return -1;
+}
+
+/* Функция потока ввода-вывода. Поток берёт свободный контекст транспорта, принимает
+   в нём запрос и передаёт контекст в очередь обработчиков. Системные процедуры
+   выполняются и отвечаются сразу, без передачи обработчикам. Без обработчиков поток
+   сам вызывает процедуры и берёт новый контекст, только если процедура отложила ответ. */
+static void *
+urpc_server_io_func (void *data)
+{
+  uRpcServer *urpc_server = data;
 
-          /* Запоминаем сессию. */
-          if (urpc_hash_table_insert (urpc_server->sessions, session_id, session) != 0)
-            {
-              urpc_rwmutex_writer_unlock (&urpc_server->sessions_lock);
-              status = URPC_STATUS_FAIL;
-              urpc_server_session_remove_func (session);
-              session = NULL;
-              goto urpc_server_send_reply;
-            }
+  uint32_t context = URPC_SERVER_NO_CONTEXT;
+  uint32_t spin = URPC_DOORBELL_MAX_SPIN;
+  uint32_t next_handler;
+  uint32_t io_id;
+  void *thread_data = NULL;
+  int received;
 
-          /* Вызываем функцию при подключении клиента. */
-          if (urpc_server->connect_proc != NULL)
-            session->user_data = urpc_server->connect_proc (session_id, urpc_server->connect_proc_data, NULL);
+  /* Пользовательская функция запуска рабочего потока. */
+  if (urpc_server->handlers_num == 0 && urpc_server->thread_start_proc != NULL)
+    thread_data = urpc_server->thread_start_proc (urpc_server->thread_start_proc_data);
 
-          urpc_rwmutex_writer_unlock (&urpc_server->sessions_lock);
+  /* Сигнализация о запуске потока. Потоки начинают распределять запросы с разных
+     обработчиков. Номер потока среди потоков ввода-вывода определяет часть статистики. */
+  urpc_mutex_lock (&urpc_server->lock);
+  next_handler = urpc_server->started_servers++;
+  io_id = urpc_server->running_io;
+  urpc_server->running_io += 1;
+  urpc_mutex_unlock (&urpc_server->lock);
 
-          status = URPC_STATUS_OK;
-          goto urpc_server_send_reply;
+  while (!urpc_server->shutdown)
+    {
+      /* Все контексты заняты обработчиками - ждём освобождения. Сигнал рассчитан на
+         одного получателя, поэтому оставшиеся контексты передаются следующему потоку. */
+      if (context == URPC_SERVER_NO_CONTEXT)
+        {
+          if (urpc_shm_queue_pop (urpc_server->free_contexts, &context) != 0)
+            {
+              context = URPC_SERVER_NO_CONTEXT;
+              urpc_doorbell_wait (&urpc_server->context_bell, &spin, 0.1);
+              continue;
+            }
+          if (!urpc_shm_queue_is_empty (urpc_server->free_contexts))
+            urpc_doorbell_ring (&urpc_server->context_bell);
         }
 
-      /* Проверка наличия сессии. */
-      urpc_rwmutex_reader_lock (&urpc_server->sessions_lock);
-      session = urpc_hash_table_find (urpc_server->sessions, session_id);
-      if (session == NULL)
+      received = urpc_server_recv_request (urpc_server, context);
+      if (received < 0)
+        continue;
+
+      if (received == 0)
         {
-          urpc_rwmutex_reader_unlock (&urpc_server->sessions_lock);
-          status = URPC_STATUS_AUTH_ERROR;
-          goto urpc_server_send_reply;
+          urpc_server_send_reply (urpc_server, context, io_id);
+          continue;
         }
-      urpc_timer_start (session->activity);
-      urpc_rwmutex_reader_unlock (&urpc_server->sessions_lock);
 
-      if (session->state == URPC_STATE_GOT_SESSION_ID)
-        session->state = URPC_STATE_CONNECTED;
-
-      /* Отключение клиента. */
-      if (proc_id == URPC_PROC_LOGOUT && session->state == URPC_STATE_CONNECTED)
+      if (urpc_server->handlers_num > 0)
         {
-          status = URPC_STATUS_OK;
-          disconnect = URPC_TRUE;
-          goto urpc_server_send_reply;
+          urpc_server_queue_request (urpc_server, context, next_handler++);
+          context = URPC_SERVER_NO_CONTEXT;
+          continue;
         }
 
-      /* Вызов пользовательской функциии. */
-      proc = urpc_hash_table_find (urpc_server->procs, proc_id);
-      proc_data = urpc_hash_table_find (urpc_server->procs_data, proc_id);
-      if (proc != NULL)
+      if (urpc_server_call_proc (urpc_server, context, thread_data) > 0)
         {
-          if (proc (urpc_data, thread_data, session->user_data, proc_data) == 0)
-            status = URPC_STATUS_OK;
+          context = URPC_SERVER_NO_CONTEXT;
+          continue;
         }
 
-      /* Ошибка при вызове пользовательской функции, отключаем клиента. */
-      if (status != URPC_STATUS_OK)
-        disconnect = URPC_TRUE;
+      urpc_server_send_reply (urpc_server, context, io_id);
+    }
 
-      /* Отправка ответа. */
-urpc_server_send_reply:
-      urpc_data_set_uint32 (urpc_data, URPC_PARAM_STATUS, status);
+  if (context != URPC_SERVER_NO_CONTEXT)
+    urpc_shm_queue_push (urpc_server->free_contexts, context);
 
-      /* Заголовок отправляемого пакета. */
-      send_size = URPC_HEADER_SIZE + urpc_data_get_data_size (urpc_data, URPC_DATA_OUTPUT);
-      oheader->magic = UINT32_TO_BE (URPC_MAGIC);
-      oheader->version = UINT32_TO_BE (URPC_VERSION);
-      oheader->size = UINT32_TO_BE (send_size);
-      oheader->session = UINT32_TO_BE (session_id);
+  /* Пользовательская функция остановки рабочего потока. */
+  if (urpc_server->handlers_num == 0 && urpc_server->thread_stop_proc != NULL)
+    urpc_server->thread_stop_proc (thread_data, urpc_server->thread_start_proc_data);
 
-      /* Отправка ответа. */
-      switch (urpc_server->type)
-        {
-        case URPC_UDP:
-          urpc_udp_server_send (urpc_server->transport, thread_id);
-          break;
+  /* Сигнализация о завершении потока. */
+  urpc_mutex_lock (&urpc_server->lock);
+  urpc_server->running_io -= 1;
+  urpc_server->started_servers--;
+  urpc_mutex_unlock (&urpc_server->lock);
 
-        case URPC_TCP:
-          urpc_tcp_server_send (urpc_server->transport, thread_id);
-          break;
+  return NULL;
+}
 
-        case URPC_SHM:
-          urpc_shm_server_send (urpc_server->transport, thread_id);
-          break;
+/* Функция потока обработчика. Поток вызывает процедуры запросов из своей очереди,
+   а при её отсутствии - из очередей других обработчиков, отправляет ответы и возвращает
+   контексты потокам ввода-вывода. При завершении работы очереди обрабатываются до конца,
+   чтобы освободить ссылки на сессии и подключения. */
+static void *
+urpc_server_handler_func (void *data)
+{
+  uRpcServer *urpc_server = data;
+  uRpcServerHandler *handler;
 
-        default:
-          break;
-        }
+  void *thread_data;
+  uint32_t handler_id;
+  uint32_t context;
+  int io_stopped;
+  int found;
+
+  /* Пользовательская функция запуска потока. */
+  if (urpc_server->thread_start_proc != NULL)
+    thread_data = urpc_server->thread_start_proc (urpc_server->thread_start_proc_data);
+  else
+    thread_data = NULL;
+
+  /* Сигнализация о запуске потока. */
+  urpc_mutex_lock (&urpc_server->lock);
+  urpc_server->started_servers++;
+  handler_id = urpc_server->started_handlers++;
+  urpc_mutex_unlock (&urpc_server->lock);
+
+  handler = &urpc_server->handlers_state[handler_id];
 
-      /* Произошла ошибка или штатное отключение - удаляем сессию. */
-      if (disconnect)
+  for (;;)
+    {
+      if (urpc_server_get_request (urpc_server, handler_id, &context) != 0)
         {
-          if (urpc_server->disconnect_proc != NULL)
-            urpc_server->disconnect_proc (session->user_data, urpc_server->disconnect_proc_data);
-          urpc_rwmutex_writer_lock (&urpc_server->sessions_lock);
-          urpc_hash_table_remove (urpc_server->sessions, session_id);
-          urpc_rwmutex_writer_unlock (&urpc_server->sessions_lock);
-
-          /* Отключаем TCP/IP клиента. */
-          if (urpc_server->type == URPC_TCP)
+          /* Потоки ввода-вывода завершили работу и новых запросов не будет. */
+          io_stopped = 0;
+          if (urpc_server->shutdown)
+            {
+              urpc_mutex_lock (&urpc_server->lock);
+              io_stopped = (urpc_server->running_io == 0);
+              urpc_mutex_unlock (&urpc_server->lock);
+            }
+
+          /* Признак ожидания устанавливается до повторной проверки очередей, поэтому
+             запрос, помещённый после проверки, сопровождается сигналом этому потоку. */
+          URPC_ATOMIC_CAS (&handler->idle, 0, 1);
+          found = (urpc_server_get_request (urpc_server, handler_id, &context) == 0);
+          if (!found)
             {
-              urpc_tcp_server_remove_client (urpc_server->transport, csocket);
-              closesocket (csocket);
+              if (io_stopped)
+                break;
+              urpc_doorbell_wait (&handler->bell, &handler->spin, 0.1);
             }
+          URPC_ATOMIC_CAS (&handler->idle, 1, 0);
+
+          if (!found)
+            continue;
         }
 
-      /* Очищаем буферы приёма-передачи. */
-      urpc_data_set_data_size (urpc_data, URPC_DATA_INPUT, 0);
-      urpc_data_set_data_size (urpc_data, URPC_DATA_OUTPUT, 0);
+      /* Контекст отложенного ответа освобождается при его завершении. */
+      if (urpc_server_call_proc (urpc_server, context, thread_data) > 0)
+        continue;
+
+      urpc_server_send_reply (urpc_server, context, urpc_server->threads_num + handler_id);
+
+      urpc_shm_queue_push (urpc_server->free_contexts, context);
+      urpc_doorbell_ring (&urpc_server->context_bell);
     }
 
-  /* Пользовательская функция остановки рабочего потока. */
+  /* Пользовательская функция остановки потока. */
   if (urpc_server->thread_stop_proc != NULL)
     urpc_server->thread_stop_proc (thread_data, urpc_server->thread_start_proc_data);
 
@@ -448,6 +1137,10 @@ urpc_server_create (const char *uri,
   if (urpc_type == URPC_UNKNOWN)
     return NULL;
 
+  /* Проверка ограничений. */
+  if (threads_num > URPC_MAX_THREADS_NUM)
+    threads_num = URPC_MAX_THREADS_NUM;
+
   /* Структура объекта. */
   urpc_server = malloc (sizeof (uRpcServer));
   if (urpc_server == NULL)
@@ -456,49 +1149,97 @@ urpc_server_create (const char *uri,
   urpc_server->type = urpc_type;
   urpc_server->urpc_server_type = URPC_SERVER_TYPE;
   urpc_server->uri = NULL;
+  urpc_server->thread_start_proc = NULL;
+  urpc_server->thread_start_proc_data = NULL;
+  urpc_server->thread_stop_proc = NULL;
+  urpc_server->thread_stop_proc_data = NULL;
   urpc_server->connect_proc = NULL;
   urpc_server->connect_proc_data = NULL;
   urpc_server->disconnect_proc = NULL;
   urpc_server->disconnect_proc_data = NULL;
   urpc_server->procs = NULL;
-  urpc_server->procs_data = NULL;
+  urpc_server->procs_num = 0;
+  urpc_server->procs_size = 0;
+  urpc_server->dispatch = NULL;
+  urpc_server->dispatch_mask = 0;
+  urpc_server->stats = NULL;
+  urpc_server->stats_num = 0;
   urpc_server->sessions = NULL;
-  urpc_server->sessions_chunks = NULL;
-  urpc_server->last_session_id = 0;
+  urpc_server->sessions_num = max_clients > 0 ? max_clients : 1;
+  urpc_server->sessions_bits = 1;
+  urpc_server->free_sessions = NULL;
+  urpc_server->free_sessions_num = 0;
+  urpc_server->peak_sessions = 0;
   urpc_server->session_timeout = session_timeout;
+  urpc_server->session_timeout_ms = (session_timeout < 0x7fffffff / 1000.0) ?
+                                    (uint32_t) (1000.0 * session_timeout) : 0x7fffffff;
+  urpc_server->wheel = NULL;
   urpc_server->session_check = NULL;
   urpc_server->transport = NULL;
   urpc_server->servers = NULL;
+  urpc_server->handlers = NULL;
+  urpc_server->handlers_num = 0;
+  urpc_server->contexts_num = threads_num;
+  urpc_server->deferred_num = 0;
+  urpc_server->deferred_active = 0;
+  urpc_server->requests = NULL;
+  urpc_server->handlers_state = NULL;
+  urpc_server->started_handlers = 0;
+  urpc_server->free_contexts = NULL;
+  memset (&urpc_server->context_bell, 0, sizeof (uRpcDoorbell));
+  urpc_server->running_io = 0;
+  urpc_server->cpus = NULL;
+  urpc_server->cpus_num = 0;
+  urpc_server->busy_poll = 0.0;
+  urpc_server->udp_batch = 1;
+  urpc_server->udp_reuse_port = 0;
+  urpc_server->use_uring = 1;
   urpc_server->threads_num = threads_num;
   urpc_server->max_clients = max_clients;
   urpc_server->max_data_size = max_data_size;
   urpc_server->data_timeout = data_timeout;
   urpc_server->started_servers = 0;
   urpc_server->shutdown = 0;
-  urpc_rwmutex_init (&urpc_server->sessions_lock);
   urpc_mutex_init (&urpc_server->lock);
+  urpc_mutex_init (&urpc_server->sessions_lock);
+  urpc_mutex_init (&urpc_server->stats_lock);
 
   urpc_server->uri = malloc (strlen (uri) + 1);
   if (urpc_server->uri == NULL)
     goto urpc_server_create_fail;
   memcpy (urpc_server->uri, uri, strlen (uri) + 1);
 
-  urpc_server->procs = urpc_hash_table_create (NULL);
-  if (urpc_server->procs == NULL)
-    goto urpc_server_create_fail;
-
-  urpc_server->procs_data = urpc_hash_table_create (NULL);
-  if (urpc_server->procs_data == NULL)
-    goto urpc_server_create_fail;
+  /* Слоты сессий. Номера слотов выдаются в порядке возрастания. */
+  while (urpc_server->sessions_bits < 24 && (1U << urpc_server->sessions_bits) < urpc_server->sessions_num)
+    urpc_server->sessions_bits += 1;
+  if (urpc_server->sessions_num > (1U << urpc_server->sessions_bits))
+    urpc_server->sessions_num = 1U << urpc_server->sessions_bits;
 
-  urpc_server->sessions = 
-    urpc_hash_table_create ((urpc_hash_table_destroy_callback) urpc_server_session_remove_func);
-  if (urpc_server->sessions == NULL)
+  urpc_server->sessions = calloc (urpc_server->sessions_num, sizeof (uRpcServerSession));
+  urpc_server->free_sessions = malloc (urpc_server->sessions_num * sizeof (uint32_t));
+  if (urpc_server->sessions == NULL || urpc_server->free_sessions == NULL)
     goto urpc_server_create_fail;
 
-  urpc_server->sessions_chunks = urpc_mem_chunk_create (sizeof (uRpcServerSession));
-  if (urpc_server->sessions_chunks == NULL)
+  for (i = 0; i < urpc_server->sessions_num; i++)
+    {
+      urpc_server->sessions[i].refs = URPC_SESSION_FREE;
+      urpc_server->free_sessions[i] = urpc_server->sessions_num - 1 - i;
+    }
+  urpc_server->free_sessions_num = urpc_server->sessions_num;
+
+  /* Колесо таймеров охватывает интервал таймаута сессии. */
+  urpc_server->wheel_tick = urpc_server->session_timeout_ms / (URPC_WHEEL_MAX_SIZE - 2);
+  if (urpc_server->wheel_tick < URPC_WHEEL_MIN_TICK)
+    urpc_server->wheel_tick = URPC_WHEEL_MIN_TICK;
+  urpc_server->wheel_size = urpc_server->session_timeout_ms / urpc_server->wheel_tick + 2;
+  urpc_server->wheel_pos = 0;
+  urpc_server->wheel_time = urpc_server_get_time ();
+
+  urpc_server->wheel = malloc (urpc_server->wheel_size * sizeof (uint32_t));
+  if (urpc_server->wheel == NULL)
     goto urpc_server_create_fail;
+  for (i = 0; i < urpc_server->wheel_size; i++)
+    urpc_server->wheel[i] = URPC_WHEEL_END;
 
   urpc_server->servers = malloc (threads_num * sizeof (uRpcThread *));
   if (urpc_server->servers == NULL)
@@ -545,10 +1286,23 @@ urpc_server_destroy (uRpcServer *urpc_server)
             urpc_thread_destroy (urpc_server->servers[i]);
         }
     }
+  if (urpc_server->handlers != NULL)
+    {
+      for (i = 0; i < urpc_server->handlers_num; i++)
+        {
+          if (urpc_server->handlers[i] != NULL)
+            urpc_thread_destroy (urpc_server->handlers[i]);
+        }
+    }
 
   if (urpc_server->session_check != NULL)
     urpc_thread_destroy (urpc_server->session_check);
 
+  /* Потоки остановлены и новые ответы не откладываются, ожидаем завершения
+     уже отложенных ответов. */
+  while (URPC_ATOMIC_LOAD (&urpc_server->deferred_active) != 0)
+    urpc_timer_sleep (0.01);
+
   /* Удаляем объект обмена данными. */
   if (urpc_server->transport != NULL)
     {
@@ -574,19 +1328,38 @@ urpc_server_destroy (uRpcServer *urpc_server)
   /* Удаляем объект. */
   if (urpc_server->servers != NULL)
     free (urpc_server->servers);
-  if (urpc_server->procs_data != NULL)
-    urpc_hash_table_destroy (urpc_server->procs_data);
+  if (urpc_server->handlers != NULL)
+    free (urpc_server->handlers);
+  if (urpc_server->requests != NULL)
+    free (urpc_server->requests);
+  if (urpc_server->handlers_state != NULL)
+    {
+      for (i = 0; i < urpc_server->handlers_num; i++)
+        free (urpc_server->handlers_state[i].queue);
+      free (urpc_server->handlers_state);
+    }
+  if (urpc_server->free_contexts != NULL)
+    free (urpc_server->free_contexts);
+  if (urpc_server->cpus != NULL)
+    free (urpc_server->cpus);
+  if (urpc_server->stats != NULL)
+    free (urpc_server->stats);
+  if (urpc_server->dispatch != NULL)
+    free (urpc_server->dispatch);
   if (urpc_server->procs != NULL)
-    urpc_hash_table_destroy (urpc_server->procs);
+    free (urpc_server->procs);
   if (urpc_server->sessions != NULL)
-    urpc_hash_table_destroy (urpc_server->sessions);
-  if (urpc_server->sessions_chunks != NULL)
-    urpc_mem_chunk_destroy (urpc_server->sessions_chunks);
+    free (urpc_server->sessions);
+  if (urpc_server->free_sessions != NULL)
+    free (urpc_server->free_sessions);
+  if (urpc_server->wheel != NULL)
+    free (urpc_server->wheel);
   if (urpc_server->uri != NULL)
     free (urpc_server->uri);
 
   urpc_mutex_clear (&urpc_server->lock);
-  urpc_rwmutex_clear (&urpc_server->sessions_lock);
+  urpc_mutex_clear (&urpc_server->sessions_lock);
+  urpc_mutex_clear (&urpc_server->stats_lock);
 
   free (urpc_server);
 }
@@ -660,19 +1433,156 @@ urpc_server_add_callback (uRpcServer *urpc_server,
                           uint32_t    proc_id,
                           urpc_proc   func,
                           void       *data)
+{
+  uint32_t i;
+
+  if (urpc_server->urpc_server_type != URPC_SERVER_TYPE)
+    return -1;
+  if (urpc_server->transport != NULL)
+    return -1;
+  if (func == NULL)
+    return -1;
+
+  for (i = 0; i < urpc_server->procs_num; i++)
+    if (urpc_server->procs[i].proc_id == proc_id)
+      return -1;
+
+  if (urpc_server->procs_num == urpc_server->procs_size)
+    {
+      uint32_t procs_size = (urpc_server->procs_size > 0) ? 2 * urpc_server->procs_size : 16;
+      uRpcServerProc *procs = realloc (urpc_server->procs, procs_size * sizeof (uRpcServerProc));
+
+      if (procs == NULL)
+        return -1;
+
+      urpc_server->procs = procs;
+      urpc_server->procs_size = procs_size;
+    }
+
+  urpc_server->procs[urpc_server->procs_num].proc_id = proc_id;
+  urpc_server->procs[urpc_server->procs_num].proc = func;
+  urpc_server->procs[urpc_server->procs_num].data = data;
+  urpc_server->procs_num += 1;
+
+  return 0;
+}
+
+int
+urpc_server_set_busy_poll (uRpcServer *urpc_server,
+                           double      busy_poll)
+{
+  if (urpc_server->urpc_server_type != URPC_SERVER_TYPE)
+    return -1;
+  if (urpc_server->transport != NULL)
+    return -1;
+  if (busy_poll < 0.0)
+    return -1;
+
+  urpc_server->busy_poll = busy_poll;
+
+  return 0;
+}
+
+int
+urpc_server_set_cpu_affinity (uRpcServer     *urpc_server,
+                              const uint32_t *cpus,
+                              uint32_t        cpus_num)
+{
+  uint32_t *new_cpus = NULL;
+
+  if (urpc_server->urpc_server_type != URPC_SERVER_TYPE)
+    return -1;
+  if (urpc_server->transport != NULL)
+    return -1;
+
+  if (cpus_num > urpc_server->threads_num)
+    cpus_num = urpc_server->threads_num;
+
+  if (cpus_num > 0)
+    {
+      new_cpus = malloc (cpus_num * sizeof (uint32_t));
+      if (new_cpus == NULL)
+        return -1;
+      memcpy (new_cpus, cpus, cpus_num * sizeof (uint32_t));
+    }
+
+  if (urpc_server->cpus != NULL)
+    free (urpc_server->cpus);
+  urpc_server->cpus = new_cpus;
+  urpc_server->cpus_num = cpus_num;
+
+  return 0;
+}
+
+int
+urpc_server_set_udp_batch (uRpcServer *urpc_server,
+                           uint32_t    batch_size)
+{
+  if (urpc_server->urpc_server_type != URPC_SERVER_TYPE)
+    return -1;
+  if (urpc_server->transport != NULL)
+    return -1;
+  if (batch_size < 1 || batch_size > URPC_MAX_UDP_BATCH_SIZE)
+    return -1;
+
+  urpc_server->udp_batch = batch_size;
+
+  return 0;
+}
+
+int
+urpc_server_set_udp_reuse_port (uRpcServer *urpc_server,
+                                int         reuse_port)
+{
+  if (urpc_server->urpc_server_type != URPC_SERVER_TYPE)
+    return -1;
+  if (urpc_server->transport != NULL)
+    return -1;
+
+  urpc_server->udp_reuse_port = reuse_port ? 1 : 0;
+
+  return 0;
+}
+
+int
+urpc_server_set_io_uring (uRpcServer *urpc_server,
+                          int         use_uring)
 {
   if (urpc_server->urpc_server_type != URPC_SERVER_TYPE)
     return -1;
   if (urpc_server->transport != NULL)
     return -1;
 
-  if (urpc_hash_table_find (urpc_server->procs, proc_id) != NULL)
+  urpc_server->use_uring = use_uring ? 1 : 0;
+
+  return 0;
+}
+
+int
+urpc_server_set_handlers (uRpcServer *urpc_server,
+                          uint32_t    handlers_num)
+{
+  if (urpc_server->urpc_server_type != URPC_SERVER_TYPE)
     return -1;
-  if (urpc_hash_table_insert (urpc_server->procs, proc_id, func) != 0)
+  if (urpc_server->transport != NULL)
+    return -1;
+
+  urpc_server->handlers_num = handlers_num;
+
+  return 0;
+}
+
+int
+urpc_server_set_deferred (uRpcServer *urpc_server,
+                          uint32_t    deferred_num)
+{
+  if (urpc_server->urpc_server_type != URPC_SERVER_TYPE)
     return -1;
-  if (urpc_hash_table_insert (urpc_server->procs_data, proc_id, data) != 0)
+  if (urpc_server->transport != NULL)
     return -1;
 
+  urpc_server->deferred_num = deferred_num;
+
   return 0;
 }
 
@@ -685,23 +1595,100 @@ urpc_server_bind (uRpcServer *urpc_server)
   if (urpc_server->urpc_server_type != URPC_SERVER_TYPE)
     return -1;
 
+  /* С обработчиками или отложенными ответами контексты не закреплены за потоками: каждый
+     поток ввода-вывода принимает запрос в своём контексте, а остальные контексты хранят
+     запросы в очереди, у обработчиков и в отложенных ответах. Число контекстов ограничено
+     транспортами, для SHM - числом слотов запросов. */
+  if (urpc_server->handlers_num > 0 || urpc_server->deferred_num > 0)
+    {
+      urpc_server->contexts_num = urpc_server->threads_num + 2 * urpc_server->handlers_num;
+      if (urpc_server->contexts_num > URPC_MAX_THREADS_NUM)
+        urpc_server->contexts_num = URPC_MAX_THREADS_NUM;
+      if (urpc_server->deferred_num > URPC_MAX_CONTEXTS_NUM - urpc_server->contexts_num)
+        urpc_server->contexts_num = URPC_MAX_CONTEXTS_NUM;
+      else
+        urpc_server->contexts_num += urpc_server->deferred_num;
+      if (urpc_server->type == URPC_SHM && urpc_server->contexts_num > URPC_MAX_SHM_SLOTS_NUM)
+        urpc_server->contexts_num = URPC_MAX_SHM_SLOTS_NUM;
+    }
+  else
+    {
+      urpc_server->contexts_num = urpc_server->threads_num;
+    }
+
+  urpc_server->requests = calloc (urpc_server->contexts_num, sizeof (uRpcServerRequest));
+  if (urpc_server->requests == NULL)
+    return -1;
+
+  for (i = 0; i < urpc_server->contexts_num; i++)
+    {
+      urpc_server->requests[i].reply.urpc_server = urpc_server;
+      urpc_server->requests[i].reply.context = i;
+    }
+
+  if (urpc_server->handlers_num > 0 || urpc_server->deferred_num > 0)
+    {
+      urpc_server->free_contexts = malloc (urpc_shm_queue_get_size (urpc_server->contexts_num));
+      if (urpc_server->free_contexts == NULL)
+        return -1;
+
+      urpc_shm_queue_init (urpc_server->free_contexts, urpc_server->contexts_num);
+      for (i = 0; i < urpc_server->contexts_num; i++)
+        urpc_shm_queue_push (urpc_server->free_contexts, i);
+    }
+
+  if (urpc_server->handlers_num > 0)
+    {
+      urpc_server->handlers = calloc (urpc_server->handlers_num, sizeof (uRpcThread *));
+      urpc_server->handlers_state = calloc (urpc_server->handlers_num, sizeof (uRpcServerHandler));
+      if (urpc_server->handlers == NULL ||
+          urpc_server->handlers_state == NULL)
+        return -1;
+
+      /* Каждая очередь вмещает все контексты. */
+      for (i = 0; i < urpc_server->handlers_num; i++)
+        {
+          urpc_server->handlers_state[i].queue = malloc (urpc_shm_queue_get_size (urpc_server->contexts_num));
+          if (urpc_server->handlers_state[i].queue == NULL)
+            return -1;
+          urpc_shm_queue_init (urpc_server->handlers_state[i].queue, urpc_server->contexts_num);
+          urpc_server->handlers_state[i].spin = URPC_DOORBELL_MAX_SPIN;
+        }
+    }
+
+  /* После запуска сервера набор процедур не изменяется. */
+  if (urpc_server_build_dispatch (urpc_server) != 0)
+    return -1;
+
   /* Создаём транспортный объект. */
   switch (urpc_server->type)
     {
     case URPC_UDP:
+      /* С обработчиками и отложенными ответами контекстов больше, чем потоков ввода-вывода,
+         и запросы в сокете свободного контекста ожидали бы, пока поток не дойдёт до него.
+         Поэтому все контексты используют общий сокет. Контекст, переданный обработчику,
+         возвращается в очередь свободных контекстов, и остальные запросы его пакета ожидали
+         бы повторного выбора этого контекста, поэтому с обработчиками запросы принимаются
+         по одному. То же относится к контексту с отложенным ответом, который занят до
+         завершения ответа. */
       urpc_server->transport =
-        urpc_udp_server_create (urpc_server->uri, urpc_server->threads_num, urpc_server->data_timeout);
+        urpc_udp_server_create (urpc_server->uri, urpc_server->contexts_num,
+                                urpc_server->free_contexts != NULL ? 1 : urpc_server->udp_batch,
+                                urpc_server->udp_reuse_port && urpc_server->free_contexts == NULL,
+                                urpc_server->use_uring, urpc_server->data_timeout);
       break;
 
     case URPC_TCP:
       urpc_server->transport =
-        urpc_tcp_server_create (urpc_server->uri, urpc_server->threads_num, urpc_server->max_clients,
-                                urpc_server->max_data_size, urpc_server->data_timeout);
+        urpc_tcp_server_create (urpc_server->uri, urpc_server->contexts_num, urpc_server->max_clients,
+                                urpc_server->max_data_size, urpc_server->use_uring,
+                                urpc_server->data_timeout);
       break;
 
     case URPC_SHM:
       urpc_server->transport =
-        urpc_shm_server_create (urpc_server->uri, urpc_server->threads_num, urpc_server->max_data_size);
+        urpc_shm_server_create (urpc_server->uri, urpc_server->contexts_num, urpc_server->max_clients,
+                                urpc_server->max_data_size);
       break;
 
     default:
@@ -711,15 +1698,43 @@ urpc_server_bind (uRpcServer *urpc_server)
   if (urpc_server->transport == NULL)
     return -1;
 
+  if (urpc_server->type == URPC_SHM)
+    urpc_shm_server_set_busy_poll (urpc_server->transport, urpc_server->busy_poll);
+
+  /* Запросы к закреплённым потокам направляются в их сокеты. Если система
+     этого не поддерживает, запросы распределяются без учёта процессоров. С
+     обработчиками и отложенными ответами используется общий сокет. */
+  if (urpc_server->type == URPC_UDP && urpc_server->udp_reuse_port && urpc_server->cpus_num > 0 &&
+      urpc_server->free_contexts == NULL)
+    urpc_udp_server_set_steering (urpc_server->transport, urpc_server->cpus, urpc_server->cpus_num);
+
   /* Запускаем потоки обработки запросов. */
   for (i = 0; i < urpc_server->threads_num; i++)
     {
-      urpc_server->servers[i] = urpc_thread_create (urpc_server_func, urpc_server);
+      urpc_server->servers[i] = urpc_thread_create (urpc_server->free_contexts != NULL ? urpc_server_io_func :
+                                                    urpc_server_func, urpc_server);
       if (urpc_server->servers[i] == NULL)
         {
           urpc_server->shutdown = 1;
           return -1;
         }
+
+      if (i < urpc_server->cpus_num &&
+          urpc_thread_set_affinity (urpc_server->servers[i], urpc_server->cpus[i]) != 0)
+        {
+          urpc_server->shutdown = 1;
+          return -1;
+        }
+    }
+
+  for (i = 0; i < urpc_server->handlers_num; i++)
+    {
+      urpc_server->handlers[i] = urpc_thread_create (urpc_server_handler_func, urpc_server);
+      if (urpc_server->handlers[i] == NULL)
+        {
+          urpc_server->shutdown = 1;
+          return -1;
+        }
     }
 
   /* Ожидаем начала работы всех потоков транспортных объектов. */
@@ -730,7 +1745,7 @@ urpc_server_bind (uRpcServer *urpc_server)
       urpc_mutex_unlock (&urpc_server->lock);
       urpc_timer_sleep (0.1);
     }
-  while (started_servers != urpc_server->threads_num);
+  while (started_servers != urpc_server->threads_num + urpc_server->handlers_num);
 
   /* Запуск потока проверки сессий. */
   urpc_server->session_check = urpc_thread_create (urpc_server_session_timeout_check, urpc_server);
@@ -748,7 +1763,131 @@ urpc_server_bind (uRpcServer *urpc_server)
       urpc_mutex_unlock (&urpc_server->lock);
       urpc_timer_sleep (0.1);
     }
-  while (started_servers != urpc_server->threads_num + 1);
+  while (started_servers != urpc_server->threads_num + urpc_server->handlers_num + 1);
+
+  return 0;
+}
+
+uRpcServerReply *
+urpc_server_defer (uRpcData *urpc_data)
+{
+  uRpcServerRequest *request;
+
+  /* Ответ откладывается только из выполняемой процедуры, на время её выполнения
+     объект RPC данных связан с запросом. */
+  request = urpc_data_get_owner (urpc_data);
+  if (request == NULL || request->urpc_data != urpc_data)
+    return NULL;
+  if (request->reply.urpc_server->deferred_num == 0)
+    return NULL;
+  if (request->deferred != URPC_REPLY_NONE)
+    return NULL;
+
+  request->deferred = URPC_REPLY_DEFERRED;
+  URPC_ATOMIC_INC (&request->reply.urpc_server->deferred_active);
+
+  return &request->reply;
+}
+
+int
+urpc_server_complete (uRpcServerReply *reply,
+                      int              status)
+{
+  uRpcServer *urpc_server;
+  uRpcServerRequest *request;
+  uint32_t deferred;
+
+  if (reply == NULL)
+    return -1;
+
+  urpc_server = reply->urpc_server;
+  if (urpc_server->urpc_server_type != URPC_SERVER_TYPE)
+    return -1;
+
+  request = &urpc_server->requests[reply->context];
+  deferred = URPC_ATOMIC_LOAD (&request->deferred);
+  if (deferred != URPC_REPLY_DEFERRED && deferred != URPC_REPLY_DETACHED)
+    return -1;
+
+  /* Ошибка при выполнении процедуры, отключаем клиента. */
+  if (status == 0)
+    request->status = URPC_STATUS_OK;
+  else
+    request->disconnect = URPC_TRUE;
+  request->proc_stop = urpc_timer_get_monotonic_time ();
+
+  /* Процедура ещё выполняется - ответ отправит вызвавший её поток. */
+  if (URPC_ATOMIC_CAS (&request->deferred, URPC_REPLY_DEFERRED, URPC_REPLY_COMPLETED))
+    {
+      URPC_ATOMIC_DEC (&urpc_server->deferred_active);
+      return 0;
+    }
+
+  urpc_server_send_reply (urpc_server, reply->context, urpc_server->stats_num - 1);
+  request->deferred = URPC_REPLY_NONE;
+
+  /* Возвращаем контекст потокам ввода-вывода. */
+  urpc_shm_queue_push (urpc_server->free_contexts, reply->context);
+  urpc_doorbell_ring (&urpc_server->context_bell);
+
+  /* После этого сервер может быть удалён. */
+  URPC_ATOMIC_DEC (&urpc_server->deferred_active);
+
+  return 0;
+}
+
+int
+urpc_server_get_stats (uRpcServer          *urpc_server,
+                       uRpcServerProcStats *stats,
+                       uint32_t             stats_num)
+{
+  uRpcServerProcStats *thread_stats;
+  uint32_t i, j;
+
+  if (urpc_server->urpc_server_type != URPC_SERVER_TYPE)
+    return -1;
+  if (urpc_server->stats == NULL)
+    return -1;
+
+  if (stats_num > urpc_server->procs_num)
+    stats_num = urpc_server->procs_num;
+
+  for (i = 0; i < stats_num; i++)
+    {
+      memset (&stats[i], 0, sizeof (uRpcServerProcStats));
+      stats[i].proc_id = urpc_server->procs[i].proc_id;
+
+      for (j = 0; j < urpc_server->stats_num; j++)
+        {
+          thread_stats = &urpc_server->stats[j * urpc_server->procs_num + i];
+
+          stats[i].calls += thread_stats->calls;
+          stats[i].errors += thread_stats->errors;
+          stats[i].bytes_in += thread_stats->bytes_in;
+          stats[i].bytes_out += thread_stats->bytes_out;
+          urpc_histogram_merge (&stats[i].dispatch_time, &thread_stats->dispatch_time);
+          urpc_histogram_merge (&stats[i].proc_time, &thread_stats->proc_time);
+          urpc_histogram_merge (&stats[i].send_time, &thread_stats->send_time);
+        }
+    }
+
+  return urpc_server->procs_num;
+}
+
+int
+urpc_server_get_session_stats (uRpcServer             *urpc_server,
+                               uRpcServerSessionStats *stats)
+{
+  if (urpc_server->urpc_server_type != URPC_SERVER_TYPE)
+    return -1;
+
+  urpc_mutex_lock (&urpc_server->sessions_lock);
+  stats->slots = urpc_server->sessions_num;
+  stats->active = urpc_server->sessions_num - urpc_server->free_sessions_num;
+  stats->peak = urpc_server->peak_sessions;
+  urpc_mutex_unlock (&urpc_server->sessions_lock);
+
+  stats->memory = (uint64_t) urpc_server->sessions_num * (sizeof (uRpcServerSession) + sizeof (uint32_t));
 
   return 0;
 }
@@ -52,7 +52,14 @@
  * - #urpc_server_add_thread_stop_callback - добавление callback функции вызываемой при остановке потока обработки;
  * - #urpc_server_add_connect_callback - добавление callback функции вызываемой при подключении клиента;
  * - #urpc_server_add_disconnect_callback - добавление callback функции вызываемой при отключении клиента;
- * - #urpc_server_add_callback - добаление callback функции исполняемой процедуры.
+ * - #urpc_server_add_callback - добаление callback функции исполняемой процедуры;
+ * - #urpc_server_set_busy_poll - задание времени активного ожидания запросов рабочими потоками;
+ * - #urpc_server_set_cpu_affinity - закрепление рабочих потоков за процессорами;
+ * - #urpc_server_set_udp_batch - задание числа UDP запросов принимаемых за один системный вызов;
+ * - #urpc_server_set_udp_reuse_port - использование отдельного UDP сокета в каждом рабочем потоке;
+ * - #urpc_server_set_io_uring - использование io_uring для обмена данными в Linux;
+ * - #urpc_server_set_handlers - вызов процедур отдельными от приёма запросов потоками;
+ * - #urpc_server_set_deferred - задание числа запросов с отложенными ответами.
  *
  * Подробнее механизмы безопасности описаны в разделе \link uRpcSecurity \endlink.
  *
@@ -73,6 +80,15 @@
  * PROC_ID2, то при RPC запросе #urpc_client_exec ( rpc, PROC_ID1 ) на сервере выполнится процедура proc1.
  * А при RPC запросе #urpc_client_exec ( rpc, PROC_ID2 ) на сервере выполнится функция proc2.
  *
+ * Процедура может не отвечать на запрос сразу: функция #urpc_server_defer откладывает ответ
+ * и освобождает поток, а ответ отправляется функцией #urpc_server_complete из любого потока,
+ * например после завершения асинхронной операции.
+ *
+ * Для каждой зарегистрированной процедуры сервер собирает статистику: число вызовов и ошибок,
+ * объём принятых и отправленных данных и гистограммы времени этапов обработки запроса.
+ * Статистика возвращается функцией #urpc_server_get_stats. Подключенный клиент может
+ * запросить её функцией #urpc_client_get_server_stats.
+ *
  * Удаление сервера производится функцией #urpc_server_destroy.
  *
  */
@@ -83,12 +99,14 @@
 #include <urpc-exports.h>
 #include <urpc-types.h>
 #include <urpc-data.h>
+#include <urpc-stats.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 typedef struct _uRpcServer uRpcServer;
+typedef struct _uRpcServerReply uRpcServerReply;
 
 /**
  *
@@ -175,6 +193,10 @@ typedef int (*urpc_proc)                       (uRpcData              *urpc_data
  * Для IP версии 6 ip адрес должен быть задан в прямых скобках [], например [::1/128].
  * Для shm номер порта может быть любым или отсутствовать.
  *
+ * Для shm параметр max_clients также определяет число запросов, которые клиенты могут
+ * одновременно поставить в очередь сервера (но не более URPC_MAX_SHM_SLOTS_NUM). Для каждого
+ * такого запроса в разделяемой памяти выделяется пара буферов размером max_data_size.
+ *
  * \param uri адрес сервера;
  * \param threads_num число потоков исполнения на сервере;
  * \param max_clients максимальное число клиентов подключенных к серверу;
@@ -195,7 +217,10 @@ uRpcServer *urpc_server_create                 (const char            *uri,
 
 /**
  *
- * Функция завершает потоки исполнения и удаляет RPC сервер.
+ * Функция завершает потоки исполнения и удаляет RPC сервер. Если процедуры отложили
+ * ответы (#urpc_server_defer), функция ожидает их завершения функцией
+ * #urpc_server_complete, поэтому потоки, завершающие ответы, должны работать до
+ * возврата из функции.
  *
  * \param urpc_server указатель на uRpcServer объект.
  *
@@ -328,6 +353,9 @@ int urpc_server_add_disconnect_callback        (uRpcServer            *urpc_serv
  * \link uRpcData \endlink. Результат работы должен быть передан обратно
  * регистрацией переменных через объект \link uRpcData \endlink.
  *
+ * Функции регистрируются до запуска сервера функцией #urpc_server_bind. При запуске
+ * из зарегистрированных функций создаётся неизменяемая таблица вызова.
+ *
  * \param urpc_server указатель на uRpcServer объект;
  * \param proc_id идентификатор callback функции;
  * \param proc callback функция;
@@ -342,6 +370,174 @@ int urpc_server_add_callback                   (uRpcServer            *urpc_serv
                                                 urpc_proc              proc,
                                                 void                  *data);
 
+/**
+ *
+ * Функция задаёт время, в течение которого рабочий поток активно опрашивает буфер
+ * запроса, прежде чем заснуть в ожидании. Активный опрос сокращает задержку обработки
+ * запроса, но полностью занимает процессор, поэтому его имеет смысл использовать совместно
+ * с #urpc_server_set_cpu_affinity, выделив рабочим потокам отдельные процессоры.
+ *
+ * Активный опрос поддерживается только для транспорта SHM. По умолчанию отключен.
+ *
+ * \param urpc_server указатель на uRpcServer объект;
+ * \param busy_poll время активного опроса, с, 0 - отключить.
+ *
+ * \return 0 если время успешно задано, отрицательное число в случае ошибки.
+ *
+ */
+URPC_EXPORT
+int urpc_server_set_busy_poll                  (uRpcServer            *urpc_server,
+                                                double                 busy_poll);
+
+/**
+ *
+ * Функция закрепляет рабочие потоки сервера за процессорами. Поток с номером i
+ * выполняется на процессоре cpus[i]. Если cpus_num меньше числа рабочих потоков,
+ * остальные потоки не закрепляются. Если закрепить поток не удалось, функция
+ * #urpc_server_bind завершается с ошибкой.
+ *
+ * \param urpc_server указатель на uRpcServer объект;
+ * \param cpus массив номеров процессоров;
+ * \param cpus_num число элементов массива cpus, 0 - отменить закрепление.
+ *
+ * \return 0 если параметры успешно заданы, отрицательное число в случае ошибки.
+ *
+ */
+URPC_EXPORT
+int urpc_server_set_cpu_affinity               (uRpcServer            *urpc_server,
+                                                const uint32_t        *cpus,
+                                                uint32_t               cpus_num);
+
+/**
+ *
+ * Функция задаёт максимальное число UDP запросов, которые рабочий поток принимает
+ * за один системный вызов. Ответы на принятые запросы также отправляются одним
+ * системным вызовом после обработки последнего из них. Пакетная обработка сокращает
+ * число системных вызовов при большом потоке коротких запросов.
+ *
+ * Для каждого запроса в пакете выделяется отдельный буфер приёма-передачи размером
+ * около 128 Кб. Пакетная обработка поддерживается только для транспорта UDP в Linux,
+ * число запросов ограничено значением URPC_MAX_UDP_BATCH_SIZE. По умолчанию запросы
+ * принимаются по одному. Если запросы выполняются потоками обработчиков
+ * (#urpc_server_set_handlers) или ответы могут откладываться (#urpc_server_set_deferred),
+ * запросы также принимаются по одному.
+ *
+ * \param urpc_server указатель на uRpcServer объект;
+ * \param batch_size число запросов, 1 - принимать запросы по одному.
+ *
+ * \return 0 если число запросов успешно задано, отрицательное число в случае ошибки.
+ *
+ */
+URPC_EXPORT
+int urpc_server_set_udp_batch                  (uRpcServer            *urpc_server,
+                                                uint32_t               batch_size);
+
+/**
+ *
+ * Функция включает режим, в котором каждый рабочий поток UDP сервера принимает
+ * запросы через свой сокет. Все сокеты привязываются к адресу сервера с параметром
+ * SO_REUSEPORT, а запросы между ними распределяет система по адресам клиентов.
+ * Потоки не конкурируют за общую очередь приёма и не просыпаются впустую.
+ *
+ * Если рабочие потоки закреплены за процессорами функцией #urpc_server_set_cpu_affinity,
+ * в Linux запросы, принятые системой на процессоре потока, дополнительно направляются
+ * в сокет этого потока.
+ *
+ * Если система не поддерживает SO_REUSEPORT, функция #urpc_server_bind завершается
+ * с ошибкой. По умолчанию все потоки используют один общий сокет.
+ *
+ * \param urpc_server указатель на uRpcServer объект;
+ * \param reuse_port 1 - отдельный сокет для каждого потока, 0 - общий сокет.
+ *
+ * \return 0 если режим успешно задан, отрицательное число в случае ошибки.
+ *
+ */
+URPC_EXPORT
+int urpc_server_set_udp_reuse_port             (uRpcServer            *urpc_server,
+                                                int                    reuse_port);
+
+/**
+ *
+ * Функция разрешает или запрещает обмен данными через io_uring в Linux. Если
+ * ядро поддерживает io_uring, TCP сервер принимает и передаёт данные операциями
+ * io_uring без опроса готовности сокетов, а большие ответы передаёт из
+ * зарегистрированных буферов без копирования. UDP сервер в режиме
+ * #urpc_server_set_udp_reuse_port принимает запросы многократной операцией
+ * io_uring непосредственно в буферы RPC данных, а ответы передаёт ядру тем же
+ * системным вызовом, которым ожидает следующие запросы.
+ *
+ * Если io_uring не поддерживается или запрещён в системе, используются обычные
+ * системные вызовы. По умолчанию использование io_uring разрешено.
+ *
+ * \param urpc_server указатель на uRpcServer объект;
+ * \param use_uring 1 - использовать io_uring при наличии поддержки, 0 - не использовать.
+ *
+ * \return 0 если режим успешно задан, отрицательное число в случае ошибки.
+ *
+ */
+URPC_EXPORT
+int urpc_server_set_io_uring                   (uRpcServer            *urpc_server,
+                                                int                    use_uring);
+
+/**
+ *
+ * Функция разделяет приём запросов и вызов процедур между разными потоками. Рабочие
+ * потоки сервера (threads_num в #urpc_server_create) становятся потоками ввода-вывода:
+ * они принимают запросы и сразу выполняют системные процедуры (подключение, отключение,
+ * статистика). Запросы пользовательских процедур передаются потокам обработчиков, которые
+ * вызывают процедуру и отправляют ответ. Медленная процедура при этом не останавливает
+ * приём запросов, а число потоков ввода-вывода и обработчиков выбирается независимо.
+ *
+ * Каждый обработчик имеет локальную очередь без блокировок. Запрос помещается в очередь
+ * свободного обработчика, а если все заняты - в очереди обработчиков по кругу. Обработчик,
+ * у которого закончились запросы, забирает их из очередей других обработчиков, поэтому
+ * запросы не ждут завершения медленной процедуры при наличии свободных потоков.
+ *
+ * Число одновременно принятых запросов без учёта отложенных ответов (#urpc_server_set_deferred)
+ * ограничено \link URPC_MAX_THREADS_NUM \endlink.
+ * Функции запуска и остановки потока (#urpc_server_add_thread_start_callback) вызываются
+ * в потоках обработчиков. Закрепление потоков за процессорами относится к потокам
+ * ввода-вывода. UDP запросы в этом режиме принимаются через общий сокет, режим
+ * #urpc_server_set_udp_reuse_port и направление запросов по процессорам не используются.
+ *
+ * По умолчанию обработчиков нет и процедуры вызываются рабочими потоками.
+ *
+ * \param urpc_server указатель на uRpcServer объект;
+ * \param handlers_num число потоков обработчиков, 0 - процедуры вызываются рабочими потоками.
+ *
+ * \return 0 если число обработчиков успешно задано, отрицательное число в случае ошибки.
+ *
+ */
+URPC_EXPORT
+int urpc_server_set_handlers                   (uRpcServer            *urpc_server,
+                                                uint32_t               handlers_num);
+
+/**
+ *
+ * Функция разрешает процедурам откладывать ответы (#urpc_server_defer) и задаёт число
+ * запросов, которые могут одновременно ожидать отложенного ответа. Для каждого такого
+ * запроса сервер выделяет отдельные буферы приёма-передачи транспорта, поэтому рабочих
+ * потоков может быть немного, а ожидающих ответа запросов - тысячи. Для TCP это два
+ * буфера размером max_data_size на запрос, для SHM - пара буферов в разделяемой памяти.
+ *
+ * Рабочие потоки при этом берут свободные буферы из общего пула и, если процедура отложила
+ * ответ, продолжают приём запросов в других буферах. Если все буферы заняты, приём
+ * приостанавливается до завершения отложенных ответов. UDP запросы в этом режиме
+ * принимаются через общий сокет, как и с обработчиками (#urpc_server_set_handlers).
+ *
+ * Общее число запросов ограничено \link URPC_MAX_CONTEXTS_NUM \endlink, а для SHM -
+ * \link URPC_MAX_SHM_SLOTS_NUM \endlink. По умолчанию ответы не откладываются.
+ *
+ * \param urpc_server указатель на uRpcServer объект;
+ * \param deferred_num число запросов с отложенными ответами, 0 - ответы не откладываются.
+ *
+ * \return 0 если число запросов успешно задано, отрицательное число в случае ошибки.
+ *
+ */
+URPC_EXPORT
+int urpc_server_set_deferred                   (uRpcServer            *urpc_server,
+                                                uint32_t               deferred_num);
+
 /**
  *
  * Функция производит запуск сервера с использованием выбранного механизма
@@ -355,6 +551,77 @@ int urpc_server_add_callback                   (uRpcServer            *urpc_serv
 URPC_EXPORT
 int urpc_server_bind                           (uRpcServer            *urpc_server);
 
+/**
+ *
+ * Функция откладывает ответ на запрос. Вызывается из пользовательской процедуры с
+ * объектом \link uRpcData \endlink этого запроса. После возврата из процедуры поток
+ * продолжает обработку других запросов, а результат процедуры не учитывается. Данные
+ * запроса и ответа остаются доступными через тот же объект uRpcData до вызова
+ * #urpc_server_complete.
+ *
+ * Ответ можно отложить, только если сервер настроен функцией #urpc_server_set_deferred.
+ * Все отложенные ответы должны быть завершены, #urpc_server_destroy ожидает их завершения.
+ *
+ * \param urpc_data указатель на объект \link uRpcData \endlink выполняемого запроса.
+ *
+ * \return Указатель на отложенный ответ или NULL, если ответ не может быть отложен -
+ * в этом случае процедура должна ответить обычным образом.
+ *
+ */
+URPC_EXPORT
+uRpcServerReply *urpc_server_defer             (uRpcData              *urpc_data);
+
+/**
+ *
+ * Функция завершает отложенный ответ и отправляет его клиенту. Может вызываться из
+ * любого потока, в том числе до возврата из процедуры, отложившей ответ. Данные ответа
+ * должны быть записаны в объект \link uRpcData \endlink запроса до вызова функции.
+ * После вызова указатель на отложенный ответ становится недействительным.
+ *
+ * \param reply указатель на отложенный ответ (#urpc_server_defer);
+ * \param status 0 если запрос выполнен, иначе отрицательное число - клиент будет отключен.
+ *
+ * \return 0 если ответ отправлен, отрицательное число в случае ошибки.
+ *
+ */
+URPC_EXPORT
+int urpc_server_complete                       (uRpcServerReply       *reply,
+                                                int                    status);
+
+/**
+ *
+ * Функция возвращает статистику выполнения зарегистрированных процедур в порядке
+ * их регистрации. Статистика доступна после запуска сервера. Рабочие потоки собирают
+ * статистику независимо друг от друга, функция объединяет их данные. Значения,
+ * изменяемые во время вызова функции, могут быть учтены частично.
+ *
+ * \param urpc_server указатель на uRpcServer объект;
+ * \param stats массив для статистики процедур;
+ * \param stats_num число элементов массива.
+ *
+ * \return Число зарегистрированных процедур или отрицательное значение в случае ошибки.
+ *
+ */
+URPC_EXPORT
+int urpc_server_get_stats                      (uRpcServer            *urpc_server,
+                                                uRpcServerProcStats   *stats,
+                                                uint32_t               stats_num);
+
+/**
+ *
+ * Функция возвращает статистику слотов сессий сервера: их число, число активных
+ * сессий, наибольшее число одновременно активных сессий и занятую слотами память.
+ *
+ * \param urpc_server указатель на uRpcServer объект;
+ * \param stats указатель на структуру для статистики.
+ *
+ * \return 0 в случае успешного завершения, отрицательное значение в случае ошибки.
+ *
+ */
+URPC_EXPORT
+int urpc_server_get_session_stats              (uRpcServer            *urpc_server,
+                                                uRpcServerSessionStats *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -26,8 +26,10 @@
 #include "urpc-shm-client.h"
 #include "urpc-common.h"
 #include "urpc-shm.h"
-#include "urpc-semaphore.h"
+#include "urpc-shm-queue.h"
+#include "urpc-doorbell.h"
 #include "urpc-endian.h"
+#include "urpc-timer.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -38,27 +40,27 @@
 
 #define URPC_SHM_CLIENT_TYPE 0x434D4853
 
-typedef struct uRpcSHMTransport
-{
-  uRpcData            *urpc_data;              /* RPC данные. */
-
-  uRpcSem             *start;                  /* Семафор запуска функции на выполнение. */
-  uRpcSem             *stop;                   /* Семафор сигнализации завершения функции. */
-  uRpcSem             *used;                   /* Признак использования. */
-} uRpcSHMTransport;
-
 struct _uRpcSHMClient
 {
   uint32_t             urpc_shm_client_type;   /* Тип объекта uRpcSHMClient. */
 
   char                *uri;                    /* Адрес сервера/клиента. */
 
-  uRpcSem             *access;                 /* Семафор доступа к SHM серверу. */
   uRpcShm             *transport_shm;          /* Сегмент разделяемой области памяти RPC данных. */
+  char                *buffers;                /* Буферы RPC данных слотов. */
+  uint32_t             max_data_size;          /* Размер буфера RPC данных. */
+
+  uRpcSHMTransportHeader *header;              /* Заголовок транспортного сегмента. */
+  uRpcSHMQueue        *requests;               /* Очередь запросов. */
+  uRpcSHMQueue        *free_slots;             /* Очередь свободных слотов. */
+  uRpcSHMSlot         *slots;                  /* Сигнальные слова слотов. */
+  uRpcData           **urpc_data;              /* RPC данные слотов. */
+  uint32_t             slots_num;              /* Число слотов. */
+
+  uint32_t             slot;                   /* Выбранный слот. */
+  uint32_t             spin;                   /* Число итераций активного ожидания ответа. */
 
-  uRpcSHMTransport    *transport;              /* Выбранный буфер обмена с сервером. */
-  uRpcSHMTransport   **transports;             /* Сегменты обмена данными. */
-  uint32_t             threads_num;            /* Число рабочих потоков. */
+  double               wait_time;              /* Время ожидания ответа. */
 };
 
 uRpcSHMClient *
@@ -71,8 +73,8 @@ urpc_shm_client_create (const char *uri)
   char obj_name[MAX_HOST_LEN + 32];
   uRpcSHMControl *control = NULL;
   char *transport_shm;
-
-  uint32_t max_data_size;
+  size_t queue_size;
+  size_t transport_size;
 
   unsigned int i;
 
@@ -88,10 +90,12 @@ urpc_shm_client_create (const char *uri)
 
   urpc_shm_client->urpc_shm_client_type = URPC_SHM_CLIENT_TYPE;
   urpc_shm_client->uri = NULL;
-  urpc_shm_client->access = NULL;
   urpc_shm_client->transport_shm = NULL;
-  urpc_shm_client->transport = NULL;
-  urpc_shm_client->transports = NULL;
+  urpc_shm_client->urpc_data = NULL;
+  urpc_shm_client->slots_num = 0;
+  urpc_shm_client->slot = 0;
+  urpc_shm_client->spin = URPC_DOORBELL_MAX_SPIN;
+  urpc_shm_client->wait_time = 0.0;
 
   /* Считываем информацию о сервере. */
   snprintf (obj_name, sizeof (obj_name), "%s.control", uri);
@@ -101,67 +105,35 @@ urpc_shm_client_create (const char *uri)
   control = urpc_shm_map (control_shm);
   if (control == NULL)
     goto urpc_shm_client_create_fail;
-  urpc_shm_client->threads_num = control->threads_num;
-  max_data_size = control->size;
+  urpc_shm_client->slots_num = control->slots_num;
+  urpc_shm_client->max_data_size = control->size;
   urpc_shm_destroy (control_shm);
 
-  /* Открываем семафор доступа к SHM серверу. */
-  snprintf (obj_name, sizeof (obj_name), "%s.access", uri);
-  urpc_shm_client->access = urpc_sem_open (obj_name);
-  if (urpc_shm_client->access == NULL)
-    goto urpc_shm_client_create_fail;
-
-  /* Подключаемся к транспортному сегменту shared memory сервера.
-     Для клиента входящий и исходящий буферы меняем местами. */
+  /* Подключаемся к транспортному сегменту shared memory сервера. */
   snprintf (obj_name, sizeof (obj_name), "%s.transport", uri);
-  urpc_shm_client->transport_shm = urpc_shm_open (obj_name, 2 * max_data_size * urpc_shm_client->threads_num);
+  queue_size = URPC_SHM_ALIGN (urpc_shm_queue_get_size (urpc_shm_client->slots_num));
+  transport_size = sizeof (uRpcSHMTransportHeader) + 2 * queue_size +
+                   urpc_shm_client->slots_num * sizeof (uRpcSHMSlot);
+  urpc_shm_client->transport_shm = urpc_shm_open (obj_name, transport_size +
+                                                  2 * urpc_shm_client->max_data_size * urpc_shm_client->slots_num);
   if (urpc_shm_client->transport_shm == NULL)
     goto urpc_shm_client_create_fail;
   transport_shm = urpc_shm_map (urpc_shm_client->transport_shm);
   if (transport_shm == NULL)
     goto urpc_shm_client_create_fail;
 
-  urpc_shm_client->transports = malloc (urpc_shm_client->threads_num * sizeof (uRpcData *));
-  if (urpc_shm_client->transports == NULL)
-    goto urpc_shm_client_create_fail;
-  for (i = 0; i < urpc_shm_client->threads_num; i++)
-    urpc_shm_client->transports[i] = NULL;
+  urpc_shm_client->header = (uRpcSHMTransportHeader*)transport_shm;
+  urpc_shm_client->requests = (uRpcSHMQueue*)(transport_shm + sizeof (uRpcSHMTransportHeader));
+  urpc_shm_client->free_slots = (uRpcSHMQueue*)((char*)urpc_shm_client->requests + queue_size);
+  urpc_shm_client->slots = (uRpcSHMSlot*)((char*)urpc_shm_client->free_slots + queue_size);
+  urpc_shm_client->buffers = transport_shm + transport_size;
 
-  for (i = 0; i < urpc_shm_client->threads_num; i++)
-    {
-      urpc_shm_client->transports[i] = malloc (sizeof (uRpcSHMTransport));
-      if (urpc_shm_client->transports[i] == NULL)
-        goto urpc_shm_client_create_fail;
-      urpc_shm_client->transports[i]->urpc_data = NULL;
-      urpc_shm_client->transports[i]->start = NULL;
-      urpc_shm_client->transports[i]->stop = NULL;
-      urpc_shm_client->transports[i]->used = NULL;
-    }
-
-  for (i = 0; i < urpc_shm_client->threads_num; i++)
-    {
-      char *obuffer = transport_shm + i * 2 * max_data_size;
-      char *ibuffer = obuffer + max_data_size;
-      urpc_shm_client->transports[i]->urpc_data =
-        urpc_data_create (max_data_size, sizeof (uRpcHeader), ibuffer, obuffer, 0);
-      if (urpc_shm_client->transports[i]->urpc_data == NULL)
-        goto urpc_shm_client_create_fail;
-
-      snprintf (obj_name, sizeof (obj_name), "%s.transport.%u.start", uri, i);
-      urpc_shm_client->transports[i]->start = urpc_sem_open (obj_name);
-      if (urpc_shm_client->transports[i]->start == NULL)
-        goto urpc_shm_client_create_fail;
-
-      snprintf (obj_name, sizeof (obj_name), "%s.transport.%u.stop", uri, i);
-      urpc_shm_client->transports[i]->stop = urpc_sem_open (obj_name);
-      if (urpc_shm_client->transports[i]->stop == NULL)
-        goto urpc_shm_client_create_fail;
-
-      snprintf (obj_name, sizeof (obj_name), "%s.transport.%u.used", uri, i);
-      urpc_shm_client->transports[i]->used = urpc_sem_open (obj_name);
-      if (urpc_shm_client->transports[i]->used == NULL)
-        goto urpc_shm_client_create_fail;
-    }
+  /* RPC данные слотов создаются при первом использовании слота. */
+  urpc_shm_client->urpc_data = malloc (urpc_shm_client->slots_num * sizeof (uRpcData *));
+  if (urpc_shm_client->urpc_data == NULL)
+    goto urpc_shm_client_create_fail;
+  for (i = 0; i < urpc_shm_client->slots_num; i++)
+    urpc_shm_client->urpc_data[i] = NULL;
 
   /* Адрес сервера/клиента. */
   urpc_shm_client->uri = malloc (MAX_HOST_LEN);
@@ -186,29 +158,16 @@ urpc_shm_client_destroy (uRpcSHMClient *urpc_shm_client)
   if (urpc_shm_client->urpc_shm_client_type != URPC_SHM_CLIENT_TYPE)
     return;
 
-  if (urpc_shm_client->transports != NULL)
+  if (urpc_shm_client->urpc_data != NULL)
     {
-      for (i = 0; i < urpc_shm_client->threads_num; i++)
-        {
-          if (urpc_shm_client->transports[i] == NULL)
-            continue;
-          if (urpc_shm_client->transports[i]->urpc_data != NULL)
-            urpc_data_destroy (urpc_shm_client->transports[i]->urpc_data);
-          if (urpc_shm_client->transports[i]->start != NULL)
-            urpc_sem_destroy (urpc_shm_client->transports[i]->start);
-          if (urpc_shm_client->transports[i]->stop != NULL)
-            urpc_sem_destroy (urpc_shm_client->transports[i]->stop);
-          if (urpc_shm_client->transports[i]->used != NULL)
-            urpc_sem_destroy (urpc_shm_client->transports[i]->used);
-          free (urpc_shm_client->transports[i]);
-        }
-      free (urpc_shm_client->transports);
+      for (i = 0; i < urpc_shm_client->slots_num; i++)
+        if (urpc_shm_client->urpc_data[i] != NULL)
+          urpc_data_destroy (urpc_shm_client->urpc_data[i]);
+      free (urpc_shm_client->urpc_data);
     }
 
   if (urpc_shm_client->transport_shm != NULL)
     urpc_shm_destroy (urpc_shm_client->transport_shm);
-  if (urpc_shm_client->access != NULL)
-    urpc_sem_destroy (urpc_shm_client->access);
 
   if (urpc_shm_client->uri != NULL)
     free (urpc_shm_client->uri);
@@ -219,50 +178,69 @@ urpc_shm_client_destroy (uRpcSHMClient *urpc_shm_client)
 uRpcData *
 urpc_shm_client_lock (uRpcSHMClient *urpc_shm_client)
 {
-  unsigned int i;
+  uint32_t slot;
 
   if (urpc_shm_client->urpc_shm_client_type != URPC_SHM_CLIENT_TYPE)
     return NULL;
 
-  /* Блокируем доступ к серверу. */
-  urpc_sem_lock (urpc_shm_client->access);
-
-  /* Ищем свободный буфер обмена с сервером. */
-  for (i = 0; i < urpc_shm_client->threads_num; i++)
-    if (urpc_sem_trylock (urpc_shm_client->transports[i]->used) == 0)
-      break;
+  /* Берём свободный слот. Если все слоты заняты другими клиентами, ждём сигнала
+     об освобождении одного из них. Сигнал могут ожидать несколько клиентов,
+     поэтому время ожидания ограничено. */
+  while (urpc_shm_queue_pop (urpc_shm_client->free_slots, &slot) != 0)
+    urpc_doorbell_wait (&urpc_shm_client->header->released, NULL, 0.001);
 
-  /* Нет свободных буферов !!?? */
-  if (i == urpc_shm_client->threads_num)
+  if (slot >= urpc_shm_client->slots_num)
     return NULL;
 
-  urpc_shm_client->transport = urpc_shm_client->transports[i];
+  /* Для клиента входящий и исходящий буферы меняем местами. */
+  if (urpc_shm_client->urpc_data[slot] == NULL)
+    {
+      char *obuffer = urpc_shm_client->buffers + slot * 2 * urpc_shm_client->max_data_size;
+      char *ibuffer = obuffer + urpc_shm_client->max_data_size;
+
+      urpc_shm_client->urpc_data[slot] =
+        urpc_data_create (urpc_shm_client->max_data_size, sizeof (uRpcHeader), ibuffer, obuffer, 0);
+      if (urpc_shm_client->urpc_data[slot] == NULL)
+        {
+          urpc_shm_queue_push (urpc_shm_client->free_slots, slot);
+          urpc_doorbell_ring (&urpc_shm_client->header->released);
+          return NULL;
+        }
+    }
+
+  urpc_shm_client->slot = slot;
 
-  return urpc_shm_client->transport->urpc_data;
+  return urpc_shm_client->urpc_data[slot];
 }
 
 uint32_t
 urpc_shm_client_exchange (uRpcSHMClient *urpc_shm_client)
 {
+  uRpcData *urpc_data;
   uRpcHeader *iheader;
+  double wait_start;
 
   if (urpc_shm_client->urpc_shm_client_type != URPC_SHM_CLIENT_TYPE)
     return URPC_STATUS_FAIL;
 
-  iheader = urpc_data_get_header (urpc_shm_client->transport->urpc_data, URPC_DATA_INPUT);
+  urpc_data = urpc_shm_client->urpc_data[urpc_shm_client->slot];
+  iheader = urpc_data_get_header (urpc_data, URPC_DATA_INPUT);
 
-  /* Сигнализируем о начале выполнения запроса. */
-  urpc_sem_unlock (urpc_shm_client->transport->start);
+  /* Ставим запрос в очередь и сигнализируем о его поступлении. */
+  if (urpc_shm_queue_push (urpc_shm_client->requests, urpc_shm_client->slot) != 0)
+    return URPC_STATUS_TRANSPORT_ERROR;
+  urpc_doorbell_ring (&urpc_shm_client->header->request);
 
   /* Ожидаем завершения выполнения. */
-  urpc_sem_lock (urpc_shm_client->transport->stop);
+  wait_start = urpc_timer_get_monotonic_time ();
+  urpc_doorbell_wait (&urpc_shm_client->slots[urpc_shm_client->slot].stop, &urpc_shm_client->spin, -1.0);
+  urpc_shm_client->wait_time += urpc_timer_get_monotonic_time () - wait_start;
 
   /* Проверяем заголовок ответа. */
   if (UINT32_FROM_BE (iheader->magic) != URPC_MAGIC)
     return URPC_STATUS_TRANSPORT_ERROR;
 
-  urpc_data_set_data_size (urpc_shm_client->transport->urpc_data, URPC_DATA_INPUT,
-                           UINT32_FROM_BE (iheader->size) - URPC_HEADER_SIZE);
+  urpc_data_set_data_size (urpc_data, URPC_DATA_INPUT, UINT32_FROM_BE (iheader->size) - URPC_HEADER_SIZE);
 
   return URPC_STATUS_OK;
 }
@@ -273,9 +251,18 @@ urpc_shm_client_unlock (uRpcSHMClient *urpc_shm_client)
   if (urpc_shm_client->urpc_shm_client_type != URPC_SHM_CLIENT_TYPE)
     return;
 
-  urpc_sem_unlock (urpc_shm_client->transport->used);
-  urpc_sem_unlock (urpc_shm_client->access);
-  urpc_shm_client->transport = NULL;
+  urpc_shm_queue_push (urpc_shm_client->free_slots, urpc_shm_client->slot);
+  urpc_doorbell_ring (&urpc_shm_client->header->released);
+}
+
+void
+urpc_shm_client_get_stats (uRpcSHMClient   *urpc_shm_client,
+                           uRpcClientStats *stats)
+{
+  if (urpc_shm_client->urpc_shm_client_type != URPC_SHM_CLIENT_TYPE)
+    return;
+
+  stats->wait_time += (uint64_t) (1e9 * urpc_shm_client->wait_time);
 }
 
 const char *
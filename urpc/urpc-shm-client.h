@@ -32,6 +32,7 @@
 
 #include <urpc-types.h>
 #include <urpc-data.h>
+#include <urpc-stats.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -55,6 +56,10 @@ uint32_t       urpc_shm_client_exchange                (uRpcSHMClient         *u
 /* Функция разблокирует канал связи. */
 void           urpc_shm_client_unlock                  (uRpcSHMClient         *urpc_shm_client);
 
+/* Функция добавляет в статистику клиента число повторных ожиданий и время ожидания транспорта. */
+void           urpc_shm_client_get_stats               (uRpcSHMClient         *urpc_shm_client,
+                                                        uRpcClientStats       *stats);
+
 /* Функция возвращает указатель на строку с локальным адресом в формате URI. */
 const char    *urpc_shm_client_get_self_address        (uRpcSHMClient         *urpc_shm_client);
 
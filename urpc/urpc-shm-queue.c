@@ -0,0 +1,167 @@
+/*
+ * uRPC - rpc (remote procedure call) library.
+ *
+ * Copyright 2015 Andrei Fadeev (andrei@webcontrol.ru)
+ *
+ * This file is part of uRPC.
+ *
+ * uRPC is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * uRPC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the author in this case.
+ *
+ */
+
+#include "urpc-shm-queue.h"
+#include "urpc-atomic.h"
+
+/* Очередь построена по схеме Д. Вьюкова: каждая ячейка содержит порядковый номер,
+   по которому писатель и читатель определяют, свободна ли ячейка для них. Позиции
+   записи и чтения захватываются атомарной заменой значения и расположены в разных
+   строках кеша. */
+
+typedef struct _uRpcSHMQueueCell
+{
+  uint32_t             sequence;               /* Порядковый номер ячейки. */
+  uint32_t             value;                  /* Значение. */
+} uRpcSHMQueueCell;
+
+struct _uRpcSHMQueue
+{
+  uint32_t             mask;                   /* Маска индекса ячейки (размер очереди - 1). */
+  uint32_t             reserved1[15];
+  uint32_t             enqueue_pos;            /* Позиция записи. */
+  uint32_t             reserved2[15];
+  uint32_t             dequeue_pos;            /* Позиция чтения. */
+  uint32_t             reserved3[15];
+  uRpcSHMQueueCell     cells[1];               /* Ячейки очереди. */
+};
+
+static uint32_t
+urpc_shm_queue_round_size (uint32_t size)
+{
+  uint32_t round_size = 1;
+
+  while (round_size < size)
+    round_size <<= 1;
+
+  return round_size;
+}
+
+size_t
+urpc_shm_queue_get_size (uint32_t size)
+{
+  return offsetof (uRpcSHMQueue, cells) + urpc_shm_queue_round_size (size) * sizeof (uRpcSHMQueueCell);
+}
+
+void
+urpc_shm_queue_init (uRpcSHMQueue *queue,
+                     uint32_t      size)
+{
+  uint32_t i;
+
+  size = urpc_shm_queue_round_size (size);
+
+  queue->mask = size - 1;
+  queue->enqueue_pos = 0;
+  queue->dequeue_pos = 0;
+  for (i = 0; i < size; i++)
+    {
+      queue->cells[i].sequence = i;
+      queue->cells[i].value = 0;
+    }
+}
+
+int
+urpc_shm_queue_push (uRpcSHMQueue *queue,
+                     uint32_t      value)
+{
+  uRpcSHMQueueCell *cell;
+  uint32_t pos = URPC_ATOMIC_LOAD (&queue->enqueue_pos);
+  uint32_t sequence;
+  int32_t diff;
+
+  while (1)
+    {
+      cell = &queue->cells[pos & queue->mask];
+      sequence = URPC_ATOMIC_LOAD (&cell->sequence);
+      diff = (int32_t) (sequence - pos);
+
+      /* Ячейка свободна - пытаемся захватить позицию записи. */
+      if (diff == 0)
+        {
+          if (URPC_ATOMIC_CAS (&queue->enqueue_pos, pos, pos + 1))
+            break;
+        }
+
+      /* Ячейка ещё не прочитана - очередь заполнена. */
+      else if (diff < 0)
+        {
+          return -1;
+        }
+
+      pos = URPC_ATOMIC_LOAD (&queue->enqueue_pos);
+    }
+
+  cell->value = value;
+  URPC_ATOMIC_STORE (&cell->sequence, pos + 1);
+
+  return 0;
+}
+
+int
+urpc_shm_queue_pop (uRpcSHMQueue *queue,
+                    uint32_t     *value)
+{
+  uRpcSHMQueueCell *cell;
+  uint32_t pos = URPC_ATOMIC_LOAD (&queue->dequeue_pos);
+  uint32_t sequence;
+  int32_t diff;
+
+  while (1)
+    {
+      cell = &queue->cells[pos & queue->mask];
+      sequence = URPC_ATOMIC_LOAD (&cell->sequence);
+      diff = (int32_t) (sequence - (pos + 1));
+
+      /* Ячейка записана - пытаемся захватить позицию чтения. */
+      if (diff == 0)
+        {
+          if (URPC_ATOMIC_CAS (&queue->dequeue_pos, pos, pos + 1))
+            break;
+        }
+
+      /* Ячейка ещё не записана - очередь пуста. */
+      else if (diff < 0)
+        {
+          return -1;
+        }
+
+      pos = URPC_ATOMIC_LOAD (&queue->dequeue_pos);
+    }
+
+  *value = cell->value;
+  URPC_ATOMIC_STORE (&cell->sequence, pos + queue->mask + 1);
+
+  return 0;
+}
+
+int
+urpc_shm_queue_is_empty (uRpcSHMQueue *queue)
+{
+  uint32_t pos = URPC_ATOMIC_LOAD (&queue->dequeue_pos);
+  uRpcSHMQueueCell *cell = &queue->cells[pos & queue->mask];
+
+  return (int32_t) (URPC_ATOMIC_LOAD (&cell->sequence) - (pos + 1)) < 0;
+}
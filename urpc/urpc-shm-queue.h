@@ -0,0 +1,68 @@
+/*
+ * uRPC - rpc (remote procedure call) library.
+ *
+ * Copyright 2015 Andrei Fadeev (andrei@webcontrol.ru)
+ *
+ * This file is part of uRPC.
+ *
+ * uRPC is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * uRPC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the author in this case.
+ *
+ */
+
+/* Заголовочный файл очереди 32-х битных значений в разделяемой памяти. Очередь
+   ограниченного размера допускает одновременную запись и чтение из нескольких
+   потоков и процессов без блокировок. Функции очереди используются библиотекой uRPC
+   самостоятельно и не предназначены для пользователей. */
+
+#ifndef __URPC_SHM_QUEUE_H__
+#define __URPC_SHM_QUEUE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _uRpcSHMQueue uRpcSHMQueue;
+
+/* Функция возвращает размер памяти необходимый для очереди из size элементов.
+   Размер очереди округляется вверх до степени двойки. */
+size_t urpc_shm_queue_get_size                 (uint32_t               size);
+
+/* Функция инициализирует очередь из size элементов в области памяти queue. */
+void urpc_shm_queue_init                       (uRpcSHMQueue          *queue,
+                                                uint32_t               size);
+
+/* Функция помещает значение в очередь. Возвращает 0 или отрицательное число,
+   если очередь заполнена. */
+int urpc_shm_queue_push                        (uRpcSHMQueue          *queue,
+                                                uint32_t               value);
+
+/* Функция извлекает значение из очереди. Возвращает 0 или отрицательное число,
+   если очередь пуста. */
+int urpc_shm_queue_pop                         (uRpcSHMQueue          *queue,
+                                                uint32_t              *value);
+
+/* Функция возвращает не ноль, если в очереди нет значений. */
+int urpc_shm_queue_is_empty                    (uRpcSHMQueue          *queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __URPC_SHM_QUEUE_H__ */
@@ -26,11 +26,13 @@
 #include "urpc-shm-server.h"
 #include "urpc-common.h"
 #include "urpc-shm.h"
-#include "urpc-semaphore.h"
+#include "urpc-shm-queue.h"
+#include "urpc-doorbell.h"
 #include "urpc-endian.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #if defined( __unix__ )
 #include <signal.h>
@@ -42,46 +44,63 @@
 
 #define URPC_SHM_SERVER_TYPE 0x534D4853
 
-typedef struct uRpcSHMTransport
-{
-  uRpcData            *urpc_data;              /* RPC данные. */
+/* Объём начала буфера слота, память которого не возвращается системе. Память
+   буферов сегмента выделяется системой при первом обращении, после больших
+   запросов и ответов страницы за этой границей освобождаются. */
+#define URPC_SHM_SERVER_KEEP_SIZE 65536
 
-  uRpcSem             *start;                  /* Семафор запуска функции на выполнение. */
-  uRpcSem             *stop;                   /* Семафор сигнализации завершения функции. */
-  uRpcSem             *used;                   /* Признак использования. */
-} uRpcSHMTransport;
+typedef struct uRpcSHMServerThread
+{
+  uint32_t             slot;                   /* Слот обрабатываемого запроса. */
+  uint32_t             spin;                   /* Число итераций активного ожидания запроса. */
+} uRpcSHMServerThread;
 
 struct _uRpcSHMServer
 {
   uint32_t             urpc_shm_server_type;   /* Тип объекта uRpcSHMServer. */
 
-  uRpcSem             *access;                 /* Семафор доступа к SHM серверу. */
-
   uRpcShm             *control;                /* Сегмент разделяемой области памяти управляющей структуры. */
   uRpcShm             *transport;              /* Сегмент разделяемой области памяти RPC данных. */
 
-  uRpcSHMTransport   **transports;             /* Сегменты обмена данными. */
+  uRpcSHMTransportHeader *header;              /* Заголовок транспортного сегмента. */
+  uRpcSHMQueue        *requests;               /* Очередь запросов. */
+  uRpcSHMSlot         *slots;                  /* Сигнальные слова слотов. */
+  uRpcData           **urpc_data;              /* RPC данные слотов. */
+  uint32_t            *reply_sizes;            /* Размеры последних ответов слотов. */
+  uint32_t             slots_num;              /* Число слотов. */
+
+  uRpcSHMServerThread *threads;                /* Состояние рабочих потоков. */
   uint32_t             threads_num;            /* Число рабочих потоков. */
+
+  double               busy_poll;              /* Время активного опроса запроса. */
 };
 
 uRpcSHMServer *
 urpc_shm_server_create (const char *uri,
                         uint32_t    threads_num,
+                        uint32_t    slots_num,
                         uint32_t    max_data_size)
 {
   uRpcSHMServer *urpc_shm_server = NULL;
 
   char obj_name[MAX_HOST_LEN + 32];
   uRpcSHMControl *control = NULL;
+  uRpcSHMQueue *free_slots;
   char *transport_shm;
+  size_t queue_size;
+  size_t transport_size;
 
   unsigned int i;
 
   /* Проверка ограничений. */
   if (max_data_size > URPC_MAX_DATA_SIZE)
     return NULL;
-  if (threads_num > URPC_MAX_THREADS_NUM)
-    threads_num = URPC_MAX_THREADS_NUM;
+  if (threads_num > URPC_MAX_SHM_SLOTS_NUM)
+    threads_num = URPC_MAX_SHM_SLOTS_NUM;
+  if (slots_num > URPC_MAX_SHM_SLOTS_NUM)
+    slots_num = URPC_MAX_SHM_SLOTS_NUM;
+  if (slots_num < threads_num)
+    slots_num = threads_num;
   max_data_size += URPC_HEADER_SIZE;
 
   /* Проверяем тип адреса. */
@@ -95,11 +114,14 @@ urpc_shm_server_create (const char *uri,
     return NULL;
 
   urpc_shm_server->urpc_shm_server_type = URPC_SHM_SERVER_TYPE;
-  urpc_shm_server->access = NULL;
   urpc_shm_server->control = NULL;
   urpc_shm_server->transport = NULL;
-  urpc_shm_server->transports = NULL;
+  urpc_shm_server->urpc_data = NULL;
+  urpc_shm_server->reply_sizes = NULL;
+  urpc_shm_server->slots_num = slots_num;
+  urpc_shm_server->threads = NULL;
   urpc_shm_server->threads_num = threads_num;
+  urpc_shm_server->busy_poll = 0.0;
 
   /* Название управляющего сегмента. */
   snprintf (obj_name, sizeof (obj_name), "%s.control", uri);
@@ -128,13 +150,6 @@ urpc_shm_server_create (const char *uri,
   if (control == NULL)
     goto urpc_shm_server_create_fail;
 
-  /* Создаем семафор доступа к SHM серверу. */
-  snprintf (obj_name, sizeof (obj_name), "%s.access", uri);
-  urpc_sem_remove (obj_name);
-  urpc_shm_server->access = urpc_sem_create (obj_name, URPC_SEM_UNLOCKED, threads_num);
-  if (urpc_shm_server->access == NULL)
-    goto urpc_shm_server_create_fail;
-
   /* Параметры сервера. */
 #if defined( __unix__ )
   control->pid = getpid ();
@@ -143,61 +158,64 @@ urpc_shm_server_create (const char *uri,
 #endif
   control->size = max_data_size;
   control->threads_num = threads_num;
+  control->slots_num = slots_num;
 
-  /* Создаем транспортный сегмент SHM сервера.
-     Сегмент содержит по два буфера размером max_data_size для каждого потока. */
+  /* Создаем транспортный сегмент SHM сервера. Сегмент содержит заголовок, очереди
+     запросов и свободных слотов, сигнальные слова и по два буфера размером
+     max_data_size для каждого слота. */
   snprintf (obj_name, sizeof (obj_name), "%s.transport", uri);
+  queue_size = URPC_SHM_ALIGN (urpc_shm_queue_get_size (slots_num));
+  transport_size = sizeof (uRpcSHMTransportHeader) + 2 * queue_size + slots_num * sizeof (uRpcSHMSlot);
   urpc_shm_remove (obj_name);
-  urpc_shm_server->transport = urpc_shm_create (obj_name, 2 * max_data_size * threads_num);
+  urpc_shm_server->transport = urpc_shm_create (obj_name, transport_size + 2 * max_data_size * slots_num);
   if (urpc_shm_server->transport == NULL)
     goto urpc_shm_server_create_fail;
   transport_shm = urpc_shm_map (urpc_shm_server->transport);
   if (transport_shm == NULL)
     goto urpc_shm_server_create_fail;
-
-  /* Буферы приёма-передачи, семафоры вызова функций. */
-  urpc_shm_server->transports = malloc (threads_num * sizeof (uRpcData *));
-  if (urpc_shm_server->transports == NULL)
+  memset (transport_shm, 0, transport_size);
+
+  urpc_shm_server->header = (uRpcSHMTransportHeader*)transport_shm;
+  urpc_shm_server->requests = (uRpcSHMQueue*)(transport_shm + sizeof (uRpcSHMTransportHeader));
+  free_slots = (uRpcSHMQueue*)((char*)urpc_shm_server->requests + queue_size);
+  urpc_shm_server->slots = (uRpcSHMSlot*)((char*)free_slots + queue_size);
+  transport_shm += transport_size;
+
+  /* Изначально все слоты свободны. */
+  urpc_shm_queue_init (urpc_shm_server->requests, slots_num);
+  urpc_shm_queue_init (free_slots, slots_num);
+  for (i = 0; i < slots_num; i++)
+    urpc_shm_queue_push (free_slots, i);
+
+  /* Состояние рабочих потоков. */
+  urpc_shm_server->threads = malloc (threads_num * sizeof (uRpcSHMServerThread));
+  if (urpc_shm_server->threads == NULL)
     goto urpc_shm_server_create_fail;
-  for (i = 0; i < threads_num; i++)
-    urpc_shm_server->transports[i] = NULL;
-
   for (i = 0; i < threads_num; i++)
     {
-      urpc_shm_server->transports[i] = malloc (sizeof (uRpcSHMTransport));
-      if (urpc_shm_server->transports[i] == NULL)
-        goto urpc_shm_server_create_fail;
-      urpc_shm_server->transports[i]->urpc_data = NULL;
-      urpc_shm_server->transports[i]->start = NULL;
-      urpc_shm_server->transports[i]->stop = NULL;
-      urpc_shm_server->transports[i]->used = NULL;
+      urpc_shm_server->threads[i].slot = 0;
+      urpc_shm_server->threads[i].spin = URPC_DOORBELL_MAX_SPIN;
     }
 
-  for (i = 0; i < threads_num; i++)
+  /* Размеры ответов слотов. */
+  urpc_shm_server->reply_sizes = calloc (slots_num, sizeof (uint32_t));
+  if (urpc_shm_server->reply_sizes == NULL)
+    goto urpc_shm_server_create_fail;
+
+  /* Буферы приёма-передачи слотов. */
+  urpc_shm_server->urpc_data = malloc (slots_num * sizeof (uRpcData *));
+  if (urpc_shm_server->urpc_data == NULL)
+    goto urpc_shm_server_create_fail;
+  for (i = 0; i < slots_num; i++)
+    urpc_shm_server->urpc_data[i] = NULL;
+
+  for (i = 0; i < slots_num; i++)
     {
       char *ibuffer = transport_shm + i * 2 * max_data_size;
       char *obuffer = ibuffer + max_data_size;
-      urpc_shm_server->transports[i]->urpc_data =
+      urpc_shm_server->urpc_data[i] =
         urpc_data_create (max_data_size, sizeof (uRpcHeader), ibuffer, obuffer, 0);
-      if (urpc_shm_server->transports[i]->urpc_data == NULL)
-        goto urpc_shm_server_create_fail;
-
-      snprintf (obj_name, sizeof (obj_name), "%s.transport.%u.start", uri, i);
-      urpc_sem_remove (obj_name);
-      urpc_shm_server->transports[i]->start = urpc_sem_create (obj_name, URPC_SEM_LOCKED, 1);
-      if (urpc_shm_server->transports[i]->start == NULL)
-        goto urpc_shm_server_create_fail;
-
-      snprintf (obj_name, sizeof (obj_name), "%s.transport.%u.stop", uri, i);
-      urpc_sem_remove (obj_name);
-      urpc_shm_server->transports[i]->stop = urpc_sem_create (obj_name, URPC_SEM_LOCKED, 1);
-      if (urpc_shm_server->transports[i]->stop == NULL)
-        goto urpc_shm_server_create_fail;
-
-      snprintf (obj_name, sizeof (obj_name), "%s.transport.%u.used", uri, i);
-      urpc_sem_remove (obj_name);
-      urpc_shm_server->transports[i]->used = urpc_sem_create (obj_name, URPC_SEM_UNLOCKED, 1);
-      if (urpc_shm_server->transports[i]->used == NULL)
+      if (urpc_shm_server->urpc_data[i] == NULL)
         goto urpc_shm_server_create_fail;
     }
 
@@ -217,72 +235,138 @@ urpc_shm_server_destroy (uRpcSHMServer *urpc_shm_server)
   if (urpc_shm_server->urpc_shm_server_type != URPC_SHM_SERVER_TYPE)
     return;
 
-  if (urpc_shm_server->transports != NULL)
+  if (urpc_shm_server->urpc_data != NULL)
     {
-      for (i = 0; i < urpc_shm_server->threads_num; i++)
-        {
-          if (urpc_shm_server->transports[i] == NULL)
-            continue;
-          if (urpc_shm_server->transports[i]->urpc_data != NULL)
-            urpc_data_destroy (urpc_shm_server->transports[i]->urpc_data);
-          if (urpc_shm_server->transports[i]->start != NULL)
-            urpc_sem_destroy (urpc_shm_server->transports[i]->start);
-          if (urpc_shm_server->transports[i]->stop != NULL)
-            urpc_sem_destroy (urpc_shm_server->transports[i]->stop);
-          if (urpc_shm_server->transports[i]->used != NULL)
-            urpc_sem_destroy (urpc_shm_server->transports[i]->used);
-          free (urpc_shm_server->transports[i]);
-        }
-      free (urpc_shm_server->transports);
+      for (i = 0; i < urpc_shm_server->slots_num; i++)
+        if (urpc_shm_server->urpc_data[i] != NULL)
+          urpc_data_destroy (urpc_shm_server->urpc_data[i]);
+      free (urpc_shm_server->urpc_data);
     }
 
+  free (urpc_shm_server->reply_sizes);
+
+  if (urpc_shm_server->threads != NULL)
+    free (urpc_shm_server->threads);
+
   if (urpc_shm_server->transport != NULL)
     urpc_shm_destroy (urpc_shm_server->transport);
-  if (urpc_shm_server->access != NULL)
-    urpc_sem_destroy (urpc_shm_server->access);
   if (urpc_shm_server->control != NULL)
     urpc_shm_destroy (urpc_shm_server->control);
 
   free (urpc_shm_server);
 }
 
+void
+urpc_shm_server_set_busy_poll (uRpcSHMServer *urpc_shm_server,
+                               double         busy_poll)
+{
+  if (urpc_shm_server->urpc_shm_server_type != URPC_SHM_SERVER_TYPE)
+    return;
+
+  urpc_shm_server->busy_poll = busy_poll > 0.0 ? busy_poll : 0.0;
+}
+
+/* Функция возвращает системе память буфера слота за границей URPC_SHM_SERVER_KEEP_SIZE,
+   если в нём находилось size байт. */
+static void
+urpc_shm_server_discard (uRpcSHMServer *urpc_shm_server,
+                         void          *buffer,
+                         uint32_t       size)
+{
+  if (size <= URPC_SHM_SERVER_KEEP_SIZE)
+    return;
+
+  urpc_shm_discard (urpc_shm_server->transport, (char *) buffer + URPC_SHM_SERVER_KEEP_SIZE,
+                    size - URPC_SHM_SERVER_KEEP_SIZE);
+}
+
 uRpcData *
 urpc_shm_server_recv (uRpcSHMServer *urpc_shm_server,
                       uint32_t       thread_id)
 {
+  uRpcSHMServerThread *thread;
+  uRpcData *urpc_data;
   uRpcHeader *iheader;
+  uRpcHeader *oheader;
+  uint32_t slot;
 
   if (urpc_shm_server->urpc_shm_server_type != URPC_SHM_SERVER_TYPE)
     return NULL;
   if (thread_id > urpc_shm_server->threads_num - 1)
     return NULL;
 
-  /* Ждём 500мс сигнала о начале выполнения запроса. */
-  if (urpc_sem_timedlock (urpc_shm_server->transports[thread_id]->start, 0.5) != 0)
+  thread = &urpc_shm_server->threads[thread_id];
+
+  /* Берём запрос из очереди. Если очередь пуста, активно опрашиваем сигнал о
+     поступлении запроса, а затем ждём его 500мс. */
+  if (urpc_shm_queue_pop (urpc_shm_server->requests, &slot) != 0)
+    {
+      if (urpc_shm_server->busy_poll == 0.0 ||
+          urpc_doorbell_poll (&urpc_shm_server->header->request, urpc_shm_server->busy_poll) != 0)
+        {
+          if (urpc_doorbell_wait (&urpc_shm_server->header->request, &thread->spin, 0.5) != 0)
+            return NULL;
+        }
+
+      /* Запрос мог быть забран другим рабочим потоком. */
+      if (urpc_shm_queue_pop (urpc_shm_server->requests, &slot) != 0)
+        return NULL;
+    }
+
+  /* Сигнал о поступлении запроса получает только один поток. Если в очереди
+     остались запросы, будим следующий. */
+  if (!urpc_shm_queue_is_empty (urpc_shm_server->requests))
+    urpc_doorbell_ring (&urpc_shm_server->header->request);
+
+  if (slot >= urpc_shm_server->slots_num)
     return NULL;
 
-  /* Проверяем заголовок запроса. */
-  iheader = urpc_data_get_header (urpc_shm_server->transports[thread_id]->urpc_data, URPC_DATA_INPUT);
+  thread->slot = slot;
+  urpc_data = urpc_shm_server->urpc_data[slot];
+
+  /* Новый запрос в слоте означает, что клиент уже прочитал предыдущий ответ. */
+  oheader = urpc_data_get_header (urpc_data, URPC_DATA_OUTPUT);
+  urpc_shm_server_discard (urpc_shm_server, oheader, urpc_shm_server->reply_sizes[slot]);
+  urpc_shm_server->reply_sizes[slot] = 0;
+
+  /* Проверяем заголовок запроса. Клиент ожидает ответа, поэтому сообщаем ему
+     об ошибке заголовком ответа с неверным идентификатором. */
+  iheader = urpc_data_get_header (urpc_data, URPC_DATA_INPUT);
   if (UINT32_FROM_BE (iheader->magic) != URPC_MAGIC)
-    return NULL;
+    {
+      oheader->magic = 0;
+      urpc_doorbell_ring (&urpc_shm_server->slots[slot].stop);
+      return NULL;
+    }
 
-  urpc_data_set_data_size (urpc_shm_server->transports[thread_id]->urpc_data, URPC_DATA_INPUT,
-                           UINT32_FROM_BE (iheader->size) - URPC_HEADER_SIZE);
+  urpc_data_set_data_size (urpc_data, URPC_DATA_INPUT, UINT32_FROM_BE (iheader->size) - URPC_HEADER_SIZE);
 
-  return urpc_shm_server->transports[thread_id]->urpc_data;
+  return urpc_data;
 }
 
 int
 urpc_shm_server_send (uRpcSHMServer *urpc_shm_server,
                       uint32_t       thread_id)
 {
+  uRpcData *urpc_data;
+  uint32_t slot;
+
   if (urpc_shm_server->urpc_shm_server_type != URPC_SHM_SERVER_TYPE)
     return -1;
   if (thread_id > urpc_shm_server->threads_num - 1)
     return -1;
 
+  slot = urpc_shm_server->threads[thread_id].slot;
+  urpc_data = urpc_shm_server->urpc_data[slot];
+
+  /* Запрос обработан и больше не нужен. Ответ будет прочитан клиентом позже,
+     поэтому запоминаем только его размер. */
+  urpc_shm_server_discard (urpc_shm_server, urpc_data_get_header (urpc_data, URPC_DATA_INPUT),
+                           URPC_HEADER_SIZE + urpc_data_get_data_size (urpc_data, URPC_DATA_INPUT));
+  urpc_shm_server->reply_sizes[slot] = URPC_HEADER_SIZE + urpc_data_get_data_size (urpc_data, URPC_DATA_OUTPUT);
+
   /* Сигналазируем о завершении выполнения запроса. */
-  urpc_sem_unlock (urpc_shm_server->transports[thread_id]->stop);
+  urpc_doorbell_ring (&urpc_shm_server->slots[slot].stop);
 
   return 0;
 }
@@ -24,7 +24,7 @@
  */
 
 /* Заголовочный файл сервера удалённых вызовов процедур через механизм разделяемой
-   памяти и семафоры. Функции UDP сервера используются библиотекой uRPC самостоятельно
+   памяти и сигналы в ней. Функции UDP сервера используются библиотекой uRPC самостоятельно
    и не предназначены для пользователей. */
 
 #ifndef __URPC_SHM_SERVER_H__
@@ -40,17 +40,24 @@ extern "C" {
 typedef struct _uRpcSHMServer uRpcSHMServer;
 
 /* Функция создаёт RPC сервер обслуживающий клиентов по протоколу SHM.
-   При запуске сервера создаётся threads_num объектов каждый из которых может
-   использоваться в своём потоке. Сами потоки создаются функцией urpc_server_create.
-   В дальнейшем при вызове функций каждый поток передаёт свой идентификатор.
-   Параметры функции аналогичны urpc_server_create. */
+   Запросы клиентов помещаются в общую очередь, из которой их забирают threads_num
+   рабочих потоков. Сами потоки создаются функцией urpc_server_create. В дальнейшем
+   при вызове функций каждый поток передаёт свой идентификатор. Число одновременно
+   выполняемых запросов определяется числом слотов slots_num, но не меньше threads_num.
+   Остальные параметры функции аналогичны urpc_server_create. */
 uRpcSHMServer *urpc_shm_server_create          (const char            *uri,
                                                 uint32_t               threads_num,
+                                                uint32_t               slots_num,
                                                 uint32_t               max_data_size);
 
 /* Функция удаляет сервер. */
 void urpc_shm_server_destroy                   (uRpcSHMServer         *urpc_shm_server);
 
+/* Функция задаёт время активного опроса буфера запроса перед засыпанием рабочего потока.
+   Значение 0 отключает активный опрос. */
+void urpc_shm_server_set_busy_poll             (uRpcSHMServer         *urpc_shm_server,
+                                                double                 busy_poll);
+
 /* Функция принимает один запрос в потоке thread_id. */
 uRpcData *urpc_shm_server_recv                 (uRpcSHMServer         *urpc_shm_server,
                                                 uint32_t               thread_id);
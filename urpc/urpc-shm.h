@@ -146,6 +146,24 @@ void urpc_shm_remove           (const char            *name);
 URPC_EXPORT
 void *urpc_shm_map             (uRpcShm               *shm);
 
+/**
+ *
+ * Функция освобождает физическую память страниц сегмента, целиком попадающих в
+ * заданную область. При следующем обращении страницы будут заполнены нулями. Функция
+ * используется для возврата системе памяти, занятой редкими большими данными.
+ *
+ * \param shm указатель на сегмент разделяемой памяти;
+ * \param address адрес начала области в отображённом сегменте;
+ * \param size размер области в байтах.
+ *
+ * \return 0 в случае успешного завершения, иначе -1 (в том числе если система не поддерживает операцию).
+ *
+ */
+URPC_EXPORT
+int urpc_shm_discard           (uRpcShm               *shm,
+                                void                  *address,
+                                unsigned long          size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,301 @@
+/*
+ * uRPC - rpc (remote procedure call) library.
+ *
+ * Copyright 2015 Andrei Fadeev (andrei@webcontrol.ru)
+ *
+ * This file is part of uRPC.
+ *
+ * uRPC is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * uRPC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the author in this case.
+ *
+ */
+
+#include "urpc-stats.h"
+#include "urpc-common.h"
+#include "urpc-endian.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define URPC_HISTOGRAM_MAX_VALUE       ((((uint64_t) 1) << 38) - 1)
+
+/* Функция возвращает номер интервала гистограммы для значения. Значения до 4 нс
+   учитываются отдельно, далее каждый интервал от 2^n до 2^(n+1) делится на четыре. */
+static uint32_t
+urpc_histogram_get_bucket (uint64_t value)
+{
+  uint32_t order;
+
+  if (value < 4)
+    return (uint32_t) value;
+  if (value > URPC_HISTOGRAM_MAX_VALUE)
+    value = URPC_HISTOGRAM_MAX_VALUE;
+
+#if defined (__GNUC__)
+  order = 63 - __builtin_clzll (value);
+#else
+  for (order = 2; (value >> (order + 1)) != 0; order++);
+#endif
+
+  return 4 * (order - 1) + (uint32_t) ((value >> (order - 2)) & 3);
+}
+
+/* Функция возвращает верхнюю границу интервала гистограммы. */
+static uint64_t
+urpc_histogram_get_bucket_limit (uint32_t bucket)
+{
+  uint32_t order;
+
+  if (bucket < 4)
+    return bucket;
+
+  order = bucket / 4 + 1;
+
+  return ((uint64_t) (4 + bucket % 4 + 1) << (order - 2)) - 1;
+}
+
+void
+urpc_histogram_add (uRpcHistogram *histogram,
+                    uint64_t       value)
+{
+  histogram->count += 1;
+  histogram->sum += value;
+  if (value > histogram->max)
+    histogram->max = value;
+  histogram->buckets[urpc_histogram_get_bucket (value)] += 1;
+}
+
+void
+urpc_histogram_merge (uRpcHistogram       *histogram,
+                      const uRpcHistogram *source)
+{
+  uint32_t i;
+
+  histogram->count += source->count;
+  histogram->sum += source->sum;
+  if (source->max > histogram->max)
+    histogram->max = source->max;
+  for (i = 0; i < URPC_HISTOGRAM_SIZE; i++)
+    histogram->buckets[i] += source->buckets[i];
+}
+
+uint64_t
+urpc_histogram_get_percentile (const uRpcHistogram *histogram,
+                               double               percentile)
+{
+  uint64_t target;
+  uint64_t count = 0;
+  uint64_t limit;
+  uint32_t i;
+
+  if (histogram->count == 0)
+    return 0;
+
+  if (percentile < 0.0)
+    percentile = 0.0;
+  if (percentile > 100.0)
+    percentile = 100.0;
+
+  target = (uint64_t) (histogram->count * percentile / 100.0 + 0.5);
+  if (target == 0)
+    target = 1;
+
+  for (i = 0; i < URPC_HISTOGRAM_SIZE; i++)
+    {
+      count += histogram->buckets[i];
+      if (count >= target)
+        break;
+    }
+
+  limit = urpc_histogram_get_bucket_limit (i < URPC_HISTOGRAM_SIZE ? i : URPC_HISTOGRAM_SIZE - 1);
+
+  return (limit < histogram->max) ? limit : histogram->max;
+}
+
+/* Функция возвращает размер гистограммы при передаче: число измерений, сумма,
+   максимальное значение, число непустых интервалов и пары номер - число измерений
+   для непустых интервалов. */
+static uint32_t
+urpc_histogram_get_export_size (const uRpcHistogram *histogram)
+{
+  uint32_t size = 3 * sizeof (uint64_t) + sizeof (uint32_t);
+  uint32_t i;
+
+  for (i = 0; i < URPC_HISTOGRAM_SIZE; i++)
+    if (histogram->buckets[i] != 0)
+      size += 2 * sizeof (uint32_t);
+
+  return size;
+}
+
+/* Функция записывает 32-х битное значение в буфер в сетевом порядке байт. */
+static uint8_t *
+urpc_stats_put_uint32 (uint8_t  *data,
+                       uint32_t  value)
+{
+  value = UINT32_TO_BE (value);
+  memcpy (data, &value, sizeof (uint32_t));
+
+  return data + sizeof (uint32_t);
+}
+
+/* Функция записывает 64-х битное значение в буфер в сетевом порядке байт. */
+static uint8_t *
+urpc_stats_put_uint64 (uint8_t  *data,
+                       uint64_t  value)
+{
+  value = UINT64_TO_BE (value);
+  memcpy (data, &value, sizeof (uint64_t));
+
+  return data + sizeof (uint64_t);
+}
+
+/* Функция считывает 32-х битное значение из буфера. */
+static const uint8_t *
+urpc_stats_get_uint32 (const uint8_t *data,
+                       uint32_t      *value)
+{
+  memcpy (value, data, sizeof (uint32_t));
+  *value = UINT32_FROM_BE (*value);
+
+  return data + sizeof (uint32_t);
+}
+
+/* Функция считывает 64-х битное значение из буфера. */
+static const uint8_t *
+urpc_stats_get_uint64 (const uint8_t *data,
+                       uint64_t      *value)
+{
+  memcpy (value, data, sizeof (uint64_t));
+  *value = UINT64_FROM_BE (*value);
+
+  return data + sizeof (uint64_t);
+}
+
+/* Функция записывает гистограмму в буфер. */
+static uint8_t *
+urpc_histogram_export (const uRpcHistogram *histogram,
+                       uint8_t             *data)
+{
+  uint32_t buckets_num = 0;
+  uint32_t i;
+
+  for (i = 0; i < URPC_HISTOGRAM_SIZE; i++)
+    if (histogram->buckets[i] != 0)
+      buckets_num += 1;
+
+  data = urpc_stats_put_uint64 (data, histogram->count);
+  data = urpc_stats_put_uint64 (data, histogram->sum);
+  data = urpc_stats_put_uint64 (data, histogram->max);
+  data = urpc_stats_put_uint32 (data, buckets_num);
+
+  for (i = 0; i < URPC_HISTOGRAM_SIZE; i++)
+    {
+      if (histogram->buckets[i] == 0)
+        continue;
+      data = urpc_stats_put_uint32 (data, i);
+      data = urpc_stats_put_uint32 (data, histogram->buckets[i]);
+    }
+
+  return data;
+}
+
+/* Функция считывает гистограмму из буфера. Возвращает NULL при ошибке в данных. */
+static const uint8_t *
+urpc_histogram_import (uRpcHistogram *histogram,
+                       const uint8_t *data,
+                       const uint8_t *end)
+{
+  uint32_t buckets_num;
+  uint32_t bucket;
+  uint32_t i;
+
+  if (data == NULL || end - data < (ptrdiff_t) (3 * sizeof (uint64_t) + sizeof (uint32_t)))
+    return NULL;
+
+  data = urpc_stats_get_uint64 (data, &histogram->count);
+  data = urpc_stats_get_uint64 (data, &histogram->sum);
+  data = urpc_stats_get_uint64 (data, &histogram->max);
+  data = urpc_stats_get_uint32 (data, &buckets_num);
+
+  if (buckets_num > URPC_HISTOGRAM_SIZE || end - data < (ptrdiff_t) (2 * sizeof (uint32_t) * buckets_num))
+    return NULL;
+
+  memset (histogram->buckets, 0, sizeof (histogram->buckets));
+  for (i = 0; i < buckets_num; i++)
+    {
+      data = urpc_stats_get_uint32 (data, &bucket);
+      if (bucket >= URPC_HISTOGRAM_SIZE)
+        return NULL;
+      data = urpc_stats_get_uint32 (data, &histogram->buckets[bucket]);
+    }
+
+  return data;
+}
+
+uint32_t
+urpc_server_proc_stats_get_size (const uRpcServerProcStats *stats)
+{
+  return sizeof (uint32_t) + 4 * sizeof (uint64_t) +
+         urpc_histogram_get_export_size (&stats->dispatch_time) +
+         urpc_histogram_get_export_size (&stats->proc_time) +
+         urpc_histogram_get_export_size (&stats->send_time);
+}
+
+uint32_t
+urpc_server_proc_stats_export (const uRpcServerProcStats *stats,
+                               void                      *data)
+{
+  uint8_t *buffer = data;
+
+  buffer = urpc_stats_put_uint32 (buffer, stats->proc_id);
+  buffer = urpc_stats_put_uint64 (buffer, stats->calls);
+  buffer = urpc_stats_put_uint64 (buffer, stats->errors);
+  buffer = urpc_stats_put_uint64 (buffer, stats->bytes_in);
+  buffer = urpc_stats_put_uint64 (buffer, stats->bytes_out);
+
+  buffer = urpc_histogram_export (&stats->dispatch_time, buffer);
+  buffer = urpc_histogram_export (&stats->proc_time, buffer);
+  buffer = urpc_histogram_export (&stats->send_time, buffer);
+
+  return (uint32_t) (buffer - (uint8_t *) data);
+}
+
+uint32_t
+urpc_server_proc_stats_import (uRpcServerProcStats *stats,
+                               const void          *data,
+                               uint32_t             size)
+{
+  const uint8_t *buffer = data;
+  const uint8_t *end = buffer + size;
+
+  if (size < sizeof (uint32_t) + 4 * sizeof (uint64_t))
+    return 0;
+
+  buffer = urpc_stats_get_uint32 (buffer, &stats->proc_id);
+  buffer = urpc_stats_get_uint64 (buffer, &stats->calls);
+  buffer = urpc_stats_get_uint64 (buffer, &stats->errors);
+  buffer = urpc_stats_get_uint64 (buffer, &stats->bytes_in);
+  buffer = urpc_stats_get_uint64 (buffer, &stats->bytes_out);
+
+  buffer = urpc_histogram_import (&stats->dispatch_time, buffer, end);
+  buffer = urpc_histogram_import (&stats->proc_time, buffer, end);
+  buffer = urpc_histogram_import (&stats->send_time, buffer, end);
+  if (buffer == NULL)
+    return 0;
+
+  return (uint32_t) (buffer - (const uint8_t *) data);
+}
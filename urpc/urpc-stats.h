@@ -0,0 +1,204 @@
+/*
+ * uRPC - rpc (remote procedure call) library.
+ *
+ * Copyright 2015 Andrei Fadeev (andrei@webcontrol.ru)
+ *
+ * This file is part of uRPC.
+ *
+ * uRPC is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * uRPC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the author in this case.
+ *
+ */
+
+/**
+ * \file urpc-stats.h
+ *
+ * \brief Заголовочный файл статистики выполнения RPC запросов
+ * \author Andrei Fadeev (andrei@webcontrol.ru)
+ * \date 2015
+ * \license GNU General Public License version 3 или более поздняя<br>
+ * Коммерческая лицензия - свяжитесь с автором
+ *
+ * \defgroup uRpcStats uRpcStats - статистика выполнения RPC запросов.
+ *
+ * Время выполнения запросов учитывается в гистограммах \link uRpcHistogram \endlink.
+ * Гистограмма хранит число измерений в интервалах, ширина которых растёт вместе со
+ * значением: каждый интервал от 2^n до 2^(n+1) наносекунд разделён на четыре части.
+ * Относительная погрешность значения не превышает 25%, а размер гистограммы не зависит
+ * от числа измерений. Для работы с гистограммами используются функции:
+ *
+ * - #urpc_histogram_add - добавление измерения;
+ * - #urpc_histogram_merge - объединение гистограмм;
+ * - #urpc_histogram_get_percentile - значение заданного процентиля.
+ *
+ * Статистика сервера по каждой процедуре \link uRpcServerProcStats \endlink возвращается
+ * функцией #urpc_server_get_stats, клиент может запросить её у сервера функцией
+ * #urpc_client_get_server_stats.
+ *
+ * Заполнение слотов сессий сервера \link uRpcServerSessionStats \endlink возвращается
+ * функцией #urpc_server_get_session_stats.
+ *
+ * Статистика клиента \link uRpcClientStats \endlink и время выполнения запросов к каждой
+ * процедуре \link uRpcClientProcStats \endlink возвращаются функцией #urpc_client_get_stats.
+ *
+ */
+
+#ifndef __URPC_STATS_H__
+#define __URPC_STATS_H__
+
+#include <urpc-exports.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define URPC_HISTOGRAM_SIZE            148             /**< Число интервалов гистограммы, максимальное
+                                                            учитываемое значение - 2^38 нс (около 275 с). */
+
+/**
+ *
+ * Гистограмма времени выполнения, значения в наносекундах.
+ *
+ */
+typedef struct _uRpcHistogram uRpcHistogram;
+struct _uRpcHistogram
+{
+  uint64_t             count;                          /**< Число измерений. */
+  uint64_t             sum;                            /**< Сумма значений. */
+  uint64_t             max;                            /**< Максимальное значение. */
+  uint32_t             buckets[URPC_HISTOGRAM_SIZE];   /**< Число измерений в интервалах. */
+};
+
+/**
+ *
+ * Статистика выполнения процедуры сервером.
+ *
+ */
+typedef struct _uRpcServerProcStats uRpcServerProcStats;
+struct _uRpcServerProcStats
+{
+  uint32_t             proc_id;                        /**< Идентификатор процедуры. */
+  uint64_t             calls;                          /**< Число вызовов. */
+  uint64_t             errors;                         /**< Число вызовов завершившихся ошибкой. */
+  uint64_t             bytes_in;                       /**< Объём принятых запросов, байт. */
+  uint64_t             bytes_out;                      /**< Объём отправленных ответов, байт. */
+  uRpcHistogram        dispatch_time;                  /**< Время от получения запроса рабочим потоком
+                                                            до вызова процедуры: проверка заголовка и сессии. */
+  uRpcHistogram        proc_time;                      /**< Время выполнения процедуры. */
+  uRpcHistogram        send_time;                      /**< Время отправки ответа. */
+};
+
+/**
+ *
+ * Статистика слотов сессий сервера. Память под слоты выделяется при создании сервера
+ * по числу max_clients, пиковое число сессий позволяет подобрать это значение.
+ *
+ */
+typedef struct _uRpcServerSessionStats uRpcServerSessionStats;
+struct _uRpcServerSessionStats
+{
+  uint32_t             slots;                          /**< Число слотов сессий. */
+  uint32_t             active;                         /**< Число активных сессий. */
+  uint32_t             peak;                           /**< Наибольшее число одновременно активных сессий. */
+  uint64_t             memory;                         /**< Память, занятая слотами сессий, байт. */
+};
+
+/**
+ *
+ * Статистика клиента.
+ *
+ */
+typedef struct _uRpcClientStats uRpcClientStats;
+struct _uRpcClientStats
+{
+  uint64_t             calls;                          /**< Число запросов. */
+  uint64_t             errors;                         /**< Число запросов завершившихся ошибкой, кроме
+                                                            превышения времени ожидания и ошибок передачи. */
+  uint64_t             timeouts;                       /**< Число запросов с превышением времени ожидания. */
+  uint64_t             transport_errors;               /**< Число запросов с ошибкой передачи данных. */
+  uint64_t             retries;                        /**< Число повторных ожиданий готовности канала связи:
+                                                            ожидание ведётся интервалами по 100 мс, а также
+                                                            повторяется после прерывания системного вызова. */
+  uint64_t             bytes_sent;                     /**< Объём отправленных запросов, байт. */
+  uint64_t             bytes_received;                 /**< Объём принятых ответов, байт. */
+  uint64_t             wait_time;                      /**< Время ожидания готовности канала связи и
+                                                            ответов сервера транспортом, нс. */
+};
+
+/**
+ *
+ * Статистика запросов клиента к процедуре.
+ *
+ */
+typedef struct _uRpcClientProcStats uRpcClientProcStats;
+struct _uRpcClientProcStats
+{
+  uint32_t             proc_id;                        /**< Идентификатор процедуры. */
+  uint64_t             calls;                          /**< Число запросов. */
+  uint64_t             errors;                         /**< Число запросов завершившихся с любой ошибкой. */
+  uRpcHistogram        latency;                        /**< Время выполнения запроса. */
+};
+
+/**
+ *
+ * Функция добавляет измерение в гистограмму.
+ *
+ * \param histogram указатель на гистограмму;
+ * \param value значение, нс.
+ *
+ * \return Нет.
+ *
+ */
+URPC_EXPORT
+void           urpc_histogram_add              (uRpcHistogram         *histogram,
+                                                uint64_t               value);
+
+/**
+ *
+ * Функция добавляет измерения гистограммы source в гистограмму histogram.
+ *
+ * \param histogram указатель на гистограмму;
+ * \param source указатель на добавляемую гистограмму.
+ *
+ * \return Нет.
+ *
+ */
+URPC_EXPORT
+void           urpc_histogram_merge            (uRpcHistogram         *histogram,
+                                                const uRpcHistogram   *source);
+
+/**
+ *
+ * Функция возвращает значение, которое не превышает указанный процент измерений.
+ * Возвращается верхняя граница интервала, в который попадает процентиль.
+ *
+ * \param histogram указатель на гистограмму;
+ * \param percentile процентиль, от 0 до 100.
+ *
+ * \return Значение процентиля, нс.
+ *
+ */
+URPC_EXPORT
+uint64_t       urpc_histogram_get_percentile   (const uRpcHistogram   *histogram,
+                                                double                 percentile);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __URPC_STATS_H__ */
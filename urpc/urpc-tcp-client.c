@@ -28,6 +28,9 @@
 #include "urpc-network.h"
 #include "urpc-timer.h"
 #include "urpc-endian.h"
+#include "urpc-mutex.h"
+#include "urpc-cond.h"
+#include "urpc-notify.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -43,6 +46,26 @@
 #define TCP_PAD_SIZE         64
 #define TCP_INFO_SIZE        TCP_ADDRESS_SIZE + TCP_PORT_SIZE + TCP_PAD_SIZE
 
+enum
+{
+  URPC_TCP_CLIENT_REQUEST_FREE,                /* Буфер запроса свободен. */
+  URPC_TCP_CLIENT_REQUEST_LOCKED,              /* Буфер запроса используется клиентом. */
+  URPC_TCP_CLIENT_REQUEST_WAITING,             /* Запрос отправлен, ожидается ответ. */
+  URPC_TCP_CLIENT_REQUEST_DONE                 /* Ответ принят. */
+};
+
+/* Запрос к серверу. */
+typedef struct
+{
+  uRpcData            *urpc_data;              /* Буферы приёма-передачи запроса. */
+  uRpcTimer           *timer;                  /* Таймаут таймер. */
+  uint32_t             id;                     /* Идентификатор запроса. */
+  uint32_t             state;                  /* Состояние запроса. */
+
+  urpc_client_async_proc async_proc;           /* Функция завершения асинхронного запроса. */
+  void                *async_data;             /* Пользовательские данные асинхронного запроса. */
+} uRpcTCPClientRequest;
+
 struct _uRpcTCPClient
 {
   uint32_t             urpc_tcp_client_type;   /* Тип объекта uRpcTCPClient. */
@@ -50,16 +73,323 @@ struct _uRpcTCPClient
   SOCKET               socket;                 /* Рабочий сокет. */
 
   uint32_t             buffer_size;            /* Размер буфера приёма-передачи. */
-  uRpcData            *urpc_data;              /* Указатель на объект RPC данных. */
-  uRpcTimer           *timer;                  /* Таймаут таймер. */
+  uRpcTCPClientRequest requests[URPC_MAX_REQUESTS_NUM]; /* Таблица запросов. */
+  uint32_t             last_request_id;        /* Идентификатор последнего запроса. */
+  uint32_t             reading;                /* Признак приёма ответа одним из потоков. */
+  uRpcHeader           rx_header;              /* Заголовок принимаемого ответа. */
+  uRpcTCPClientRequest *rx_request;            /* Запрос для которого принимается ответ. */
+  uint32_t             rx_size;                /* Размер принимаемого ответа. */
+  uint32_t             rx_received;            /* Число принятых байт ответа. */
   double               timeout;                /* Интервал таймаута. */
 
+  uint64_t             tx_retries;             /* Число повторных ожиданий при передаче, изменяется под send_lock. */
+  double               tx_wait_time;           /* Время ожидания при передаче. */
+  uint64_t             rx_retries;             /* Число повторных ожиданий при приёме, изменяется потоком приёма. */
+  double               rx_wait_time;           /* Время ожидания при приёме. */
+
+  uRpcMutex            lock;                   /* Блокировка доступа к таблице запросов. */
+  uRpcCond             cond;                   /* Оповещение об изменении состояния запросов. */
+  uRpcMutex            send_lock;              /* Блокировка отправки запросов. */
+  uRpcTimer           *send_timer;             /* Таймаут таймер передачи, используется под send_lock. */
+  uRpcNotify          *notify;                 /* Оповещение о завершении асинхронных запросов. */
+
   char                *self_address;           /* Локальный адрес. */
   char                *peer_address;           /* Адрес сервера. */
 
   volatile uint32_t    fail;                   /* Признак ошибки. */
 };
 
+/* Функция ищет запрос по его буферам приёма-передачи. */
+static uRpcTCPClientRequest *
+urpc_tcp_client_find_request (uRpcTCPClient *urpc_tcp_client,
+                              uRpcData      *urpc_data)
+{
+  unsigned int i;
+
+  for (i = 0; i < URPC_MAX_REQUESTS_NUM; i++)
+    if (urpc_tcp_client->requests[i].urpc_data == urpc_data)
+      return &urpc_tcp_client->requests[i];
+
+  return NULL;
+}
+
+/* Функция создаёт буферы приёма-передачи и таймер запроса. */
+static int
+urpc_tcp_client_init_request (uRpcTCPClient        *urpc_tcp_client,
+                              uRpcTCPClientRequest *request)
+{
+  if (request->urpc_data == NULL)
+    request->urpc_data = urpc_data_create (urpc_tcp_client->buffer_size, sizeof (uRpcHeader), NULL, NULL, 0);
+  if (request->timer == NULL)
+    request->timer = urpc_timer_create ();
+
+  if (request->urpc_data == NULL || request->timer == NULL)
+    return -1;
+
+  return 0;
+}
+
+/* Функция завершает приём данных потоком. Если соединение неисправно, ожидающие
+   асинхронные запросы могут быть завершены с ошибкой, о чём оповещается поток
+   обработки асинхронных запросов. Вызывается под блокировкой lock. */
+static void
+urpc_tcp_client_stop_reading (uRpcTCPClient *urpc_tcp_client,
+                              int            read_status)
+{
+  urpc_tcp_client->reading = 0;
+  if (read_status < 0)
+    urpc_tcp_client->fail = 1;
+  if (urpc_tcp_client->fail)
+    urpc_notify_set (urpc_tcp_client->notify);
+  urpc_cond_broadcast (&urpc_tcp_client->cond);
+}
+
+/* Функция помечает соединение как неисправное и оповещает все ожидающие ответов потоки. */
+static void
+urpc_tcp_client_set_fail (uRpcTCPClient *urpc_tcp_client)
+{
+  urpc_mutex_lock (&urpc_tcp_client->lock);
+  urpc_tcp_client->fail = 1;
+  urpc_notify_set (urpc_tcp_client->notify);
+  urpc_cond_broadcast (&urpc_tcp_client->cond);
+  urpc_mutex_unlock (&urpc_tcp_client->lock);
+}
+
+/* Функция отправляет size байт данных серверу. */
+static int
+urpc_tcp_client_write (uRpcTCPClient *urpc_tcp_client,
+                       uRpcTimer     *timer,
+                       char          *buffer,
+                       uint32_t       size)
+{
+  uint32_t sended = 0;
+  double wait_start;
+  int selected;
+  int sr_size;
+
+  /* Время начала передачи. */
+  urpc_timer_start (timer);
+
+  while (sended != size)
+    {
+      if (urpc_tcp_client->fail)
+        return -1;
+
+      /* Проверка таймаута при передаче данных. */
+      if (urpc_timer_elapsed (timer) > urpc_tcp_client->timeout)
+        return -1;
+
+      /* Проверяем возможность записи в канал связи с интервалом в 100мс. */
+      wait_start = urpc_timer_get_monotonic_time ();
+      selected = urpc_network_wait_write (urpc_tcp_client->socket, 0.1);
+      urpc_tcp_client->tx_wait_time += urpc_timer_get_monotonic_time () - wait_start;
+      if (selected < 0)
+        {
+          if (urpc_network_last_error () == URPC_EINTR)
+            {
+              urpc_tcp_client->tx_retries += 1;
+              continue;
+            }
+          return -1;
+        }
+
+      if (selected == 0)
+        {
+          urpc_tcp_client->tx_retries += 1;
+          continue;
+        }
+
+      /* Отправляем данные. */
+      sr_size = send (urpc_tcp_client->socket, buffer + sended, size - sended, URPC_MSG_NOSIGNAL);
+      if (sr_size <= 0)
+        {
+          int error = urpc_network_last_error ();
+          if (error == URPC_EINTR || error == URPC_EAGAIN)
+            {
+              urpc_tcp_client->tx_retries += 1;
+              continue;
+            }
+          return -1;
+        }
+
+      sended += sr_size;
+
+      /* Перезапускаем таймер. */
+      urpc_timer_start (timer);
+    }
+
+  return 0;
+}
+
+/* Функция принимает доступные в канале связи данные ответов сервера без ожидания.
+   Принятые целиком ответы передаются запросам с теми же идентификаторами, ответы
+   могут приходить в порядке отличном от порядка отправки запросов. Функцию вызывает
+   только поток получивший право приёма данных (reading), поэтому состояние приёма
+   хранится в структуре клиента между вызовами. */
+static int
+urpc_tcp_client_receive (uRpcTCPClient *urpc_tcp_client)
+{
+  uRpcTCPClientRequest *request;
+  uRpcHeader *iheader;
+
+  char *buffer;
+  uint32_t size;
+  uint32_t request_id;
+  unsigned int i;
+  int sr_size;
+
+  while (1)
+    {
+      /* Сначала принимается заголовок ответа, затем данные в буфер запроса. */
+      request = urpc_tcp_client->rx_request;
+      if (request == NULL)
+        {
+          buffer = (char *) &urpc_tcp_client->rx_header;
+          size = sizeof (uRpcHeader);
+        }
+      else
+        {
+          buffer = urpc_data_get_header (request->urpc_data, URPC_DATA_INPUT);
+          size = urpc_tcp_client->rx_size;
+        }
+
+      /* Считываем данные. */
+      if (urpc_tcp_client->rx_received < size)
+        {
+          sr_size = recv (urpc_tcp_client->socket, buffer + urpc_tcp_client->rx_received,
+                          size - urpc_tcp_client->rx_received, URPC_MSG_NOSIGNAL);
+          if (sr_size <= 0)
+            {
+              int error = urpc_network_last_error ();
+              if (sr_size < 0 && error == URPC_EINTR)
+                continue;
+              if (sr_size < 0 && error == URPC_EAGAIN)
+                return 0;
+              return -1;
+            }
+
+          urpc_tcp_client->rx_received += sr_size;
+          if (urpc_tcp_client->rx_received < size)
+            continue;
+        }
+
+      /* Принят заголовок ответа. */
+      if (request == NULL)
+        {
+          iheader = &urpc_tcp_client->rx_header;
+
+          /* Проверяем заголовок ответа. */
+          if (UINT32_FROM_BE (iheader->magic) != URPC_MAGIC)
+            return -1;
+          size = UINT32_FROM_BE (iheader->size);
+          if (size > urpc_tcp_client->buffer_size || size < sizeof (uRpcHeader))
+            return -1;
+
+          /* Ищем запрос ожидающий этот ответ. */
+          request_id = UINT32_FROM_BE (iheader->id);
+          urpc_mutex_lock (&urpc_tcp_client->lock);
+          for (i = 0; i < URPC_MAX_REQUESTS_NUM; i++)
+            {
+              if (urpc_tcp_client->requests[i].state == URPC_TCP_CLIENT_REQUEST_WAITING &&
+                  urpc_tcp_client->requests[i].id == request_id)
+                {
+                  request = &urpc_tcp_client->requests[i];
+                  break;
+                }
+            }
+          urpc_mutex_unlock (&urpc_tcp_client->lock);
+
+          if (request == NULL)
+            return -1;
+
+          /* Буферы запроса в состоянии ожидания ответа не используются другими потоками. */
+          *(uRpcHeader *) urpc_data_get_header (request->urpc_data, URPC_DATA_INPUT) = *iheader;
+          urpc_tcp_client->rx_request = request;
+          urpc_tcp_client->rx_size = size;
+          continue;
+        }
+
+      /* Принят ответ целиком. */
+      urpc_data_set_data_size (request->urpc_data, URPC_DATA_INPUT, size - URPC_HEADER_SIZE);
+
+      /* Ответ на асинхронный запрос мог принять поток, ожидающий синхронный
+         запрос, поэтому поток обработки асинхронных запросов оповещается. */
+      urpc_mutex_lock (&urpc_tcp_client->lock);
+      request->state = URPC_TCP_CLIENT_REQUEST_DONE;
+      if (request->async_proc != NULL)
+        urpc_notify_set (urpc_tcp_client->notify);
+      urpc_mutex_unlock (&urpc_tcp_client->lock);
+
+      urpc_tcp_client->rx_request = NULL;
+      urpc_tcp_client->rx_received = 0;
+    }
+}
+
+/* Функция отправляет запрос серверу. */
+static uint32_t
+urpc_tcp_client_send (uRpcTCPClient          *urpc_tcp_client,
+                      uRpcData               *urpc_data,
+                      urpc_client_async_proc  async_proc,
+                      void                   *async_data)
+{
+  uRpcTCPClientRequest *request;
+  uRpcHeader *oheader;
+  uint32_t request_id;
+
+  if (urpc_tcp_client->urpc_tcp_client_type != URPC_TCP_CLIENT_TYPE)
+    return URPC_STATUS_FAIL;
+  if (urpc_tcp_client->fail)
+    return URPC_STATUS_TRANSPORT_ERROR;
+
+  request = urpc_tcp_client_find_request (urpc_tcp_client, urpc_data);
+  if (request == NULL || request->state != URPC_TCP_CLIENT_REQUEST_LOCKED)
+    return URPC_STATUS_FAIL;
+
+  /* Идентификатор запроса, по нему ответ сопоставляется с запросом. */
+  urpc_mutex_lock (&urpc_tcp_client->lock);
+  do
+    {
+      urpc_tcp_client->last_request_id += 1;
+    }
+  while (urpc_tcp_client->last_request_id == 0);
+  request->id = urpc_tcp_client->last_request_id;
+  request_id = request->id;
+  request->async_proc = async_proc;
+  request->async_data = async_data;
+  request->state = URPC_TCP_CLIENT_REQUEST_WAITING;
+
+  /* Таймаут ожидающего запроса проверяется другими потоками под блокировкой,
+     поэтому таймер запускается вместе с изменением состояния запроса. */
+  urpc_timer_start (request->timer);
+  urpc_mutex_unlock (&urpc_tcp_client->lock);
+
+  oheader = urpc_data_get_header (urpc_data, URPC_DATA_OUTPUT);
+  oheader->id = UINT32_TO_BE (request_id);
+
+  /* Отправляем запрос. Запросы разных потоков передаются целиком по очереди. */
+  urpc_mutex_lock (&urpc_tcp_client->send_lock);
+  if (urpc_tcp_client_write (urpc_tcp_client, urpc_tcp_client->send_timer, (char *) oheader, UINT32_FROM_BE (oheader->size)) < 0)
+    {
+      urpc_mutex_unlock (&urpc_tcp_client->send_lock);
+      urpc_tcp_client_set_fail (urpc_tcp_client);
+      urpc_mutex_lock (&urpc_tcp_client->lock);
+      request->async_proc = NULL;
+      request->state = URPC_TCP_CLIENT_REQUEST_LOCKED;
+      urpc_mutex_unlock (&urpc_tcp_client->lock);
+      return URPC_STATUS_TRANSPORT_ERROR;
+    }
+  urpc_mutex_unlock (&urpc_tcp_client->send_lock);
+
+  /* Время начала ожидания ответа. Асинхронный запрос мог быть уже завершён
+     и его буфер занят другим запросом. */
+  urpc_mutex_lock (&urpc_tcp_client->lock);
+  if (request->state == URPC_TCP_CLIENT_REQUEST_WAITING && request->id == request_id)
+    urpc_timer_start (request->timer);
+  urpc_mutex_unlock (&urpc_tcp_client->lock);
+
+  return URPC_STATUS_OK;
+}
+
 uRpcTCPClient *
 urpc_tcp_client_create (const char *uri,
                         uint32_t    max_data_size,
@@ -74,6 +404,8 @@ urpc_tcp_client_create (const char *uri,
   char ips[TCP_ADDRESS_SIZE];
   char ports[TCP_PORT_SIZE];
 
+  unsigned int i;
+
   /* Проверка ограничений. */
   if (max_data_size > URPC_MAX_DATA_SIZE)
     return NULL;
@@ -93,16 +425,46 @@ urpc_tcp_client_create (const char *uri,
   urpc_tcp_client->urpc_tcp_client_type = URPC_TCP_CLIENT_TYPE;
   urpc_tcp_client->socket = INVALID_SOCKET;
   urpc_tcp_client->buffer_size = max_data_size;
-  urpc_tcp_client->urpc_data = NULL;
-  urpc_tcp_client->timer = NULL;
+  urpc_tcp_client->last_request_id = 0;
+  urpc_tcp_client->reading = 0;
+  urpc_tcp_client->rx_request = NULL;
+  urpc_tcp_client->rx_size = 0;
+  urpc_tcp_client->rx_received = 0;
   urpc_tcp_client->timeout = timeout;
+  urpc_tcp_client->tx_retries = 0;
+  urpc_tcp_client->tx_wait_time = 0.0;
+  urpc_tcp_client->rx_retries = 0;
+  urpc_tcp_client->rx_wait_time = 0.0;
   urpc_tcp_client->self_address = NULL;
   urpc_tcp_client->peer_address = NULL;
   urpc_tcp_client->fail = 0;
+  urpc_mutex_init (&urpc_tcp_client->lock);
+  urpc_cond_init (&urpc_tcp_client->cond);
+  urpc_mutex_init (&urpc_tcp_client->send_lock);
+  urpc_tcp_client->notify = NULL;
+  urpc_tcp_client->send_timer = NULL;
+
+  /* Таблица запросов. Буферы приёма-передачи создаются при первом использовании
+     запроса, буферы первого запроса создаются сразу. */
+  for (i = 0; i < URPC_MAX_REQUESTS_NUM; i++)
+    {
+      urpc_tcp_client->requests[i].urpc_data = NULL;
+      urpc_tcp_client->requests[i].timer = NULL;
+      urpc_tcp_client->requests[i].id = 0;
+      urpc_tcp_client->requests[i].state = URPC_TCP_CLIENT_REQUEST_FREE;
+      urpc_tcp_client->requests[i].async_proc = NULL;
+      urpc_tcp_client->requests[i].async_data = NULL;
+    }
+  if (urpc_tcp_client_init_request (urpc_tcp_client, &urpc_tcp_client->requests[0]) < 0)
+    goto urpc_tcp_client_create_fail;
 
-  /* Буферы приёма-передачи. */
-  urpc_tcp_client->urpc_data = urpc_data_create (max_data_size, sizeof (uRpcHeader), NULL, NULL, 0);
-  if (urpc_tcp_client->urpc_data == NULL)
+  /* Оповещение о завершении асинхронных запросов. */
+  urpc_tcp_client->notify = urpc_notify_create ();
+  if (urpc_tcp_client->notify == NULL)
+    goto urpc_tcp_client_create_fail;
+
+  urpc_tcp_client->send_timer = urpc_timer_create ();
+  if (urpc_tcp_client->send_timer == NULL)
     goto urpc_tcp_client_create_fail;
 
   /* Адрес сервера. */
@@ -182,11 +544,6 @@ urpc_tcp_client_create (const char *uri,
       goto urpc_tcp_client_create_fail;
     }
 
-  /* Таймер передачи. */
-  urpc_tcp_client->timer = urpc_timer_create ();
-  if (urpc_tcp_client->timer == NULL)
-    goto urpc_tcp_client_create_fail;
-
   freeaddrinfo (addr);
 
   return urpc_tcp_client;
@@ -202,225 +559,271 @@ urpc_tcp_client_create_fail:
 void
 urpc_tcp_client_destroy (uRpcTCPClient *urpc_tcp_client)
 {
+  unsigned int i;
+
   if (urpc_tcp_client->urpc_tcp_client_type != URPC_TCP_CLIENT_TYPE)
     return;
 
   if (urpc_tcp_client->socket != INVALID_SOCKET)
     closesocket (urpc_tcp_client->socket);
-  if (urpc_tcp_client->timer != NULL)
-    urpc_timer_destroy (urpc_tcp_client->timer);
-  if (urpc_tcp_client->urpc_data != NULL)
-    urpc_data_destroy (urpc_tcp_client->urpc_data);
+
+  for (i = 0; i < URPC_MAX_REQUESTS_NUM; i++)
+    {
+      if (urpc_tcp_client->requests[i].timer != NULL)
+        urpc_timer_destroy (urpc_tcp_client->requests[i].timer);
+      if (urpc_tcp_client->requests[i].urpc_data != NULL)
+        urpc_data_destroy (urpc_tcp_client->requests[i].urpc_data);
+    }
 
   if (urpc_tcp_client->self_address != NULL)
     free (urpc_tcp_client->self_address);
   if (urpc_tcp_client->peer_address != NULL)
     free (urpc_tcp_client->peer_address);
 
+  if (urpc_tcp_client->notify != NULL)
+    urpc_notify_destroy (urpc_tcp_client->notify);
+  if (urpc_tcp_client->send_timer != NULL)
+    urpc_timer_destroy (urpc_tcp_client->send_timer);
+
+  urpc_mutex_clear (&urpc_tcp_client->send_lock);
+  urpc_cond_clear (&urpc_tcp_client->cond);
+  urpc_mutex_clear (&urpc_tcp_client->lock);
+
   free (urpc_tcp_client);
 }
 
 uRpcData *
 urpc_tcp_client_lock (uRpcTCPClient *urpc_tcp_client)
 {
+  uRpcTCPClientRequest *request = NULL;
+  unsigned int i;
+
   if (urpc_tcp_client->urpc_tcp_client_type != URPC_TCP_CLIENT_TYPE)
     return NULL;
-  if (urpc_tcp_client->fail)
-    return NULL;
 
-  return urpc_tcp_client->urpc_data;
-}
-
-uint32_t
-urpc_tcp_client_exchange (uRpcTCPClient *urpc_tcp_client)
-{
-  fd_set sock_set;
-  struct timeval sock_tv;
+  /* Ожидаем освобождения одного из запросов. */
+  urpc_mutex_lock (&urpc_tcp_client->lock);
+  while (!urpc_tcp_client->fail)
+    {
+      for (i = 0; i < URPC_MAX_REQUESTS_NUM; i++)
+        {
+          if (urpc_tcp_client->requests[i].state == URPC_TCP_CLIENT_REQUEST_FREE)
+            {
+              request = &urpc_tcp_client->requests[i];
+              break;
+            }
+        }
 
-  uRpcHeader *iheader;
-  uRpcHeader *oheader;
+      if (request != NULL)
+        break;
 
-  unsigned int send_size;
-  unsigned int recv_size;
+      urpc_cond_wait (&urpc_tcp_client->cond, &urpc_tcp_client->lock);
+    }
 
-  int selected;
-  unsigned int sended = 0;
-  unsigned int received = 0;
+  if (request != NULL && urpc_tcp_client_init_request (urpc_tcp_client, request) == 0)
+    request->state = URPC_TCP_CLIENT_REQUEST_LOCKED;
+  else
+    request = NULL;
+  urpc_mutex_unlock (&urpc_tcp_client->lock);
 
-  int sr_size;
+  return request != NULL ? request->urpc_data : NULL;
+}
 
-  if (urpc_tcp_client->urpc_tcp_client_type != URPC_TCP_CLIENT_TYPE)
-    return URPC_STATUS_FAIL;
-  if (urpc_tcp_client->fail)
-    return URPC_STATUS_TRANSPORT_ERROR;
+uint32_t
+urpc_tcp_client_exchange (uRpcTCPClient *urpc_tcp_client,
+                          uRpcData      *urpc_data)
+{
+  uRpcTCPClientRequest *request;
+  uint32_t status;
 
-  iheader = urpc_data_get_header (urpc_tcp_client->urpc_data, URPC_DATA_INPUT);
-  oheader = urpc_data_get_header (urpc_tcp_client->urpc_data, URPC_DATA_OUTPUT);
-  send_size = UINT32_FROM_BE (oheader->size);
+  status = urpc_tcp_client_send (urpc_tcp_client, urpc_data, NULL, NULL);
+  if (status != URPC_STATUS_OK)
+    return status;
 
-  /* Время начала передачи. */
-  urpc_timer_start (urpc_tcp_client->timer);
+  request = urpc_tcp_client_find_request (urpc_tcp_client, urpc_data);
 
-  /* Отправляем запрос. */
-  while (sended != send_size)
+  /* Ожидаем ответ. Ответы из канала связи принимает один из ожидающих потоков,
+     остальные потоки ожидают пока их ответ не будет принят. */
+  urpc_mutex_lock (&urpc_tcp_client->lock);
+  while (request->state != URPC_TCP_CLIENT_REQUEST_DONE)
     {
-      /* Проверка таймаута при передаче данных. */
-      if (urpc_timer_elapsed (urpc_tcp_client->timer) > urpc_tcp_client->timeout)
+      /* При ошибке дожидаемся завершения приёма данных, т.к. они могут
+         записываться в буфер этого запроса. */
+      if (urpc_tcp_client->fail)
         {
-          urpc_tcp_client->fail = 1;
-          return URPC_STATUS_TRANSPORT_ERROR;
+          status = URPC_STATUS_TRANSPORT_ERROR;
+          if (!urpc_tcp_client->reading)
+            break;
+          urpc_cond_timed_wait (&urpc_tcp_client->cond, &urpc_tcp_client->lock, 0.1);
+          continue;
         }
 
-      /* Проверяем возможность записи в канал связи с интервалом в 100мс. */
-      FD_ZERO (&sock_set);
-      FD_SET (urpc_tcp_client->socket, &sock_set);
-      sock_tv.tv_sec = 0;
-      sock_tv.tv_usec = 100000;
-
-      selected = select ((int) (urpc_tcp_client->socket + 1), NULL, &sock_set, NULL, &sock_tv);
-      if (selected < 0)
+      if (!urpc_tcp_client->reading)
         {
-          int error = urpc_network_last_error ();
-          if (error == URPC_EINTR)
-            continue;
-          urpc_tcp_client->fail = 1;
-          return URPC_STATUS_TRANSPORT_ERROR;
+          int read_status = 0;
+          double wait_start;
+          int selected;
+
+          urpc_tcp_client->reading = 1;
+          urpc_mutex_unlock (&urpc_tcp_client->lock);
+
+          /* Проверяем возможность чтения из канала связи с интервалом в 100мс. */
+          wait_start = urpc_timer_get_monotonic_time ();
+          selected = urpc_network_wait_read (urpc_tcp_client->socket, 0.1);
+          urpc_tcp_client->rx_wait_time += urpc_timer_get_monotonic_time () - wait_start;
+          if (selected > 0)
+            read_status = urpc_tcp_client_receive (urpc_tcp_client);
+          else if (selected < 0 && urpc_network_last_error () != URPC_EINTR)
+            read_status = -1;
+          else
+            urpc_tcp_client->rx_retries += 1;
+
+          urpc_mutex_lock (&urpc_tcp_client->lock);
+          urpc_tcp_client_stop_reading (urpc_tcp_client, read_status);
+        }
+      else
+        {
+          urpc_cond_timed_wait (&urpc_tcp_client->cond, &urpc_tcp_client->lock, 0.1);
         }
 
-      if (selected == 0)
-        continue;
-
-      /* Отправляем данные. */
-      sr_size = send (urpc_tcp_client->socket, (char *) oheader + sended, send_size - sended, URPC_MSG_NOSIGNAL);
-      if (sr_size <= 0)
+      /* Проверка таймаута ожидания ответа. */
+      if (request->state != URPC_TCP_CLIENT_REQUEST_DONE &&
+          urpc_timer_elapsed (request->timer) > urpc_tcp_client->timeout)
         {
-          int error = urpc_network_last_error ();
-          if (error == URPC_EINTR || error == URPC_EAGAIN)
-            continue;
           urpc_tcp_client->fail = 1;
-          return URPC_STATUS_TRANSPORT_ERROR;
+          urpc_notify_set (urpc_tcp_client->notify);
+          urpc_cond_broadcast (&urpc_tcp_client->cond);
         }
-
-      sended += sr_size;
-
-      /* Перезапускаем таймер. */
-      urpc_timer_start (urpc_tcp_client->timer);
     }
+  request->state = URPC_TCP_CLIENT_REQUEST_LOCKED;
+  urpc_mutex_unlock (&urpc_tcp_client->lock);
 
-  /* Время начала приёма. */
-  urpc_timer_start (urpc_tcp_client->timer);
+  return status;
+}
 
-  /* Принимаем заголовок ответа. */
-  recv_size = sizeof (uRpcHeader);
-  while (received != recv_size)
-    {
-      /* Проверка таймаута при приёме данных. */
-      if (urpc_timer_elapsed (urpc_tcp_client->timer) > urpc_tcp_client->timeout)
-        {
-          urpc_tcp_client->fail = 1;
-          return URPC_STATUS_TRANSPORT_ERROR;
-        }
+uint32_t
+urpc_tcp_client_exchange_async (uRpcTCPClient          *urpc_tcp_client,
+                                uRpcData               *urpc_data,
+                                urpc_client_async_proc  async_proc,
+                                void                   *async_data)
+{
+  if (async_proc == NULL)
+    return URPC_STATUS_FAIL;
 
-      /* Проверяем возможность чтения из канала связи с интервалом в 100мс. */
-      FD_ZERO (&sock_set);
-      FD_SET (urpc_tcp_client->socket, &sock_set);
-      sock_tv.tv_sec = 0;
-      sock_tv.tv_usec = 100000;
+  return urpc_tcp_client_send (urpc_tcp_client, urpc_data, async_proc, async_data);
+}
 
-      selected = select ((int) (urpc_tcp_client->socket + 1), &sock_set, NULL, NULL, &sock_tv);
-      if (selected < 0)
-        {
-          int error = urpc_network_last_error ();
-          if (error == URPC_EINTR)
-            continue;
-          urpc_tcp_client->fail = 1;
-          return URPC_STATUS_TRANSPORT_ERROR;
-        }
+int
+urpc_tcp_client_receive_async (uRpcTCPClient *urpc_tcp_client)
+{
+  int read_status = 0;
 
-      if (selected == 0)
-        continue;
+  if (urpc_tcp_client->urpc_tcp_client_type != URPC_TCP_CLIENT_TYPE)
+    return -1;
 
-      /* Считываем данные. */
-      sr_size =  recv (urpc_tcp_client->socket, (char *) iheader + received, 
-                       recv_size - received, URPC_MSG_NOSIGNAL);
-      if (sr_size <= 0)
-        {
-          int error = urpc_network_last_error ();
-          if (error == URPC_EINTR || error == URPC_EAGAIN)
-            continue;
-          urpc_tcp_client->fail = 1;
-          return URPC_STATUS_TRANSPORT_ERROR;
-        }
+  /* Если ответы принимает поток ожидающий синхронный запрос, о принятых им
+     ответах на асинхронные запросы он оповестит через дескриптор оповещения. */
+  urpc_mutex_lock (&urpc_tcp_client->lock);
+  if (!urpc_tcp_client->fail && !urpc_tcp_client->reading)
+    {
+      urpc_tcp_client->reading = 1;
+      urpc_mutex_unlock (&urpc_tcp_client->lock);
 
-      received += sr_size;
+      read_status = urpc_tcp_client_receive (urpc_tcp_client);
 
-      /* Перезапускаем таймер. */
-      urpc_timer_start (urpc_tcp_client->timer);
+      urpc_mutex_lock (&urpc_tcp_client->lock);
+      urpc_tcp_client_stop_reading (urpc_tcp_client, read_status);
     }
 
-  /* Проверяем заголовок ответа. */
-  if (UINT32_FROM_BE (iheader->magic) != URPC_MAGIC)
-    {
-      urpc_tcp_client->fail = 1;
-      return URPC_STATUS_TRANSPORT_ERROR;
-    }
-  recv_size = UINT32_FROM_BE (iheader->size);
-  if (recv_size > urpc_tcp_client->buffer_size)
-    {
-      urpc_tcp_client->fail = 1;
-      return URPC_STATUS_TRANSPORT_ERROR;
-    }
+  /* Оповещение сбрасывается до поиска завершённых запросов, поэтому запросы,
+     завершённые после сброса, будут обработаны при следующем оповещении. */
+  urpc_notify_clear (urpc_tcp_client->notify);
+  urpc_mutex_unlock (&urpc_tcp_client->lock);
 
-  /* Принимаем данные ответа. */
-  while (received != recv_size)
-    {
-      /* Проверка таймаута при приёме данных. */
-      if (urpc_timer_elapsed (urpc_tcp_client->timer) > urpc_tcp_client->timeout)
-        {
-          urpc_tcp_client->fail = 1;
-          return URPC_STATUS_TRANSPORT_ERROR;
-        }
+  return read_status;
+}
 
-      /* Проверяем возможность чтения из канала связи с интервалом в 100мс. */
-      FD_ZERO (&sock_set);
-      FD_SET (urpc_tcp_client->socket, &sock_set);
-      sock_tv.tv_sec = 0;
-      sock_tv.tv_usec = 100000;
+uRpcData *
+urpc_tcp_client_get_completed (uRpcTCPClient          *urpc_tcp_client,
+                               uint32_t               *status,
+                               urpc_client_async_proc *async_proc,
+                               void                  **async_data)
+{
+  uRpcTCPClientRequest *request;
+  uRpcData *urpc_data = NULL;
+  unsigned int i;
 
-      selected = select ((int) (urpc_tcp_client->socket + 1), &sock_set, NULL, NULL, &sock_tv);
-      if (selected < 0)
-        {
-          int error = urpc_network_last_error ();
-          if (error == URPC_EINTR)
-            continue;
-          urpc_tcp_client->fail = 1;
-          return URPC_STATUS_TRANSPORT_ERROR;
-        }
+  if (urpc_tcp_client->urpc_tcp_client_type != URPC_TCP_CLIENT_TYPE)
+    return NULL;
 
-      if (selected == 0)
+  /* Ищем асинхронный запрос на который получен ответ, или который завершился
+     с ошибкой. Превышение времени ожидания ответа переводит соединение в состояние
+     ошибки так же как и для синхронных запросов. */
+  urpc_mutex_lock (&urpc_tcp_client->lock);
+  for (i = 0; i < URPC_MAX_REQUESTS_NUM; i++)
+    {
+      request = &urpc_tcp_client->requests[i];
+      if (request->async_proc == NULL)
         continue;
 
-      /* Считываем данные. */
-      sr_size = recv (urpc_tcp_client->socket, (char *) iheader + received,
-                      recv_size - received, URPC_MSG_NOSIGNAL);
-      if (sr_size <= 0)
+      if (request->state == URPC_TCP_CLIENT_REQUEST_WAITING && !urpc_tcp_client->fail &&
+          urpc_timer_elapsed (request->timer) > urpc_tcp_client->timeout)
         {
-          int error = urpc_network_last_error ();
-          if (error == URPC_EINTR || error == URPC_EAGAIN)
-            continue;
           urpc_tcp_client->fail = 1;
-          return URPC_STATUS_TRANSPORT_ERROR;
+          urpc_notify_set (urpc_tcp_client->notify);
+          urpc_cond_broadcast (&urpc_tcp_client->cond);
         }
 
-      received += sr_size;
+      if (request->state == URPC_TCP_CLIENT_REQUEST_DONE)
+        *status = URPC_STATUS_OK;
+      else if (request->state == URPC_TCP_CLIENT_REQUEST_WAITING && urpc_tcp_client->fail &&
+               !urpc_tcp_client->reading)
+        *status = URPC_STATUS_TRANSPORT_ERROR;
+      else
+        continue;
 
-      /* Перезапускаем таймер. */
-      urpc_timer_start (urpc_tcp_client->timer);
+      *async_proc = request->async_proc;
+      *async_data = request->async_data;
+      request->async_proc = NULL;
+      request->async_data = NULL;
+      request->state = URPC_TCP_CLIENT_REQUEST_LOCKED;
+      urpc_data = request->urpc_data;
+      break;
     }
+  urpc_mutex_unlock (&urpc_tcp_client->lock);
 
-  urpc_data_set_data_size (urpc_tcp_client->urpc_data, URPC_DATA_INPUT, recv_size - URPC_HEADER_SIZE);
+  return urpc_data;
+}
 
-  return URPC_STATUS_OK;
+void
+urpc_tcp_client_unlock (uRpcTCPClient *urpc_tcp_client,
+                        uRpcData      *urpc_data)
+{
+  uRpcTCPClientRequest *request;
+
+  if (urpc_tcp_client->urpc_tcp_client_type != URPC_TCP_CLIENT_TYPE)
+    return;
+
+  request = urpc_tcp_client_find_request (urpc_tcp_client, urpc_data);
+  if (request == NULL)
+    return;
+
+  /* Освобождаем запрос. */
+  urpc_mutex_lock (&urpc_tcp_client->lock);
+  request->state = URPC_TCP_CLIENT_REQUEST_FREE;
+  urpc_cond_broadcast (&urpc_tcp_client->cond);
+  urpc_mutex_unlock (&urpc_tcp_client->lock);
+}
+
+void
+urpc_tcp_client_get_stats (uRpcTCPClient   *urpc_tcp_client,
+                           uRpcClientStats *stats)
+{
+  if (urpc_tcp_client->urpc_tcp_client_type != URPC_TCP_CLIENT_TYPE)
+    return;
+
+  stats->retries += urpc_tcp_client->tx_retries + urpc_tcp_client->rx_retries;
+  stats->wait_time += (uint64_t) (1e9 * (urpc_tcp_client->tx_wait_time + urpc_tcp_client->rx_wait_time));
 }
 
 const char *
@@ -444,3 +847,61 @@ urpc_tcp_client_get_peer_address (uRpcTCPClient *urpc_tcp_client)
 
   return urpc_tcp_client->peer_address;
 }
+
+SOCKET
+urpc_tcp_client_get_socket (uRpcTCPClient *urpc_tcp_client)
+{
+  if (urpc_tcp_client->urpc_tcp_client_type != URPC_TCP_CLIENT_TYPE)
+    return INVALID_SOCKET;
+
+  return urpc_tcp_client->socket;
+}
+
+SOCKET
+urpc_tcp_client_get_event_fd (uRpcTCPClient *urpc_tcp_client)
+{
+  if (urpc_tcp_client->urpc_tcp_client_type != URPC_TCP_CLIENT_TYPE)
+    return INVALID_SOCKET;
+
+  return urpc_notify_get_fd (urpc_tcp_client->notify);
+}
+
+double
+urpc_tcp_client_get_timeout (uRpcTCPClient *urpc_tcp_client)
+{
+  uRpcTCPClientRequest *request;
+  double timeout = -1.0;
+  double remain;
+  unsigned int i;
+
+  if (urpc_tcp_client->urpc_tcp_client_type != URPC_TCP_CLIENT_TYPE)
+    return -1.0;
+
+  /* Время до истечения таймаута ближайшего асинхронного запроса. Если есть
+     завершённые, но не обработанные запросы, ожидать не нужно. */
+  urpc_mutex_lock (&urpc_tcp_client->lock);
+  for (i = 0; i < URPC_MAX_REQUESTS_NUM; i++)
+    {
+      request = &urpc_tcp_client->requests[i];
+      if (request->async_proc == NULL)
+        continue;
+
+      if (request->state == URPC_TCP_CLIENT_REQUEST_DONE || urpc_tcp_client->fail)
+        {
+          timeout = 0.0;
+          break;
+        }
+
+      if (request->state != URPC_TCP_CLIENT_REQUEST_WAITING)
+        continue;
+
+      remain = urpc_tcp_client->timeout - urpc_timer_elapsed (request->timer);
+      if (remain < 0.0)
+        remain = 0.0;
+      if (timeout < 0.0 || remain < timeout)
+        timeout = remain;
+    }
+  urpc_mutex_unlock (&urpc_tcp_client->lock);
+
+  return timeout;
+}
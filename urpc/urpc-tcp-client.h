@@ -29,8 +29,11 @@
 #ifndef __URPC_TCP_CLIENT_H__
 #define __URPC_TCP_CLIENT_H__
 
+#include <urpc-network.h>
 #include <urpc-types.h>
 #include <urpc-data.h>
+#include <urpc-stats.h>
+#include <urpc-client.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -47,11 +50,42 @@ uRpcTCPClient *urpc_tcp_client_create                  (const char            *u
 /* Функция удаляет клиента. */
 void           urpc_tcp_client_destroy                 (uRpcTCPClient         *urpc_tcp_client);
 
-/* Функция блокирует канал связи. */
+/* Функция возвращает буферы приёма-передачи свободного запроса. Одновременно
+   может выполняться до URPC_MAX_REQUESTS_NUM запросов, при их исчерпании функция
+   ожидает освобождения одного из запросов. */
 uRpcData      *urpc_tcp_client_lock                    (uRpcTCPClient         *urpc_tcp_client);
 
-/* Функция производит отправку запроса серверу и приём от него ответа. */
-uint32_t       urpc_tcp_client_exchange                (uRpcTCPClient         *urpc_tcp_client);
+/* Функция производит отправку запроса серверу и приём от него ответа. Функция
+   может вызываться одновременно из нескольких потоков для разных запросов, ответы
+   сервера сопоставляются с запросами по идентификатору. */
+uint32_t       urpc_tcp_client_exchange                (uRpcTCPClient         *urpc_tcp_client,
+                                                        uRpcData              *urpc_data);
+
+/* Функция отправляет запрос серверу не дожидаясь ответа. После приёма ответа
+   запрос возвращается функцией urpc_tcp_client_get_completed. */
+uint32_t       urpc_tcp_client_exchange_async          (uRpcTCPClient         *urpc_tcp_client,
+                                                        uRpcData              *urpc_data,
+                                                        urpc_client_async_proc async_proc,
+                                                        void                  *async_data);
+
+/* Функция принимает доступные в канале связи ответы сервера без ожидания и
+   сбрасывает оповещение о завершении асинхронных запросов. */
+int            urpc_tcp_client_receive_async           (uRpcTCPClient         *urpc_tcp_client);
+
+/* Функция возвращает один из завершившихся асинхронных запросов, статус его
+   выполнения и параметры переданные в urpc_tcp_client_exchange_async. */
+uRpcData      *urpc_tcp_client_get_completed           (uRpcTCPClient         *urpc_tcp_client,
+                                                        uint32_t              *status,
+                                                        urpc_client_async_proc *async_proc,
+                                                        void                 **async_data);
+
+/* Функция освобождает запрос. */
+void           urpc_tcp_client_unlock                  (uRpcTCPClient         *urpc_tcp_client,
+                                                        uRpcData              *urpc_data);
+
+/* Функция добавляет в статистику клиента число повторных ожиданий и время ожидания транспорта. */
+void           urpc_tcp_client_get_stats               (uRpcTCPClient         *urpc_tcp_client,
+                                                        uRpcClientStats       *stats);
 
 /* Функция возвращает указатель на строку с локальным адресом в формате URI. */
 const char    *urpc_tcp_client_get_self_address        (uRpcTCPClient         *urpc_tcp_client);
@@ -59,6 +93,18 @@ const char    *urpc_tcp_client_get_self_address        (uRpcTCPClient         *u
 /* Функция возвращает указатель на строку с адресом сервера в формате URI. */
 const char    *urpc_tcp_client_get_peer_address        (uRpcTCPClient         *urpc_tcp_client);
 
+/* Функция возвращает рабочий сокет клиента. */
+SOCKET         urpc_tcp_client_get_socket              (uRpcTCPClient         *urpc_tcp_client);
+
+/* Функция возвращает дескриптор оповещения о завершении асинхронных запросов. Оповещение
+   устанавливается, если ответ на асинхронный запрос принят потоком, ожидающим синхронный
+   запрос, или соединение стало неисправным, и сбрасывается urpc_tcp_client_receive_async. */
+SOCKET         urpc_tcp_client_get_event_fd            (uRpcTCPClient         *urpc_tcp_client);
+
+/* Функция возвращает время до истечения таймаута ближайшего асинхронного запроса,
+   0 - если есть завершённые запросы, или -1 если асинхронных запросов нет. */
+double         urpc_tcp_client_get_timeout             (uRpcTCPClient         *urpc_tcp_client);
+
 #ifdef __cplusplus
 }
 #endif
@@ -25,26 +25,80 @@
 
 #include "urpc-tcp-server.h"
 #include "urpc-common.h"
+#include "urpc-vmem.h"
 #include "urpc-thread.h"
+#include "urpc-mutex.h"
 #include "urpc-rwmutex.h"
 #include "urpc-network.h"
 #include "urpc-timer.h"
 #include "urpc-endian.h"
+#include "urpc-hash-table.h"
+#include "urpc-uring.h"
 
 #include <stdlib.h>
 
+#if defined(__linux__)
+#include <sys/epoll.h>
+#define URPC_TCP_SERVER_EPOLL
+#define URPC_TCP_SERVER_URING
+#endif
+
+/* Размер ответа, начиная с которого он передаётся без копирования. Для небольших
+   ответов ожидание освобождения буфера обходится дороже копирования. */
+#define URPC_TCP_SERVER_ZC_SIZE 65536
+
+/* Объём начала буферов приёма-передачи, память которого не возвращается системе.
+   Память буферов выделяется системой при первом обращении, после больших запросов
+   и ответов страницы за этой границей освобождаются. */
+#define URPC_TCP_SERVER_KEEP_SIZE 65536
+
+/* Признак операции отмены в идентификаторе операции io_uring. */
+#define URPC_TCP_SERVER_URING_CANCEL ((uint64_t) 1 << 63)
+
 #define URPC_TCP_SERVER_TYPE 0x53504354
 
+#define URPC_TCP_SERVER_NO_CLIENT 0xFFFFFFFF
+
+/* Подключенный клиент. */
+typedef struct
+{
+  SOCKET               socket;                 /* Рабочий сокет клиента. */
+  uint32_t             id;                     /* Идентификатор подключения, 0 - запись не используется. */
+  uint32_t             refs;                   /* Число потоков обслуживающих запросы клиента. */
+  uint32_t             closed;                 /* Признак отключения клиента. */
+  uint32_t             reading;                /* Признак приёма запроса одним из потоков. */
+  uint32_t             position;               /* Позиция в списке подключенных клиентов или
+                                                  индекс следующей свободной записи. */
+  uRpcMutex            send_lock;              /* Блокировка отправки ответов клиенту. */
+} uRpcTCPServerClient;
+
+/* Состояние io_uring рабочего потока. */
+typedef struct
+{
+  uRpcUring           *uring;                  /* Кольцо io_uring или NULL. */
+  uint64_t             op;                     /* Идентификатор последней операции. */
+  int                  fixed;                  /* Признак передачи ответа без копирования:
+                                                  URPC_URING_UNREGISTERED или -1. */
+} uRpcTCPServerUring;
+
 struct _uRpcTCPServer
 {
   uint32_t             urpc_tcp_server_type;   /* Тип объекта uRpcTCPServer. */
 
   SOCKET               lsocket;                /* Сокет входящих подключений клиентов. */
+#if defined(URPC_TCP_SERVER_EPOLL)
+  int                  epoll_fd;               /* Дескриптор epoll для ожидания запросов. */
+#endif
 
-  SOCKET              *wsockets;               /* Рабочие сокеты подключенных клиентов. */
-  SOCKET              *wsockets_per_threads;   /* Рабочие сокеты обслуживаемые потоками сервера. */
+  uRpcTCPServerClient *clients;                /* Таблица клиентов. */
+  uint32_t            *active;                 /* Индексы подключенных клиентов. */
+  uint32_t             free_client;            /* Индекс первой свободной записи таблицы клиентов. */
+  uRpcHashTable       *ids;                    /* Индексы клиентов по идентификаторам подключений. */
+  uint32_t             last_client_id;         /* Идентификатор последнего подключения. */
+  uint32_t            *clients_per_threads;    /* Индексы клиентов обслуживаемых потоками сервера. */
 
   uint32_t             buffer_size;            /* Размер буфера приёма-передачи. */
+  void               **buffers;                /* Буферы приёма-передачи, по два на поток. */
   uRpcData           **urpc_data;              /* Указатель на объекты RPC данных. */
   uint32_t             threads_num;            /* Число рабочих потоков. */
   uint32_t             max_clients;            /* Максимальное число подключенных клиентов. */
@@ -53,12 +107,119 @@ struct _uRpcTCPServer
   uRpcTimer          **timers;                 /* Таймаут таймеры. */
   double               timeout;                /* Таймаут обмена данными. */
 
+  uRpcTCPServerUring  *urings;                 /* Состояние io_uring рабочих потоков. */
+
   uRpcThread          *connector;              /* Поток обслуживания новых подключений. */
   volatile uint32_t    connector_status;       /* Признак запуска потока. */
   volatile uint32_t    shutdown;               /* Признак завершения работы. */
   uRpcRWMutex          lock;                   /* Блокировка доступа к критическим данным структуры. */
 };
 
+#if defined(URPC_TCP_SERVER_EPOLL)
+
+/* Функция регистрирует сокет клиента в epoll или повторно разрешает получение событий от него.
+   Сокеты регистрируются с флагом EPOLLONESHOT, поэтому о готовности сокета к чтению
+   узнаёт только один из ожидающих потоков. Следующее событие будет получено только
+   после повторного разрешения, т.е. после приёма запроса целиком. Вместе с событием
+   передаются индекс клиента в таблице и идентификатор подключения. */
+static int
+urpc_tcp_server_epoll_arm (uRpcTCPServer *urpc_tcp_server,
+                           uint32_t       index,
+                           int            op)
+{
+  uRpcTCPServerClient *client = &urpc_tcp_server->clients[index];
+  struct epoll_event event;
+
+  event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+  event.data.u64 = ((uint64_t) client->id << 32) | index;
+
+  return epoll_ctl (urpc_tcp_server->epoll_fd, op, client->socket, &event);
+}
+
+#endif
+
+/* Функция освобождает запись клиента и закрывает его сокет. Вызывается
+   при заблокированной структуре после отключения клиента и завершения
+   обработки всех его запросов. */
+static void
+urpc_tcp_server_release_client (uRpcTCPServer *urpc_tcp_server,
+                                uint32_t       index)
+{
+  uRpcTCPServerClient *client = &urpc_tcp_server->clients[index];
+
+  closesocket (client->socket);
+  client->socket = INVALID_SOCKET;
+  client->id = 0;
+  client->closed = 0;
+  client->reading = 0;
+  client->position = urpc_tcp_server->free_client;
+  urpc_tcp_server->free_client = index;
+}
+
+/* Функция добавляет сокет в список подключенных клиентов и возвращает индекс клиента. */
+static uint32_t
+urpc_tcp_server_add_client (uRpcTCPServer *urpc_tcp_server,
+                            SOCKET         wsocket)
+{
+  uRpcTCPServerClient *client;
+  uint32_t index = URPC_TCP_SERVER_NO_CLIENT;
+  uint32_t client_id;
+
+  /* Подключенные клиенты размещаются в начале списка без пропусков, позиция
+     клиента в списке запоминается для его быстрого удаления. */
+  urpc_rwmutex_writer_lock (&urpc_tcp_server->lock);
+  if (urpc_tcp_server->cur_clients < urpc_tcp_server->max_clients &&
+      urpc_tcp_server->free_client != URPC_TCP_SERVER_NO_CLIENT)
+    {
+      /* Генерируем новый идентификатор подключения. */
+      client_id = urpc_tcp_server->last_client_id;
+      do
+        {
+          client_id += 1;
+        }
+      while (client_id == 0 || urpc_hash_table_find_uint32 (urpc_tcp_server->ids, client_id) != 0);
+
+      index = urpc_tcp_server->free_client;
+      if (urpc_hash_table_insert_uint32 (urpc_tcp_server->ids, client_id, index + 1) == 0)
+        {
+          client = &urpc_tcp_server->clients[index];
+          urpc_tcp_server->free_client = client->position;
+          urpc_tcp_server->last_client_id = client_id;
+
+          client->socket = wsocket;
+          client->id = client_id;
+          client->refs = 0;
+          client->closed = 0;
+          client->reading = 0;
+          client->position = urpc_tcp_server->cur_clients;
+
+          urpc_tcp_server->active[urpc_tcp_server->cur_clients] = index;
+          urpc_tcp_server->cur_clients += 1;
+        }
+      else
+        {
+          index = URPC_TCP_SERVER_NO_CLIENT;
+        }
+    }
+  urpc_rwmutex_writer_unlock (&urpc_tcp_server->lock);
+
+  return index;
+}
+
+/* Функция завершает обслуживание запроса клиента потоком. */
+static void
+urpc_tcp_server_unref_client (uRpcTCPServer *urpc_tcp_server,
+                              uint32_t       index)
+{
+  uRpcTCPServerClient *client = &urpc_tcp_server->clients[index];
+
+  urpc_rwmutex_writer_lock (&urpc_tcp_server->lock);
+  client->refs -= 1;
+  if (client->closed && client->refs == 0)
+    urpc_tcp_server_release_client (urpc_tcp_server, index);
+  urpc_rwmutex_writer_unlock (&urpc_tcp_server->lock);
+}
+
 /* Функция обслуживания новых подключений в потоке. */
 static void *
 urpc_tcp_server_func (void *data)
@@ -69,59 +230,61 @@ urpc_tcp_server_func (void *data)
 
   while (!urpc_tcp_server->shutdown)
     {
-      fd_set sock_set;
-      struct timeval sock_tv;
       int selected;
 
       SOCKET wsocket;
-      unsigned int i;
+      uint32_t index;
 
-      /* Ожидаем новых подключений клиентов в течение 100мс. */
-      FD_ZERO (&sock_set);
-      sock_tv.tv_sec = 0;
-      sock_tv.tv_usec = 100000;
-      FD_SET (urpc_tcp_server->lsocket, &sock_set);
+      /* Достигнуто максимальное число клиентов, новые подключения остаются в очереди. */
+      if (urpc_tcp_server->cur_clients == urpc_tcp_server->max_clients)
+        {
+          urpc_timer_sleep (0.1);
+          continue;
+        }
 
-      selected = select ((int) (urpc_tcp_server->lsocket + 1), &sock_set, NULL, NULL, &sock_tv);
+      /* Ожидаем новых подключений клиентов в течение 100мс. */
+      selected = urpc_network_wait_read (urpc_tcp_server->lsocket, 0.1);
       if (selected < 0)
         {
           if (urpc_network_last_error () == URPC_EINTR)
-            return NULL;
+            continue;
           break;
         }
       if (selected == 0)
         continue;
 
-      /* Достигнуто максимальное число клиентов. */
-      if (urpc_tcp_server->cur_clients == urpc_tcp_server->max_clients)
-        continue;
-
-      /* Проверяем наличие новых клиентов. */
-      wsocket = accept (urpc_tcp_server->lsocket, NULL, NULL);
-      if (wsocket == INVALID_SOCKET)
+      /* Принимаем все ожидающие подключения. */
+      while (urpc_tcp_server->cur_clients < urpc_tcp_server->max_clients)
         {
-          int accept_error = urpc_network_last_error ();
-          if (accept_error == URPC_EINTR || accept_error == URPC_EAGAIN)
-            continue;
-          break;
-        }
+          wsocket = accept (urpc_tcp_server->lsocket, NULL, NULL);
+          if (wsocket == INVALID_SOCKET)
+            {
+              int accept_error = urpc_network_last_error ();
 
-      /* Для нового соединения устанавливаем не блокирующий режим работы,
-         отключаем задержку при передаче данных и запоминаем его. */
-      urpc_network_set_tcp_nodelay (wsocket);
-      urpc_network_set_non_block (wsocket);
+              /* Нехватка ресурсов (например дескрипторов), повторим попытку позже. */
+              if (accept_error != URPC_EINTR && accept_error != URPC_EAGAIN)
+                urpc_timer_sleep (0.1);
+              break;
+            }
 
-      urpc_rwmutex_writer_lock (&urpc_tcp_server->lock);
-      for (i = 0; i < urpc_tcp_server->max_clients; i++)
-        {
-          if (urpc_tcp_server->wsockets[i] == INVALID_SOCKET)
+          /* Для нового соединения устанавливаем не блокирующий режим работы,
+             отключаем задержку при передаче данных и запоминаем его. */
+          urpc_network_set_tcp_nodelay (wsocket);
+          urpc_network_set_non_block (wsocket);
+
+          index = urpc_tcp_server_add_client (urpc_tcp_server, wsocket);
+          if (index == URPC_TCP_SERVER_NO_CLIENT)
             {
-              urpc_tcp_server->wsockets[i] = wsocket;
-              urpc_tcp_server->cur_clients += 1;
-              break;
+              closesocket (wsocket);
+              continue;
             }
+
+#if defined(URPC_TCP_SERVER_EPOLL)
+          /* Начинаем ожидать запросы от нового клиента. */
+          if (urpc_tcp_server_epoll_arm (urpc_tcp_server, index, EPOLL_CTL_ADD) < 0)
+            urpc_tcp_server_remove_client (urpc_tcp_server, urpc_tcp_server->clients[index].id);
+#endif
         }
-      urpc_rwmutex_writer_unlock (&urpc_tcp_server->lock);
     }
 
   urpc_tcp_server->connector_status = 0;
@@ -134,6 +297,7 @@ urpc_tcp_server_create (const char *uri,
                         uint32_t    threads_num,
                         uint32_t    max_clients,
                         uint32_t    max_data_size,
+                        int         use_uring,
                         double      timeout)
 {
   uRpcTCPServer *urpc_tcp_server = NULL;
@@ -141,12 +305,16 @@ urpc_tcp_server_create (const char *uri,
   unsigned int i;
 
   /* Проверка ограничений. */
+#if !defined(URPC_TCP_SERVER_EPOLL)
   if (max_clients > FD_SETSIZE)
     return NULL;
+#endif
+  if (max_clients == 0 || max_clients == URPC_TCP_SERVER_NO_CLIENT)
+    return NULL;
   if (max_data_size > URPC_MAX_DATA_SIZE)
     return NULL;
-  if (threads_num > URPC_MAX_THREADS_NUM)
-    threads_num = URPC_MAX_THREADS_NUM;
+  if (threads_num > URPC_MAX_CONTEXTS_NUM)
+    threads_num = URPC_MAX_CONTEXTS_NUM;
   if (timeout < URPC_MIN_TIMEOUT)
     timeout = URPC_MIN_TIMEOUT;
   max_data_size += URPC_HEADER_SIZE;
@@ -162,21 +330,42 @@ urpc_tcp_server_create (const char *uri,
 
   urpc_tcp_server->urpc_tcp_server_type = URPC_TCP_SERVER_TYPE;
   urpc_tcp_server->lsocket = INVALID_SOCKET;
-  urpc_tcp_server->wsockets = NULL;
-  urpc_tcp_server->wsockets_per_threads = NULL;
+#if defined(URPC_TCP_SERVER_EPOLL)
+  urpc_tcp_server->epoll_fd = -1;
+#endif
+  urpc_tcp_server->clients = NULL;
+  urpc_tcp_server->active = NULL;
+  urpc_tcp_server->free_client = URPC_TCP_SERVER_NO_CLIENT;
+  urpc_tcp_server->ids = NULL;
+  urpc_tcp_server->last_client_id = 0;
+  urpc_tcp_server->clients_per_threads = NULL;
   urpc_tcp_server->buffer_size = max_data_size;
+  urpc_tcp_server->buffers = NULL;
   urpc_tcp_server->urpc_data = NULL;
   urpc_tcp_server->threads_num = threads_num;
   urpc_tcp_server->max_clients = max_clients;
   urpc_tcp_server->cur_clients = 0;
   urpc_tcp_server->timers = NULL;
   urpc_tcp_server->timeout = timeout;
+  urpc_tcp_server->urings = NULL;
   urpc_tcp_server->connector = NULL;
   urpc_tcp_server->connector_status = 0;
   urpc_tcp_server->shutdown = 0;
   urpc_rwmutex_init (&urpc_tcp_server->lock);
 
-  /* Буферы приёма-передачи. */
+  /* Буферы приёма-передачи. Для буферов резервируется адресное пространство максимального
+     размера, а память выделяется системой только под фактически принятые и записанные
+     данные. Адреса буферов не меняются, поэтому указатели на данные, полученные
+     процедурами, остаются действительными до отправки ответа. */
+  urpc_tcp_server->buffers = calloc (2 * threads_num, sizeof (void *));
+  if (urpc_tcp_server->buffers == NULL)
+    goto urpc_tcp_server_create_fail;
+  for (i = 0; i < 2 * threads_num; i++)
+    {
+      urpc_tcp_server->buffers[i] = urpc_vmem_alloc (max_data_size);
+      if (urpc_tcp_server->buffers[i] == NULL)
+        goto urpc_tcp_server_create_fail;
+    }
   urpc_tcp_server->urpc_data = malloc (threads_num * sizeof (uRpcData *));
   if (urpc_tcp_server->urpc_data == NULL)
     goto urpc_tcp_server_create_fail;
@@ -184,7 +373,9 @@ urpc_tcp_server_create (const char *uri,
     urpc_tcp_server->urpc_data[i] = NULL;
   for (i = 0; i < threads_num; i++)
     {
-      urpc_tcp_server->urpc_data[i] = urpc_data_create (max_data_size, sizeof (uRpcHeader), NULL, NULL, 0);
+      urpc_tcp_server->urpc_data[i] = urpc_data_create (max_data_size, sizeof (uRpcHeader),
+                                                        urpc_tcp_server->buffers[2 * i],
+                                                        urpc_tcp_server->buffers[2 * i + 1], 0);
       if (urpc_tcp_server->urpc_data[i] == NULL)
         goto urpc_tcp_server_create_fail;
     }
@@ -202,19 +393,66 @@ urpc_tcp_server_create (const char *uri,
         goto urpc_tcp_server_create_fail;
     }
 
-  /* Массив рабочих сокетов обслуживаемых потоками. */
-  urpc_tcp_server->wsockets = malloc (max_clients * sizeof (SOCKET));
-  if (urpc_tcp_server->wsockets == NULL)
+  /* Кольца io_uring. Если io_uring не поддерживается, данные передаются обычным образом.
+     Регистрация буфера ответа в ядре закрепила бы в памяти все его страницы, поэтому
+     буфер не регистрируется и большие ответы передаются без копирования из
+     незарегистрированного буфера.
+     Каждое кольцо занимает файловый дескриптор, поэтому кольца создаются не более чем
+     для URPC_MAX_THREADS_NUM контекстов, остальные используют обычные системные вызовы. */
+  urpc_tcp_server->urings = calloc (threads_num, sizeof (uRpcTCPServerUring));
+  if (urpc_tcp_server->urings == NULL)
+    goto urpc_tcp_server_create_fail;
+#if defined(URPC_TCP_SERVER_URING)
+  for (i = 0; use_uring && i < threads_num && i < URPC_MAX_THREADS_NUM; i++)
+    {
+      uRpcTCPServerUring *uring = &urpc_tcp_server->urings[i];
+
+      uring->uring = urpc_uring_create (4);
+      uring->fixed = URPC_URING_UNREGISTERED;
+      if (uring->uring == NULL)
+        break;
+    }
+#endif
+
+  /* Таблица клиентов, все записи помещаются в список свободных. */
+  urpc_tcp_server->clients = malloc (max_clients * sizeof (uRpcTCPServerClient));
+  if (urpc_tcp_server->clients == NULL)
     goto urpc_tcp_server_create_fail;
   for (i = 0; i < max_clients; i++)
-    urpc_tcp_server->wsockets[i] = INVALID_SOCKET;
+    {
+      urpc_tcp_server->clients[i].socket = INVALID_SOCKET;
+      urpc_tcp_server->clients[i].id = 0;
+      urpc_tcp_server->clients[i].refs = 0;
+      urpc_tcp_server->clients[i].closed = 0;
+      urpc_tcp_server->clients[i].reading = 0;
+      urpc_tcp_server->clients[i].position = (i + 1 < max_clients) ? i + 1 : URPC_TCP_SERVER_NO_CLIENT;
+      urpc_mutex_init (&urpc_tcp_server->clients[i].send_lock);
+    }
+  urpc_tcp_server->free_client = 0;
+
+  /* Список подключенных клиентов. */
+  urpc_tcp_server->active = malloc (max_clients * sizeof (uint32_t));
+  if (urpc_tcp_server->active == NULL)
+    goto urpc_tcp_server_create_fail;
 
-  /* Массив сокетов подключенных клиентов. */
-  urpc_tcp_server->wsockets_per_threads = malloc (threads_num * sizeof (SOCKET));
-  if (urpc_tcp_server->wsockets_per_threads == NULL)
+  /* Таблица индексов клиентов. */
+  urpc_tcp_server->ids = urpc_hash_table_create (NULL);
+  if (urpc_tcp_server->ids == NULL)
+    goto urpc_tcp_server_create_fail;
+
+  /* Массив клиентов обслуживаемых потоками. */
+  urpc_tcp_server->clients_per_threads = malloc (threads_num * sizeof (uint32_t));
+  if (urpc_tcp_server->clients_per_threads == NULL)
     goto urpc_tcp_server_create_fail;
   for (i = 0; i < threads_num; i++)
-    urpc_tcp_server->wsockets_per_threads[i] = INVALID_SOCKET;
+    urpc_tcp_server->clients_per_threads[i] = URPC_TCP_SERVER_NO_CLIENT;
+
+#if defined(URPC_TCP_SERVER_EPOLL)
+  /* Дескриптор ожидания запросов от клиентов. */
+  urpc_tcp_server->epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+  if (urpc_tcp_server->epoll_fd < 0)
+    goto urpc_tcp_server_create_fail;
+#endif
 
   /* Адрес сервера. */
   addr = urpc_get_sockaddr (uri);
@@ -228,7 +466,7 @@ urpc_tcp_server_create (const char *uri,
   urpc_network_set_reuse (urpc_tcp_server->lsocket);
   if (bind (urpc_tcp_server->lsocket, addr->ai_addr, (socklen_t) addr->ai_addrlen) < 0)
     goto urpc_tcp_server_create_fail;
-  if (listen (urpc_tcp_server->lsocket, 5) < 0)
+  if (listen (urpc_tcp_server->lsocket, SOMAXCONN) < 0)
     goto urpc_tcp_server_create_fail;
   urpc_network_set_non_block (urpc_tcp_server->lsocket);
 
@@ -274,19 +512,31 @@ urpc_tcp_server_destroy (uRpcTCPServer *urpc_tcp_server)
   if (urpc_tcp_server->lsocket != INVALID_SOCKET)
     closesocket (urpc_tcp_server->lsocket);
 
-  /* Удаляем таблицу подключенных клиентов (закрываем сокеты). */
-  if (urpc_tcp_server->wsockets != NULL)
+  /* Удаляем таблицу клиентов (закрываем сокеты). */
+  if (urpc_tcp_server->clients != NULL)
     {
       for (i = 0; i < urpc_tcp_server->max_clients; i++)
         {
-          if (urpc_tcp_server->wsockets[i] != INVALID_SOCKET)
-            closesocket (urpc_tcp_server->wsockets[i]);
+          if (urpc_tcp_server->clients[i].socket != INVALID_SOCKET)
+            closesocket (urpc_tcp_server->clients[i].socket);
+          urpc_mutex_clear (&urpc_tcp_server->clients[i].send_lock);
         }
-      free (urpc_tcp_server->wsockets);
+      free (urpc_tcp_server->clients);
     }
 
-  if (urpc_tcp_server->wsockets_per_threads != NULL)
-    free (urpc_tcp_server->wsockets_per_threads);
+  if (urpc_tcp_server->active != NULL)
+    free (urpc_tcp_server->active);
+
+  if (urpc_tcp_server->ids != NULL)
+    urpc_hash_table_destroy (urpc_tcp_server->ids);
+
+  if (urpc_tcp_server->clients_per_threads != NULL)
+    free (urpc_tcp_server->clients_per_threads);
+
+#if defined(URPC_TCP_SERVER_EPOLL)
+  if (urpc_tcp_server->epoll_fd >= 0)
+    close (urpc_tcp_server->epoll_fd);
+#endif
 
   /* Удаляем таймаут таймеры. */
   if (urpc_tcp_server->timers != NULL)
@@ -299,6 +549,17 @@ urpc_tcp_server_destroy (uRpcTCPServer *urpc_tcp_server)
       free (urpc_tcp_server->timers);
     }
 
+  /* Удаляем кольца io_uring до освобождения буферов, которые могут использоваться ядром. */
+  if (urpc_tcp_server->urings != NULL)
+    {
+      for (i = 0; i < urpc_tcp_server->threads_num; i++)
+        {
+          if (urpc_tcp_server->urings[i].uring != NULL)
+            urpc_uring_destroy (urpc_tcp_server->urings[i].uring);
+        }
+      free (urpc_tcp_server->urings);
+    }
+
   /* Освобождаем память буферов приёма-передачи. */
   if (urpc_tcp_server->urpc_data != NULL)
     {
@@ -310,144 +571,161 @@ urpc_tcp_server_destroy (uRpcTCPServer *urpc_tcp_server)
       free (urpc_tcp_server->urpc_data);
     }
 
+  if (urpc_tcp_server->buffers != NULL)
+    {
+      for (i = 0; i < 2 * urpc_tcp_server->threads_num; i++)
+        urpc_vmem_free (urpc_tcp_server->buffers[i], urpc_tcp_server->buffer_size);
+      free (urpc_tcp_server->buffers);
+    }
+
+  urpc_rwmutex_clear (&urpc_tcp_server->lock);
+
   free (urpc_tcp_server);
 }
 
-uRpcData *
-urpc_tcp_server_recv (uRpcTCPServer *urpc_tcp_server,
-                      uint32_t       thread_id)
+#if defined(URPC_TCP_SERVER_URING)
+
+/* Функция принимает (send = 0) или передаёт size байт данных через io_uring потока.
+   Каждая операция выполняется до приёма или передачи всех данных. Если операция не
+   завершилась за время таймаута обмена, она отменяется. При передаче без
+   копирования функция дожидается освобождения буфера ядром. */
+static int
+urpc_tcp_server_uring_io (uRpcTCPServer *urpc_tcp_server,
+                          uint32_t       thread_id,
+                          SOCKET         wsocket,
+                          char          *buffer,
+                          uint32_t       size,
+                          int            send,
+                          int            fixed)
 {
-  fd_set sock_set;
-  struct timeval sock_tv;
-
-  uRpcTimer *timer;
-  uRpcData *urpc_data;
-  uRpcHeader *iheader;
-
-  int selected;
-  unsigned int recv_size;
-  unsigned int received = 0;
-  int sr_size;
+  uRpcTCPServerUring *uring = &urpc_tcp_server->urings[thread_id];
+  uRpcUringEvent event;
+  uint32_t done = 0;
 
-  SOCKET max_fd = 0;
-  SOCKET wsocket = INVALID_SOCKET;
-
-  unsigned int i, j;
-
-  if (urpc_tcp_server->urpc_tcp_server_type != URPC_TCP_SERVER_TYPE)
-    return NULL;
-  if (thread_id > urpc_tcp_server->threads_num - 1)
-    return NULL;
-
-  /* Ожидаем запрос от клиента в течение 100мс. */
-  FD_ZERO (&sock_set);
-  sock_tv.tv_sec = 0;
-  sock_tv.tv_usec = 100000;
-
-  /* Список рабочих сокетов. */
-  urpc_rwmutex_reader_lock (&urpc_tcp_server->lock);
-  if (urpc_tcp_server->cur_clients == 0)
+  while (done != size)
     {
-      FD_SET (urpc_tcp_server->lsocket, &sock_set);
-      max_fd = urpc_tcp_server->lsocket;
-    }
-  else
-    {
-      for (i = 0; i < urpc_tcp_server->max_clients; i++)
+      uint64_t op = ++uring->op & ~URPC_TCP_SERVER_URING_CANCEL;
+      uint32_t events = 0;
+      uint32_t wait = 1;
+      int32_t result = 0;
+      int cancelled = 0;
+      int status;
+
+      if (send)
+        status = urpc_uring_send (uring->uring, (int) wsocket, buffer + done, size - done,
+                                  MSG_WAITALL | URPC_MSG_NOSIGNAL, fixed, op);
+      else
+        status = urpc_uring_recv (uring->uring, (int) wsocket, buffer + done, size - done,
+                                  MSG_WAITALL, -1, op);
+      if (status < 0)
+        return -1;
+
+      /* Ожидаем завершения операции и, при передаче без копирования, уведомления
+         об освобождении буфера. Обычно данные уже есть в сокете и операция
+         завершается при передаче ядру. События прерванных ранее операций пропускаются. */
+      while (wait > 0)
         {
-          if (urpc_tcp_server->wsockets[i] != INVALID_SOCKET)
+          if (urpc_uring_get_event (uring->uring, &event) == 0)
             {
-              FD_SET (urpc_tcp_server->wsockets[i], &sock_set);
-              if (urpc_tcp_server->wsockets[i] > max_fd)
-                max_fd = urpc_tcp_server->wsockets[i];
+              if (event.user_data == (op | URPC_TCP_SERVER_URING_CANCEL))
+                {
+                  wait -= 1;
+                }
+              else if (event.user_data == op)
+                {
+                  if (events++ == 0)
+                    result = event.result;
+                  if (event.more)
+                    wait += 1;
+                  wait -= 1;
+                }
+              continue;
             }
-        }
-    }
-  urpc_rwmutex_reader_unlock (&urpc_tcp_server->lock);
 
-  /* Ожидаем запрос. */
-  selected = select ((int) (max_fd + 1), &sock_set, NULL, NULL, &sock_tv);
-  if (selected <= 0)
-    return NULL;
-
-  /* Смотрим какой из клиентов прислал запрос. */
-  urpc_rwmutex_writer_lock (&urpc_tcp_server->lock);
-  urpc_tcp_server->wsockets_per_threads[thread_id] = INVALID_SOCKET;
-  for (i = 0; i < urpc_tcp_server->max_clients; i++)
-    {
-      wsocket = urpc_tcp_server->wsockets[i];
+          status = urpc_uring_submit (uring->uring, 1, urpc_tcp_server->timeout);
+          if (status < 0)
+            return -1;
+          if (status == 0)
+            continue;
 
-      if (urpc_tcp_server->wsockets[i] == INVALID_SOCKET)
-        continue;
+          /* Истёк таймаут - отменяем операцию и дожидаемся её завершения. Если
+             не освобождён буфер, ответ считается не отправленным. */
+          if (cancelled || events > 0)
+            return -1;
+          if (urpc_uring_cancel (uring->uring, op, op | URPC_TCP_SERVER_URING_CANCEL) < 0)
+            return -1;
+          cancelled = 1;
+          wait += 1;
+        }
 
-      if (FD_ISSET (wsocket, &sock_set))
+      /* Ядро не поддерживает передачу без копирования. */
+      if (result < 0 && fixed != -1 && (result == -EINVAL || result == -EOPNOTSUPP))
         {
-          /* Проверяем, что этот сокет не обслуживается в другом потоке. */
-          for (j = 0; j < urpc_tcp_server->threads_num; j++)
-            {
-              if (urpc_tcp_server->wsockets_per_threads[j] == wsocket)
-                break;
-            }
-          if (j == urpc_tcp_server->threads_num)
-            {
-              urpc_tcp_server->wsockets_per_threads[thread_id] = wsocket;
-              break;
-            }
+          uring->fixed = -1;
+          fixed = -1;
+          continue;
         }
+
+      /* Ошибка, отключение клиента или истечение таймаута. Отменённая операция
+         может вернуть число уже принятых байт. */
+      if (result <= 0 || cancelled)
+        return -1;
+
+      done += result;
     }
-  urpc_rwmutex_writer_unlock (&urpc_tcp_server->lock);
 
-  /* Нет запросов. */
-  if (urpc_tcp_server->wsockets_per_threads[thread_id] == INVALID_SOCKET)
-    return NULL;
+  return 0;
+}
 
-  timer = urpc_tcp_server->timers[thread_id];
-  urpc_data = urpc_tcp_server->urpc_data[thread_id];
-  iheader = urpc_data_get_header (urpc_data, URPC_DATA_INPUT);
+#endif
+
+/* Функция принимает из сокета клиента size байт данных. */
+static int
+urpc_tcp_server_read (uRpcTCPServer *urpc_tcp_server,
+                      uint32_t       thread_id,
+                      SOCKET         wsocket,
+                      char          *buffer,
+                      uint32_t       size)
+{
+  uRpcTimer *timer = urpc_tcp_server->timers[thread_id];
+  uint32_t received = 0;
+  int selected;
+  int sr_size;
+
+#if defined(URPC_TCP_SERVER_URING)
+  if (urpc_tcp_server->urings[thread_id].uring != NULL)
+    return urpc_tcp_server_uring_io (urpc_tcp_server, thread_id, wsocket, buffer, size, 0, -1);
+#endif
 
   /* Время начала приёма. */
   urpc_timer_start (timer);
 
-  /* Принимаем заголовок запроса. */
-  recv_size = sizeof (uRpcHeader);
-  while (received != recv_size)
+  while (received != size)
     {
-
       /* Проверка таймаута при приёме данных. */
       if (urpc_timer_elapsed (timer) > urpc_tcp_server->timeout)
-        {
-          urpc_tcp_server_remove_client (urpc_tcp_server, wsocket);
-          return NULL;
-        }
+        return -1;
 
       /* Проверяем возможность чтения из канала связи с интервалом в 100мс. */
-      FD_ZERO (&sock_set);
-      FD_SET (wsocket, &sock_set);
-      sock_tv.tv_sec = 0;
-      sock_tv.tv_usec = 100000;
-
-      selected = select ((int) (wsocket + 1), &sock_set, NULL, NULL, &sock_tv);
+      selected = urpc_network_wait_read (wsocket, 0.1);
       if (selected < 0)
         {
-          int error = urpc_network_last_error ();
-          if (error == URPC_EINTR)
+          if (urpc_network_last_error () == URPC_EINTR)
             continue;
-          urpc_tcp_server_remove_client (urpc_tcp_server, wsocket);
-          return NULL;
+          return -1;
         }
 
       if (selected == 0)
         continue;
 
       /* Считываем данные. */
-      sr_size = recv (wsocket, (char *) iheader + received, recv_size - received, URPC_MSG_NOSIGNAL);
+      sr_size = recv (wsocket, buffer + received, size - received, URPC_MSG_NOSIGNAL);
       if (sr_size <= 0)
         {
           int error = urpc_network_last_error ();
-          if (error == URPC_EINTR || error == URPC_EAGAIN)
+          if (sr_size < 0 && (error == URPC_EINTR || error == URPC_EAGAIN))
             continue;
-          urpc_tcp_server_remove_client (urpc_tcp_server, wsocket);
-          return NULL;
+          return -1;
         }
 
       received += sr_size;
@@ -456,98 +734,205 @@ urpc_tcp_server_recv (uRpcTCPServer *urpc_tcp_server,
       urpc_timer_start (timer);
     }
 
-  /* Проверяем заголовок запроса. */
-  if (UINT32_FROM_BE (iheader->magic) != URPC_MAGIC)
+  return 0;
+}
+
+/* Функция возвращает системе память буфера за границей URPC_TCP_SERVER_KEEP_SIZE,
+   если в нём находилось size байт. */
+static void
+urpc_tcp_server_discard (uRpcTCPServer *urpc_tcp_server,
+                         void          *buffer,
+                         uint32_t       size)
+{
+  if (size > urpc_tcp_server->buffer_size)
+    size = urpc_tcp_server->buffer_size;
+  if (size <= URPC_TCP_SERVER_KEEP_SIZE)
+    return;
+
+  urpc_vmem_discard ((char *) buffer + URPC_TCP_SERVER_KEEP_SIZE, size - URPC_TCP_SERVER_KEEP_SIZE);
+}
+
+uRpcData *
+urpc_tcp_server_recv (uRpcTCPServer *urpc_tcp_server,
+                      uint32_t       thread_id)
+{
+  uRpcTCPServerClient *client;
+  uRpcData *urpc_data;
+  uRpcHeader *iheader;
+
+  uint32_t index = URPC_TCP_SERVER_NO_CLIENT;
+  uint32_t client_id;
+  uint32_t recv_size = 0;
+  int selected;
+
+#if defined(URPC_TCP_SERVER_EPOLL)
+  struct epoll_event event;
+#else
+  fd_set sock_set;
+  struct timeval sock_tv;
+  SOCKET max_fd = 0;
+  unsigned int i;
+#endif
+
+  if (urpc_tcp_server->urpc_tcp_server_type != URPC_TCP_SERVER_TYPE)
+    return NULL;
+  if (thread_id > urpc_tcp_server->threads_num - 1)
+    return NULL;
+
+  urpc_tcp_server->clients_per_threads[thread_id] = URPC_TCP_SERVER_NO_CLIENT;
+
+#if defined(URPC_TCP_SERVER_EPOLL)
+  /* Ожидаем запрос от клиента в течение 100мс. Все сокеты зарегистрированы с
+     флагом EPOLLONESHOT, поэтому готовый к чтению сокет достаётся только этому
+     потоку и до приёма запроса целиком в другие потоки не попадёт. */
+  selected = epoll_wait (urpc_tcp_server->epoll_fd, &event, 1, 100);
+  if (selected <= 0)
+    return NULL;
+
+  /* Проверяем, что клиент не был отключен после получения события. */
+  index = (uint32_t) event.data.u64;
+  client_id = (uint32_t) (event.data.u64 >> 32);
+  client = &urpc_tcp_server->clients[index];
+
+  urpc_rwmutex_writer_lock (&urpc_tcp_server->lock);
+  if (client->id != client_id || client->closed)
     {
-      urpc_tcp_server_remove_client (urpc_tcp_server, wsocket);
+      urpc_rwmutex_writer_unlock (&urpc_tcp_server->lock);
       return NULL;
     }
-  recv_size = UINT32_FROM_BE (iheader->size);
-  if (recv_size > urpc_tcp_server->buffer_size)
+  client->refs += 1;
+  urpc_rwmutex_writer_unlock (&urpc_tcp_server->lock);
+#else
+  /* Ожидаем запрос от клиента в течение 100мс. */
+  FD_ZERO (&sock_set);
+  sock_tv.tv_sec = 0;
+  sock_tv.tv_usec = 100000;
+
+  /* Список рабочих сокетов, запросы из которых сейчас не принимаются другими потоками. */
+  urpc_rwmutex_reader_lock (&urpc_tcp_server->lock);
+  for (i = 0; i < urpc_tcp_server->cur_clients; i++)
     {
-      urpc_tcp_server_remove_client (urpc_tcp_server, wsocket);
-      return NULL;
+      client = &urpc_tcp_server->clients[urpc_tcp_server->active[i]];
+      if (client->reading)
+        continue;
+      FD_SET (client->socket, &sock_set);
+      if (client->socket > max_fd)
+        max_fd = client->socket;
+    }
+  if (max_fd == 0)
+    {
+      FD_SET (urpc_tcp_server->lsocket, &sock_set);
+      max_fd = urpc_tcp_server->lsocket;
     }
+  urpc_rwmutex_reader_unlock (&urpc_tcp_server->lock);
 
-  /* Принимаем данные запроса. */
-  while (received != recv_size)
+  /* Ожидаем запрос. */
+  selected = select ((int) (max_fd + 1), &sock_set, NULL, NULL, &sock_tv);
+  if (selected <= 0)
+    return NULL;
+
+  /* Смотрим какой из клиентов прислал запрос и проверяем, что запрос
+     этого клиента не принимается в другом потоке. */
+  urpc_rwmutex_writer_lock (&urpc_tcp_server->lock);
+  for (i = 0; i < urpc_tcp_server->cur_clients; i++)
     {
-      /* Проверка таймаута при приёме данных. */
-      if (urpc_timer_elapsed (timer) > urpc_tcp_server->timeout)
+      client = &urpc_tcp_server->clients[urpc_tcp_server->active[i]];
+      if (!client->reading && FD_ISSET (client->socket, &sock_set))
         {
-          urpc_tcp_server_remove_client (urpc_tcp_server, wsocket);
-          return NULL;
+          index = urpc_tcp_server->active[i];
+          client->reading = 1;
+          client->refs += 1;
+          break;
         }
+    }
+  urpc_rwmutex_writer_unlock (&urpc_tcp_server->lock);
 
-      /* Проверяем возможность чтения из канала связи с интервалом в 100мс. */
-      FD_ZERO (&sock_set);
-      FD_SET (wsocket, &sock_set);
-      sock_tv.tv_sec = 0;
-      sock_tv.tv_usec = 100000;
+  /* Нет запросов. */
+  if (index == URPC_TCP_SERVER_NO_CLIENT)
+    return NULL;
 
-      selected = select ((int) (wsocket + 1), &sock_set, NULL, NULL, &sock_tv);
-      if (selected < 0)
-        {
-          int error = urpc_network_last_error ();
-          if (error == URPC_EINTR)
-            continue;
-          urpc_tcp_server_remove_client (urpc_tcp_server, wsocket);
-          return NULL;
-        }
+  client = &urpc_tcp_server->clients[index];
+  client_id = client->id;
+#endif
 
-      if (selected == 0)
-        continue;
+  urpc_data = urpc_tcp_server->urpc_data[thread_id];
+  iheader = urpc_data_get_header (urpc_data, URPC_DATA_INPUT);
 
-      /* Считываем данные. */
-      sr_size = recv (wsocket, (char *) iheader + received, recv_size - received, URPC_MSG_NOSIGNAL);
-      if (sr_size <= 0)
-        {
-          int error = urpc_network_last_error ();
-          if (error == URPC_EINTR || error == URPC_EAGAIN)
-            continue;
-          urpc_tcp_server_remove_client (urpc_tcp_server, wsocket);
-          return NULL;
-        }
+  /* Принимаем заголовок запроса. */
+  if (urpc_tcp_server_read (urpc_tcp_server, thread_id, client->socket,
+                            (char *) iheader, sizeof (uRpcHeader)) < 0)
+    goto urpc_tcp_server_recv_fail;
 
-      received += sr_size;
+  /* Проверяем заголовок запроса. */
+  if (UINT32_FROM_BE (iheader->magic) != URPC_MAGIC)
+    goto urpc_tcp_server_recv_fail;
+  recv_size = UINT32_FROM_BE (iheader->size);
+  if (recv_size > urpc_tcp_server->buffer_size || recv_size < sizeof (uRpcHeader))
+    goto urpc_tcp_server_recv_fail;
 
-      /* Перезапускаем таймер. */
-      urpc_timer_start (timer);
-    }
+  /* Принимаем данные запроса. */
+  if (urpc_tcp_server_read (urpc_tcp_server, thread_id, client->socket,
+                            (char *) iheader + sizeof (uRpcHeader), recv_size - sizeof (uRpcHeader)) < 0)
+    goto urpc_tcp_server_recv_fail;
+
+  /* Запрос принят целиком, следующий запрос клиента может быть принят другим
+     потоком параллельно с обработкой этого запроса. */
+#if defined(URPC_TCP_SERVER_EPOLL)
+  if (!client->closed && urpc_tcp_server_epoll_arm (urpc_tcp_server, index, EPOLL_CTL_MOD) < 0)
+    goto urpc_tcp_server_recv_fail;
+#else
+  urpc_rwmutex_writer_lock (&urpc_tcp_server->lock);
+  client->reading = 0;
+  urpc_rwmutex_writer_unlock (&urpc_tcp_server->lock);
+#endif
+
+  urpc_tcp_server->clients_per_threads[thread_id] = index;
 
   urpc_data_set_data_size (urpc_data, URPC_DATA_INPUT, recv_size - URPC_HEADER_SIZE);
 
   return urpc_data;
+
+urpc_tcp_server_recv_fail:
+  urpc_tcp_server_discard (urpc_tcp_server, iheader, recv_size);
+  urpc_tcp_server_remove_client (urpc_tcp_server, client_id);
+  urpc_tcp_server_unref_client (urpc_tcp_server, index);
+
+  return NULL;
 }
 
 int
 urpc_tcp_server_send (uRpcTCPServer *urpc_tcp_server,
                       uint32_t       thread_id)
 {
+  uRpcTCPServerClient *client;
   uRpcData *urpc_data;
+  uRpcHeader *iheader;
   uRpcHeader *oheader;
 
-  fd_set sock_set;
-  struct timeval sock_tv;
-
   uRpcTimer *timer;
   SOCKET wsocket;
 
+  uint32_t index;
+  uint32_t client_id;
   int selected;
   unsigned int send_size;
   unsigned int sended = 0;
   int sr_size;
+  int status = 0;
 
   if (urpc_tcp_server->urpc_tcp_server_type != URPC_TCP_SERVER_TYPE)
     return -1;
   if (thread_id > urpc_tcp_server->threads_num - 1)
     return -1;
 
-  wsocket = urpc_tcp_server->wsockets_per_threads[thread_id];
-  urpc_tcp_server->wsockets_per_threads[thread_id] = INVALID_SOCKET;
-  if (wsocket == INVALID_SOCKET)
+  index = urpc_tcp_server->clients_per_threads[thread_id];
+  urpc_tcp_server->clients_per_threads[thread_id] = URPC_TCP_SERVER_NO_CLIENT;
+  if (index == URPC_TCP_SERVER_NO_CLIENT)
     return -1;
 
+  client = &urpc_tcp_server->clients[index];
+  client_id = client->id;
+  wsocket = client->socket;
   timer = urpc_tcp_server->timers[thread_id];
 
   /* Отправляемые данные. */
@@ -555,33 +940,45 @@ urpc_tcp_server_send (uRpcTCPServer *urpc_tcp_server,
   oheader = urpc_data_get_header (urpc_data, URPC_DATA_OUTPUT);
   send_size = UINT32_FROM_BE (oheader->size);
 
+  /* Ответы разных потоков одному клиенту отправляются по очереди. */
+  urpc_mutex_lock (&client->send_lock);
+
+#if defined(URPC_TCP_SERVER_URING)
+  /* Отправляем ответ через io_uring, большие ответы - без копирования. */
+  if (urpc_tcp_server->urings[thread_id].uring != NULL)
+    {
+      int fixed = urpc_tcp_server->urings[thread_id].fixed;
+
+      if (send_size < URPC_TCP_SERVER_ZC_SIZE)
+        fixed = -1;
+      if (!client->closed &&
+          urpc_tcp_server_uring_io (urpc_tcp_server, thread_id, wsocket,
+                                    (char *) oheader, send_size, 1, fixed) == 0)
+        sended = send_size;
+    }
+#endif
+
   /* Время начала передачи. */
   urpc_timer_start (timer);
 
   /* Отправляем ответ. */
-  while (sended != send_size)
+  while (sended != send_size && !client->closed && urpc_tcp_server->urings[thread_id].uring == NULL)
     {
       /* Проверка таймаута при передаче данных. */
       if (urpc_timer_elapsed (timer) > urpc_tcp_server->timeout)
         {
-          urpc_tcp_server_remove_client (urpc_tcp_server, wsocket);
-          return -1;
+          status = -1;
+          break;
         }
 
       /* Проверяем возможность записи в канал связи с интервалом в 100мс. */
-      FD_ZERO (&sock_set);
-      FD_SET (wsocket, &sock_set);
-      sock_tv.tv_sec = 0;
-      sock_tv.tv_usec = 100000;
-
-      selected = select ((int) (wsocket + 1), NULL, &sock_set, NULL, &sock_tv);
+      selected = urpc_network_wait_write (wsocket, 0.1);
       if (selected < 0)
         {
-          int error = urpc_network_last_error ();
-          if (error == URPC_EINTR)
+          if (urpc_network_last_error () == URPC_EINTR)
             continue;
-          urpc_tcp_server_remove_client (urpc_tcp_server, wsocket);
-          return -1;
+          status = -1;
+          break;
         }
 
       if (selected == 0)
@@ -594,8 +991,8 @@ urpc_tcp_server_send (uRpcTCPServer *urpc_tcp_server,
           int error = urpc_network_last_error ();
           if (error == URPC_EINTR || error == URPC_EAGAIN)
             continue;
-          urpc_tcp_server_remove_client (urpc_tcp_server, wsocket);
-          return -1;
+          status = -1;
+          break;
         }
 
       sended += sr_size;
@@ -604,42 +1001,86 @@ urpc_tcp_server_send (uRpcTCPServer *urpc_tcp_server,
       urpc_timer_start (timer);
     }
 
-  return 0;
+  if (sended != send_size)
+    status = -1;
+
+  urpc_mutex_unlock (&client->send_lock);
+
+  /* Память, занятая большим запросом или ответом, больше не нужна. */
+  iheader = urpc_data_get_header (urpc_data, URPC_DATA_INPUT);
+  urpc_tcp_server_discard (urpc_tcp_server, iheader, UINT32_FROM_BE (iheader->size));
+  urpc_tcp_server_discard (urpc_tcp_server, oheader, send_size);
+
+  /* Ошибка при передаче, отключаем клиента. */
+  if (status < 0)
+    urpc_tcp_server_remove_client (urpc_tcp_server, client_id);
+
+  urpc_tcp_server_unref_client (urpc_tcp_server, index);
+
+  return status;
 }
 
-SOCKET
-urpc_tcp_server_get_client_socket (uRpcTCPServer *urpc_tcp_server,
-                                   uint32_t       thread_id)
+uint32_t
+urpc_tcp_server_get_client_id (uRpcTCPServer *urpc_tcp_server,
+                               uint32_t       thread_id)
 {
+  uint32_t index;
+
   if (urpc_tcp_server->urpc_tcp_server_type != URPC_TCP_SERVER_TYPE)
-    return INVALID_SOCKET;
+    return 0;
   if (thread_id > urpc_tcp_server->threads_num - 1)
-    return INVALID_SOCKET;
+    return 0;
+
+  /* Возвращаем идентификатор подключения текущего клиента обрабатываемого потоком. */
+  index = urpc_tcp_server->clients_per_threads[thread_id];
+  if (index == URPC_TCP_SERVER_NO_CLIENT)
+    return 0;
 
-  /* Возвращаем сокет текущего клиента обрабатываемого потоком. */
-  return urpc_tcp_server->wsockets_per_threads[thread_id];
+  return urpc_tcp_server->clients[index].id;
 }
 
 int
 urpc_tcp_server_remove_client (uRpcTCPServer *urpc_tcp_server,
-                                   SOCKET         wsocket)
+                               uint32_t       client_id)
 {
-  unsigned int i;
+  uRpcTCPServerClient *client;
+  uint32_t index;
+  uint32_t last;
 
   if (urpc_tcp_server->urpc_tcp_server_type != URPC_TCP_SERVER_TYPE)
     return -1;
 
-  /* Закрываем сокет указанного клиента и удаляем его из списка. */
   urpc_rwmutex_writer_lock (&urpc_tcp_server->lock);
-  for (i = 0; i < urpc_tcp_server->max_clients; i++)
+  index = urpc_hash_table_find_uint32 (urpc_tcp_server->ids, client_id);
+  if (index == 0)
     {
-      if (urpc_tcp_server->wsockets[i] == wsocket)
-        {
-          urpc_tcp_server->wsockets[i] = INVALID_SOCKET;
-          urpc_tcp_server->cur_clients -= 1;
-          break;
-        }
+      urpc_rwmutex_writer_unlock (&urpc_tcp_server->lock);
+      return -1;
     }
+
+  index -= 1;
+  client = &urpc_tcp_server->clients[index];
+  urpc_hash_table_remove (urpc_tcp_server->ids, client_id);
+
+#if defined(URPC_TCP_SERVER_EPOLL)
+  /* Прекращаем ожидать запросы от клиента. */
+  epoll_ctl (urpc_tcp_server->epoll_fd, EPOLL_CTL_DEL, client->socket, NULL);
+#endif
+
+  /* Удаляем клиента из списка подключенных. Освободившееся место занимает
+     последний клиент списка. */
+  last = urpc_tcp_server->cur_clients - 1;
+  if (client->position != last)
+    {
+      urpc_tcp_server->active[client->position] = urpc_tcp_server->active[last];
+      urpc_tcp_server->clients[urpc_tcp_server->active[last]].position = client->position;
+    }
+  urpc_tcp_server->cur_clients -= 1;
+
+  /* Сокет закрывается после завершения обработки всех запросов клиента. */
+  client->closed = 1;
+  if (client->refs == 0)
+    urpc_tcp_server_release_client (urpc_tcp_server, index);
   urpc_rwmutex_writer_unlock (&urpc_tcp_server->lock);
 
   return 0;
@@ -43,17 +43,21 @@ typedef struct _uRpcTCPServer uRpcTCPServer;
    При запуске сервера создаётся threads_num объектов каждый из которых может
    использоваться в своём потоке. Сами потоки создаются функцией urpc_server_create.
    В дальнейшем при вызове функций каждый поток передаёт свой идентификатор.
-   Параметры функции аналогичны urpc_server_create. */
+   Если use_uring не равен нулю и система поддерживает io_uring, запросы и ответы
+   передаются операциями io_uring, а большие ответы - из зарегистрированных буферов
+   без копирования. Остальные параметры функции аналогичны urpc_server_create. */
 uRpcTCPServer *urpc_tcp_server_create          (const char            *uri,
                                                 uint32_t               threads_num,
                                                 uint32_t               max_clients,
                                                 uint32_t               max_data_size,
+                                                int                    use_uring,
                                                 double                 timeout);
 
 /* Функция удаляет сервер. */
 void urpc_tcp_server_destroy                   (uRpcTCPServer         *urpc_tcp_server);
 
-/* Функция принимает один запрос в потоке thread_id. */
+/* Функция принимает один запрос в потоке thread_id. Запросы одного клиента
+   могут приниматься и обрабатываться несколькими потоками одновременно. */
 uRpcData *urpc_tcp_server_recv                 (uRpcTCPServer         *urpc_tcp_server,
                                                 uint32_t               thread_id);
 
@@ -61,13 +65,15 @@ uRpcData *urpc_tcp_server_recv                 (uRpcTCPServer         *urpc_tcp_
 int urpc_tcp_server_send                       (uRpcTCPServer         *urpc_tcp_server,
                                                 uint32_t               thread_id);
 
-/* Функция возвращает дескриптор сокета клиента обслуживаемого сейчас в потоке thread_id. */
-SOCKET urpc_tcp_server_get_client_socket       (uRpcTCPServer         *urpc_tcp_server,
+/* Функция возвращает идентификатор подключения клиента обслуживаемого сейчас в потоке thread_id.
+   Идентификаторы не повторяются для одновременно подключенных клиентов, 0 - нет клиента. */
+uint32_t urpc_tcp_server_get_client_id         (uRpcTCPServer         *urpc_tcp_server,
                                                 uint32_t               thread_id);
 
-/* Функция удаляет указанный сокет связи с клиентом из списка обслуживаемых. */
+/* Функция отключает клиента с указанным идентификатором подключения. Сокет клиента
+   закрывается после завершения обработки всех принятых от него запросов. */
 int urpc_tcp_server_remove_client              (uRpcTCPServer         *urpc_tcp_server,
-                                                SOCKET                 wsocket);
+                                                uint32_t               client_id);
 
 #ifdef __cplusplus
 }
@@ -46,12 +46,15 @@
  * о завершении дочернего потока с использованием функции #urpc_thread_join. Функция #urpc_thread_destroy
  * ожидает завершения потока и после этого освобождает память занятую управляющей структурой.
  *
+ * Функция #urpc_thread_set_affinity закрепляет выполнение потока за одним процессором.
+ *
  */
 
 #ifndef __URPC_THREAD_H__
 #define __URPC_THREAD_H__
 
 #include <urpc-exports.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -92,6 +95,21 @@ URPC_EXPORT
 uRpcThread *urpc_thread_create         (urpc_thread_func       func,
                                         void                  *data);
 
+/**
+ *
+ * Функция закрепляет выполнение потока за указанным процессором. В POSIX системах
+ * функция поддерживается только в Linux.
+ *
+ * \param thread указатель на поток;
+ * \param cpu номер процессора, начиная с нуля.
+ *
+ * \return 0 в случае успеха, иначе отрицательное число.
+ *
+ */
+URPC_EXPORT
+int urpc_thread_set_affinity           (uRpcThread            *thread,
+                                        uint32_t               cpu);
+
 /**
  *
  * функция ожидает завершения потока и освобождает память занятую управляющей структурой.
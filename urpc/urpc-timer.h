@@ -45,6 +45,8 @@
  * Функция urpc_timer_sleep может использоваться для остановки выполнения программы или
  * потока на заданную длительность времени.
  *
+ * Функция #urpc_timer_get_monotonic_time возвращает текущее монотонное время без создания таймера.
+ *
  */
 
 #ifndef __URPC_TIMER_H__
@@ -106,6 +108,17 @@ void urpc_timer_start          (uRpcTimer             *timer);
 URPC_EXPORT
 double urpc_timer_elapsed      (uRpcTimer             *timer);
 
+/**
+ *
+ * Функция возвращает текущее значение монотонного системного времени. Время
+ * отсчитывается от произвольного момента и не изменяется при переводе часов.
+ *
+ * \return Монотонное время в секундах.
+ *
+*/
+URPC_EXPORT
+double urpc_timer_get_monotonic_time (void);
+
 /**
  *
  * Функция останавливает выполнения программы на заданную длительность времени.
@@ -52,6 +52,14 @@
 #define URPC_DEFAULT_DATA_SIZE                 65000           /**< Размер данных передаваемых по RPC по умолчанию.
                                                                     Является максимально возможным для протокола UDP.*/
 #define URPC_MAX_THREADS_NUM                   32              /**< Максимально возможное число потоков сервера. */
+#define URPC_MAX_CONTEXTS_NUM                  4096            /**< Максимальное число запросов одновременно
+                                                                    принятых сервером, включая отложенные. */
+#define URPC_MAX_REQUESTS_NUM                  32              /**< Максимальное число одновременно выполняемых
+                                                                    запросов через одного клиента. */
+#define URPC_MAX_SHM_SLOTS_NUM                 1024            /**< Максимальное число одновременно выполняемых
+                                                                    запросов к SHM серверу. */
+#define URPC_MAX_UDP_BATCH_SIZE                64              /**< Максимальное число UDP запросов принимаемых
+                                                                    рабочим потоком за один системный вызов. */
 
 /* Пользовательские идентификаторы. */
 #define URPC_PARAM_USER                        0x20000000      /**< Идентификатор начала пользовательских параметров. */
@@ -52,6 +52,10 @@ struct _uRpcUDPClient
   uRpcData            *urpc_data;              /* Указатель на объект RPC данных. */
   uRpcTimer           *timer;                  /* Таймаут таймер. */
   double               timeout;                /* Таймаут обмена данными. */
+  uint32_t             request_id;             /* Идентификатор последнего запроса. */
+
+  uint64_t             retries;                /* Число повторных ожиданий ответа. */
+  double               wait_time;              /* Время ожидания ответа. */
 
   char                *self_address;           /* Локальный адрес. */
   char                *peer_address;           /* Адрес сервера. */
@@ -90,6 +94,9 @@ urpc_udp_client_create (const char *uri,
   urpc_udp_client->urpc_data = NULL;
   urpc_udp_client->timer = NULL;
   urpc_udp_client->timeout = timeout;
+  urpc_udp_client->request_id = 0;
+  urpc_udp_client->retries = 0;
+  urpc_udp_client->wait_time = 0.0;
   urpc_udp_client->self_address = NULL;
   urpc_udp_client->peer_address = NULL;
   urpc_udp_client->fail = 0;
@@ -230,12 +237,11 @@ urpc_udp_client_lock (uRpcUDPClient *urpc_udp_client)
 uint32_t
 urpc_udp_client_exchange (uRpcUDPClient *urpc_udp_client)
 {
-  fd_set sock_set;
-  struct timeval sock_tv;
-
   uRpcHeader *iheader;
   uRpcHeader *oheader;
 
+  double wait_start;
+  int selected;
   int recv_size;
 
   if (urpc_udp_client->urpc_udp_client_type != URPC_UDP_CLIENT_TYPE)
@@ -247,6 +253,10 @@ urpc_udp_client_exchange (uRpcUDPClient *urpc_udp_client)
   oheader = urpc_data_get_header (urpc_udp_client->urpc_data, URPC_DATA_OUTPUT);
   recv_size = UINT32_FROM_BE (oheader->size);
 
+  /* Идентификатор запроса, по нему отбрасываются запоздавшие ответы на предыдущие запросы. */
+  urpc_udp_client->request_id += 1;
+  oheader->id = UINT32_TO_BE (urpc_udp_client->request_id);
+
   /* Время начала передачи. */
   urpc_timer_start (urpc_udp_client->timer);
 
@@ -261,22 +271,26 @@ urpc_udp_client_exchange (uRpcUDPClient *urpc_udp_client)
   while (urpc_timer_elapsed (urpc_udp_client->timer) < urpc_udp_client->timeout)
     {
       /* Проверяем приход ответа с интервалом в 100мс. */
-      FD_ZERO (&sock_set);
-      FD_SET (urpc_udp_client->socket, &sock_set);
-      sock_tv.tv_sec = 0;
-      sock_tv.tv_usec = 100000;
-
-      if (select ((int) (urpc_udp_client->socket + 1), &sock_set, NULL, NULL, &sock_tv) < 0)
+      wait_start = urpc_timer_get_monotonic_time ();
+      selected = urpc_network_wait_read (urpc_udp_client->socket, 0.1);
+      urpc_udp_client->wait_time += urpc_timer_get_monotonic_time () - wait_start;
+      if (selected < 0)
         {
           if (urpc_network_last_error () == URPC_EINTR)
-            continue;
+            {
+              urpc_udp_client->retries += 1;
+              continue;
+            }
           urpc_udp_client->fail = 1;
           return URPC_STATUS_TRANSPORT_ERROR;
         }
 
       /* Если данных нет - ждём. */
-      if (!FD_ISSET (urpc_udp_client->socket, &sock_set))
-        continue;
+      if (selected == 0)
+        {
+          urpc_udp_client->retries += 1;
+          continue;
+        }
 
       /* Считываем ответ. */
       recv_size = recv (urpc_udp_client->socket, (void *) iheader, URPC_DEFAULT_BUFFER_SIZE, 0);
@@ -293,6 +307,8 @@ urpc_udp_client_exchange (uRpcUDPClient *urpc_udp_client)
         continue;
       if (UINT32_FROM_BE (iheader->magic) != URPC_MAGIC)
         continue;
+      if (UINT32_FROM_BE (iheader->id) != urpc_udp_client->request_id)
+        continue;
 
       urpc_data_set_data_size (urpc_udp_client->urpc_data, URPC_DATA_INPUT, recv_size - URPC_HEADER_SIZE);
 
@@ -302,6 +318,17 @@ urpc_udp_client_exchange (uRpcUDPClient *urpc_udp_client)
   return URPC_STATUS_TIMEOUT;
 }
 
+void
+urpc_udp_client_get_stats (uRpcUDPClient   *urpc_udp_client,
+                           uRpcClientStats *stats)
+{
+  if (urpc_udp_client->urpc_udp_client_type != URPC_UDP_CLIENT_TYPE)
+    return;
+
+  stats->retries += urpc_udp_client->retries;
+  stats->wait_time += (uint64_t) (1e9 * urpc_udp_client->wait_time);
+}
+
 const char *
 urpc_udp_client_get_self_address (uRpcUDPClient *urpc_udp_client)
 {
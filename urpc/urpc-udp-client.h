@@ -31,6 +31,7 @@
 
 #include <urpc-types.h>
 #include <urpc-data.h>
+#include <urpc-stats.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -52,6 +53,10 @@ uRpcData      *urpc_udp_client_lock                    (uRpcUDPClient         *u
 /* Функция производит отправку запроса серверу и приём от него ответа. */
 uint32_t       urpc_udp_client_exchange                (uRpcUDPClient         *urpc_udp_client);
 
+/* Функция добавляет в статистику клиента число повторных ожиданий и время ожидания транспорта. */
+void           urpc_udp_client_get_stats               (uRpcUDPClient         *urpc_udp_client,
+                                                        uRpcClientStats       *stats);
+
 /* Функция возвращает указатель на строку с локальным адресом в формате URI. */
 const char    *urpc_udp_client_get_self_address        (uRpcUDPClient         *urpc_udp_client);
 
@@ -23,40 +23,203 @@
  *
  */
 
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+
 #include "urpc-udp-server.h"
 #include "urpc-common.h"
 #include "urpc-network.h"
 #include "urpc-timer.h"
 #include "urpc-endian.h"
+#include "urpc-uring.h"
 
 #include <stdlib.h>
+#include <errno.h>
+
+#if defined(__linux__)
+#include <linux/filter.h>
+#endif
 
 #define URPC_UDP_SERVER_TYPE 0x53504455
 
+/* Пакетный приём и отправка дейтаграмм поддерживаются только в Linux. */
+#if defined(__linux__)
+#define URPC_UDP_SERVER_MMSG
+#endif
+
+/* Приём запросов через io_uring. Используется только если каждый поток работает со
+   своим сокетом: многократный приём забирает дейтаграммы из сокета заранее, и в
+   общем сокете запросы ожидали бы занятый поток при наличии свободных. */
+#if defined(URPC_UDP_SERVER_MMSG)
+#define URPC_UDP_SERVER_URING
+#endif
+
+/* Минимальное число областей приёма потока при работе через io_uring. */
+#define URPC_UDP_SERVER_URING_SLOTS    16
+
+/* Идентификатор операции многократного приёма, операции отправки ответов
+   идентифицируются номером области приёма запроса. */
+#define URPC_UDP_SERVER_URING_RECV     0xFFFFFFFF
+
+/* Признак отсутствия удерживаемой области приёма. */
+#define URPC_UDP_SERVER_NO_SLOT        0xFFFFFFFF
+
+/* Распределение запросов между сокетами по номеру процессора. */
+#if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+#define URPC_UDP_SERVER_STEERING
+#endif
+
+/* Состояние рабочего потока. Поток принимает за один системный вызов до batch_size
+   запросов, обрабатывает их по одному и отправляет накопленные ответы одним
+   системным вызовом после обработки последнего из них. */
+typedef struct
+{
+  SOCKET               socket;                 /* Сокет потока. */
+
+  uRpcData           **urpc_data;              /* Буферы приёма-передачи запросов пакета. */
+  struct sockaddr    **client_addr;            /* Адреса клиентов запросов пакета. */
+
+  uint32_t             received;               /* Число принятых запросов в пакете. */
+  uint32_t             current;                /* Номер следующего необработанного запроса. */
+  uint32_t             request;                /* Номер обрабатываемого запроса. */
+
+#ifdef URPC_UDP_SERVER_MMSG
+  struct mmsghdr      *imsgs;                  /* Описатели принимаемых дейтаграмм. */
+  struct iovec        *iovecs;                 /* Буферы принимаемых дейтаграмм. */
+  struct mmsghdr      *omsgs;                  /* Описатели отправляемых ответов. */
+  struct iovec        *ovecs;                  /* Буферы отправляемых ответов. */
+  uint32_t             replies;                /* Число накопленных ответов. */
+#endif
+
+#ifdef URPC_UDP_SERVER_URING
+  uRpcUring           *uring;                  /* Кольцо io_uring или NULL. */
+  char                *slots;                  /* Области приёма, предоставляемые ядру. */
+  uint32_t             slot_size;              /* Размер области приёма. */
+  uint32_t             name_size;              /* Место под адрес клиента в области приёма. */
+  struct msghdr        rmsg;                   /* Параметры многократного приёма. */
+  uint32_t             armed;                  /* Признак активного многократного приёма. */
+  uint32_t             held;                   /* Область обрабатываемого запроса. */
+  uint32_t             sending;                /* Число незавершённых отправок ответов. */
+#endif
+} uRpcUDPServerThread;
+
 struct _uRpcUDPServer
 {
   uint32_t             urpc_udp_server_type;   /* Тип объекта uRpcUDPServer. */
 
-  SOCKET               socket;                 /* Рабочий сокет. */
-  struct sockaddr    **client_addr;            /* Массив структур с адресами клиентов. */
+  SOCKET              *sockets;                /* Рабочие сокеты: один общий или по одному на поток. */
+  uint32_t             sockets_num;            /* Число рабочих сокетов. */
   size_t               client_addr_len;        /* Размер адреса клиента. */
 
-  uRpcData           **urpc_data;              /* Указатель на объекты RPC данных. */
+  uRpcUDPServerThread *threads;                /* Состояние рабочих потоков. */
   uint32_t             threads_num;            /* Число рабочих потоков. */
+  uint32_t             batch_size;             /* Максимальное число запросов в пакете. */
+  uint32_t             buffers_num;            /* Число буферов приёма-передачи потока. */
 };
 
+#ifdef URPC_UDP_SERVER_URING
+
+/* Функция подготавливает приём запросов потока через io_uring. Каждому буферу
+   приёма-передачи соответствует область приёма, в которую ядро помещает заголовок
+   сообщения, адрес клиента и сам запрос. Входной буфер RPC данных указывает на
+   запрос в этой области, поэтому запросы не копируются. Если io_uring недоступен,
+   поток принимает запросы обычным образом. */
+static void
+urpc_udp_server_uring_init (uRpcUDPServer       *urpc_udp_server,
+                            uRpcUDPServerThread *thread)
+{
+  uint32_t i;
+
+  thread->held = URPC_UDP_SERVER_NO_SLOT;
+  thread->name_size = (urpc_udp_server->client_addr_len + 7) & ~7;
+  thread->slot_size = (URPC_URING_RECVMSG_HEADER + thread->name_size + URPC_DEFAULT_BUFFER_SIZE + 63) & ~63;
+  thread->slots = malloc ((size_t) thread->slot_size * urpc_udp_server->buffers_num);
+  if (thread->slots == NULL)
+    return;
+
+  thread->uring = urpc_uring_create (2 * urpc_udp_server->buffers_num);
+  if (thread->uring == NULL)
+    goto urpc_udp_server_uring_init_fail;
+  if (urpc_uring_setup_buffers (thread->uring, 0, urpc_udp_server->buffers_num) < 0)
+    goto urpc_udp_server_uring_init_fail;
+
+  for (i = 0; i < urpc_udp_server->buffers_num; i++)
+    urpc_uring_provide_buffer (thread->uring, thread->slots + (size_t) i * thread->slot_size,
+                               thread->slot_size, (uint16_t) i);
+
+  /* Размер адреса клиента определяет смещение запроса в области приёма. */
+  thread->rmsg.msg_namelen = thread->name_size;
+
+  return;
+
+urpc_udp_server_uring_init_fail:
+  if (thread->uring != NULL)
+    urpc_uring_destroy (thread->uring);
+  free (thread->slots);
+  thread->uring = NULL;
+  thread->slots = NULL;
+}
+
+/* Функция возвращает указатель на запрос в области приёма. */
+static void *
+urpc_udp_server_uring_payload (uRpcUDPServerThread *thread,
+                               uint32_t             slot)
+{
+  return thread->slots + (size_t) slot * thread->slot_size + URPC_URING_RECVMSG_HEADER + thread->name_size;
+}
+
+/* Функция возвращает область приёма ядру. */
+static void
+urpc_udp_server_uring_release (uRpcUDPServerThread *thread,
+                               uint32_t             slot)
+{
+  urpc_uring_provide_buffer (thread->uring, thread->slots + (size_t) slot * thread->slot_size,
+                             thread->slot_size, (uint16_t) slot);
+}
+
+/* Функция дожидается завершения отправки ответов и прекращает работу через io_uring.
+   Приём запросов продолжается обычным образом в те же буферы. */
+static void
+urpc_udp_server_uring_stop (uRpcUDPServerThread *thread)
+{
+  uRpcUringEvent event;
+
+  while (thread->sending > 0 && urpc_uring_submit (thread->uring, 1, 1.0) == 0)
+    {
+      while (urpc_uring_get_event (thread->uring, &event) == 0)
+        if (event.user_data != URPC_UDP_SERVER_URING_RECV)
+          thread->sending -= 1;
+    }
+
+  urpc_uring_destroy (thread->uring);
+  thread->uring = NULL;
+}
+
+#endif
+
 uRpcUDPServer *
 urpc_udp_server_create (const char *uri,
                         uint32_t    threads_num,
+                        uint32_t    batch_size,
+                        int         reuse_port,
+                        int         use_uring,
                         double      timeout)
 {
   uRpcUDPServer *urpc_udp_server = NULL;
   struct addrinfo *addr = NULL;
-  unsigned int i;
+  unsigned int i, j;
 
   /* Проверка ограничений. */
-  if (threads_num > URPC_MAX_THREADS_NUM)
-    threads_num = URPC_MAX_THREADS_NUM;
+  if (threads_num > URPC_MAX_CONTEXTS_NUM)
+    threads_num = URPC_MAX_CONTEXTS_NUM;
+  if (batch_size > URPC_MAX_UDP_BATCH_SIZE)
+    batch_size = URPC_MAX_UDP_BATCH_SIZE;
+  if (batch_size < 1)
+    batch_size = 1;
+#ifndef URPC_UDP_SERVER_MMSG
+  batch_size = 1;
+#endif
 
   /* Проверяем тип адреса. */
   if (urpc_get_type (uri) != URPC_UDP)
@@ -68,55 +231,111 @@ urpc_udp_server_create (const char *uri,
     return NULL;
 
   urpc_udp_server->urpc_udp_server_type = URPC_UDP_SERVER_TYPE;
-  urpc_udp_server->socket = INVALID_SOCKET;
-  urpc_udp_server->client_addr = NULL;
-  urpc_udp_server->urpc_data = NULL;
+  urpc_udp_server->sockets = NULL;
+  urpc_udp_server->sockets_num = reuse_port ? threads_num : 1;
+  urpc_udp_server->threads = NULL;
   urpc_udp_server->threads_num = threads_num;
+  urpc_udp_server->batch_size = batch_size;
+  urpc_udp_server->buffers_num = batch_size;
 
-  /* Буферы приёма-передачи. */
-  urpc_udp_server->urpc_data = malloc (threads_num * sizeof (uRpcData *));
-  if (urpc_udp_server->urpc_data == NULL)
-    goto urpc_udp_server_create_fail;
-  for (i = 0; i < threads_num; i++)
-    urpc_udp_server->urpc_data[i] = NULL;
-
-  for (i = 0; i < threads_num; i++)
+#ifdef URPC_UDP_SERVER_URING
+  /* При работе через io_uring число областей приёма не зависит от размера пакета
+     и должно быть степенью двойки. */
+  if (use_uring && reuse_port)
     {
-      urpc_udp_server->urpc_data[i] = urpc_data_create (URPC_DEFAULT_BUFFER_SIZE, sizeof (uRpcHeader),
-                                                        NULL, NULL, 0);
-      if (urpc_udp_server->urpc_data[i] == NULL)
-        goto urpc_udp_server_create_fail;
+      urpc_udp_server->buffers_num = URPC_UDP_SERVER_URING_SLOTS;
+      while (urpc_udp_server->buffers_num < batch_size)
+        urpc_udp_server->buffers_num *= 2;
     }
+#endif
 
   /* Адрес сервера. */
   addr = urpc_get_sockaddr (uri);
   if (addr == NULL)
     goto urpc_udp_server_create_fail;
 
-  /* Рабочий сокет. */
-  urpc_udp_server->socket = socket (addr->ai_family, SOCK_DGRAM, addr->ai_protocol);
-  if (urpc_udp_server->socket == INVALID_SOCKET)
-    goto urpc_udp_server_create_fail;
-  urpc_network_set_non_block (urpc_udp_server->socket);
-  urpc_network_set_reuse (urpc_udp_server->socket);
-  if (bind (urpc_udp_server->socket, addr->ai_addr, (socklen_t) addr->ai_addrlen) < 0)
-    goto urpc_udp_server_create_fail;
+  urpc_udp_server->client_addr_len = addr->ai_addrlen;
 
-  /* Структуры для сохранения адресов клиентов. */
-  urpc_udp_server->client_addr = malloc (threads_num * sizeof (struct sockaddr *));
-  if (urpc_udp_server->client_addr == NULL)
+  /* Состояние рабочих потоков. */
+  urpc_udp_server->threads = calloc (threads_num, sizeof (uRpcUDPServerThread));
+  if (urpc_udp_server->threads == NULL)
     goto urpc_udp_server_create_fail;
-  for (i = 0; i < threads_num; i++)
-    urpc_udp_server->client_addr[i] = NULL;
 
   for (i = 0; i < threads_num; i++)
     {
-      urpc_udp_server->client_addr[i] = malloc (addr->ai_addrlen);
-      if (urpc_udp_server->client_addr[i] == NULL)
+      uRpcUDPServerThread *thread = &urpc_udp_server->threads[i];
+      void *ibuffer = NULL;
+
+#ifdef URPC_UDP_SERVER_URING
+      if (urpc_udp_server->buffers_num != batch_size)
+        urpc_udp_server_uring_init (urpc_udp_server, thread);
+#endif
+
+      /* Буферы приёма-передачи и адреса клиентов. */
+      thread->urpc_data = calloc (urpc_udp_server->buffers_num, sizeof (uRpcData *));
+      thread->client_addr = calloc (urpc_udp_server->buffers_num, sizeof (struct sockaddr *));
+      if (thread->urpc_data == NULL || thread->client_addr == NULL)
         goto urpc_udp_server_create_fail;
+
+      for (j = 0; j < urpc_udp_server->buffers_num; j++)
+        {
+#ifdef URPC_UDP_SERVER_URING
+          if (thread->slots != NULL)
+            ibuffer = urpc_udp_server_uring_payload (thread, j);
+#endif
+          thread->urpc_data[j] = urpc_data_create (URPC_DEFAULT_BUFFER_SIZE, sizeof (uRpcHeader),
+                                                   ibuffer, NULL, 0);
+          thread->client_addr[j] = malloc (addr->ai_addrlen);
+          if (thread->urpc_data[j] == NULL || thread->client_addr[j] == NULL)
+            goto urpc_udp_server_create_fail;
+        }
+
+#ifdef URPC_UDP_SERVER_MMSG
+      /* Описатели дейтаграмм для recvmmsg и sendmmsg. */
+      thread->imsgs = calloc (urpc_udp_server->buffers_num, sizeof (struct mmsghdr));
+      thread->iovecs = calloc (urpc_udp_server->buffers_num, sizeof (struct iovec));
+      thread->omsgs = calloc (urpc_udp_server->buffers_num, sizeof (struct mmsghdr));
+      thread->ovecs = calloc (urpc_udp_server->buffers_num, sizeof (struct iovec));
+      if (thread->imsgs == NULL || thread->iovecs == NULL ||
+          thread->omsgs == NULL || thread->ovecs == NULL)
+        goto urpc_udp_server_create_fail;
+
+      for (j = 0; j < batch_size; j++)
+        {
+          thread->iovecs[j].iov_base = urpc_data_get_header (thread->urpc_data[j], URPC_DATA_INPUT);
+          thread->iovecs[j].iov_len = URPC_DEFAULT_BUFFER_SIZE;
+          thread->imsgs[j].msg_hdr.msg_iov = &thread->iovecs[j];
+          thread->imsgs[j].msg_hdr.msg_iovlen = 1;
+          thread->imsgs[j].msg_hdr.msg_name = thread->client_addr[j];
+        }
+#endif
     }
 
-  urpc_udp_server->client_addr_len = addr->ai_addrlen;
+  /* Рабочие сокеты. В режиме reuse_port каждый поток работает со своим сокетом,
+     привязанным к общему адресу, а запросы между ними распределяет система. */
+  urpc_udp_server->sockets = malloc (urpc_udp_server->sockets_num * sizeof (SOCKET));
+  if (urpc_udp_server->sockets == NULL)
+    goto urpc_udp_server_create_fail;
+  for (i = 0; i < urpc_udp_server->sockets_num; i++)
+    urpc_udp_server->sockets[i] = INVALID_SOCKET;
+
+  for (i = 0; i < urpc_udp_server->sockets_num; i++)
+    {
+      SOCKET usocket = socket (addr->ai_family, SOCK_DGRAM, addr->ai_protocol);
+
+      urpc_udp_server->sockets[i] = usocket;
+      if (usocket == INVALID_SOCKET)
+        goto urpc_udp_server_create_fail;
+      urpc_network_set_non_block (usocket);
+      urpc_network_set_reuse (usocket);
+      if (reuse_port && urpc_network_set_reuse_port (usocket) < 0)
+        goto urpc_udp_server_create_fail;
+      if (bind (usocket, addr->ai_addr, (socklen_t) addr->ai_addrlen) < 0)
+        goto urpc_udp_server_create_fail;
+    }
+
+  for (i = 0; i < threads_num; i++)
+    urpc_udp_server->threads[i].socket = urpc_udp_server->sockets[i % urpc_udp_server->sockets_num];
 
   freeaddrinfo (addr);
 
@@ -133,46 +352,331 @@ urpc_udp_server_create_fail:
 void
 urpc_udp_server_destroy (uRpcUDPServer *urpc_udp_server)
 {
-  unsigned int i;
+  unsigned int i, j;
 
   if (urpc_udp_server->urpc_udp_server_type != URPC_UDP_SERVER_TYPE)
     return;
 
-  /* Закрываем рабочий сокет. */
-  if (urpc_udp_server->socket != INVALID_SOCKET)
-    closesocket (urpc_udp_server->socket);
-
-  if (urpc_udp_server->client_addr != NULL)
+  /* Закрываем рабочие сокеты. */
+  if (urpc_udp_server->sockets != NULL)
     {
-      for (i = 0; i < urpc_udp_server->threads_num; i++)
+      for (i = 0; i < urpc_udp_server->sockets_num; i++)
         {
-          if (urpc_udp_server->client_addr[i] != NULL)
-            free (urpc_udp_server->client_addr[i]);
+          if (urpc_udp_server->sockets[i] != INVALID_SOCKET)
+            closesocket (urpc_udp_server->sockets[i]);
         }
-      free (urpc_udp_server->client_addr);
+      free (urpc_udp_server->sockets);
     }
 
   /* Освобождаем память буферов приёма-передачи. */
-  if (urpc_udp_server->urpc_data != NULL)
+  if (urpc_udp_server->threads != NULL)
     {
       for (i = 0; i < urpc_udp_server->threads_num; i++)
         {
-          if (urpc_udp_server->urpc_data[i] != NULL)
-            urpc_data_destroy (urpc_udp_server->urpc_data[i]);
+          uRpcUDPServerThread *thread = &urpc_udp_server->threads[i];
+
+#ifdef URPC_UDP_SERVER_URING
+          /* Ядро может обращаться к областям приёма до завершения операций. */
+          if (thread->uring != NULL)
+            urpc_udp_server_uring_stop (thread);
+          free (thread->slots);
+#endif
+
+          for (j = 0; j < urpc_udp_server->buffers_num; j++)
+            {
+              if (thread->urpc_data != NULL && thread->urpc_data[j] != NULL)
+                urpc_data_destroy (thread->urpc_data[j]);
+              if (thread->client_addr != NULL && thread->client_addr[j] != NULL)
+                free (thread->client_addr[j]);
+            }
+
+          free (thread->urpc_data);
+          free (thread->client_addr);
+#ifdef URPC_UDP_SERVER_MMSG
+          free (thread->imsgs);
+          free (thread->iovecs);
+          free (thread->omsgs);
+          free (thread->ovecs);
+#endif
         }
-      free (urpc_udp_server->urpc_data);
+      free (urpc_udp_server->threads);
     }
 
   free (urpc_udp_server);
 }
 
+int
+urpc_udp_server_set_steering (uRpcUDPServer  *urpc_udp_server,
+                              const uint32_t *cpus,
+                              uint32_t        cpus_num)
+{
+#ifdef URPC_UDP_SERVER_STEERING
+  struct sock_filter code[2 * URPC_MAX_THREADS_NUM + 3];
+  struct sock_fprog prog;
+  uint32_t n = 0;
+  uint32_t i;
+
+  if (urpc_udp_server->urpc_udp_server_type != URPC_UDP_SERVER_TYPE)
+    return -1;
+  if (urpc_udp_server->sockets_num < 2)
+    return -1;
+
+  if (cpus_num > urpc_udp_server->sockets_num)
+    cpus_num = urpc_udp_server->sockets_num;
+  if (cpus_num > URPC_MAX_THREADS_NUM)
+    cpus_num = URPC_MAX_THREADS_NUM;
+
+  /* Программа возвращает номер сокета в группе (в порядке привязки) для процессора,
+     на котором обрабатывается пакет: сокет потока закреплённого за этим процессором
+     или номер процессора по модулю числа сокетов. */
+  code[n++] = (struct sock_filter) BPF_STMT (BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_CPU);
+  for (i = 0; i < cpus_num; i++)
+    {
+      code[n++] = (struct sock_filter) BPF_JUMP (BPF_JMP | BPF_JEQ | BPF_K, cpus[i], 0, 1);
+      code[n++] = (struct sock_filter) BPF_STMT (BPF_RET | BPF_K, i);
+    }
+  code[n++] = (struct sock_filter) BPF_STMT (BPF_ALU | BPF_MOD | BPF_K, urpc_udp_server->sockets_num);
+  code[n++] = (struct sock_filter) BPF_STMT (BPF_RET | BPF_A, 0);
+
+  prog.len = n;
+  prog.filter = code;
+
+  if (setsockopt (urpc_udp_server->sockets[0], SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof (prog)) < 0)
+    return -1;
+
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+/* Функция отправляет накопленные потоком ответы. */
+static int
+urpc_udp_server_flush (uRpcUDPServer       *urpc_udp_server,
+                       uRpcUDPServerThread *thread)
+{
+#ifdef URPC_UDP_SERVER_MMSG
+  uint32_t sended = 0;
+  int status = 0;
+
+  while (sended < thread->replies)
+    {
+      int n = sendmmsg (thread->socket, thread->omsgs + sended, thread->replies - sended, 0);
+
+      if (n < 0 && urpc_network_last_error () == URPC_EINTR)
+        continue;
+
+      /* Ответ, который не удалось отправить, пропускаем - клиент повторит запрос. */
+      if (n <= 0)
+        {
+          status = -1;
+          n = 1;
+        }
+
+      sended += n;
+    }
+
+  thread->replies = 0;
+
+  return status;
+#else
+  return 0;
+#endif
+}
+
+/* Функция возвращает следующий корректный запрос из принятого пакета. */
+static uRpcData *
+urpc_udp_server_next (uRpcUDPServer       *urpc_udp_server,
+                      uRpcUDPServerThread *thread)
+{
+#ifdef URPC_UDP_SERVER_MMSG
+  while (thread->current < thread->received)
+    {
+      uint32_t request = thread->current++;
+      struct msghdr *hdr = &thread->imsgs[request].msg_hdr;
+      uint32_t recv_size = thread->imsgs[request].msg_len;
+      uRpcData *urpc_data = thread->urpc_data[request];
+      uRpcHeader *iheader = urpc_data_get_header (urpc_data, URPC_DATA_INPUT);
+
+      /* Проверяем заголовок запроса. */
+      if (hdr->msg_namelen != urpc_udp_server->client_addr_len)
+        continue;
+      if (recv_size < URPC_HEADER_SIZE)
+        continue;
+      if (UINT32_FROM_BE (iheader->size) != recv_size)
+        continue;
+      if (UINT32_FROM_BE (iheader->magic) != URPC_MAGIC)
+        continue;
+
+      urpc_data_set_data_size (urpc_data, URPC_DATA_INPUT, recv_size - URPC_HEADER_SIZE);
+      thread->request = request;
+
+      return urpc_data;
+    }
+#endif
+
+  return NULL;
+}
+
+/* Функция принимает пакет запросов. */
+static int
+urpc_udp_server_recv_batch (uRpcUDPServer       *urpc_udp_server,
+                            uRpcUDPServerThread *thread)
+{
+#ifdef URPC_UDP_SERVER_MMSG
+  uint32_t i;
+  int n;
+
+  for (i = 0; i < urpc_udp_server->batch_size; i++)
+    thread->imsgs[i].msg_hdr.msg_namelen = (socklen_t) urpc_udp_server->client_addr_len;
+
+  n = recvmmsg (thread->socket, thread->imsgs, urpc_udp_server->batch_size, MSG_DONTWAIT, NULL);
+  if (n <= 0)
+    return -1;
+
+  thread->received = n;
+  thread->current = 0;
+
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+#ifdef URPC_UDP_SERVER_URING
+
+/* Функция возвращает следующий запрос, принятый через io_uring. Ответы на предыдущие
+   запросы передаются ядру тем же системным вызовом, которым ожидается приём. */
+static uRpcData *
+urpc_udp_server_uring_recv (uRpcUDPServer       *urpc_udp_server,
+                            uRpcUDPServerThread *thread)
+{
+  uRpcUringEvent event;
+  int timeout = 0;
+
+  /* Запрос, на который не был отправлен ответ. */
+  if (thread->held != URPC_UDP_SERVER_NO_SLOT)
+    {
+      urpc_udp_server_uring_release (thread, thread->held);
+      thread->held = URPC_UDP_SERVER_NO_SLOT;
+    }
+
+  while (1)
+    {
+      while (urpc_uring_get_event (thread->uring, &event) == 0)
+        {
+          uRpcData *urpc_data;
+          uRpcHeader *iheader;
+          uint32_t namelen;
+          uint32_t recv_size;
+          uint32_t slot;
+
+          /* Завершена отправка ответа, область приёма запроса освобождается. */
+          if (event.user_data != URPC_UDP_SERVER_URING_RECV)
+            {
+              thread->sending -= 1;
+              urpc_udp_server_uring_release (thread, (uint32_t) event.user_data);
+              continue;
+            }
+
+          if (!event.more)
+            thread->armed = 0;
+
+          /* Ядро не поддерживает многократный приём сообщений. */
+          if (event.result == -EINVAL)
+            {
+              urpc_udp_server_uring_stop (thread);
+              return NULL;
+            }
+
+          /* Ошибка или нехватка областей приёма - приём будет возобновлён. */
+          if (event.buffer < 0)
+            continue;
+
+          slot = (uint32_t) event.buffer;
+          urpc_data = thread->urpc_data[slot];
+          iheader = urpc_data_get_header (urpc_data, URPC_DATA_INPUT);
+
+          /* Проверяем заголовок запроса. */
+          if (urpc_uring_recvmsg_parse (thread->slots + (size_t) slot * thread->slot_size,
+                                        event.result, &namelen, &recv_size) < 0 ||
+              namelen != urpc_udp_server->client_addr_len ||
+              recv_size < URPC_HEADER_SIZE ||
+              UINT32_FROM_BE (iheader->size) != recv_size ||
+              UINT32_FROM_BE (iheader->magic) != URPC_MAGIC)
+            {
+              urpc_udp_server_uring_release (thread, slot);
+              continue;
+            }
+
+          urpc_data_set_data_size (urpc_data, URPC_DATA_INPUT, recv_size - URPC_HEADER_SIZE);
+          thread->request = slot;
+          thread->held = slot;
+
+          return urpc_data;
+        }
+
+      if (timeout)
+        return NULL;
+
+      /* Возобновляем приём запросов. */
+      if (!thread->armed)
+        {
+          if (urpc_uring_recvmsg_multishot (thread->uring, (int) thread->socket, &thread->rmsg,
+                                            0, URPC_UDP_SERVER_URING_RECV) == 0)
+            thread->armed = 1;
+        }
+
+      /* Ожидаем запросы в течение 500мс. */
+      timeout = urpc_uring_submit (thread->uring, 1, 0.5);
+      if (timeout < 0)
+        return NULL;
+    }
+}
+
+/* Функция ставит ответ в очередь отправки через io_uring. Очередь передаётся
+   ядру сразу, если принятых запросов больше нет, иначе - при приёме следующего. */
+static int
+urpc_udp_server_uring_send (uRpcUDPServer       *urpc_udp_server,
+                            uRpcUDPServerThread *thread,
+                            uint32_t             send_size)
+{
+  uint32_t slot = thread->held;
+  struct msghdr *omsg;
+  struct iovec *ovec;
+
+  if (slot == URPC_UDP_SERVER_NO_SLOT)
+    return -1;
+
+  omsg = &thread->omsgs[slot].msg_hdr;
+  ovec = &thread->ovecs[slot];
+
+  ovec->iov_base = urpc_data_get_header (thread->urpc_data[slot], URPC_DATA_OUTPUT);
+  ovec->iov_len = send_size;
+  omsg->msg_name = thread->slots + (size_t) slot * thread->slot_size + URPC_URING_RECVMSG_HEADER;
+  omsg->msg_namelen = (socklen_t) urpc_udp_server->client_addr_len;
+  omsg->msg_iov = ovec;
+  omsg->msg_iovlen = 1;
+
+  if (urpc_uring_sendmsg (thread->uring, (int) thread->socket, omsg, slot) < 0)
+    return -1;
+
+  thread->held = URPC_UDP_SERVER_NO_SLOT;
+  thread->sending += 1;
+
+  if (urpc_uring_get_ready (thread->uring) == 0)
+    urpc_uring_submit (thread->uring, 0, 0.0);
+
+  return 0;
+}
+
+#endif
+
 uRpcData *
 urpc_udp_server_recv (uRpcUDPServer *urpc_udp_server,
                       uint32_t       thread_id)
 {
-  fd_set sock_set;
-  struct timeval sock_tv;
-
+  uRpcUDPServerThread *thread;
   uRpcData *urpc_data;
   uRpcHeader *iheader;
   socklen_t client_addr_len;
@@ -183,25 +687,47 @@ urpc_udp_server_recv (uRpcUDPServer *urpc_udp_server,
   if (thread_id > urpc_udp_server->threads_num - 1)
     return NULL;
 
-  urpc_data = urpc_udp_server->urpc_data[thread_id];
+  thread = &urpc_udp_server->threads[thread_id];
+
+#ifdef URPC_UDP_SERVER_URING
+  if (thread->uring != NULL)
+    return urpc_udp_server_uring_recv (urpc_udp_server, thread);
+#endif
+
+  /* Пакетный приём запросов. */
+  if (urpc_udp_server->batch_size > 1)
+    {
+      /* Необработанные запросы из уже принятого пакета. */
+      urpc_data = urpc_udp_server_next (urpc_udp_server, thread);
+      if (urpc_data != NULL)
+        return urpc_data;
+
+      /* Перед приёмом нового пакета отправляем ответы на предыдущий. */
+      urpc_udp_server_flush (urpc_udp_server, thread);
+
+      /* Ожидаем запросы в течение 500мс, если их ещё нет в сокете. */
+      if (urpc_udp_server_recv_batch (urpc_udp_server, thread) < 0)
+        {
+          if (urpc_network_wait_read (thread->socket, 0.5) <= 0)
+            return NULL;
+          if (urpc_udp_server_recv_batch (urpc_udp_server, thread) < 0)
+            return NULL;
+        }
+
+      return urpc_udp_server_next (urpc_udp_server, thread);
+    }
+
+  urpc_data = thread->urpc_data[0];
   iheader = urpc_data_get_header (urpc_data, URPC_DATA_INPUT);
 
   /* Ожидаем запрос в течение 500мс. */
-  FD_ZERO (&sock_set);
-  FD_SET (urpc_udp_server->socket, &sock_set);
-  sock_tv.tv_sec = 0;
-  sock_tv.tv_usec = 500000;
-
-  /* Ждём данные. */
-  if (select ((int) (urpc_udp_server->socket + 1), &sock_set, NULL, NULL, &sock_tv) < 0)
-    return NULL;
-  if (!FD_ISSET (urpc_udp_server->socket, &sock_set))
+  if (urpc_network_wait_read (thread->socket, 0.5) <= 0)
     return NULL;
 
   /* Считываем данные. */
   client_addr_len = (socklen_t) urpc_udp_server->client_addr_len;
-  recv_size = recvfrom (urpc_udp_server->socket, (void *) iheader, URPC_DEFAULT_BUFFER_SIZE, 0,
-                        urpc_udp_server->client_addr[thread_id], &client_addr_len);
+  recv_size = recvfrom (thread->socket, (void *) iheader, URPC_DEFAULT_BUFFER_SIZE, 0,
+                        thread->client_addr[0], &client_addr_len);
   if (client_addr_len != urpc_udp_server->client_addr_len)
     return NULL;
   if (recv_size < 0)
@@ -222,6 +748,7 @@ int
 urpc_udp_server_send (uRpcUDPServer *urpc_udp_server,
                       uint32_t       thread_id)
 {
+  uRpcUDPServerThread *thread;
   uRpcData *urpc_data;
   uRpcHeader *oheader;
   int send_size;
@@ -232,14 +759,44 @@ urpc_udp_server_send (uRpcUDPServer *urpc_udp_server,
   if (thread_id > urpc_udp_server->threads_num - 1)
     return -1;
 
+  thread = &urpc_udp_server->threads[thread_id];
+
   /* Отправляемые данные. */
-  urpc_data = urpc_udp_server->urpc_data[thread_id];
+  urpc_data = thread->urpc_data[thread->request];
   oheader = urpc_data_get_header (urpc_data, URPC_DATA_OUTPUT);
   send_size = UINT32_FROM_BE (oheader->size);
 
+#ifdef URPC_UDP_SERVER_URING
+  if (thread->uring != NULL)
+    return urpc_udp_server_uring_send (urpc_udp_server, thread, send_size);
+#endif
+
+#ifdef URPC_UDP_SERVER_MMSG
+  /* Пакетная отправка - ответ ставится в очередь, очередь отправляется
+     после обработки последнего запроса пакета. */
+  if (urpc_udp_server->batch_size > 1)
+    {
+      struct mmsghdr *omsg = &thread->omsgs[thread->replies];
+      struct iovec *ovec = &thread->ovecs[thread->replies];
+
+      ovec->iov_base = oheader;
+      ovec->iov_len = send_size;
+      omsg->msg_hdr.msg_name = thread->client_addr[thread->request];
+      omsg->msg_hdr.msg_namelen = (socklen_t) urpc_udp_server->client_addr_len;
+      omsg->msg_hdr.msg_iov = ovec;
+      omsg->msg_hdr.msg_iovlen = 1;
+      thread->replies += 1;
+
+      if (thread->current < thread->received)
+        return 0;
+
+      return urpc_udp_server_flush (urpc_udp_server, thread);
+    }
+#endif
+
   /* Отправка ответа. */
-  sended = sendto (urpc_udp_server->socket, (void *) oheader, send_size, 0, 
-                   urpc_udp_server->client_addr[thread_id],
+  sended = sendto (thread->socket, (void *) oheader, send_size, 0,
+                   thread->client_addr[0],
                    (socklen_t)urpc_udp_server->client_addr_len);
   if (sended < 0)
     return -1;
@@ -42,19 +42,39 @@ typedef struct _uRpcUDPServer uRpcUDPServer;
    При запуске сервера создаётся threads_num объектов каждый из которых может
    использоваться в своём потоке. Сами потоки создаются функцией urpc_server_create.
    В дальнейшем при вызове функций каждый поток передаёт свой идентификатор.
-   Параметры функции аналогичны urpc_server_create. */
+   Каждый поток принимает за один системный вызов до batch_size запросов, а ответы
+   на них отправляет одним системным вызовом после обработки последнего запроса.
+   Пакетный приём поддерживается только в Linux, в остальных системах и при
+   batch_size равном 1 запросы принимаются по одному.
+   Если reuse_port не равен нулю, для каждого потока открывается свой сокет с
+   параметром SO_REUSEPORT и запросы между потоками распределяет система.
+   Если use_uring не равен нулю, в режиме reuse_port потоки принимают запросы
+   многократной операцией io_uring, а ответы передают ядру вместе с ожиданием
+   следующих запросов. Если io_uring не поддерживается системой, используются
+   обычные системные вызовы. Остальные параметры функции аналогичны urpc_server_create. */
 uRpcUDPServer *urpc_udp_server_create          (const char            *uri,
                                                 uint32_t               threads_num,
+                                                uint32_t               batch_size,
+                                                int                    reuse_port,
+                                                int                    use_uring,
                                                 double                 timeout);
 
+/* Функция направляет запросы, обрабатываемые системой на процессоре cpus[i], в сокет
+   потока i. Запросы с остальных процессоров распределяются по номеру процессора.
+   Работает только в режиме reuse_port в Linux. */
+int urpc_udp_server_set_steering               (uRpcUDPServer         *urpc_udp_server,
+                                                const uint32_t        *cpus,
+                                                uint32_t               cpus_num);
+
 /* Функция удаляет сервер. */
 void urpc_udp_server_destroy                   (uRpcUDPServer         *urpc_udp_server);
 
-/* Функция принимает один запрос в потоке thread_id. */
+/* Функция принимает один запрос в потоке thread_id. Запрос обрабатывается
+   до следующего вызова функции в этом потоке. */
 uRpcData *urpc_udp_server_recv                 (uRpcUDPServer         *urpc_udp_server,
                                                 uint32_t               thread_id);
 
-/* Функция отправляет ответ в потоке thread_id. */
+/* Функция отправляет ответ на последний принятый запрос в потоке thread_id. */
 int urpc_udp_server_send                       (uRpcUDPServer         *urpc_udp_server,
                                                 uint32_t               thread_id);
 
@@ -0,0 +1,627 @@
+/*
+ * uRPC - rpc (remote procedure call) library.
+ *
+ * Copyright 2009-2015 Andrei Fadeev (andrei@webcontrol.ru)
+ *
+ * This file is part of uRPC.
+ *
+ * uRPC is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * uRPC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the author in this case.
+ *
+ */
+
+#include "urpc-uring.h"
+
+#include <stdlib.h>
+
+/* Используются только системные вызовы и структуры из заголовков ядра, библиотека
+   liburing не требуется. Многократный приём сообщений и передача из
+   зарегистрированных буферов появились в заголовках ядра 6.0, более старые
+   версии не поддерживаются. */
+#if defined(__linux__) && defined(URPC_HAVE_IO_URING)
+#include <linux/io_uring.h>
+#if defined(IORING_RECV_MULTISHOT) && defined(IORING_RECVSEND_FIXED_BUF)
+#define URPC_URING_ENABLED
+#endif
+#endif
+
+#if defined(URPC_URING_ENABLED)
+
+#include "urpc-atomic.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+struct _uRpcUring
+{
+  int                       fd;                /* Дескриптор кольца. */
+
+  void                     *ring;              /* Общая с ядром память очередей. */
+  size_t                    ring_size;         /* Размер памяти очередей. */
+  struct io_uring_sqe      *sqes;              /* Массив операций. */
+  size_t                    sqes_size;         /* Размер массива операций. */
+
+  uint32_t                 *sq_head;           /* Начало очереди отправки (изменяется ядром). */
+  uint32_t                 *sq_tail;           /* Конец очереди отправки. */
+  uint32_t                  sq_mask;           /* Маска индекса очереди отправки. */
+  uint32_t                  sq_entries;        /* Размер очереди отправки. */
+  uint32_t                  sqe_tail;          /* Конец очереди с учётом подготавливаемых операций. */
+
+  uint32_t                 *cq_head;           /* Начало очереди завершения. */
+  uint32_t                 *cq_tail;           /* Конец очереди завершения (изменяется ядром). */
+  uint32_t                  cq_mask;           /* Маска индекса очереди завершения. */
+  struct io_uring_cqe      *cqes;              /* Результаты операций. */
+
+  struct io_uring_buf_ring *br;                /* Кольцо предоставляемых буферов. */
+  size_t                    br_size;           /* Размер кольца предоставляемых буферов. */
+  uint16_t                  br_mask;           /* Маска индекса кольца буферов. */
+  uint16_t                  br_tail;           /* Конец кольца буферов. */
+};
+
+static int
+urpc_uring_setup (uint32_t                entries,
+                  struct io_uring_params *params)
+{
+  return (int) syscall (__NR_io_uring_setup, entries, params);
+}
+
+static int
+urpc_uring_enter (int          fd,
+                  uint32_t     to_submit,
+                  uint32_t     min_complete,
+                  uint32_t     flags,
+                  const void  *arg,
+                  size_t       argsz)
+{
+  return (int) syscall (__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int
+urpc_uring_register (int          fd,
+                     uint32_t     opcode,
+                     const void  *arg,
+                     uint32_t     nr_args)
+{
+  return (int) syscall (__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/* Функция возвращает очередную операцию для заполнения или NULL, если очередь заполнена. */
+static struct io_uring_sqe *
+urpc_uring_get_sqe (uRpcUring *uring)
+{
+  struct io_uring_sqe *sqe;
+  uint32_t head = URPC_ATOMIC_LOAD (uring->sq_head);
+
+  if (uring->sqe_tail - head >= uring->sq_entries)
+    return NULL;
+
+  sqe = &uring->sqes[uring->sqe_tail & uring->sq_mask];
+  uring->sqe_tail += 1;
+
+  memset (sqe, 0, sizeof (struct io_uring_sqe));
+
+  return sqe;
+}
+
+uRpcUring *
+urpc_uring_create (uint32_t entries)
+{
+  uRpcUring *uring;
+  struct io_uring_params params;
+  char *ring;
+  size_t sq_size;
+  size_t cq_size;
+  uint32_t i;
+
+  uring = malloc (sizeof (uRpcUring));
+  if (uring == NULL)
+    return NULL;
+
+  memset (uring, 0, sizeof (uRpcUring));
+  uring->ring = MAP_FAILED;
+  uring->sqes = MAP_FAILED;
+  uring->br = MAP_FAILED;
+
+  /* Создаём кольцо. Ошибка возвращается и в случае запрета io_uring
+     (например, параметром kernel.io_uring_disabled или seccomp). */
+  memset (&params, 0, sizeof (params));
+  uring->fd = urpc_uring_setup (entries, &params);
+  if (uring->fd < 0)
+    goto urpc_uring_create_fail;
+
+  /* Необходимы общая память очередей и ожидание с таймаутом (ядро 5.11 и новее). */
+  if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG))
+    goto urpc_uring_create_fail;
+
+  /* Очереди отправки и завершения размещаются в одной области памяти. */
+  sq_size = params.sq_off.array + params.sq_entries * sizeof (uint32_t);
+  cq_size = params.cq_off.cqes + params.cq_entries * sizeof (struct io_uring_cqe);
+  uring->ring_size = (sq_size > cq_size) ? sq_size : cq_size;
+  uring->ring = mmap (NULL, uring->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      uring->fd, IORING_OFF_SQ_RING);
+  if (uring->ring == MAP_FAILED)
+    goto urpc_uring_create_fail;
+
+  uring->sqes_size = params.sq_entries * sizeof (struct io_uring_sqe);
+  uring->sqes = mmap (NULL, uring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      uring->fd, IORING_OFF_SQES);
+  if (uring->sqes == MAP_FAILED)
+    goto urpc_uring_create_fail;
+
+  ring = uring->ring;
+  uring->sq_head = (uint32_t *) (ring + params.sq_off.head);
+  uring->sq_tail = (uint32_t *) (ring + params.sq_off.tail);
+  uring->sq_mask = *(uint32_t *) (ring + params.sq_off.ring_mask);
+  uring->sq_entries = params.sq_entries;
+  uring->sqe_tail = *uring->sq_tail;
+  uring->cq_head = (uint32_t *) (ring + params.cq_off.head);
+  uring->cq_tail = (uint32_t *) (ring + params.cq_off.tail);
+  uring->cq_mask = *(uint32_t *) (ring + params.cq_off.ring_mask);
+  uring->cqes = (struct io_uring_cqe *) (ring + params.cq_off.cqes);
+
+  /* Операции в очереди отправки располагаются по порядку. */
+  for (i = 0; i < params.sq_entries; i++)
+    ((uint32_t *) (ring + params.sq_off.array))[i] = i;
+
+  return uring;
+
+urpc_uring_create_fail:
+  urpc_uring_destroy (uring);
+
+  return NULL;
+}
+
+void
+urpc_uring_destroy (uRpcUring *uring)
+{
+  if (uring->br != MAP_FAILED)
+    munmap (uring->br, uring->br_size);
+  if (uring->sqes != MAP_FAILED)
+    munmap (uring->sqes, uring->sqes_size);
+  if (uring->ring != MAP_FAILED)
+    munmap (uring->ring, uring->ring_size);
+  if (uring->fd >= 0)
+    close (uring->fd);
+
+  free (uring);
+}
+
+int
+urpc_uring_register_buffers (uRpcUring  *uring,
+                             void      **buffers,
+                             uint32_t    size,
+                             uint32_t    num)
+{
+  struct iovec *iovecs;
+  uint32_t i;
+  int status;
+
+  iovecs = malloc (num * sizeof (struct iovec));
+  if (iovecs == NULL)
+    return -1;
+
+  for (i = 0; i < num; i++)
+    {
+      iovecs[i].iov_base = buffers[i];
+      iovecs[i].iov_len = size;
+    }
+
+  status = urpc_uring_register (uring->fd, IORING_REGISTER_BUFFERS, iovecs, num);
+
+  free (iovecs);
+
+  return (status < 0) ? -1 : 0;
+}
+
+int
+urpc_uring_setup_buffers (uRpcUring *uring,
+                          uint16_t   group,
+                          uint32_t   num)
+{
+  struct io_uring_buf_reg reg;
+
+  if (uring->br != MAP_FAILED || num == 0 || num > 32768 || (num & (num - 1)) != 0)
+    return -1;
+
+  /* Память кольца должна быть выровнена по странице. */
+  uring->br_size = num * sizeof (struct io_uring_buf);
+  uring->br = mmap (NULL, uring->br_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (uring->br == MAP_FAILED)
+    return -1;
+
+  memset (&reg, 0, sizeof (reg));
+  reg.ring_addr = (uint64_t) (uintptr_t) uring->br;
+  reg.ring_entries = num;
+  reg.bgid = group;
+
+  if (urpc_uring_register (uring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+      munmap (uring->br, uring->br_size);
+      uring->br = MAP_FAILED;
+      return -1;
+    }
+
+  uring->br_mask = (uint16_t) (num - 1);
+  uring->br_tail = 0;
+
+  return 0;
+}
+
+void
+urpc_uring_provide_buffer (uRpcUring *uring,
+                           void      *buffer,
+                           uint32_t   size,
+                           uint16_t   id)
+{
+  struct io_uring_buf *buf = &uring->br->bufs[uring->br_tail & uring->br_mask];
+
+  buf->addr = (uint64_t) (uintptr_t) buffer;
+  buf->len = size;
+  buf->bid = id;
+
+  uring->br_tail += 1;
+  URPC_ATOMIC_STORE (&uring->br->tail, uring->br_tail);
+}
+
+int
+urpc_uring_recv (uRpcUring *uring,
+                 int        fd,
+                 void      *buffer,
+                 uint32_t   size,
+                 int        flags,
+                 int        fixed,
+                 uint64_t   user_data)
+{
+  struct io_uring_sqe *sqe = urpc_uring_get_sqe (uring);
+
+  if (sqe == NULL)
+    return -1;
+
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t) (uintptr_t) buffer;
+  sqe->len = size;
+  sqe->msg_flags = flags;
+  sqe->user_data = user_data;
+  if (fixed >= 0)
+    {
+      sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
+      sqe->buf_index = (uint16_t) fixed;
+    }
+
+  return 0;
+}
+
+int
+urpc_uring_send (uRpcUring  *uring,
+                 int         fd,
+                 const void *buffer,
+                 uint32_t    size,
+                 int         flags,
+                 int         fixed,
+                 uint64_t    user_data)
+{
+  struct io_uring_sqe *sqe = urpc_uring_get_sqe (uring);
+
+  if (sqe == NULL)
+    return -1;
+
+  sqe->opcode = IORING_OP_SEND;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t) (uintptr_t) buffer;
+  sqe->len = size;
+  sqe->msg_flags = flags;
+  sqe->user_data = user_data;
+
+  /* Из зарегистрированного или незарегистрированного (URPC_URING_UNREGISTERED) буфера
+     данные передаются без копирования. Операция завершается двумя событиями:
+     результатом передачи с признаком more и уведомлением об освобождении буфера. */
+  if (fixed >= 0 || fixed == URPC_URING_UNREGISTERED)
+    sqe->opcode = IORING_OP_SEND_ZC;
+  if (fixed >= 0)
+    {
+      sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
+      sqe->buf_index = (uint16_t) fixed;
+    }
+
+  return 0;
+}
+
+int
+urpc_uring_recvmsg_multishot (uRpcUring     *uring,
+                              int            fd,
+                              struct msghdr *msg,
+                              uint16_t       group,
+                              uint64_t       user_data)
+{
+  struct io_uring_sqe *sqe = urpc_uring_get_sqe (uring);
+
+  if (sqe == NULL)
+    return -1;
+
+  sqe->opcode = IORING_OP_RECVMSG;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t) (uintptr_t) msg;
+  sqe->len = 1;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = group;
+  sqe->user_data = user_data;
+
+  return 0;
+}
+
+int
+urpc_uring_recvmsg_parse (const void *buffer,
+                          int32_t     size,
+                          uint32_t   *namelen,
+                          uint32_t   *payloadlen)
+{
+  const struct io_uring_recvmsg_out *out = buffer;
+
+  if (size < (int32_t) sizeof (struct io_uring_recvmsg_out))
+    return -1;
+  if (out->flags & MSG_TRUNC)
+    return -1;
+
+  *namelen = out->namelen;
+  *payloadlen = out->payloadlen;
+
+  return 0;
+}
+
+int
+urpc_uring_sendmsg (uRpcUring           *uring,
+                    int                  fd,
+                    const struct msghdr *msg,
+                    uint64_t             user_data)
+{
+  struct io_uring_sqe *sqe = urpc_uring_get_sqe (uring);
+
+  if (sqe == NULL)
+    return -1;
+
+  sqe->opcode = IORING_OP_SENDMSG;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t) (uintptr_t) msg;
+  sqe->len = 1;
+  sqe->msg_flags = MSG_NOSIGNAL;
+  sqe->user_data = user_data;
+
+  return 0;
+}
+
+int
+urpc_uring_cancel (uRpcUring *uring,
+                   uint64_t   target,
+                   uint64_t   user_data)
+{
+  struct io_uring_sqe *sqe = urpc_uring_get_sqe (uring);
+
+  if (sqe == NULL)
+    return -1;
+
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->addr = target;
+  sqe->user_data = user_data;
+
+  return 0;
+}
+
+uint32_t
+urpc_uring_get_ready (uRpcUring *uring)
+{
+  return URPC_ATOMIC_LOAD (uring->cq_tail) - *uring->cq_head;
+}
+
+int
+urpc_uring_submit (uRpcUring *uring,
+                   uint32_t   wait_nr,
+                   double     timeout)
+{
+  struct io_uring_getevents_arg arg;
+  struct __kernel_timespec ts;
+  uint32_t flags = 0;
+
+  /* Публикуем подготовленные операции. */
+  URPC_ATOMIC_STORE (uring->sq_tail, uring->sqe_tail);
+
+  memset (&arg, 0, sizeof (arg));
+  arg.sigmask_sz = _NSIG / 8;
+  if (wait_nr > 0)
+    {
+      flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+      if (timeout >= 0.0)
+        {
+          ts.tv_sec = (int64_t) timeout;
+          ts.tv_nsec = (long long) ((timeout - (double) ts.tv_sec) * 1e9);
+          arg.ts = (uint64_t) (uintptr_t) &ts;
+        }
+    }
+
+  while (1)
+    {
+      uint32_t to_submit = uring->sqe_tail - URPC_ATOMIC_LOAD (uring->sq_head);
+
+      if (to_submit == 0 && wait_nr == 0)
+        return 0;
+
+      /* Если операции были переданы ядру, вызов возвращает их число и в случае
+         таймаута ожидания, поэтому таймаут определяется по отсутствию результатов. */
+      if (urpc_uring_enter (uring->fd, to_submit, wait_nr, flags,
+                            (wait_nr > 0) ? &arg : NULL, (wait_nr > 0) ? sizeof (arg) : 0) >= 0)
+        return (wait_nr > 0 && urpc_uring_get_ready (uring) == 0) ? 1 : 0;
+
+      if (errno == EINTR)
+        continue;
+      if (errno == ETIME)
+        return 1;
+
+      /* Очередь завершения переполнена - необходимо обработать результаты. */
+      if (errno == EBUSY || errno == EAGAIN)
+        return 0;
+
+      return -1;
+    }
+}
+
+int
+urpc_uring_get_event (uRpcUring      *uring,
+                      uRpcUringEvent *event)
+{
+  struct io_uring_cqe *cqe;
+  uint32_t head = *uring->cq_head;
+
+  if (head == URPC_ATOMIC_LOAD (uring->cq_tail))
+    return -1;
+
+  cqe = &uring->cqes[head & uring->cq_mask];
+  event->user_data = cqe->user_data;
+  event->result = cqe->res;
+  event->more = (cqe->flags & IORING_CQE_F_MORE) ? 1 : 0;
+  event->buffer = (cqe->flags & IORING_CQE_F_BUFFER) ? (int32_t) (cqe->flags >> IORING_CQE_BUFFER_SHIFT) : -1;
+
+  URPC_ATOMIC_STORE (uring->cq_head, head + 1);
+
+  return 0;
+}
+
+#else
+
+uRpcUring *
+urpc_uring_create (uint32_t entries)
+{
+  return NULL;
+}
+
+void
+urpc_uring_destroy (uRpcUring *uring)
+{
+}
+
+int
+urpc_uring_register_buffers (uRpcUring  *uring,
+                             void      **buffers,
+                             uint32_t    size,
+                             uint32_t    num)
+{
+  return -1;
+}
+
+int
+urpc_uring_setup_buffers (uRpcUring *uring,
+                          uint16_t   group,
+                          uint32_t   num)
+{
+  return -1;
+}
+
+void
+urpc_uring_provide_buffer (uRpcUring *uring,
+                           void      *buffer,
+                           uint32_t   size,
+                           uint16_t   id)
+{
+}
+
+int
+urpc_uring_recv (uRpcUring *uring,
+                 int        fd,
+                 void      *buffer,
+                 uint32_t   size,
+                 int        flags,
+                 int        fixed,
+                 uint64_t   user_data)
+{
+  return -1;
+}
+
+int
+urpc_uring_send (uRpcUring  *uring,
+                 int         fd,
+                 const void *buffer,
+                 uint32_t    size,
+                 int         flags,
+                 int         fixed,
+                 uint64_t    user_data)
+{
+  return -1;
+}
+
+int
+urpc_uring_recvmsg_multishot (uRpcUring     *uring,
+                              int            fd,
+                              struct msghdr *msg,
+                              uint16_t       group,
+                              uint64_t       user_data)
+{
+  return -1;
+}
+
+int
+urpc_uring_recvmsg_parse (const void *buffer,
+                          int32_t     size,
+                          uint32_t   *namelen,
+                          uint32_t   *payloadlen)
+{
+  return -1;
+}
+
+int
+urpc_uring_sendmsg (uRpcUring           *uring,
+                    int                  fd,
+                    const struct msghdr *msg,
+                    uint64_t             user_data)
+{
+  return -1;
+}
+
+int
+urpc_uring_cancel (uRpcUring *uring,
+                   uint64_t   target,
+                   uint64_t   user_data)
+{
+  return -1;
+}
+
+int
+urpc_uring_submit (uRpcUring *uring,
+                   uint32_t   wait_nr,
+                   double     timeout)
+{
+  return -1;
+}
+
+uint32_t
+urpc_uring_get_ready (uRpcUring *uring)
+{
+  return 0;
+}
+
+int
+urpc_uring_get_event (uRpcUring      *uring,
+                      uRpcUringEvent *event)
+{
+  return -1;
+}
+
+#endif
@@ -0,0 +1,164 @@
+/*
+ * uRPC - rpc (remote procedure call) library.
+ *
+ * Copyright 2009-2015 Andrei Fadeev (andrei@webcontrol.ru)
+ *
+ * This file is part of uRPC.
+ *
+ * uRPC is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * uRPC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the author in this case.
+ *
+ */
+
+/* Заголовочный файл асинхронного ввода-вывода через io_uring (Linux). Кольцо
+   принадлежит одному контексту сервера и не допускает одновременного обращения из
+   нескольких потоков. Операции накапливаются в очереди отправки и передаются
+   ядру одним системным вызовом вместе с ожиданием их завершения. Функции
+   используются библиотекой uRPC самостоятельно и не предназначены для пользователей.
+
+   Кольцо создаётся только если ядро поддерживает необходимые возможности. В
+   остальных системах функция urpc_uring_create возвращает NULL и транспорты
+   используют обычные системные вызовы. */
+
+#ifndef __URPC_URING_H__
+#define __URPC_URING_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct msghdr;
+
+/* Размер заголовка сообщения, принятого многократной операцией (io_uring_recvmsg_out). */
+#define URPC_URING_RECVMSG_HEADER      16
+
+/* Номер буфера для передачи без копирования из незарегистрированного буфера. */
+#define URPC_URING_UNREGISTERED        -2
+
+typedef struct _uRpcUring uRpcUring;
+
+/* Результат завершения операции. */
+typedef struct _uRpcUringEvent uRpcUringEvent;
+struct _uRpcUringEvent
+{
+  uint64_t             user_data;              /* Идентификатор операции. */
+  int32_t              result;                 /* Результат - число байт или -errno. */
+  uint32_t             more;                   /* Признак продолжения многократной операции. */
+  int32_t              buffer;                 /* Номер предоставленного буфера или -1. */
+};
+
+/* Функция создаёт кольцо на entries операций. Возвращает NULL, если io_uring
+   не поддерживается системой или запрещён. */
+uRpcUring *urpc_uring_create                   (uint32_t               entries);
+
+/* Функция удаляет кольцо. Незавершённые операции отменяются. */
+void urpc_uring_destroy                        (uRpcUring             *uring);
+
+/* Функция регистрирует в ядре num буферов размером size байт. В дальнейшем
+   буфер указывается своим номером в операциях приёма и передачи. */
+int urpc_uring_register_buffers                (uRpcUring             *uring,
+                                                void                 **buffers,
+                                                uint32_t               size,
+                                                uint32_t               num);
+
+/* Функция создаёт группу group из num (степень двойки) предоставляемых ядру буферов.
+   Сами буферы добавляются функцией urpc_uring_provide_buffer. */
+int urpc_uring_setup_buffers                   (uRpcUring             *uring,
+                                                uint16_t               group,
+                                                uint32_t               num);
+
+/* Функция возвращает ядру буфер номер id группы для приёма данных. */
+void urpc_uring_provide_buffer                 (uRpcUring             *uring,
+                                                void                  *buffer,
+                                                uint32_t               size,
+                                                uint16_t               id);
+
+/* Функция ставит в очередь приём size байт из сокета. Если fixed не отрицательный,
+   данные принимаются в зарегистрированный буфер с этим номером. Возвращает 0 или
+   отрицательное число, если очередь заполнена. */
+int urpc_uring_recv                            (uRpcUring             *uring,
+                                                int                    fd,
+                                                void                  *buffer,
+                                                uint32_t               size,
+                                                int                    flags,
+                                                int                    fixed,
+                                                uint64_t               user_data);
+
+/* Функция ставит в очередь передачу size байт в сокет. Параметры аналогичны urpc_uring_recv,
+   при fixed равном URPC_URING_UNREGISTERED данные передаются без копирования из
+   незарегистрированного буфера. */
+int urpc_uring_send                            (uRpcUring             *uring,
+                                                int                    fd,
+                                                const void            *buffer,
+                                                uint32_t               size,
+                                                int                    flags,
+                                                int                    fixed,
+                                                uint64_t               user_data);
+
+/* Функция ставит в очередь многократный приём сообщений в буферы группы group.
+   Каждое сообщение завершается отдельным событием, буфер начинается со структуры
+   io_uring_recvmsg_out, за которой следуют адрес отправителя размером msg_namelen
+   и данные. Структура msg используется ядром до завершения операции. */
+int urpc_uring_recvmsg_multishot               (uRpcUring             *uring,
+                                                int                    fd,
+                                                struct msghdr         *msg,
+                                                uint16_t               group,
+                                                uint64_t               user_data);
+
+/* Функция разбирает сообщение размером size байт, принятое многократной операцией
+   в буфер buffer. Возвращает размер адреса отправителя и данных или отрицательное
+   число, если сообщение было усечено. */
+int urpc_uring_recvmsg_parse                   (const void            *buffer,
+                                                int32_t                size,
+                                                uint32_t              *namelen,
+                                                uint32_t              *payloadlen);
+
+/* Функция ставит в очередь передачу сообщения. Структура msg и данные должны
+   сохраняться до завершения операции. */
+int urpc_uring_sendmsg                         (uRpcUring             *uring,
+                                                int                    fd,
+                                                const struct msghdr   *msg,
+                                                uint64_t               user_data);
+
+/* Функция ставит в очередь отмену операции с идентификатором target. Отменённая
+   операция завершается с результатом -ECANCELED, сама отмена завершается отдельным
+   событием с идентификатором user_data. */
+int urpc_uring_cancel                          (uRpcUring             *uring,
+                                                uint64_t               target,
+                                                uint64_t               user_data);
+
+/* Функция передаёт ядру накопленные операции и ожидает завершения не менее
+   wait_nr операций в течение timeout секунд (отрицательное значение - без
+   ограничения). Возвращает 0, 1 в случае таймаута или отрицательное число при ошибке. */
+int urpc_uring_submit                          (uRpcUring             *uring,
+                                                uint32_t               wait_nr,
+                                                double                 timeout);
+
+/* Функция возвращает число завершённых операций, результаты которых не извлечены. */
+uint32_t urpc_uring_get_ready                  (uRpcUring             *uring);
+
+/* Функция извлекает результат завершённой операции. Возвращает 0 или
+   отрицательное число, если завершённых операций нет. */
+int urpc_uring_get_event                       (uRpcUring             *uring,
+                                                uRpcUringEvent        *event);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __URPC_URING_H__ */
@@ -0,0 +1,58 @@
+/*
+ * uRPC - rpc (remote procedure call) library.
+ *
+ * Copyright 2009-2015 Andrei Fadeev (andrei@webcontrol.ru)
+ *
+ * This file is part of uRPC.
+ *
+ * uRPC is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * uRPC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the author in this case.
+ *
+ */
+
+/* Заголовочный файл области виртуальной памяти. Для области резервируется адресное
+   пространство заданного размера, а физическая память выделяется системой при первом
+   обращении к страницам. Адрес области не меняется всё время её существования. Память
+   страниц, которые больше не используются, можно вернуть системе без освобождения
+   самой области. Функции используются библиотекой uRPC самостоятельно и не
+   предназначены для пользователей. */
+
+#ifndef __URPC_VMEM_H__
+#define __URPC_VMEM_H__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Функция создаёт область виртуальной памяти размером size байт. */
+void *urpc_vmem_alloc                          (size_t                 size);
+
+/* Функция удаляет область виртуальной памяти размером size байт. */
+void urpc_vmem_free                            (void                  *address,
+                                                size_t                 size);
+
+/* Функция возвращает системе память страниц, целиком попадающих в заданную часть
+   области. При следующем обращении страницы будут заполнены нулями. */
+int urpc_vmem_discard                          (void                  *address,
+                                                size_t                 size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __URPC_VMEM_H__ */
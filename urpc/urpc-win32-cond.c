@@ -0,0 +1,67 @@
+/*
+ * uRPC - rpc (remote procedure call) library.
+ *
+ * Copyright 2015 Andrei Fadeev (andrei@webcontrol.ru)
+ *
+ * This file is part of uRPC.
+ *
+ * uRPC is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * uRPC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the author in this case.
+ *
+ */
+
+#include "urpc-cond.h"
+
+void
+urpc_cond_init (uRpcCond *cond)
+{
+  InitializeConditionVariable ((PCONDITION_VARIABLE)cond);
+}
+
+void
+urpc_cond_clear (uRpcCond *cond)
+{
+}
+
+void
+urpc_cond_wait (uRpcCond  *cond,
+                uRpcMutex *mutex)
+{
+  SleepConditionVariableCS ((PCONDITION_VARIABLE)cond, (PCRITICAL_SECTION)mutex, INFINITE);
+}
+
+int
+urpc_cond_timed_wait (uRpcCond  *cond,
+                      uRpcMutex *mutex,
+                      double     timeout)
+{
+  if (!SleepConditionVariableCS ((PCONDITION_VARIABLE)cond, (PCRITICAL_SECTION)mutex, (DWORD) (1000.0 * timeout)))
+    return 1;
+
+  return 0;
+}
+
+void
+urpc_cond_signal (uRpcCond *cond)
+{
+  WakeConditionVariable ((PCONDITION_VARIABLE)cond);
+}
+
+void
+urpc_cond_broadcast (uRpcCond *cond)
+{
+  WakeAllConditionVariable ((PCONDITION_VARIABLE)cond);
+}
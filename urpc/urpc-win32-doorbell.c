@@ -0,0 +1,150 @@
+/*
+ * uRPC - rpc (remote procedure call) library.
+ *
+ * Copyright 2015 Andrei Fadeev (andrei@webcontrol.ru)
+ *
+ * This file is part of uRPC.
+ *
+ * uRPC is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * uRPC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the author in this case.
+ *
+ */
+
+#include "urpc-doorbell.h"
+
+#include <windows.h>
+
+/* Минимальное число итераций активного опроса, позволяющее адаптации восстановиться. */
+#define URPC_DOORBELL_MIN_SPIN         16
+
+/* Число итераций опроса между проверками времени в urpc_doorbell_poll. */
+#define URPC_DOORBELL_POLL_SPIN        64
+
+/* Число уступок процессора перед переходом к ожиданию с засыпанием. */
+#define URPC_DOORBELL_YIELD_NUM        64
+
+/* В Windows нет межпроцессного аналога futex (WaitOnAddress работает только внутри процесса),
+   поэтому после активного опроса поток уступает процессор, а затем опрашивает сигнал
+   с интервалом в 1мс. Поле waiters не используется. */
+
+/* Функция сбрасывает установленный сигнал. */
+static int
+urpc_doorbell_consume (uRpcDoorbell *doorbell)
+{
+  if (*(volatile uint32_t*)&doorbell->signal != 1)
+    return 0;
+
+  return InterlockedCompareExchange ((volatile LONG*)&doorbell->signal, 0, 1) == 1;
+}
+
+void
+urpc_doorbell_ring (uRpcDoorbell *doorbell)
+{
+  InterlockedExchange ((volatile LONG*)&doorbell->signal, 1);
+}
+
+int
+urpc_doorbell_wait (uRpcDoorbell *doorbell,
+                    uint32_t     *spin,
+                    double        timeout)
+{
+  static DWORD cpus_num = 0;
+
+  ULONGLONG deadline = 0;
+  uint32_t i;
+
+  /* Активный опрос имеет смысл только если вторая сторона выполняется
+     на другом процессоре. */
+  if (cpus_num == 0)
+    {
+      SYSTEM_INFO info;
+      GetSystemInfo (&info);
+      cpus_num = info.dwNumberOfProcessors;
+    }
+
+  if (spin != NULL && cpus_num > 1)
+    {
+      for (i = 0; i < *spin; i++)
+        {
+          if (urpc_doorbell_consume (doorbell))
+            {
+              *spin = (*spin < URPC_DOORBELL_MAX_SPIN / 2) ? 2 * *spin : URPC_DOORBELL_MAX_SPIN;
+              return 0;
+            }
+          YieldProcessor ();
+        }
+      *spin = (*spin > 2 * URPC_DOORBELL_MIN_SPIN) ? *spin / 2 : URPC_DOORBELL_MIN_SPIN;
+    }
+
+  if (timeout >= 0.0)
+    deadline = GetTickCount64 () + (ULONGLONG) (1000.0 * timeout);
+
+  for (i = 0; ; i++)
+    {
+      if (urpc_doorbell_consume (doorbell))
+        return 0;
+
+      if (timeout >= 0.0 && GetTickCount64 () >= deadline)
+        return 1;
+
+      if (i < URPC_DOORBELL_YIELD_NUM)
+        SwitchToThread ();
+      else
+        Sleep (1);
+    }
+}
+
+int
+urpc_doorbell_poll (uRpcDoorbell *doorbell,
+                    double        time)
+{
+  LARGE_INTEGER frequency;
+  LARGE_INTEGER start;
+  LARGE_INTEGER cur;
+  uint32_t i;
+
+  QueryPerformanceFrequency (&frequency);
+  QueryPerformanceCounter (&start);
+
+  while (1)
+    {
+      for (i = 0; i < URPC_DOORBELL_POLL_SPIN; i++)
+        {
+          if (urpc_doorbell_consume (doorbell))
+            return 0;
+          YieldProcessor ();
+        }
+
+      QueryPerformanceCounter (&cur);
+      if ((double) (cur.QuadPart - start.QuadPart) / frequency.QuadPart >= time)
+        return 1;
+    }
+}
+
+int
+urpc_doorbell_trylock (volatile uint32_t *lock)
+{
+  if (InterlockedCompareExchange ((volatile LONG*)lock, 1, 0) == 0)
+    return 0;
+
+  return -1;
+}
+
+void
+urpc_doorbell_unlock (volatile uint32_t *lock)
+{
+  InterlockedExchange ((volatile LONG*)lock, 0);
+}
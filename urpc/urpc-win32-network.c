@@ -177,3 +177,37 @@ urpc_network_last_error_str (void)
 
   return urpc_network_win_errors[0].desc;
 }
+
+int
+urpc_network_wait_read (SOCKET socket,
+                        double timeout)
+{
+  fd_set sock_set;
+  struct timeval sock_tv;
+
+  FD_ZERO (&sock_set);
+  FD_SET (socket, &sock_set);
+  sock_tv.tv_sec = (long) timeout;
+  sock_tv.tv_usec = (long) (1000000.0 * (timeout - sock_tv.tv_sec));
+
+  return select (0, &sock_set, NULL, NULL, &sock_tv);
+}
+
+int
+urpc_network_wait_write (SOCKET socket,
+                         double timeout)
+{
+  fd_set sock_set;
+  fd_set err_set;
+  struct timeval sock_tv;
+
+  /* Ошибка подключения в Windows отмечается только в наборе исключений. */
+  FD_ZERO (&sock_set);
+  FD_ZERO (&err_set);
+  FD_SET (socket, &sock_set);
+  FD_SET (socket, &err_set);
+  sock_tv.tv_sec = (long) timeout;
+  sock_tv.tv_usec = (long) (1000000.0 * (timeout - sock_tv.tv_sec));
+
+  return select (0, NULL, &sock_set, &err_set, &sock_tv);
+}
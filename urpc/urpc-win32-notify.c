@@ -0,0 +1,120 @@
+/*
+ * uRPC - rpc (remote procedure call) library.
+ *
+ * Copyright 2009-2015 Andrei Fadeev (andrei@webcontrol.ru)
+ *
+ * This file is part of uRPC.
+ *
+ * uRPC is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * uRPC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the author in this case.
+ *
+ */
+
+#include "urpc-notify.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define URPC_NOTIFY_TYPE 0x59544E75
+
+/* В Windows функция select работает только с сокетами, поэтому оповещение
+   реализовано UDP сокетом, подключенным к собственному адресу. */
+struct _uRpcNotify
+{
+  uint32_t             urpc_notify_type;       /* Тип объекта uRpcNotify. */
+
+  SOCKET               socket;                 /* Сокет оповещения. */
+};
+
+uRpcNotify *
+urpc_notify_create (void)
+{
+  uRpcNotify *notify = malloc (sizeof (uRpcNotify));
+  struct sockaddr_in addr;
+  int addr_size = sizeof (addr);
+
+  if (notify == NULL)
+    return NULL;
+
+  notify->urpc_notify_type = URPC_NOTIFY_TYPE;
+
+  notify->socket = socket (AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (notify->socket == INVALID_SOCKET)
+    goto urpc_notify_create_fail;
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  if (bind (notify->socket, (struct sockaddr *) &addr, sizeof (addr)) != 0)
+    goto urpc_notify_create_fail;
+  if (getsockname (notify->socket, (struct sockaddr *) &addr, &addr_size) != 0)
+    goto urpc_notify_create_fail;
+  if (connect (notify->socket, (struct sockaddr *) &addr, sizeof (addr)) != 0)
+    goto urpc_notify_create_fail;
+  if (urpc_network_set_non_block (notify->socket) != 0)
+    goto urpc_notify_create_fail;
+
+  return notify;
+
+urpc_notify_create_fail:
+  if (notify->socket != INVALID_SOCKET)
+    closesocket (notify->socket);
+  free (notify);
+
+  return NULL;
+}
+
+void
+urpc_notify_destroy (uRpcNotify *notify)
+{
+  if (notify->urpc_notify_type != URPC_NOTIFY_TYPE)
+    return;
+
+  closesocket (notify->socket);
+  free (notify);
+}
+
+void
+urpc_notify_set (uRpcNotify *notify)
+{
+  char value = 1;
+
+  if (notify->urpc_notify_type != URPC_NOTIFY_TYPE)
+    return;
+
+  send (notify->socket, &value, 1, 0);
+}
+
+void
+urpc_notify_clear (uRpcNotify *notify)
+{
+  char value[64];
+
+  if (notify->urpc_notify_type != URPC_NOTIFY_TYPE)
+    return;
+
+  while (recv (notify->socket, value, sizeof (value), 0) > 0);
+}
+
+SOCKET
+urpc_notify_get_fd (uRpcNotify *notify)
+{
+  if (notify->urpc_notify_type != URPC_NOTIFY_TYPE)
+    return INVALID_SOCKET;
+
+  return notify->socket;
+}
@@ -139,3 +139,11 @@ urpc_shm_map (uRpcShm *shm)
 
   return shm->maddr;
 }
+
+int
+urpc_shm_discard (uRpcShm       *shm,
+                  void          *address,
+                  unsigned long  size)
+{
+  return -1;
+}
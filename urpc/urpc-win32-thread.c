@@ -46,6 +46,16 @@ urpc_thread_create (urpc_thread_func func,
   return thread;
 }
 
+int
+urpc_thread_set_affinity (uRpcThread *thread,
+                          uint32_t    cpu)
+{
+  if (cpu >= 8 * sizeof (DWORD_PTR))
+    return -1;
+
+  return SetThreadAffinityMask (*thread, (DWORD_PTR)1 << cpu) != 0 ? 0 : -1;
+}
+
 void
 urpc_thread_destroy (uRpcThread *thread)
 {
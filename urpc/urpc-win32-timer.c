@@ -89,6 +89,18 @@ urpc_timer_elapsed (uRpcTimer *timer)
   return elapsed;
 }
 
+double
+urpc_timer_get_monotonic_time (void)
+{
+  LARGE_INTEGER pfreq;
+  LARGE_INTEGER now;
+
+  QueryPerformanceFrequency (&pfreq);
+  QueryPerformanceCounter (&now);
+
+  return (double) now.QuadPart / (double) pfreq.QuadPart;
+}
+
 void
 urpc_timer_sleep (double time)
 {
@@ -0,0 +1,72 @@
+/*
+ * uRPC - rpc (remote procedure call) library.
+ *
+ * Copyright 2009-2015 Andrei Fadeev (andrei@webcontrol.ru)
+ *
+ * This file is part of uRPC.
+ *
+ * uRPC is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * uRPC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the author in this case.
+ *
+ */
+
+#include "urpc-vmem.h"
+
+#include <stdint.h>
+#include <windows.h>
+
+void *
+urpc_vmem_alloc (size_t size)
+{
+  /* Физические страницы выделяются системой при первом обращении к ним. */
+  return VirtualAlloc (NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+void
+urpc_vmem_free (void   *address,
+                size_t  size)
+{
+  (void) size;
+
+  if (address != NULL)
+    VirtualFree (address, 0, MEM_RELEASE);
+}
+
+int
+urpc_vmem_discard (void   *address,
+                   size_t  size)
+{
+  SYSTEM_INFO info;
+  uintptr_t page_size;
+  uintptr_t start;
+  uintptr_t stop;
+
+  /* Освобождаются только страницы, целиком попадающие в область. */
+  GetSystemInfo (&info);
+  page_size = (uintptr_t) info.dwPageSize;
+  start = ((uintptr_t) address + page_size - 1) & ~(page_size - 1);
+  stop = ((uintptr_t) address + size) & ~(page_size - 1);
+  if (start >= stop)
+    return 0;
+
+  /* Страницы снимаются с выделения и сразу выделяются заново, их адреса сохраняются. */
+  if (!VirtualFree ((void *) start, stop - start, MEM_DECOMMIT))
+    return -1;
+  if (VirtualAlloc ((void *) start, stop - start, MEM_COMMIT, PAGE_READWRITE) == NULL)
+    return -1;
+
+  return 0;
+}